@@ -40,6 +40,7 @@ public:
 	virtual DirectX::XMFLOAT4X4 getWorld() const;
 	ObjectType getType() const { return m_type; };
 	int getId() const { return m_id; };
+	const std::string& getName() const { return m_name; };
 
 protected:
 	DirectX::XMFLOAT3 m_pos;
@@ -0,0 +1,309 @@
+#include "brickedField.h"
+#include "parallel.h"
+
+#include <emmintrin.h>
+
+#include <limits>
+#include <cstring>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const int SAMPLE_GRAIN = 256; // Packets of 4 positions per chunk of work of the batch sampling
+
+	inline __m128 lerp(__m128 a, __m128 b, __m128 t)
+	{
+		return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+	}
+
+	// Components of one cell in the lanes
+	inline __m128 cell(const float* data, size_t offset, int components)
+	{
+		const float* p = data + offset;
+		const int n = BrickedField::BRICK_CELLS;
+		switch (components)
+		{
+		case 1:
+			return _mm_set_ss(p[0]);
+		case 2:
+			return _mm_setr_ps(p[0], p[n], 0.0f, 0.0f);
+		case 3:
+			return _mm_setr_ps(p[0], p[n], p[2 * n], 0.0f);
+		default:
+			return _mm_setr_ps(p[0], p[n], p[2 * n], p[3 * n]);
+		}
+	}
+}
+
+BrickedField::BrickedField(int components)
+	: m_components(std::max(1, std::min(components, 4))),
+	m_resolution(0, 0, 0),
+	m_bricks(0, 0, 0),
+	m_max(0.0f, 0.0f, 0.0f, 0.0f),
+	m_numBricks(0),
+	m_offsetX(),
+	m_offsetY(),
+	m_offsetZ(),
+	m_data()
+{
+}
+
+void BrickedField::resize(const XMUINT3& resolution)
+{
+	if (resolution.x == m_resolution.x && resolution.y == m_resolution.y && resolution.z == m_resolution.z)
+		return;
+
+	m_resolution = resolution;
+	m_bricks = XMUINT3((resolution.x + BRICK_SIZE - 1) / BRICK_SIZE, (resolution.y + BRICK_SIZE - 1) / BRICK_SIZE, (resolution.z + BRICK_SIZE - 1) / BRICK_SIZE);
+	m_numBricks = static_cast<size_t>(m_bricks.x) * m_bricks.y * m_bricks.z;
+	m_max = XMFLOAT4(static_cast<float>(std::max(resolution.x, 1u) - 1), static_cast<float>(std::max(resolution.y, 1u) - 1), static_cast<float>(std::max(resolution.z, 1u) - 1), 0.0f);
+
+	const size_t brickStride = static_cast<size_t>(BRICK_CELLS) * m_components;
+	auto table = [](std::vector<size_t>& offsets, unsigned int size, size_t stride, size_t cellStride)
+	{
+		offsets.resize(size + 1);
+		for (unsigned int i = 0; i < size; ++i)
+			offsets[i] = (i / BRICK_SIZE) * stride + (i % BRICK_SIZE) * cellStride;
+		offsets[size] = size > 0 ? offsets[size - 1] : 0;
+	};
+	table(m_offsetX, resolution.x, brickStride, 1);
+	table(m_offsetY, resolution.y, brickStride * m_bricks.x, BRICK_SIZE);
+	table(m_offsetZ, resolution.z, brickStride * m_bricks.x * m_bricks.y, BRICK_SIZE * BRICK_SIZE);
+
+	std::vector<float>(m_numBricks * brickStride, 0.0f).swap(m_data);
+}
+
+void BrickedField::fromLinear(const float* linear, int stride, const XMUINT3& resolution, int threads)
+{
+	resize(resolution);
+
+	const size_t resX = m_resolution.x;
+	const size_t resY = m_resolution.y;
+	const int components = std::min(m_components, stride);
+
+	// One row of bricks along x per chunk of work; every row of cells is read once and split into the bricks
+	Parallel::forRange(0, static_cast<int>(m_bricks.y * m_bricks.z), [&](int first, int last)
+	{
+		for (int row = first; row < last; ++row)
+		{
+			const int y0 = (row % m_bricks.y) * BRICK_SIZE;
+			const int z0 = (row / m_bricks.y) * BRICK_SIZE;
+			const int y1 = std::min(y0 + BRICK_SIZE, static_cast<int>(m_resolution.y));
+			const int z1 = std::min(z0 + BRICK_SIZE, static_cast<int>(m_resolution.z));
+			for (int z = z0; z < z1; ++z)
+			{
+				for (int y = y0; y < y1; ++y)
+				{
+					const float* in = linear + stride * (resX * (y + resY * z));
+					float* out = m_data.data() + m_offsetY[y] + m_offsetZ[z];
+					for (size_t x = 0; x < resX; x += BRICK_SIZE)
+					{
+						float* brick = out + m_offsetX[x];
+						const size_t n = std::min(resX - x, static_cast<size_t>(BRICK_SIZE));
+						if (stride == 4 && n == BRICK_SIZE)
+						{
+							// 4 cells per transpose
+							for (int half = 0; half < BRICK_SIZE; half += 4)
+							{
+								const float* cells = in + 4 * (x + half);
+								__m128 c0 = _mm_loadu_ps(cells);
+								__m128 c1 = _mm_loadu_ps(cells + 4);
+								__m128 c2 = _mm_loadu_ps(cells + 8);
+								__m128 c3 = _mm_loadu_ps(cells + 12);
+								_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+								const __m128 values[4] = { c0, c1, c2, c3 };
+								for (int c = 0; c < components; ++c)
+									_mm_storeu_ps(brick + BRICK_CELLS * c + half, values[c]);
+							}
+						}
+						else if (stride == 1)
+						{
+							std::memcpy(brick, in + x, n * sizeof(float));
+						}
+						else
+						{
+							for (size_t i = 0; i < n; ++i)
+							{
+								for (int c = 0; c < components; ++c)
+									brick[BRICK_CELLS * c + i] = in[stride * (x + i) + c];
+							}
+						}
+					}
+				}
+			}
+		}
+	}, threads);
+}
+
+void BrickedField::toLinear(float* linear, int stride, int threads) const
+{
+	const size_t resX = m_resolution.x;
+	const size_t resY = m_resolution.y;
+	const int components = std::min(m_components, stride);
+
+	Parallel::forRange(0, static_cast<int>(m_bricks.y * m_bricks.z), [&](int first, int last)
+	{
+		for (int row = first; row < last; ++row)
+		{
+			const int y0 = (row % m_bricks.y) * BRICK_SIZE;
+			const int z0 = (row / m_bricks.y) * BRICK_SIZE;
+			const int y1 = std::min(y0 + BRICK_SIZE, static_cast<int>(m_resolution.y));
+			const int z1 = std::min(z0 + BRICK_SIZE, static_cast<int>(m_resolution.z));
+			for (int z = z0; z < z1; ++z)
+			{
+				for (int y = y0; y < y1; ++y)
+				{
+					float* out = linear + stride * (resX * (y + resY * z));
+					const float* in = m_data.data() + m_offsetY[y] + m_offsetZ[z];
+					for (size_t x = 0; x < resX; x += BRICK_SIZE)
+					{
+						const float* brick = in + m_offsetX[x];
+						const size_t n = std::min(resX - x, static_cast<size_t>(BRICK_SIZE));
+						if (stride == 4 && n == BRICK_SIZE)
+						{
+							for (int half = 0; half < BRICK_SIZE; half += 4)
+							{
+								__m128 values[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+								for (int c = 0; c < components; ++c)
+									values[c] = _mm_loadu_ps(brick + BRICK_CELLS * c + half);
+								_MM_TRANSPOSE4_PS(values[0], values[1], values[2], values[3]);
+								float* cells = out + 4 * (x + half);
+								_mm_storeu_ps(cells, values[0]);
+								_mm_storeu_ps(cells + 4, values[1]);
+								_mm_storeu_ps(cells + 8, values[2]);
+								_mm_storeu_ps(cells + 12, values[3]);
+							}
+						}
+						else if (stride == 1)
+						{
+							std::memcpy(out + x, brick, n * sizeof(float));
+						}
+						else
+						{
+							for (size_t i = 0; i < n; ++i)
+							{
+								for (int c = 0; c < stride; ++c)
+									out[stride * (x + i) + c] = c < components ? brick[BRICK_CELLS * c + i] : 0.0f;
+							}
+						}
+					}
+				}
+			}
+		}
+	}, threads);
+}
+
+XMVECTOR BrickedField::gather(const XMINT3* cells, int component) const
+{
+	const float* data = m_data.data() + BRICK_CELLS * component;
+	return _mm_setr_ps(data[offset(cells[0].x, cells[0].y, cells[0].z)], data[offset(cells[1].x, cells[1].y, cells[1].z)],
+		data[offset(cells[2].x, cells[2].y, cells[2].z)], data[offset(cells[3].x, cells[3].y, cells[3].z)]);
+}
+
+XMVECTOR BrickedField::sample(FXMVECTOR position) const
+{
+	// As FieldSampler::corners; the upper corners of the last cells are the extra table entries
+	const __m128 max = _mm_loadu_ps(&m_max.x);
+	__m128 f = _mm_min_ps(_mm_max_ps(_mm_sub_ps(position, _mm_set1_ps(0.5f)), _mm_setzero_ps()), max);
+	__m128i cellIds = _mm_cvttps_epi32(f);
+	__m128 t = _mm_sub_ps(f, _mm_cvtepi32_ps(cellIds));
+	int id[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(id), cellIds);
+
+	const size_t x0 = m_offsetX[id[0]], x1 = m_offsetX[id[0] + 1];
+	const size_t y0 = m_offsetY[id[1]], y1 = m_offsetY[id[1] + 1];
+	const size_t z0 = m_offsetZ[id[2]], z1 = m_offsetZ[id[2] + 1];
+	const float* data = m_data.data();
+	const int n = m_components;
+
+	__m128 tx = _mm_shuffle_ps(t, t, _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 ty = _mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 tz = _mm_shuffle_ps(t, t, _MM_SHUFFLE(2, 2, 2, 2));
+	__m128 c00 = lerp(cell(data, x0 + y0 + z0, n), cell(data, x1 + y0 + z0, n), tx);
+	__m128 c10 = lerp(cell(data, x0 + y1 + z0, n), cell(data, x1 + y1 + z0, n), tx);
+	__m128 c01 = lerp(cell(data, x0 + y0 + z1, n), cell(data, x1 + y0 + z1, n), tx);
+	__m128 c11 = lerp(cell(data, x0 + y1 + z1, n), cell(data, x1 + y1 + z1, n), tx);
+	return lerp(lerp(c00, c10, ty), lerp(c01, c11, ty), tz);
+}
+
+void BrickedField::sample(const XMFLOAT3* positions, size_t count, float* values, int threads) const
+{
+	const __m128 invalid = _mm_set1_ps(std::numeric_limits<float>::quiet_NaN());
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 maxX = _mm_set1_ps(m_max.x), maxY = _mm_set1_ps(m_max.y), maxZ = _mm_set1_ps(m_max.z);
+	const __m128 resX = _mm_set1_ps(static_cast<float>(m_resolution.x));
+	const __m128 resY = _mm_set1_ps(static_cast<float>(m_resolution.y));
+	const __m128 resZ = _mm_set1_ps(static_cast<float>(m_resolution.z));
+	const int numPackets = static_cast<int>((count + 3) / 4);
+
+	Parallel::forRange(0, numPackets, [&](int first, int last)
+	{
+		for (int packet = first; packet < last; ++packet)
+		{
+			// One position per lane; the lanes of an incomplete last packet repeat its last position
+			const size_t base = 4 * static_cast<size_t>(packet);
+			const size_t numLanes = std::min(count - base, static_cast<size_t>(4));
+			const XMFLOAT3* p[4];
+			for (size_t lane = 0; lane < 4; ++lane)
+				p[lane] = positions + base + std::min(lane, numLanes - 1);
+			__m128 px = _mm_setr_ps(p[0]->x, p[1]->x, p[2]->x, p[3]->x);
+			__m128 py = _mm_setr_ps(p[0]->y, p[1]->y, p[2]->y, p[3]->y);
+			__m128 pz = _mm_setr_ps(p[0]->z, p[1]->z, p[2]->z, p[3]->z);
+
+			// Within [0, resolution]; NaN fails the comparisons
+			__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(px, zero), _mm_cmple_ps(px, resX)),
+				_mm_and_ps(_mm_and_ps(_mm_cmpge_ps(py, zero), _mm_cmple_ps(py, resY)), _mm_and_ps(_mm_cmpge_ps(pz, zero), _mm_cmple_ps(pz, resZ))));
+
+			__m128 fx = _mm_min_ps(_mm_max_ps(_mm_sub_ps(px, half), zero), maxX);
+			__m128 fy = _mm_min_ps(_mm_max_ps(_mm_sub_ps(py, half), zero), maxY);
+			__m128 fz = _mm_min_ps(_mm_max_ps(_mm_sub_ps(pz, half), zero), maxZ);
+			__m128i ix = _mm_cvttps_epi32(fx), iy = _mm_cvttps_epi32(fy), iz = _mm_cvttps_epi32(fz);
+			__m128 tx = _mm_sub_ps(fx, _mm_cvtepi32_ps(ix));
+			__m128 ty = _mm_sub_ps(fy, _mm_cvtepi32_ps(iy));
+			__m128 tz = _mm_sub_ps(fz, _mm_cvtepi32_ps(iz));
+
+			// Offsets of the 8 corners per lane: lower and upper x, plus the 4 combinations of y and z
+			int idX[4], idY[4], idZ[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(idX), ix);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(idY), iy);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(idZ), iz);
+			size_t x0[4], x1[4], yz[4][4];
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				x0[lane] = m_offsetX[idX[lane]];
+				x1[lane] = m_offsetX[idX[lane] + 1];
+				const size_t y0 = m_offsetY[idY[lane]], y1 = m_offsetY[idY[lane] + 1];
+				const size_t z0 = m_offsetZ[idZ[lane]], z1 = m_offsetZ[idZ[lane] + 1];
+				yz[0][lane] = y0 + z0;
+				yz[1][lane] = y1 + z0;
+				yz[2][lane] = y0 + z1;
+				yz[3][lane] = y1 + z1;
+			}
+
+			float result[4][4];
+			for (int c = 0; c < m_components; ++c)
+			{
+				const float* data = m_data.data() + BRICK_CELLS * c;
+				__m128 rows[4];
+				for (int r = 0; r < 4; ++r)
+				{
+					const size_t* o = yz[r];
+					rows[r] = lerp(_mm_setr_ps(data[x0[0] + o[0]], data[x0[1] + o[1]], data[x0[2] + o[2]], data[x0[3] + o[3]]),
+						_mm_setr_ps(data[x1[0] + o[0]], data[x1[1] + o[1]], data[x1[2] + o[2]], data[x1[3] + o[3]]), tx);
+				}
+				__m128 value = lerp(lerp(rows[0], rows[1], ty), lerp(rows[2], rows[3], ty), tz);
+				_mm_storeu_ps(result[c], _mm_or_ps(_mm_and_ps(inside, value), _mm_andnot_ps(inside, invalid)));
+			}
+
+			float* out = values + m_components * base;
+			for (size_t lane = 0; lane < numLanes; ++lane)
+			{
+				for (int c = 0; c < m_components; ++c)
+					out[m_components * lane + c] = result[c][lane];
+			}
+		}
+	}, threads, SAMPLE_GRAIN);
+}
@@ -0,0 +1,65 @@
+#ifndef BRICKED_FIELD_H
+#define BRICKED_FIELD_H
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <cstddef>
+
+// Grid field with 1 to 4 components in bricks of 8^3 cells and one block of 512 floats per component and brick (structure of arrays),
+// for CPU consumers, which access the neighbours of cells along y and z (Jacobians, trilinear sampling, tracers, torque sampling)
+// In the linear layout of the simulator (x fastest, 4 floats per cell) the neighbours along z are a whole slice apart, so at large
+// resolutions each of them is on another page; within a brick they are 256 bytes apart and the 8 corners of a trilinear sample lie in
+// two cache lines per component
+//
+// The bricks are ordered x fastest and the cells within a brick as well, so the offset of a cell is the sum of one table entry per axis;
+// the tables have an extra entry at the end, which repeats the last cell, so the upper corners of samples at the faces need no clamping.
+// Resolutions, which are not a multiple of 8, are padded to full bricks; the padding cells are never read
+class BrickedField
+{
+public:
+	static const int BRICK_SIZE = 8;
+	static const int BRICK_CELLS = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE; // Offset from one component to the next
+
+	BrickedField(int components = 1);
+
+	void resize(const DirectX::XMUINT3& resolution);
+
+	// Conversion from and to the linear layout of the simulator and the GPU upload (x fastest, <stride> floats per cell of which the
+	// first components are used, e.g. 4 for Simulator::getVelocity with 3 components); toLinear sets the floats beyond the components to 0
+	void fromLinear(const float* linear, int stride, const DirectX::XMUINT3& resolution, int threads = 1);
+	void toLinear(float* linear, int stride, int threads = 1) const;
+
+	size_t offset(int x, int y, int z) const { return m_offsetX[x] + m_offsetY[y] + m_offsetZ[z]; }; // Of component 0
+	float get(int x, int y, int z, int component = 0) const { return m_data[offset(x, y, z) + BRICK_CELLS * component]; };
+	const float* data() const { return m_data.data(); };
+	float* data() { return m_data.data(); };
+
+	// One component of 4 cells
+	DirectX::XMVECTOR gather(const DirectX::XMINT3* cells, int component = 0) const;
+
+	// Trilinear interpolation as FieldSampler (voxel space, cell centers at i + 0.5, clamped to the outermost cells) with the components in
+	// the lanes; the lanes beyond the components are 0
+	DirectX::XMVECTOR sample(DirectX::FXMVECTOR position) const;
+
+	// Samples <count> positions into <values> (<components> floats each) with up to <threads> threads, 4 positions per SSE vector;
+	// positions outside of the grid give NaN as FieldSampler::sample
+	void sample(const DirectX::XMFLOAT3* positions, size_t count, float* values, int threads = 1) const;
+
+	int getComponents() const { return m_components; };
+	const DirectX::XMUINT3& getResolution() const { return m_resolution; };
+	size_t getNumBricks() const { return m_numBricks; };
+
+private:
+	int m_components;
+	DirectX::XMUINT3 m_resolution;
+	DirectX::XMUINT3 m_bricks; // Per axis
+	DirectX::XMFLOAT4 m_max; // Largest coordinate of a cell center, relative to the first one
+	size_t m_numBricks;
+	std::vector<size_t> m_offsetX; // resolution + 1 entries each
+	std::vector<size_t> m_offsetY;
+	std::vector<size_t> m_offsetZ;
+	std::vector<float> m_data;
+};
+
+#endif
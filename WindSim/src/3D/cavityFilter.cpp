@@ -0,0 +1,193 @@
+#include "cavityFilter.h"
+#include "parallel.h"
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	// Flow cells of one row in [x0, x1]
+	struct Run
+	{
+		int x0;
+		int x1;
+	};
+
+	inline bool isFlow(wtl::CellType type)
+	{
+		return type == wtl::CELL_TYPE_FLUID || type == wtl::CELL_TYPE_INFLOW || type == wtl::CELL_TYPE_OUTFLOW;
+	}
+
+	// The smaller index becomes the root, so parent[i] <= i always holds
+	uint32_t findRoot(std::vector<uint32_t>& parent, uint32_t i)
+	{
+		while (parent[i] != i)
+		{
+			parent[i] = parent[parent[i]]; // Path halving
+			i = parent[i];
+		}
+		return i;
+	}
+
+	void unite(std::vector<uint32_t>& parent, uint32_t a, uint32_t b)
+	{
+		a = findRoot(parent, a);
+		b = findRoot(parent, b);
+		if (a < b)
+			parent[b] = a;
+		else if (b < a)
+			parent[a] = b;
+	}
+
+	// Join the runs of two neighbouring rows, which share at least one x position
+	void uniteRows(std::vector<uint32_t>& parent, const std::vector<Run>& runs, uint32_t a, uint32_t aEnd, uint32_t b, uint32_t bEnd)
+	{
+		while (a < aEnd && b < bEnd)
+		{
+			if (runs[a].x1 < runs[b].x0)
+				++a;
+			else if (runs[b].x1 < runs[a].x0)
+				++b;
+			else
+			{
+				unite(parent, a, b);
+				if (runs[a].x1 < runs[b].x1)
+					++a;
+				else
+					++b;
+			}
+		}
+	}
+}
+
+uint64_t CavityFilter::fill(wtl::CellType* cellTypes, const XMUINT3& resolution, int threads)
+{
+	const int resX = resolution.x;
+	const int resY = resolution.y;
+	const int resZ = resolution.z;
+	if (resX == 0 || resY == 0 || resZ == 0)
+		return 0;
+
+	// Fixed z-slabs, so the unions of each slab stay within its own range of runs
+	const int numSlabs = static_cast<int>(std::min(Parallel::numThreads(threads), static_cast<unsigned int>(resZ)));
+	auto slabBegin = [&](int slab) { return static_cast<int>(static_cast<int64_t>(resZ) * slab / numSlabs); };
+	auto rowIndex = [&](int y, int z) { return static_cast<size_t>(z) * resY + y; };
+	auto row = [&](int y, int z) { return cellTypes + rowIndex(y, z) * resX; };
+
+	// Count the runs of each row
+	std::vector<uint32_t> rowStart(static_cast<size_t>(resY) * resZ + 1, 0);
+	Parallel::forRange(0, numSlabs, [&](int first, int last)
+	{
+		for (int z = slabBegin(first); z < slabBegin(last); ++z)
+		{
+			for (int y = 0; y < resY; ++y)
+			{
+				const wtl::CellType* cells = row(y, z);
+				uint32_t count = 0;
+				for (int x = 0; x < resX; ++x)
+				{
+					if (isFlow(cells[x]) && (x == 0 || !isFlow(cells[x - 1])))
+						++count;
+				}
+				rowStart[rowIndex(y, z) + 1] = count;
+			}
+		}
+	}, numSlabs);
+
+	for (size_t i = 1; i < rowStart.size(); ++i)
+		rowStart[i] += rowStart[i - 1];
+
+	const uint32_t numRuns = rowStart.back();
+	std::vector<Run> runs(numRuns);
+	std::vector<uint32_t> parent(numRuns);
+	std::vector<char> open(numRuns, 0); // Run contains inflow or outflow cells (valid for the roots after propagation)
+
+	// Extract the runs and join them within each slab
+	Parallel::forRange(0, numSlabs, [&](int first, int last)
+	{
+		int zBegin = slabBegin(first);
+		for (int z = zBegin; z < slabBegin(last); ++z)
+		{
+			for (int y = 0; y < resY; ++y)
+			{
+				const wtl::CellType* cells = row(y, z);
+				uint32_t r = rowStart[rowIndex(y, z)];
+				for (int x = 0; x < resX;)
+				{
+					if (!isFlow(cells[x]))
+					{
+						++x;
+						continue;
+					}
+
+					Run run = { x, x };
+					bool isOpen = false;
+					for (; x < resX && isFlow(cells[x]); ++x)
+					{
+						run.x1 = x;
+						isOpen |= cells[x] != wtl::CELL_TYPE_FLUID;
+					}
+					runs[r] = run;
+					parent[r] = r;
+					open[r] = isOpen;
+					++r;
+				}
+
+				if (y > 0)
+					uniteRows(parent, runs, rowStart[rowIndex(y, z)], rowStart[rowIndex(y, z) + 1], rowStart[rowIndex(y - 1, z)], rowStart[rowIndex(y - 1, z) + 1]);
+				if (z > zBegin)
+					uniteRows(parent, runs, rowStart[rowIndex(y, z)], rowStart[rowIndex(y, z) + 1], rowStart[rowIndex(y, z - 1)], rowStart[rowIndex(y, z - 1) + 1]);
+			}
+		}
+	}, numSlabs);
+
+	// Merge the slabs
+	for (int slab = 1; slab < numSlabs; ++slab)
+	{
+		int z = slabBegin(slab);
+		for (int y = 0; y < resY; ++y)
+			uniteRows(parent, runs, rowStart[rowIndex(y, z)], rowStart[rowIndex(y, z) + 1], rowStart[rowIndex(y, z - 1)], rowStart[rowIndex(y, z - 1) + 1]);
+	}
+
+	// Flatten the trees (parents always precede their children) and mark the components, which reach inflow or outflow cells
+	bool anyOpen = false;
+	for (uint32_t i = 0; i < numRuns; ++i)
+	{
+		parent[i] = parent[parent[i]];
+		if (open[i])
+		{
+			open[parent[i]] = 1;
+			anyOpen = true;
+		}
+	}
+	if (!anyOpen)
+		return 0;
+
+	// Turn the fluid cells of closed components into solid cells
+	std::atomic<uint64_t> reclaimed(0);
+	Parallel::forRange(0, numSlabs, [&](int first, int last)
+	{
+		uint64_t count = 0;
+		for (int z = slabBegin(first); z < slabBegin(last); ++z)
+		{
+			for (int y = 0; y < resY; ++y)
+			{
+				wtl::CellType* cells = row(y, z);
+				for (uint32_t r = rowStart[rowIndex(y, z)]; r < rowStart[rowIndex(y, z) + 1]; ++r)
+				{
+					if (open[parent[r]])
+						continue;
+
+					std::fill(cells + runs[r].x0, cells + runs[r].x1 + 1, wtl::CELL_TYPE_SOLID_NO_SLIP);
+					count += runs[r].x1 - runs[r].x0 + 1;
+				}
+			}
+		}
+		reclaimed += count;
+	}, numSlabs);
+
+	return reclaimed;
+}
@@ -0,0 +1,22 @@
+#ifndef CAVITY_FILTER_H
+#define CAVITY_FILTER_H
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+
+#include "cellType.h"
+
+// Removes fluid pockets which are sealed inside of solids (e.g. hollow parts or overlapping meshes)
+// Flow cells (fluid, inflow, outflow) are grouped into runs along x; the runs are joined with their overlapping neighbour runs
+// in y and z by a union-find, built in parallel over z-slabs and merged at the slab borders
+class CavityFilter
+{
+public:
+	// Every fluid cell, which is not 6-connected to an inflow or outflow cell, becomes CELL_TYPE_SOLID_NO_SLIP
+	// If the grid contains neither inflow nor outflow cells, nothing is changed
+	// Returns the number of reclaimed cells
+	static uint64_t fill(wtl::CellType* cellTypes, const DirectX::XMUINT3& resolution, int threads = 0);
+};
+
+#endif
@@ -0,0 +1,257 @@
+#include "cellClassifier.h"
+#include "cavityFilter.h"
+#include "parallel.h"
+
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	inline int lowestBit(uint64_t v)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, v);
+		return static_cast<int>(index);
+#else
+		return __builtin_ctzll(v);
+#endif
+	}
+
+	// Bit mask of the cells c[0..63] which are CELL_TYPE_SOLID_NO_SLIP
+	inline uint64_t packSolid64(const wtl::CellType* c)
+	{
+		static_assert(sizeof(wtl::CellType) == 1, "Cell types are expected to be bytes");
+		const __m128i solid = _mm_set1_epi8(wtl::CELL_TYPE_SOLID_NO_SLIP);
+		uint64_t word = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c + i * 16));
+			word |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, solid)))) << (i * 16);
+		}
+		return word;
+	}
+}
+
+CellClassifier::Faces::Faces()
+{
+	type[X_MIN] = wtl::CELL_TYPE_INFLOW;
+	type[X_MAX] = wtl::CELL_TYPE_OUTFLOW;
+	type[Y_MIN] = wtl::CELL_TYPE_SOLID_SLIP;
+	type[Y_MAX] = wtl::CELL_TYPE_SOLID_SLIP;
+	type[Z_MIN] = wtl::CELL_TYPE_SOLID_SLIP;
+	type[Z_MAX] = wtl::CELL_TYPE_SOLID_SLIP;
+}
+
+uint64_t CellClassifier::classify(wtl::CellType* cellTypes, const XMUINT3& resolution, const Faces& faces, bool fillCavities, int threads)
+{
+	const int resX = resolution.x;
+	const int resY = resolution.y;
+	const int resZ = resolution.z;
+	if (resX == 0 || resY == 0 || resZ == 0)
+		return 0;
+
+	applyFaces(cellTypes, resolution, faces);
+
+	uint64_t reclaimed = 0;
+	if (fillCavities)
+		reclaimed = CavityFilter::fill(cellTypes, resolution, threads);
+
+	// Pack the solid cells of each row into 64 bit words (bit i of word w is cell x = 64 * w + i)
+	// Bits beyond the x resolution are set: neighbours outside of the grid never turn a cell into a boundary cell
+	const int words = (resX + 63) / 64;
+	const int tail = resX - (words - 1) * 64; // Valid bits in the last word of a row
+	const uint64_t tailMask = tail == 64 ? ~0ull : (1ull << tail) - 1;
+
+	std::vector<uint64_t> solid(static_cast<size_t>(words) * resY * resZ);
+
+	Parallel::forRange(0, resZ, [&](int zBegin, int zEnd)
+	{
+		for (int z = zBegin; z < zEnd; ++z)
+		{
+			for (int y = 0; y < resY; ++y)
+			{
+				const wtl::CellType* row = cellTypes + (static_cast<size_t>(z) * resY + y) * resX;
+				uint64_t* bits = &solid[(static_cast<size_t>(z) * resY + y) * words];
+
+				for (int w = 0; w < words - 1; ++w)
+					bits[w] = packSolid64(row + w * 64);
+
+				uint64_t last = ~tailMask;
+				for (int i = 0; i < tail; ++i)
+					last |= static_cast<uint64_t>(row[(words - 1) * 64 + i] == wtl::CELL_TYPE_SOLID_NO_SLIP) << i;
+				bits[words - 1] = last;
+			}
+		}
+	}, threads);
+
+	// A solid cell stays an inner solid cell only if all 6 neighbours are solid
+	const std::vector<uint64_t> outside(words, ~0ull);
+
+	Parallel::forRange(0, resZ, [&](int zBegin, int zEnd)
+	{
+		for (int z = zBegin; z < zEnd; ++z)
+		{
+			for (int y = 0; y < resY; ++y)
+			{
+				auto rowBits = [&](int ny, int nz) { return (ny < 0 || ny >= resY || nz < 0 || nz >= resZ) ? outside.data() : &solid[(static_cast<size_t>(nz) * resY + ny) * words]; };
+				const uint64_t* row = rowBits(y, z);
+				const uint64_t* yMin = rowBits(y - 1, z);
+				const uint64_t* yMax = rowBits(y + 1, z);
+				const uint64_t* zMin = rowBits(y, z - 1);
+				const uint64_t* zMax = rowBits(y, z + 1);
+
+				wtl::CellType* cells = cellTypes + (static_cast<size_t>(z) * resY + y) * resX;
+
+				for (int w = 0; w < words; ++w)
+				{
+					uint64_t s = row[w];
+					if (w == words - 1)
+						s &= tailMask;
+					if (!s)
+						continue;
+
+					// Neighbour at x - 1 (shift in the highest bit of the previous word) and at x + 1 (lowest bit of the next word)
+					uint64_t xMin = (row[w] << 1) | (w > 0 ? row[w - 1] >> 63 : 1ull);
+					uint64_t xMax = (row[w] >> 1) | (w + 1 < words ? row[w + 1] << 63 : 1ull << 63);
+
+					uint64_t boundary = s & ~(xMin & xMax & yMin[w] & yMax[w] & zMin[w] & zMax[w]);
+					while (boundary)
+					{
+						cells[w * 64 + lowestBit(boundary)] = wtl::CELL_TYPE_SOLID_BOUNDARY;
+						boundary &= boundary - 1;
+					}
+				}
+			}
+		}
+	}, threads);
+
+	return reclaimed;
+}
+
+uint64_t CellClassifier::classifyReference(wtl::CellType* cellTypes, const XMUINT3& resolution, const Faces& faces, bool fillCavities)
+{
+	const int res[3] = { static_cast<int>(resolution.x), static_cast<int>(resolution.y), static_cast<int>(resolution.z) };
+	if (res[0] == 0 || res[1] == 0 || res[2] == 0)
+		return 0;
+
+	applyFaces(cellTypes, resolution, faces);
+
+	uint64_t reclaimed = 0;
+	if (fillCavities)
+		reclaimed = CavityFilter::fill(cellTypes, resolution, 1);
+
+	// Test against the unmodified types, so the result does not depend on the order of the cells
+	const std::vector<wtl::CellType> source(cellTypes, cellTypes + static_cast<size_t>(res[0]) * res[1] * res[2]);
+	static const int neighbours[6][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+
+	for (int z = 0; z < res[2]; ++z)
+	{
+		for (int y = 0; y < res[1]; ++y)
+		{
+			for (int x = 0; x < res[0]; ++x)
+			{
+				size_t index = x + static_cast<size_t>(res[0]) * (y + static_cast<size_t>(res[1]) * z);
+				if (source[index] != wtl::CELL_TYPE_SOLID_NO_SLIP)
+					continue;
+
+				for (int i = 0; i < 6; ++i)
+				{
+					int n[3] = { x + neighbours[i][0], y + neighbours[i][1], z + neighbours[i][2] };
+					if (n[0] < 0 || n[1] < 0 || n[2] < 0 || n[0] >= res[0] || n[1] >= res[1] || n[2] >= res[2])
+						continue;
+
+					if (source[n[0] + static_cast<size_t>(res[0]) * (n[1] + static_cast<size_t>(res[1]) * n[2])] != wtl::CELL_TYPE_SOLID_NO_SLIP)
+					{
+						cellTypes[index] = wtl::CELL_TYPE_SOLID_BOUNDARY;
+						break;
+					}
+				}
+			}
+		}
+	}
+	return reclaimed;
+}
+
+CellClassifier::Face CellClassifier::faceOf(const wtl::CellType* cellTypes, const XMUINT3& resolution, uint32_t x, uint32_t y, uint32_t z)
+{
+	const uint32_t p[3] = { x, y, z };
+	const uint32_t res[3] = { resolution.x, resolution.y, resolution.z };
+	int inner[3] = { 0, 0, 0 }; // Step towards the inside along the axes, on which the cell is at the border
+	int faces[3];
+	int numFaces = 0;
+	for (int a = 0; a < 3; ++a)
+	{
+		if (p[a] + 1 == res[a])
+			faces[numFaces++] = 2 * a + 1;
+		else if (p[a] == 0)
+			faces[numFaces++] = 2 * a;
+		else
+			continue;
+
+		// A single layer has no neighbours along the axis
+		if (res[a] > 1)
+			inner[a] = faces[numFaces - 1] % 2 == 0 ? 1 : -1;
+	}
+	if (numFaces == 0)
+		return NUM_FACES;
+
+	const wtl::CellType type = cellTypes[x + static_cast<size_t>(res[0]) * (y + static_cast<size_t>(res[1]) * z)];
+	int face = faces[numFaces - 1];
+	for (int f = 0; f < numFaces; ++f)
+	{
+		// The neighbours along the other border axes lie on the same face
+		const int axis = faces[f] / 2;
+		bool continues = true;
+		for (int b = 0; b < 3; ++b)
+		{
+			if (b == axis || inner[b] == 0)
+				continue;
+			uint32_t n[3] = { x, y, z };
+			n[b] += inner[b];
+			continues = continues && cellTypes[n[0] + static_cast<size_t>(res[0]) * (n[1] + static_cast<size_t>(res[1]) * n[2])] == type;
+		}
+		if (continues)
+			face = faces[f];
+	}
+	return static_cast<Face>(face);
+}
+
+void CellClassifier::applyFaces(wtl::CellType* cellTypes, const XMUINT3& resolution, const Faces& faces)
+{
+	const size_t resX = resolution.x;
+	const size_t resY = resolution.y;
+	const size_t resZ = resolution.z;
+
+	for (int f = 0; f < NUM_FACES; ++f)
+	{
+		wtl::CellType type = faces.type[f];
+		if (type == wtl::CELL_TYPE_FLUID)
+			continue;
+
+		int axis = f / 2;
+		size_t layer = (f % 2 == 0) ? 0 : (axis == 0 ? resX : axis == 1 ? resY : resZ) - 1;
+
+		switch (axis)
+		{
+		case 0:
+			for (size_t z = 0; z < resZ; ++z)
+				for (size_t y = 0; y < resY; ++y)
+					cellTypes[layer + resX * (y + resY * z)] = type;
+			break;
+		case 1:
+			for (size_t z = 0; z < resZ; ++z)
+				std::fill_n(cellTypes + resX * (layer + resY * z), resX, type);
+			break;
+		case 2:
+			std::fill_n(cellTypes + resX * resY * layer, resX * resY, type);
+			break;
+		}
+	}
+}
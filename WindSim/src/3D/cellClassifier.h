@@ -0,0 +1,46 @@
+#ifndef CELL_CLASSIFIER_H
+#define CELL_CLASSIFIER_H
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <cstdint>
+
+#include "cellType.h"
+
+// Final classification of a voxelized grid (cells are CELL_TYPE_FLUID or CELL_TYPE_SOLID_NO_SLIP) into the cell types of the simulation
+// Replaces the compute passes CellTypeGridBoundary and CellTypeSolidBoundary of voxelGrid.fx:
+// 1. The cells on the faces of the grid get the type of their face
+// 2. Optionally, enclosed fluid pockets become solid (see CavityFilter)
+// 3. Solid cells with a non solid 6-neighbour inside the grid become CELL_TYPE_SOLID_BOUNDARY
+class CellClassifier
+{
+public:
+	enum Face { X_MIN = 0, X_MAX, Y_MIN, Y_MAX, Z_MIN, Z_MAX, NUM_FACES };
+
+	// Types of the grid faces, applied in the order of Face (later faces override earlier ones on shared edges)
+	// CELL_TYPE_FLUID leaves the cells of a face as voxelized
+	struct Faces
+	{
+		Faces(); // Inflow at -x, outflow at +x, slip walls elsewhere (as in the compute shaders)
+		wtl::CellType type[NUM_FACES];
+	};
+
+	// Classify in place; the rows are packed into bit masks, so the neighbour tests of 64 cells are done with a few shifts and ands
+	// Runs multi-threaded over z-slabs; returns the number of fluid cells reclaimed by the cavity filling
+	static uint64_t classify(wtl::CellType* cellTypes, const DirectX::XMUINT3& resolution, const Faces& faces, bool fillCavities, int threads = 0);
+
+	// Straightforward per cell implementation of the solid boundary classification (single-threaded, the cavities are filled by CavityFilter
+	// as well); compared with classify() by WindSimHeadless --benchmark-classifier
+	static uint64_t classifyReference(wtl::CellType* cellTypes, const DirectX::XMUINT3& resolution, const Faces& faces, bool fillCavities);
+
+	// Face of a classified cell on the border of the grid, e.g. to find the inward normal of an inflow cell; NUM_FACES inside of the grid
+	// On edges and corners, it is the last face, along which the neighbours of the cell have its type: a later face overrides the shared
+	// cells, unless its type is CELL_TYPE_FLUID
+	static Face faceOf(const wtl::CellType* cellTypes, const DirectX::XMUINT3& resolution, uint32_t x, uint32_t y, uint32_t z);
+
+private:
+	static void applyFaces(wtl::CellType* cellTypes, const DirectX::XMUINT3& resolution, const Faces& faces);
+};
+
+#endif
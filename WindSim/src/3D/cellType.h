@@ -0,0 +1,23 @@
+#ifndef CELL_TYPE_H
+#define CELL_TYPE_H
+
+// The cell types are defined by the WindTunnel library
+// Builds without the library (WINDSIM_NO_WINDTUNNEL, e.g. WindSimHeadless and the Linux build of WindSimHost) use an identical definition
+#ifndef WINDSIM_NO_WINDTUNNEL
+#include <WindTunnel.h>
+#else
+namespace wtl
+{
+	enum CellType : char
+	{
+		CELL_TYPE_FLUID = 0,
+		CELL_TYPE_INFLOW,
+		CELL_TYPE_OUTFLOW,
+		CELL_TYPE_SOLID_SLIP,
+		CELL_TYPE_SOLID_NO_SLIP,
+		CELL_TYPE_SOLID_BOUNDARY
+	};
+}
+#endif
+
+#endif
@@ -0,0 +1,259 @@
+#include "cpuDynamics.h"
+#include "settings.h"
+#include "parallel.h"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const float SAMPLE_DISTANCE = 1.0f; // Distance of the sample position in front of the surface in voxels
+	const int TRIANGLES_PER_CHUNK = 256;
+	const int MAX_SUBDIVISION = 64; // Of a triangle edge
+
+	// Trilinear interpolation of a cell centered field at a voxel space position, leaving out solid cells
+	// Returns false if all eight cells are solid
+	bool sampleField(const std::vector<float>& field, int components, const wtl::CellType* cellTypes, const XMUINT3& res, const XMFLOAT3& pos, float* out)
+	{
+		// Cell (x, y, z) covers [x, x + 1] x [y, y + 1] x [z, z + 1], so its value is located at the center
+		float fx = std::min(std::max(pos.x - 0.5f, 0.0f), static_cast<float>(res.x - 1));
+		float fy = std::min(std::max(pos.y - 0.5f, 0.0f), static_cast<float>(res.y - 1));
+		float fz = std::min(std::max(pos.z - 0.5f, 0.0f), static_cast<float>(res.z - 1));
+		int x0 = std::min(static_cast<int>(fx), static_cast<int>(res.x) - 1);
+		int y0 = std::min(static_cast<int>(fy), static_cast<int>(res.y) - 1);
+		int z0 = std::min(static_cast<int>(fz), static_cast<int>(res.z) - 1);
+		fx -= x0;
+		fy -= y0;
+		fz -= z0;
+		int x1 = std::min(x0 + 1, static_cast<int>(res.x) - 1);
+		int y1 = std::min(y0 + 1, static_cast<int>(res.y) - 1);
+		int z1 = std::min(z0 + 1, static_cast<int>(res.z) - 1);
+
+		for (int c = 0; c < components; ++c)
+			out[c] = 0.0f;
+
+		float weightSum = 0.0f;
+		for (int i = 0; i < 8; ++i)
+		{
+			size_t cell = (i & 1 ? x1 : x0) + res.x * ((i & 2 ? y1 : y0) + static_cast<size_t>(res.y) * (i & 4 ? z1 : z0));
+			if (cellTypes && cellTypes[cell] >= wtl::CELL_TYPE_SOLID_SLIP)
+				continue;
+
+			float w = (i & 1 ? fx : 1.0f - fx) * (i & 2 ? fy : 1.0f - fy) * (i & 4 ? fz : 1.0f - fz);
+			for (int c = 0; c < components; ++c)
+				out[c] += w * field[cell * components + c];
+			weightSum += w;
+		}
+
+		if (weightSum <= 0.0f)
+			return false;
+
+		for (int c = 0; c < components; ++c)
+			out[c] /= weightSum;
+		return true;
+	}
+}
+
+CpuDynamics::CpuDynamics()
+	: m_mass(0.0f),
+	m_inertiaTensor(),
+	m_centerOfMass(0.0f, 0.0f, 0.0f),
+	m_rotationAxis(0.0f, 0.0f, 0.0f),
+	m_angVel(0.0f, 0.0f, 0.0f),
+	m_angAcc(0.0f, 0.0f, 0.0f),
+	m_rotation()
+{
+	reset();
+}
+
+void CpuDynamics::setRotationAxis(const XMFLOAT3& axis)
+{
+	XMVECTOR a = XMLoadFloat3(&axis);
+	if (XMVector3Equal(a, XMVectorZero()))
+		m_rotationAxis = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	else
+		XMStoreFloat3(&m_rotationAxis, XMVector3Normalize(a));
+}
+
+XMFLOAT3 CpuDynamics::calculateTorque(const std::vector<float>& vertexData, const std::vector<uint32_t>& indexData, const XMFLOAT4X4& objectToWorld,
+	const XMFLOAT4X4& worldToVoxel, const XMUINT3& resolution, DynamicsMethod method, const std::vector<float>& field, const wtl::CellType* cellTypes, int threads) const
+{
+	const int components = method == Pressure ? 1 : 4;
+	const size_t numCells = static_cast<size_t>(resolution.x) * resolution.y * resolution.z;
+	if (field.size() < numCells * components || indexData.empty())
+		return XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	XMMATRIX world = XMLoadFloat4x4(&objectToWorld);
+	XMMATRIX toVoxel = XMLoadFloat4x4(&worldToVoxel);
+
+	// Rotation center: the center of mass in world space
+	XMVECTOR scale;
+	XMVECTOR rot;
+	XMVECTOR trans;
+	XMMatrixDecompose(&scale, &rot, &trans, world);
+	XMVECTOR center = XMVector3Rotate(XMLoadFloat3(&m_centerOfMass), rot) + trans; // Center of mass already scaled
+
+	const int numTriangles = static_cast<int>(indexData.size() / 3);
+	const int numChunks = (numTriangles + TRIANGLES_PER_CHUNK - 1) / TRIANGLES_PER_CHUNK;
+	std::vector<XMFLOAT3> partial(numChunks, XMFLOAT3(0.0f, 0.0f, 0.0f)); // Summed per chunk, so the result does not depend on the scheduling
+
+	Parallel::forRange(0, numTriangles, [&](int first, int last)
+	{
+		XMVECTOR torque = XMVectorZero();
+		for (int t = first; t < last; ++t)
+		{
+			const uint32_t* idx = &indexData[3 * t];
+			XMVECTOR v[3];
+			XMVECTOR vertexNormal = XMVectorZero();
+			for (int i = 0; i < 3; ++i)
+			{
+				const float* vd = &vertexData[6 * idx[i]];
+				v[i] = XMVector3TransformCoord(XMVectorSet(vd[0], vd[1], vd[2], 1.0f), world);
+				vertexNormal += XMVectorSet(vd[3], vd[4], vd[5], 0.0f);
+			}
+
+			// Area weighted normal; oriented like the vertex normals, which point outwards
+			XMVECTOR cross = XMVector3Cross(v[1] - v[0], v[2] - v[0]);
+			float length = XMVectorGetX(XMVector3Length(cross));
+			if (length <= 0.0f)
+				continue;
+			XMVECTOR normal = cross / length;
+			if (XMVectorGetX(XMVector3Dot(normal, XMVector3TransformNormal(vertexNormal, world))) < 0.0f)
+				normal = -normal;
+			float area = 0.5f * length;
+
+			// Large triangles are split into n^2 similar sub-triangles of about one voxel, each sampled at its center
+			// (the Torque shader gets the same resolution by rasterizing the mesh into the voxel grid)
+			XMVECTOR edge[3] = { v[1] - v[0], v[2] - v[0], v[2] - v[1] };
+			float maxEdge = 0.0f;
+			for (int i = 0; i < 3; ++i)
+				maxEdge = std::max(maxEdge, XMVectorGetX(XMVector3Length(XMVector3TransformNormal(edge[i], toVoxel))));
+			int n = std::min(std::max(static_cast<int>(std::ceil(maxEdge)), 1), MAX_SUBDIVISION);
+			float subArea = area / (n * n);
+
+			XMVECTOR normalVS = XMVector3Normalize(XMVector3TransformNormal(normal, toVoxel));
+			for (int i = 0; i < n; ++i)
+			{
+				for (int j = 0; j < n - i; ++j)
+				{
+					// Upward sub-triangle (i, j) and, if inside, the downward one next to it
+					for (int k = 0; k < (i + j < n - 1 ? 2 : 1); ++k)
+					{
+						float offset = k == 0 ? 1.0f / 3.0f : 2.0f / 3.0f;
+						XMVECTOR pos = v[0] + ((i + offset) / n) * edge[0] + ((j + offset) / n) * edge[1];
+
+						// Sample just outside the surface
+						XMFLOAT3 samplePos;
+						XMStoreFloat3(&samplePos, XMVector3TransformCoord(pos, toVoxel) + SAMPLE_DISTANCE * normalVS);
+
+						float value[4];
+						if (!sampleField(field, components, cellTypes, resolution, samplePos, value))
+							continue;
+
+						float p;
+						if (method == Pressure)
+						{
+							p = value[0];
+						}
+						else
+						{
+							// Stagnation pressure estimate as in psVelocityTorque
+							const float airDensity = 1.2256f; // kg/m^3
+							const float g = 9.81f;
+							float pNorm = -XMVectorGetX(XMVector3Dot(XMVectorSet(value[0], value[1], value[2], 0.0f), normal)) * 0.4f;
+							p = 0.5f * airDensity * pNorm + airDensity * g * XMVectorGetY(pos);
+						}
+
+						torque += XMVector3Cross(pos - center, -p * subArea * normal);
+					}
+				}
+			}
+		}
+
+		XMStoreFloat3(&partial[first / TRIANGLES_PER_CHUNK], torque);
+	}, threads, TRIANGLES_PER_CHUNK);
+
+	XMVECTOR torque = XMVectorZero();
+	for (const XMFLOAT3& t : partial)
+		torque += XMLoadFloat3(&t);
+
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, torque);
+	return result;
+}
+
+void CpuDynamics::integrate(const XMFLOAT3& torque, const XMFLOAT4& objRot, double elapsedTime)
+{
+	// Calculate new dynamic rotation from current angular velocity and elapsed time
+	XMVECTOR dynRot = XMLoadFloat4(&m_rotation);
+	XMVECTOR angMotion = XMLoadFloat3(&m_angVel) * static_cast<float>(elapsedTime);
+	if (!XMVector3Equal(angMotion, XMVectorZero()))
+	{
+		XMVECTOR newRot = XMQuaternionRotationAxis(angMotion, XMVectorGetX(XMVector3Length(angMotion))); // Angular motion vector describes axis and its magnitude the angle
+		XMStoreFloat4(&m_rotation, XMQuaternionNormalize(XMQuaternionMultiply(newRot, dynRot)));
+	}
+
+	// Apply the current angular acceleration; after one second, x% of the original velocity remains if acceleration would be zero
+	XMVECTOR newAngVel = XMLoadFloat3(&m_angVel) * static_cast<float>(std::pow(conf.dyn.frictionCoefficient, elapsedTime)) + XMLoadFloat3(&m_angAcc) * static_cast<float>(elapsedTime);
+	XMStoreFloat3(&m_angVel, newAngVel);
+
+	// Transform torque to the body inertial frame
+	XMVECTOR trq = XMVector3Rotate(XMLoadFloat3(&torque), XMQuaternionInverse(XMLoadFloat4(&objRot)));
+
+	// Bearing friction torque = Fn * f * d/2 in opposite direction of the current velocity (see Dynamics::calculate)
+	float f = 0.0015f;
+	float d = 0.5f;
+	float Fn = m_mass * 9.81f;
+	if (!XMVector3Equal(newAngVel, XMVectorZero()))
+		trq += Fn * f * 0.5f * d * XMVectorNegate(XMVector3Normalize(newAngVel));
+
+	// Torque around the local rotation axis
+	XMVECTOR localRotationAxis = XMLoadFloat3(&m_rotationAxis);
+	if (!XMVector3Equal(localRotationAxis, XMVectorZero()))
+		trq = XMVector3Dot(trq, localRotationAxis) * localRotationAxis;
+
+	XMStoreFloat3(&m_angAcc, XMVector3Transform(trq, XMMatrixInverse(nullptr, XMLoadFloat3x3(&m_inertiaTensor)))); // t = I * a -> a = I^-1 * t
+}
+
+XMFLOAT4X4 CpuDynamics::getDynamicWorld(const XMFLOAT3& scale, const XMFLOAT4& rot, const XMFLOAT3& pos) const
+{
+	XMVECTOR com = XMLoadFloat3(&m_centerOfMass);
+
+	XMMATRIX world = XMMatrixScalingFromVector(XMLoadFloat3(&scale)); // Center of mass already contains the scaling
+	world *= XMMatrixTranslationFromVector(-com);
+	world *= XMMatrixRotationQuaternion(XMLoadFloat4(&m_rotation));
+	world *= XMMatrixTranslationFromVector(com);
+	world *= XMMatrixRotationQuaternion(XMLoadFloat4(&rot));
+	world *= XMMatrixTranslationFromVector(XMLoadFloat3(&pos));
+
+	XMFLOAT4X4 result;
+	XMStoreFloat4x4(&result, world);
+	return result;
+}
+
+void CpuDynamics::reset()
+{
+	XMStoreFloat4(&m_rotation, XMQuaternionIdentity());
+	XMStoreFloat3(&m_angVel, XMVectorZero());
+	XMStoreFloat3(&m_angAcc, XMVectorZero());
+}
+
+void CpuDynamics::getAxialMotion(const XMFLOAT3& torque, const XMFLOAT4& objRot, float& axialTorque, float& angVel, float& angAcc) const
+{
+	XMVECTOR trq = XMVector3Rotate(XMLoadFloat3(&torque), XMQuaternionInverse(XMLoadFloat4(&objRot))); // Body frame
+	XMVECTOR axis = XMLoadFloat3(&m_rotationAxis);
+	if (XMVector3Equal(axis, XMVectorZero()))
+	{
+		axialTorque = XMVectorGetX(XMVector3Length(trq));
+		angVel = XMVectorGetX(XMVector3Length(XMLoadFloat3(&m_angVel)));
+		angAcc = XMVectorGetX(XMVector3Length(XMLoadFloat3(&m_angAcc)));
+	}
+	else
+	{
+		axialTorque = XMVectorGetX(XMVector3Dot(trq, axis));
+		angVel = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&m_angVel), axis));
+		angAcc = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&m_angAcc), axis));
+	}
+}
@@ -0,0 +1,61 @@
+#ifndef CPU_DYNAMICS_H
+#define CPU_DYNAMICS_H
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <cstdint>
+
+#include "common.h"
+#include "cellType.h"
+
+// CPU counterpart of Dynamics: rotates a mesh around its center of mass, driven by the torque of the flow on its surface
+// Instead of rasterizing the mesh into the voxel grid, the torque is summed over the triangles, so no graphics device is needed
+// The integration (bearing friction, damping, local rotation axis) is the same as in Dynamics::calculate
+class CpuDynamics
+{
+public:
+	CpuDynamics();
+
+	// Sum of r x F over all triangles, F = -p * n * area and r relative to the center of mass (world space)
+	// The pressure is sampled one voxel in front of the triangle centers; Velocity derives it from the flow velocity as the Torque shader does
+	// <field> holds the pressure (1 float per cell) or the velocity (4 floats per cell) of the simulation, depending on <method>
+	// Solid cells are left out of the interpolation; <cellTypes> may be null to use all cells
+	DirectX::XMFLOAT3 calculateTorque(const std::vector<float>& vertexData, const std::vector<uint32_t>& indexData, const DirectX::XMFLOAT4X4& objectToWorld,
+		const DirectX::XMFLOAT4X4& worldToVoxel, const DirectX::XMUINT3& resolution, DynamicsMethod method, const std::vector<float>& field,
+		const wtl::CellType* cellTypes, int threads = 0) const;
+
+	// Advance the dynamic rotation by <elapsedTime> seconds and derive the new angular acceleration from a world space torque
+	// <objRot> is the world rotation of the mesh
+	void integrate(const DirectX::XMFLOAT3& torque, const DirectX::XMFLOAT4& objRot, double elapsedTime);
+
+	// World matrix including the dynamic rotation: S * T(-com) * R(dyn) * T(com) * R * T (as MeshActor)
+	DirectX::XMFLOAT4X4 getDynamicWorld(const DirectX::XMFLOAT3& scale, const DirectX::XMFLOAT4& rot, const DirectX::XMFLOAT3& pos) const;
+
+	void setMass(const float mass) { m_mass = mass; };
+	void setInertia(const DirectX::XMFLOAT3X3& inertia) { m_inertiaTensor = inertia; };
+	void setCenterOfMass(const DirectX::XMFLOAT3& centerOfMass) { m_centerOfMass = centerOfMass; };
+	void setRotationAxis(const DirectX::XMFLOAT3& axis);
+	float getMass() const { return m_mass; };
+	const DirectX::XMFLOAT3& getCenterOfMass() const { return m_centerOfMass; };
+	const DirectX::XMFLOAT4& getRotation() const { return m_rotation; };
+	const DirectX::XMFLOAT3& getAngularVelocity() const { return m_angVel; }; // Body frame
+	const DirectX::XMFLOAT3& getAngularAcceleration() const { return m_angAcc; }; // Body frame
+	// Torque (world space, e.g. of calculateTorque), angular velocity and angular acceleration about the rotation axis, their magnitudes if the
+	// mesh rotates freely (as Dynamics::getAxialMotion); <objRot> is the world rotation of the mesh
+	void getAxialMotion(const DirectX::XMFLOAT3& torque, const DirectX::XMFLOAT4& objRot, float& axialTorque, float& angVel, float& angAcc) const;
+
+	void reset();
+
+private:
+	float m_mass;
+	DirectX::XMFLOAT3X3 m_inertiaTensor;
+	DirectX::XMFLOAT3 m_centerOfMass; // Object space, already scaled
+	DirectX::XMFLOAT3 m_rotationAxis;
+
+	DirectX::XMFLOAT3 m_angVel;
+	DirectX::XMFLOAT3 m_angAcc;
+	DirectX::XMFLOAT4 m_rotation; // Dynamic rotation around the center of mass
+};
+
+#endif
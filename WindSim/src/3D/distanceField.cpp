@@ -0,0 +1,326 @@
+#include "distanceField.h"
+#include "objLoader.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace DirectX;
+using namespace objLoader;
+
+namespace
+{
+	// Closest point on triangle abc to point p (Ericson, Real-Time Collision Detection, 5.1.5)
+	Vec3 closestPointOnTriangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c)
+	{
+		Vec3 ab = b - a;
+		Vec3 ac = c - a;
+		Vec3 ap = p - a;
+		float d1 = Vec3::dotProduct(ab, ap);
+		float d2 = Vec3::dotProduct(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			return a;
+
+		Vec3 bp = p - b;
+		float d3 = Vec3::dotProduct(ab, bp);
+		float d4 = Vec3::dotProduct(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3)
+			return b;
+
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			return a + ab * (d1 / (d1 - d3));
+
+		Vec3 cp = p - c;
+		float d5 = Vec3::dotProduct(ab, cp);
+		float d6 = Vec3::dotProduct(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6)
+			return c;
+
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			return a + ac * (d2 / (d2 - d6));
+
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+			return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+		float denom = 1.0f / (va + vb + vc);
+		return a + ab * (vb * denom) + ac * (vc * denom);
+	}
+
+	struct Triangle
+	{
+		Vec3 p[3];
+		Vec3 min;
+		Vec3 max;
+	};
+}
+
+DistanceField::DistanceField()
+	: m_origin(0.0f, 0.0f, 0.0f),
+	m_cellSize(1.0f),
+	m_bandWidth(0.0f),
+	m_dim(0, 0, 0),
+	m_buildResolution(0),
+	m_buildBand(0),
+	m_values()
+{
+}
+
+void DistanceField::build(const std::vector<float>& vertexData, const std::vector<uint32_t>& indexData, int resolution, int band, int threads)
+{
+	m_values.clear();
+	m_buildResolution = resolution;
+	m_buildBand = band;
+
+	if (indexData.size() < 3 || resolution < 1)
+		return;
+
+	band = std::max(band, 1);
+
+	// Gather triangles and the bounding box of the mesh
+	std::vector<Triangle> triangles(indexData.size() / 3);
+	Vec3 bbMin = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+	Vec3 bbMax = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+	for (size_t t = 0; t < triangles.size(); ++t)
+	{
+		Triangle& tri = triangles[t];
+		for (int v = 0; v < 3; ++v)
+		{
+			const float* pos = &vertexData[indexData[t * 3 + v] * 6];
+			tri.p[v] = { pos[0], pos[1], pos[2] };
+		}
+		tri.min = { std::min({ tri.p[0].x, tri.p[1].x, tri.p[2].x }), std::min({ tri.p[0].y, tri.p[1].y, tri.p[2].y }), std::min({ tri.p[0].z, tri.p[1].z, tri.p[2].z }) };
+		tri.max = { std::max({ tri.p[0].x, tri.p[1].x, tri.p[2].x }), std::max({ tri.p[0].y, tri.p[1].y, tri.p[2].y }), std::max({ tri.p[0].z, tri.p[1].z, tri.p[2].z }) };
+		bbMin = { std::min(bbMin.x, tri.min.x), std::min(bbMin.y, tri.min.y), std::min(bbMin.z, tri.min.z) };
+		bbMax = { std::max(bbMax.x, tri.max.x), std::max(bbMax.y, tri.max.y), std::max(bbMax.z, tri.max.z) };
+	}
+
+	Vec3 extent = bbMax - bbMin;
+	float maxExtent = std::max({ extent.x, extent.y, extent.z });
+	if (maxExtent <= 0.0f)
+		return;
+
+	// Pad the sampled region by the band, so the zero level set never touches its border
+	int pad = band + 1;
+	m_cellSize = maxExtent / resolution;
+	m_bandWidth = band * m_cellSize;
+	m_origin = XMFLOAT3(bbMin.x - pad * m_cellSize, bbMin.y - pad * m_cellSize, bbMin.z - pad * m_cellSize);
+	m_dim = XMUINT3(static_cast<uint32_t>(std::ceil(extent.x / m_cellSize)) + 2 * pad + 1,
+		static_cast<uint32_t>(std::ceil(extent.y / m_cellSize)) + 2 * pad + 1,
+		static_cast<uint32_t>(std::ceil(extent.z / m_cellSize)) + 2 * pad + 1);
+
+	m_values.assign(static_cast<size_t>(m_dim.x) * m_dim.y * m_dim.z, m_bandWidth);
+
+	const float h = m_cellSize;
+	const XMFLOAT3 o = m_origin;
+	const XMUINT3 dim = m_dim;
+	auto toNode = [&](float v, float origin, int maxNode) { return std::min(std::max(static_cast<int>(std::floor((v - origin) / h)), 0), maxNode); };
+
+	// Unsigned distances within the narrow band
+	// Each worker owns a range of z planes, so every node is written by exactly one thread
+	Parallel::forRange(0, dim.z, [&](int zBegin, int zEnd)
+	{
+		for (const Triangle& tri : triangles)
+		{
+			int k0 = std::max(toNode(tri.min.z - m_bandWidth, o.z, dim.z - 1), zBegin);
+			int k1 = std::min(toNode(tri.max.z + m_bandWidth, o.z, dim.z - 1) + 1, zEnd - 1);
+			if (k0 > k1)
+				continue;
+
+			int j0 = toNode(tri.min.y - m_bandWidth, o.y, dim.y - 1);
+			int j1 = std::min(toNode(tri.max.y + m_bandWidth, o.y, dim.y - 1) + 1, static_cast<int>(dim.y) - 1);
+			int i0 = toNode(tri.min.x - m_bandWidth, o.x, dim.x - 1);
+			int i1 = std::min(toNode(tri.max.x + m_bandWidth, o.x, dim.x - 1) + 1, static_cast<int>(dim.x) - 1);
+
+			for (int k = k0; k <= k1; ++k)
+			{
+				for (int j = j0; j <= j1; ++j)
+				{
+					float* row = &m_values[(static_cast<size_t>(k) * dim.y + j) * dim.x];
+					for (int i = i0; i <= i1; ++i)
+					{
+						Vec3 p = { o.x + i * h, o.y + j * h, o.z + k * h };
+						float d = (closestPointOnTriangle(p, tri.p[0], tri.p[1], tri.p[2]) - p).length();
+						if (d < row[i])
+							row[i] = d;
+					}
+				}
+			}
+		}
+	}, threads, 4);
+
+	// Signs by ray parity along the x-axis (same rule as the solid voxelization in voxelGrid.fx)
+	// The ray origin is moved by a tiny irrational offset, so rays do not hit shared triangle edges or vertices exactly
+	const float offY = h * 7.071e-5f;
+	const float offZ = h * 5.773e-5f;
+	Parallel::forRange(0, dim.z, [&](int zBegin, int zEnd)
+	{
+		// Bucket all triangles of this slab by the rows they cover
+		float zMin = o.z + zBegin * h + offZ;
+		float zMax = o.z + (zEnd - 1) * h + offZ;
+		std::vector<std::vector<uint32_t>> rows(dim.y);
+		for (uint32_t t = 0; t < triangles.size(); ++t)
+		{
+			const Triangle& tri = triangles[t];
+			if (tri.max.z < zMin || tri.min.z > zMax)
+				continue;
+			int j0 = toNode(tri.min.y - offY, o.y, dim.y - 1);
+			int j1 = std::min(toNode(tri.max.y - offY, o.y, dim.y - 1) + 1, static_cast<int>(dim.y) - 1);
+			for (int j = j0; j <= j1; ++j)
+				rows[j].push_back(t);
+		}
+
+		std::vector<float> hits;
+		for (int k = zBegin; k < zEnd; ++k)
+		{
+			float pz = o.z + k * h + offZ;
+			for (uint32_t j = 0; j < dim.y; ++j)
+			{
+				float py = o.y + j * h + offY;
+
+				hits.clear();
+				for (uint32_t t : rows[j])
+				{
+					const Triangle& tri = triangles[t];
+					if (pz < tri.min.z || pz > tri.max.z || py < tri.min.y || py > tri.max.y)
+						continue;
+
+					const Vec3& a = tri.p[0];
+					const Vec3& b = tri.p[1];
+					const Vec3& c = tri.p[2];
+					// Barycentric coordinates of the ray in the yz-plane
+					float wa = (b.y - py) * (c.z - pz) - (b.z - pz) * (c.y - py);
+					float wb = (c.y - py) * (a.z - pz) - (c.z - pz) * (a.y - py);
+					float wc = (a.y - py) * (b.z - pz) - (a.z - pz) * (b.y - py);
+					bool inside = (wa >= 0.0f && wb >= 0.0f && wc >= 0.0f) || (wa <= 0.0f && wb <= 0.0f && wc <= 0.0f);
+					float area = wa + wb + wc;
+					if (!inside || area == 0.0f)
+						continue;
+
+					hits.push_back((wa * a.x + wb * b.x + wc * c.x) / area);
+				}
+
+				if (hits.empty())
+					continue;
+
+				std::sort(hits.begin(), hits.end());
+
+				float* row = &m_values[(static_cast<size_t>(k) * dim.y + j) * dim.x];
+				size_t crossed = 0;
+				for (uint32_t i = 0; i < dim.x; ++i)
+				{
+					float px = o.x + i * h;
+					while (crossed < hits.size() && hits[crossed] < px)
+						++crossed;
+					if (crossed & 1)
+						row[i] = -row[i];
+				}
+			}
+		}
+	}, threads, 4);
+}
+
+float DistanceField::sample(const XMFLOAT3& pos) const
+{
+	return sample(pos.x, pos.y, pos.z);
+}
+
+float DistanceField::sample(float x, float y, float z) const
+{
+	float gx = (x - m_origin.x) / m_cellSize;
+	float gy = (y - m_origin.y) / m_cellSize;
+	float gz = (z - m_origin.z) / m_cellSize;
+
+	if (gx < 0.0f || gy < 0.0f || gz < 0.0f || gx > m_dim.x - 1 || gy > m_dim.y - 1 || gz > m_dim.z - 1)
+		return m_bandWidth;
+
+	int i = std::min(static_cast<int>(gx), static_cast<int>(m_dim.x) - 2);
+	int j = std::min(static_cast<int>(gy), static_cast<int>(m_dim.y) - 2);
+	int k = std::min(static_cast<int>(gz), static_cast<int>(m_dim.z) - 2);
+	float fx = gx - i;
+	float fy = gy - j;
+	float fz = gz - k;
+
+	size_t sy = m_dim.x;
+	size_t sz = static_cast<size_t>(m_dim.x) * m_dim.y;
+	const float* v = &m_values[i + j * sy + k * sz];
+
+	float c00 = v[0] + (v[1] - v[0]) * fx;
+	float c10 = v[sy] + (v[sy + 1] - v[sy]) * fx;
+	float c01 = v[sz] + (v[sz + 1] - v[sz]) * fx;
+	float c11 = v[sz + sy] + (v[sz + sy + 1] - v[sz + sy]) * fx;
+
+	float c0 = c00 + (c10 - c00) * fy;
+	float c1 = c01 + (c11 - c01) * fy;
+
+	return c0 + (c1 - c0) * fz;
+}
+
+uint64_t DistanceField::voxelize(const XMFLOAT4X4& voxelToObject, const XMUINT3& resolution, float dilation, wtl::CellType* cellTypes, int threads) const
+{
+	if (!isValid())
+		return 0;
+
+	// Values beyond the band are clamped, so larger dilations can not be resolved
+	dilation = std::min(dilation, m_bandWidth * 0.99f);
+
+	// Bounding box of the sampled region (grown by the dilation) in voxel space
+	XMMATRIX objectToVoxel = XMMatrixInverse(nullptr, XMLoadFloat4x4(&voxelToObject));
+	XMFLOAT3 lo(m_origin.x - dilation, m_origin.y - dilation, m_origin.z - dilation);
+	XMFLOAT3 hi(m_origin.x + (m_dim.x - 1) * m_cellSize + dilation, m_origin.y + (m_dim.y - 1) * m_cellSize + dilation, m_origin.z + (m_dim.z - 1) * m_cellSize + dilation);
+	XMVECTOR vMin = XMVectorReplicate(std::numeric_limits<float>::max());
+	XMVECTOR vMax = XMVectorReplicate(-std::numeric_limits<float>::max());
+	for (int c = 0; c < 8; ++c)
+	{
+		XMVECTOR corner = XMVectorSet(c & 1 ? hi.x : lo.x, c & 2 ? hi.y : lo.y, c & 4 ? hi.z : lo.z, 1.0f);
+		corner = XMVector3TransformCoord(corner, objectToVoxel);
+		vMin = XMVectorMin(vMin, corner);
+		vMax = XMVectorMax(vMax, corner);
+	}
+	XMFLOAT3 bMin, bMax;
+	XMStoreFloat3(&bMin, vMin);
+	XMStoreFloat3(&bMax, vMax);
+
+	int x0 = std::max(static_cast<int>(std::floor(bMin.x)), 0);
+	int y0 = std::max(static_cast<int>(std::floor(bMin.y)), 0);
+	int z0 = std::max(static_cast<int>(std::floor(bMin.z)), 0);
+	int x1 = std::min(static_cast<int>(std::ceil(bMax.x)), static_cast<int>(resolution.x));
+	int y1 = std::min(static_cast<int>(std::ceil(bMax.y)), static_cast<int>(resolution.y));
+	int z1 = std::min(static_cast<int>(std::ceil(bMax.z)), static_cast<int>(resolution.z));
+
+	if (x0 >= x1 || y0 >= y1 || z0 >= z1)
+		return 0;
+
+	// Walk the voxel centers incrementally along x; row vectors, so the first matrix row is the x step in object space
+	const XMFLOAT4X4& m = voxelToObject;
+	Parallel::forRange(z0, z1, [&](int zBegin, int zEnd)
+	{
+		for (int z = zBegin; z < zEnd; ++z)
+		{
+			for (int y = y0; y < y1; ++y)
+			{
+				float vx = x0 + 0.5f;
+				float vy = y + 0.5f;
+				float vz = z + 0.5f;
+				float px = vx * m._11 + vy * m._21 + vz * m._31 + m._41;
+				float py = vx * m._12 + vy * m._22 + vz * m._32 + m._42;
+				float pz = vx * m._13 + vy * m._23 + vz * m._33 + m._43;
+
+				wtl::CellType* row = cellTypes + (static_cast<size_t>(z) * resolution.y + y) * resolution.x;
+				for (int x = x0; x < x1; ++x)
+				{
+					if (sample(px, py, pz) <= dilation)
+						row[x] = wtl::CELL_TYPE_SOLID_NO_SLIP;
+
+					px += m._11;
+					py += m._12;
+					pz += m._13;
+				}
+			}
+		}
+	}, threads);
+
+	return static_cast<uint64_t>(x1 - x0) * (y1 - y0) * (z1 - z0);
+}
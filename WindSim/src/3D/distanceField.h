@@ -0,0 +1,49 @@
+#ifndef DISTANCE_FIELD_H
+#define DISTANCE_FIELD_H
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <cstdint>
+
+#include "cellType.h"
+
+// Narrow-band signed distance field of a closed triangle mesh, sampled on a regular grid in the object space of the mesh
+// Negative values are inside the mesh; values are clamped to [-bandWidth, bandWidth]
+class DistanceField
+{
+public:
+	DistanceField();
+
+	// Build the field from mesh data as used by Mesh3D (6 floats per vertex: position, normal; 3 indices per triangle)
+	// <resolution> is the number of cells along the longest side of the mesh bounding box, <band> the width of the narrow band in cells
+	void build(const std::vector<float>& vertexData, const std::vector<uint32_t>& indexData, int resolution, int band, int threads = 0);
+
+	bool isValid() const { return !m_values.empty(); };
+	int getResolution() const { return m_buildResolution; };
+	int getBand() const { return m_buildBand; };
+
+	// Trilinear interpolation of the signed distance at an object space position
+	// Positions outside of the sampled region return the band width (outside)
+	float sample(const DirectX::XMFLOAT3& pos) const;
+
+	// Rasterize the field into a voxel grid: Every voxel, whose center lies inside the mesh or closer than <dilation> (in object space units) to its surface,
+	// is set to CELL_TYPE_SOLID_NO_SLIP; other voxels are left untouched so several meshes can be combined in one grid
+	// <voxelToObject> transforms voxel space (voxel (x, y, z) covers [x, x + 1] x [y, y + 1] x [z, z + 1]) into the object space of the mesh
+	// Returns the number of voxels which were tested
+	uint64_t voxelize(const DirectX::XMFLOAT4X4& voxelToObject, const DirectX::XMUINT3& resolution, float dilation, wtl::CellType* cellTypes, int threads = 0) const;
+
+private:
+	float sample(float x, float y, float z) const;
+
+	DirectX::XMFLOAT3 m_origin; // Object space position of node (0, 0, 0)
+	float m_cellSize;
+	float m_bandWidth; // Clamping distance in object space units
+	DirectX::XMUINT3 m_dim; // Number of nodes along each axis
+	int m_buildResolution;
+	int m_buildBand;
+
+	std::vector<float> m_values; // x fastest, m_dim.x * m_dim.y * m_dim.z values
+};
+
+#endif
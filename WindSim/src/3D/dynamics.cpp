@@ -106,6 +106,7 @@ Dynamics::Dynamics(Mesh3D& mesh)
 	, m_rotationAxis(0.0f, 0.0f, 0.0f)
 	, m_angVel({ 0.0f, 0.0f, 0.0f })
 	, m_angAcc({0.0f, 0.0f, 0.0f})
+	, m_torque(0.0f, 0.0f, 0.0f)
 	, m_renderRot()
 	, m_calcRot()
 {
@@ -170,6 +171,7 @@ void Dynamics::calculate(ID3D11Device* device, ID3D11DeviceContext* context, con
 	XMQuaternionToAxisAngle(&axis, &angle, oRot);
 	XMStoreFloat3(&m_debugTrq, trq);
 	trq = XMVector3Rotate(trq, XMQuaternionInverse(oRot));
+	XMStoreFloat3(&m_torque, trq);
 
 	//// Torque because of friction
 	//// Friction torque = Fn * f * d/2; see http://www.roymech.co.uk/Useful_Tables/Tribology/Bearing%20Friction.html
@@ -334,12 +336,48 @@ void Dynamics::render(ID3D11Device* device, ID3D11DeviceContext* context, const
 }
 
 
+Dynamics::State Dynamics::getState() const
+{
+	State state;
+	state.angVel = m_angVel;
+	state.angAcc = m_angAcc;
+	state.renderRot = m_renderRot;
+	state.calcRot = m_calcRot;
+	return state;
+}
+
+void Dynamics::setState(const State& state)
+{
+	m_angVel = state.angVel;
+	m_angAcc = state.angAcc;
+	m_renderRot = state.renderRot;
+	m_calcRot = state.calcRot;
+}
+
 void Dynamics::reset()
 {
 	XMStoreFloat4(&m_renderRot, XMQuaternionIdentity());
 	XMStoreFloat4(&m_calcRot, XMQuaternionIdentity());
 	XMStoreFloat3(&m_angVel, XMVectorZero());
 	XMStoreFloat3(&m_angAcc, XMVectorZero());
+	XMStoreFloat3(&m_torque, XMVectorZero());
+}
+
+void Dynamics::getAxialMotion(float& torque, float& angVel, float& angAcc) const
+{
+	XMVECTOR axis = XMLoadFloat3(&m_rotationAxis);
+	if (XMVector3Equal(axis, XMVectorZero()))
+	{
+		torque = XMVectorGetX(XMVector3Length(XMLoadFloat3(&m_torque)));
+		angVel = XMVectorGetX(XMVector3Length(XMLoadFloat3(&m_angVel)));
+		angAcc = XMVectorGetX(XMVector3Length(XMLoadFloat3(&m_angAcc)));
+	}
+	else
+	{
+		torque = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&m_torque), axis));
+		angVel = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&m_angVel), axis));
+		angAcc = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&m_angAcc), axis));
+	}
 }
 
 Dynamics::ShaderVariables::ShaderVariables()
@@ -25,6 +25,15 @@ class Mesh3D;
 class Dynamics
 {
 public:
+	// Integration state, which is not derived from the mesh (see Simulator::saveCheckpoint)
+	struct State
+	{
+		DirectX::XMFLOAT3 angVel;
+		DirectX::XMFLOAT3 angAcc;
+		DirectX::XMFLOAT4 renderRot;
+		DirectX::XMFLOAT4 calcRot;
+	};
+
 	static HRESULT createShaderFromFile(const std::wstring& path, ID3D11Device* device, const bool reload = false);
 	static void releaseShader();
 
@@ -45,6 +54,11 @@ public:
 	const DirectX::XMFLOAT3& getCenterOfMass() const { return m_centerOfMass; };
 	const DirectX::XMFLOAT3& getAngularVelocity() const { return m_angVel; };
 	void updateCalcRotation() { m_calcRot = m_renderRot; };
+	State getState() const;
+	// Torque of the flow (body frame, without the bearing friction), angular velocity and angular acceleration about the rotation axis,
+	// their magnitudes if the mesh rotates freely
+	void getAxialMotion(float& torque, float& angVel, float& angAcc) const;
+	void setState(const State& state);
 
 	void reset();
 
@@ -83,6 +97,7 @@ private:
 
 	DirectX::XMFLOAT3 m_angVel;
 	DirectX::XMFLOAT3 m_debugTrq;
+	DirectX::XMFLOAT3 m_torque; // Of the flow in the body frame, without the bearing friction
 	DirectX::XMFLOAT3 m_angAcc;
 	DirectX::XMFLOAT4 m_renderRot; // Additional rotation arround the center of mass through Dynamics simulation, recalculated every frame
 	DirectX::XMFLOAT4 m_calcRot; // Additional rotation arround center of mass through Dynamics simulation, recalculated every dynamics calculation
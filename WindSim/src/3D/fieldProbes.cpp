@@ -0,0 +1,416 @@
+#include "fieldProbes.h"
+#include "fieldSampler.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const size_t QUEUE_STEPS = 64; // Steps waiting for the file writer, further steps are not written
+	const int MAX_HISTORY_SAMPLES = 1 << 22; // Point samples in the history of a probe (64MB), so large planes keep fewer steps
+
+	XMFLOAT3 lerp(const XMFLOAT3& a, const XMFLOAT3& b, float t)
+	{
+		XMFLOAT3 result;
+		XMStoreFloat3(&result, XMVectorLerp(XMLoadFloat3(&a), XMLoadFloat3(&b), t));
+		return result;
+	}
+}
+
+FieldProbes::Probe::Probe()
+	: id(-1),
+	type(Type::Point),
+	name(),
+	numPoints(0),
+	numU(0),
+	numV(0),
+	positions()
+{
+}
+
+FieldProbes::Sample::Sample()
+	: step(0),
+	time(0.0),
+	values()
+{
+}
+
+FieldProbes::FieldProbes(int historyLength, int threads)
+	: m_historyLength(std::max(historyLength, 1)),
+	m_threads(threads),
+	m_mutex(),
+	m_probes(),
+	m_nextId(0),
+	m_worldToVoxel(),
+	m_world(),
+	m_voxelSize(1.0f, 1.0f, 1.0f),
+	m_voxelPositions(),
+	m_values(),
+	m_layout(std::make_shared<Layout>()),
+	m_writing(false),
+	m_statistics(nullptr),
+	m_file(),
+	m_writer(),
+	m_queueMutex(),
+	m_queueCond(),
+	m_queue(),
+	m_freeBuffers(),
+	m_stopping(false),
+	m_error(),
+	m_numSteps(0),
+	m_numDropped(0),
+	m_sampleTime(0.0)
+{
+	XMStoreFloat4x4(&m_worldToVoxel, XMMatrixIdentity());
+	XMStoreFloat4x4(&m_world, XMMatrixIdentity());
+}
+
+FieldProbes::~FieldProbes()
+{
+	closeFile();
+}
+
+void FieldProbes::setGridTransform(const XMFLOAT4X4& world, const XMFLOAT3& voxelSize)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (std::memcmp(&world, &m_world, sizeof(world)) == 0 && std::memcmp(&voxelSize, &m_voxelSize, sizeof(voxelSize)) == 0)
+		return;
+
+	// World space -> grid object space -> voxel space (as VoxelGrid::voxelize)
+	XMMATRIX worldToGrid = XMMatrixInverse(nullptr, XMLoadFloat4x4(&world));
+	XMMATRIX gridToVoxel = XMMatrixScalingFromVector(XMVectorReciprocal(XMLoadFloat3(&voxelSize)));
+	XMStoreFloat4x4(&m_worldToVoxel, worldToGrid * gridToVoxel);
+	m_world = world;
+	m_voxelSize = voxelSize;
+	updatePositions();
+}
+
+int FieldProbes::addPoint(const std::string& name, const XMFLOAT3& position)
+{
+	Probe probe;
+	probe.type = Type::Point;
+	probe.name = name;
+	probe.numU = 1;
+	probe.numV = 1;
+	probe.positions.push_back(position);
+	return add(probe);
+}
+
+int FieldProbes::addLine(const std::string& name, const XMFLOAT3& from, const XMFLOAT3& to, int numPoints)
+{
+	Probe probe;
+	probe.type = Type::Line;
+	probe.name = name;
+	probe.numU = std::max(numPoints, 1);
+	probe.numV = 1;
+	for (int i = 0; i < probe.numU; ++i)
+		probe.positions.push_back(lerp(from, to, probe.numU > 1 ? static_cast<float>(i) / (probe.numU - 1) : 0.0f));
+	return add(probe);
+}
+
+int FieldProbes::addPlane(const std::string& name, const XMFLOAT3& origin, const XMFLOAT3& u, const XMFLOAT3& v, int numU, int numV)
+{
+	Probe probe;
+	probe.type = Type::Plane;
+	probe.name = name;
+	probe.numU = std::max(numU, 1);
+	probe.numV = std::max(numV, 1);
+	XMVECTOR o = XMLoadFloat3(&origin);
+	XMVECTOR du = probe.numU > 1 ? XMLoadFloat3(&u) / static_cast<float>(probe.numU - 1) : XMVectorZero();
+	XMVECTOR dv = probe.numV > 1 ? XMLoadFloat3(&v) / static_cast<float>(probe.numV - 1) : XMVectorZero();
+	for (int j = 0; j < probe.numV; ++j)
+	{
+		for (int i = 0; i < probe.numU; ++i)
+		{
+			XMFLOAT3 position;
+			XMStoreFloat3(&position, o + du * static_cast<float>(i) + dv * static_cast<float>(j));
+			probe.positions.push_back(position);
+		}
+	}
+	return add(probe);
+}
+
+int FieldProbes::add(Probe& probe)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	probe.id = m_nextId++;
+	probe.numPoints = static_cast<int>(probe.positions.size());
+
+	std::unique_ptr<Entry> entry(new Entry());
+	entry->probe = probe;
+	entry->offset = 0;
+	History& history = entry->history;
+	history.capacity = std::max(1, std::min(m_historyLength, MAX_HISTORY_SAMPLES / std::max(probe.numPoints, 1)));
+	history.values.assign(static_cast<size_t>(history.capacity) * probe.numPoints * 4, 0.0f);
+	history.steps.assign(history.capacity, 0);
+	history.times.assign(history.capacity, 0.0);
+	history.next = 0;
+	history.count = 0;
+	m_probes.push_back(std::move(entry));
+
+	updatePositions();
+	return probe.id;
+}
+
+bool FieldProbes::remove(int id)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = std::find_if(m_probes.begin(), m_probes.end(), [id](const std::unique_ptr<Entry>& entry) { return entry->probe.id == id; });
+	if (it == m_probes.end())
+		return false;
+
+	m_probes.erase(it);
+	updatePositions();
+	return true;
+}
+
+void FieldProbes::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_probes.clear();
+	updatePositions();
+}
+
+void FieldProbes::updatePositions()
+{
+	XMMATRIX worldToVoxel = XMLoadFloat4x4(&m_worldToVoxel);
+	std::shared_ptr<Layout> layout = std::make_shared<Layout>();
+	m_voxelPositions.clear();
+
+	for (auto& entry : m_probes)
+	{
+		const Probe& probe = entry->probe;
+		entry->offset = m_voxelPositions.size();
+		int index = static_cast<int>(layout->names.size());
+		layout->names.push_back(probe.name);
+		for (int i = 0; i < probe.numPoints; ++i)
+		{
+			XMFLOAT3 position;
+			XMStoreFloat3(&position, XMVector3TransformCoord(XMLoadFloat3(&probe.positions[i]), worldToVoxel));
+			m_voxelPositions.push_back(position);
+			layout->probe.push_back(index);
+			layout->point.push_back(i);
+			layout->positions.push_back(probe.positions[i]);
+		}
+	}
+	m_values.resize(m_voxelPositions.size() * 4);
+	m_layout = layout;
+}
+
+std::vector<FieldProbes::Probe> FieldProbes::getProbes() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<Probe> probes;
+	for (auto& entry : m_probes)
+		probes.push_back(entry->probe);
+	return probes;
+}
+
+bool FieldProbes::getLatest(int id, Sample& sample) const
+{
+	std::vector<Sample> history = getHistory(id, 1);
+	if (history.empty())
+		return false;
+
+	std::swap(sample, history.front());
+	return true;
+}
+
+std::vector<FieldProbes::Sample> FieldProbes::getHistory(int id, int maxSamples) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<Sample> samples;
+	auto it = std::find_if(m_probes.begin(), m_probes.end(), [id](const std::unique_ptr<Entry>& entry) { return entry->probe.id == id; });
+	if (it == m_probes.end())
+		return samples;
+
+	const History& history = (*it)->history;
+	const size_t numPoints = (*it)->probe.numPoints;
+	int count = maxSamples < 0 ? history.count : std::min(maxSamples, history.count);
+	samples.resize(count);
+	for (int i = 0; i < count; ++i)
+	{
+		int slot = (history.next - count + i + history.capacity) % history.capacity;
+		Sample& sample = samples[i];
+		sample.step = history.steps[slot];
+		sample.time = history.times[slot];
+		sample.values.resize(numPoints);
+		std::memcpy(&sample.values[0].x, history.values.data() + slot * numPoints * 4, numPoints * 4 * sizeof(float));
+	}
+	return samples;
+}
+
+bool FieldProbes::getSeries(int id, int point, std::vector<double>& times, std::vector<XMFLOAT4>& values) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = std::find_if(m_probes.begin(), m_probes.end(), [id](const std::unique_ptr<Entry>& entry) { return entry->probe.id == id; });
+	if (it == m_probes.end() || point < 0 || point >= (*it)->probe.numPoints)
+		return false;
+
+	const History& history = (*it)->history;
+	const size_t numPoints = (*it)->probe.numPoints;
+	times.resize(history.count);
+	values.resize(history.count);
+	for (int i = 0; i < history.count; ++i)
+	{
+		int slot = (history.next - history.count + i + history.capacity) % history.capacity;
+		const float* v = history.values.data() + (slot * numPoints + point) * 4;
+		times[i] = history.times[slot];
+		values[i] = XMFLOAT4(v[0], v[1], v[2], v[3]);
+	}
+	return true;
+}
+
+int FieldProbes::getNumPoints() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return static_cast<int>(m_voxelPositions.size());
+}
+
+bool FieldProbes::openFile(const std::string& path)
+{
+	closeFile();
+	m_file.open(path, std::ios::out | std::ios::trunc);
+	if (!m_file.is_open())
+	{
+		m_error = "Failed to open '" + path + "' for writing.";
+		return false;
+	}
+
+	m_file << std::setprecision(8) << "step,time,probe,point,x,y,z,u,v,w,p\n";
+	m_stopping = false;
+	m_writer = std::thread(&FieldProbes::write, this);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_writing = true;
+	return true;
+}
+
+void FieldProbes::closeFile()
+{
+	if (!m_writer.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_writing = false;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_stopping = true;
+	}
+	m_queueCond.notify_all();
+	m_writer.join();
+	m_file.close();
+	m_freeBuffers.clear();
+}
+
+void FieldProbes::setStatistics(SignalStatistics* statistics)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_statistics = statistics;
+}
+
+void FieldProbes::stepPublished(const FieldFrame& frame)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_voxelPositions.empty())
+		return;
+
+	FieldSampler sampler(frame.velocity, frame.pressure, frame.resolution);
+	sampler.sample(m_voxelPositions.data(), m_voxelPositions.size(), m_values.data(), m_threads);
+
+	for (auto& entry : m_probes)
+	{
+		History& history = entry->history;
+		const size_t numPoints = entry->probe.numPoints;
+		std::memcpy(history.values.data() + history.next * numPoints * 4, m_values.data() + entry->offset * 4, numPoints * 4 * sizeof(float));
+		history.steps[history.next] = frame.step;
+		history.times[history.next] = frame.time;
+		history.next = (history.next + 1) % history.capacity;
+		history.count = std::min(history.count + 1, history.capacity);
+
+		// Only the means are queued, the statistics are updated by their own thread
+		if (m_statistics)
+		{
+			double speed = 0.0, pressure = 0.0;
+			int count = 0;
+			for (const float* v = m_values.data() + entry->offset * 4, *end = v + numPoints * 4; v < end; v += 4)
+			{
+				if (std::isnan(v[3]))
+					continue;
+				speed += std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+				pressure += v[3];
+				count++;
+			}
+			if (count > 0)
+			{
+				m_statistics->add(entry->probe.name + "/speed", frame.time, speed / count);
+				m_statistics->add(entry->probe.name + "/pressure", frame.time, pressure / count);
+			}
+		}
+	}
+
+	if (m_writing)
+	{
+		// The buffers are reused, so the steps are handed to the writer without allocating once the queue is warmed up
+		std::unique_lock<std::mutex> queueLock(m_queueMutex);
+		if (m_queue.size() < QUEUE_STEPS)
+		{
+			Pending pending;
+			pending.step = frame.step;
+			pending.time = frame.time;
+			pending.layout = m_layout;
+			if (!m_freeBuffers.empty())
+			{
+				std::swap(pending.values, m_freeBuffers.back());
+				m_freeBuffers.pop_back();
+			}
+			pending.values.assign(m_values.begin(), m_values.end());
+			m_queue.push_back(std::move(pending));
+			queueLock.unlock();
+			m_queueCond.notify_one();
+		}
+		else
+			m_numDropped++;
+	}
+
+	m_numSteps++;
+	m_sampleTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FieldProbes::write()
+{
+	for (;;)
+	{
+		Pending pending;
+		{
+			std::unique_lock<std::mutex> lock(m_queueMutex);
+			m_queueCond.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+			if (m_queue.empty())
+				return;
+			pending = std::move(m_queue.front());
+			m_queue.pop_front();
+		}
+
+		const Layout& layout = *pending.layout;
+		for (size_t i = 0; i < layout.probe.size(); ++i)
+		{
+			const float* v = pending.values.data() + 4 * i;
+			const XMFLOAT3& p = layout.positions[i];
+			m_file << pending.step << ',' << pending.time << ',' << layout.names[layout.probe[i]] << ',' << layout.point[i] << ','
+				<< p.x << ',' << p.y << ',' << p.z << ',' << v[0] << ',' << v[1] << ',' << v[2] << ',' << v[3] << '\n';
+		}
+		m_file.flush();
+
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_freeBuffers.push_back(std::move(pending.values));
+	}
+}
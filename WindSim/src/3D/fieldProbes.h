@@ -0,0 +1,155 @@
+#ifndef FIELD_PROBES_H
+#define FIELD_PROBES_H
+
+#include "stepListener.h"
+#include "signalStatistics.h"
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+// Samples velocity and pressure at points, along lines and on planes after every simulation step
+// Probes are placed in world space and moved into voxel space with the transformation of the grid (see setGridTransform), so they stay
+// where they were placed when the grid is moved or resized. The points of all probes are sampled in one batch (see FieldSampler); each
+// probe keeps the samples of the last <historyLength> steps for the GUI (fewer for large planes), and openFile additionally streams all samples to a CSV file,
+// which is written by a background thread. Points outside of the grid are sampled as NaN
+class FieldProbes : public StepListener
+{
+public:
+	enum class Type { Point, Line, Plane };
+
+	struct Probe
+	{
+		Probe();
+		int id;
+		Type type;
+		std::string name;
+		int numPoints;
+		int numU, numV; // Points along the two axes of a plane; numPoints and 1 for the others
+		std::vector<DirectX::XMFLOAT3> positions; // World space, u fastest for planes
+	};
+
+	// Values of the points of a probe in one step
+	struct Sample
+	{
+		Sample();
+		int step;
+		double time; // Simulated time in seconds
+		std::vector<DirectX::XMFLOAT4> values; // Velocity in xyz, pressure in w (both in simulation units)
+	};
+
+	FieldProbes(int historyLength = 512, int threads = 1);
+	~FieldProbes();
+
+	// Grid object space -> world space (the world matrix of the VoxelGrid actor) and the voxel size; only changes are applied
+	void setGridTransform(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT3& voxelSize);
+
+	// Add a probe and return its id; the history of all probes starts with the next step
+	int addPoint(const std::string& name, const DirectX::XMFLOAT3& position);
+	int addLine(const std::string& name, const DirectX::XMFLOAT3& from, const DirectX::XMFLOAT3& to, int numPoints); // Rake including both ends
+	int addPlane(const std::string& name, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& u, const DirectX::XMFLOAT3& v, int numU, int numV); // Spans origin + [0, 1] * u + [0, 1] * v
+	bool remove(int id);
+	void clear();
+
+	// Queries, thread safe
+	std::vector<Probe> getProbes() const;
+	bool getLatest(int id, Sample& sample) const; // False if the probe does not exist or has no sample yet
+	std::vector<Sample> getHistory(int id, int maxSamples = -1) const; // Oldest first, at most the last <maxSamples>
+	bool getSeries(int id, int point, std::vector<double>& times, std::vector<DirectX::XMFLOAT4>& values) const; // History of a single point, oldest first
+	int getNumPoints() const; // Of all probes
+
+	// CSV output of every step (step, time, probe, point, position, velocity and pressure); closeFile waits for the queued steps
+	bool openFile(const std::string& path);
+	void closeFile();
+	bool isFileOpen() const { return m_writer.joinable(); };
+
+	// After every step, the mean speed and pressure over the points of each probe (without the points outside of the grid) are added to
+	// <statistics> as "<name>/speed" and "<name>/pressure" with the simulated time; null for none
+	void setStatistics(SignalStatistics* statistics);
+
+	void stepPublished(const FieldFrame& frame) override;
+
+	const std::string& errorString() const { return m_error; };
+	uint64_t getNumSteps() const { return m_numSteps; };
+	uint64_t getNumDropped() const { return m_numDropped; }; // Steps, which the file writer could not keep up with
+	double getSampleTime() const { return m_sampleTime; }; // msec in the simulation thread, summed over all steps
+
+private:
+	// Samples of a probe in a ring of steps
+	struct History
+	{
+		std::vector<float> values; // 4 floats per point and step
+		std::vector<int> steps;
+		std::vector<double> times;
+		int capacity; // <historyLength> steps, fewer for probes with many points
+		int next; // Slot of the next step
+		int count;
+	};
+
+	struct Entry
+	{
+		Probe probe;
+		size_t offset; // First point in m_voxelPositions
+		History history;
+	};
+
+	// Description of the points for the file writer, replaced as a whole when the probes change
+	struct Layout
+	{
+		std::vector<int> probe; // Index into names per point
+		std::vector<int> point; // Within its probe
+		std::vector<DirectX::XMFLOAT3> positions;
+		std::vector<std::string> names;
+	};
+
+	struct Pending
+	{
+		int step;
+		double time;
+		std::shared_ptr<const Layout> layout;
+		std::vector<float> values;
+	};
+
+	int add(Probe& probe);
+	void updatePositions(); // Needs m_mutex
+	void write();
+
+	int m_historyLength;
+	int m_threads;
+
+	mutable std::mutex m_mutex; // Guards the probes, the positions and the histories
+	std::vector<std::unique_ptr<Entry>> m_probes;
+	int m_nextId;
+	DirectX::XMFLOAT4X4 m_worldToVoxel;
+	DirectX::XMFLOAT4X4 m_world;
+	DirectX::XMFLOAT3 m_voxelSize;
+	std::vector<DirectX::XMFLOAT3> m_voxelPositions; // Of all probes
+	std::vector<float> m_values; // Samples of the current step
+	std::shared_ptr<const Layout> m_layout;
+	bool m_writing; // Steps are queued for the file writer
+	SignalStatistics* m_statistics;
+
+	std::ofstream m_file;
+	std::thread m_writer;
+	std::mutex m_queueMutex; // Guards the queue
+	std::condition_variable m_queueCond;
+	std::deque<Pending> m_queue;
+	std::vector<std::vector<float>> m_freeBuffers;
+	bool m_stopping;
+
+	std::string m_error;
+	std::atomic<uint64_t> m_numSteps;
+	std::atomic<uint64_t> m_numDropped;
+	double m_sampleTime;
+};
+
+#endif
@@ -0,0 +1,232 @@
+#include "fieldPyramid.h"
+#include "parallel.h"
+
+#include <emmintrin.h>
+
+#include <chrono>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const unsigned int GRAIN_CELLS = 1 << 14; // Cells of a level per chunk of work at least, so the coarse levels are built in one go
+
+	inline bool isFluid(wtl::CellType type)
+	{
+		return type != wtl::CELL_TYPE_SOLID_SLIP && type != wtl::CELL_TYPE_SOLID_NO_SLIP && type != wtl::CELL_TYPE_SOLID_BOUNDARY;
+	}
+
+	XMUINT3 halved(const XMUINT3& resolution)
+	{
+		return XMUINT3((resolution.x + 1) / 2, (resolution.y + 1) / 2, (resolution.z + 1) / 2);
+	}
+
+	void resize(FieldPyramid::Level& level, int scale, const XMUINT3& resolution)
+	{
+		const size_t numCells = static_cast<size_t>(resolution.x) * resolution.y * resolution.z;
+		level.scale = scale;
+		level.resolution = resolution;
+		level.values.resize(4 * numCells);
+		level.fluid.resize(numCells);
+	}
+
+	int grain(const XMUINT3& resolution)
+	{
+		return static_cast<int>(std::max(1u, GRAIN_CELLS / std::max(1u, resolution.x * resolution.y)));
+	}
+}
+
+FieldPyramid::Level::Level()
+	: scale(1),
+	resolution(0, 0, 0),
+	values(),
+	fluid()
+{
+}
+
+XMFLOAT4 FieldPyramid::Level::at(unsigned int x, unsigned int y, unsigned int z) const
+{
+	const float* value = values.data() + 4 * (x + static_cast<size_t>(resolution.x) * (y + static_cast<size_t>(resolution.y) * z));
+	return XMFLOAT4(value[0], value[1], value[2], value[3]);
+}
+
+FieldPyramid::Pyramid::Pyramid()
+	: step(0),
+	time(0.0),
+	resolution(0, 0, 0),
+	levels(),
+	buildTime(0.0)
+{
+}
+
+const FieldPyramid::Level* FieldPyramid::Pyramid::level(int level) const
+{
+	return level >= 1 && level <= static_cast<int>(levels.size()) ? &levels[level - 1] : nullptr;
+}
+
+FieldPyramid::FieldPyramid(int threads)
+	: m_threads(threads),
+	m_enabled(false),
+	m_pyramids(),
+	m_mutex(),
+	m_latest()
+{
+}
+
+void FieldPyramid::stepPublished(const FieldFrame& frame)
+{
+	if (!m_enabled)
+		return;
+
+	auto start = std::chrono::steady_clock::now();
+
+	// A pyramid, which only this list holds, is neither the latest one nor in use by a consumer
+	std::shared_ptr<Pyramid> pyramid;
+	for (const auto& candidate : m_pyramids)
+	{
+		if (candidate.use_count() == 1)
+		{
+			pyramid = candidate;
+			break;
+		}
+	}
+	if (!pyramid)
+	{
+		pyramid = std::make_shared<Pyramid>();
+		m_pyramids.push_back(pyramid);
+	}
+
+	pyramid->step = frame.step;
+	pyramid->time = frame.time;
+	pyramid->resolution = frame.resolution;
+
+	int numLevels = 0;
+	for (XMUINT3 resolution = frame.resolution; resolution.x > 1 || resolution.y > 1 || resolution.z > 1; resolution = halved(resolution))
+		++numLevels;
+	pyramid->levels.resize(numLevels);
+	for (int i = 0; i < numLevels; ++i)
+	{
+		if (i == 0)
+			downsample(frame.velocity, frame.pressure, reinterpret_cast<const wtl::CellType*>(frame.cellTypes), frame.resolution, pyramid->levels[0], m_threads);
+		else
+			downsample(pyramid->levels[i - 1], pyramid->levels[i], m_threads);
+	}
+	pyramid->buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_latest = pyramid;
+}
+
+std::shared_ptr<const FieldPyramid::Pyramid> FieldPyramid::getLatest() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_latest;
+}
+
+int FieldPyramid::levelFor(float spacing)
+{
+	// NaN fails the comparison as well
+	int level = 0;
+	while (spacing >= 2.0f && level < 30)
+	{
+		spacing *= 0.5f;
+		++level;
+	}
+	return level;
+}
+
+void FieldPyramid::downsample(const float* velocity, const float* pressure, const wtl::CellType* cellTypes, const XMUINT3& resolution, Level& level, int threads)
+{
+	resize(level, 2, halved(resolution));
+	const XMUINT3 res = level.resolution;
+	const size_t fineX = resolution.x;
+	const size_t fineSlice = fineX * resolution.y;
+
+	Parallel::forRange(0, static_cast<int>(res.z), [&](int first, int last)
+	{
+		for (unsigned int z = first; z < static_cast<unsigned int>(last); ++z)
+		{
+			const unsigned int z0 = 2 * z, z1 = std::min(z0 + 2, resolution.z);
+			for (unsigned int y = 0; y < res.y; ++y)
+			{
+				const unsigned int y0 = 2 * y, y1 = std::min(y0 + 2, resolution.y);
+				const size_t row = res.x * (y + static_cast<size_t>(res.y) * z);
+				float* out = level.values.data() + 4 * row;
+				float* fluid = level.fluid.data() + row;
+				for (unsigned int x = 0; x < res.x; ++x)
+				{
+					const unsigned int x0 = 2 * x, x1 = std::min(x0 + 2, resolution.x);
+					__m128 sum = _mm_setzero_ps();
+					int count = 0;
+					for (unsigned int fz = z0; fz < z1; ++fz)
+					{
+						for (unsigned int fy = y0; fy < y1; ++fy)
+						{
+							for (unsigned int fx = x0; fx < x1; ++fx)
+							{
+								const size_t i = fx + fineX * fy + fineSlice * fz;
+								if (cellTypes && !isFluid(cellTypes[i]))
+									continue;
+
+								// (x, y, z, pressure)
+								__m128 v = _mm_loadu_ps(velocity + 4 * i);
+								__m128 p = _mm_set1_ps(pressure ? pressure[i] : 0.0f);
+								sum = _mm_add_ps(sum, _mm_shuffle_ps(v, _mm_unpackhi_ps(v, p), _MM_SHUFFLE(1, 0, 1, 0)));
+								++count;
+							}
+						}
+					}
+					_mm_storeu_ps(out + 4 * x, count > 0 ? _mm_mul_ps(sum, _mm_set1_ps(1.0f / count)) : _mm_setzero_ps());
+					fluid[x] = static_cast<float>(count);
+				}
+			}
+		}
+	}, threads, grain(res));
+}
+
+void FieldPyramid::downsample(const Level& fine, Level& coarse, int threads)
+{
+	resize(coarse, 2 * fine.scale, halved(fine.resolution));
+	const XMUINT3 res = coarse.resolution;
+	const XMUINT3 fineRes = fine.resolution;
+	const size_t fineX = fineRes.x;
+	const size_t fineSlice = fineX * fineRes.y;
+
+	Parallel::forRange(0, static_cast<int>(res.z), [&](int first, int last)
+	{
+		for (unsigned int z = first; z < static_cast<unsigned int>(last); ++z)
+		{
+			const unsigned int z0 = 2 * z, z1 = std::min(z0 + 2, fineRes.z);
+			for (unsigned int y = 0; y < res.y; ++y)
+			{
+				const unsigned int y0 = 2 * y, y1 = std::min(y0 + 2, fineRes.y);
+				const size_t row = res.x * (y + static_cast<size_t>(res.y) * z);
+				float* out = coarse.values.data() + 4 * row;
+				float* fluid = coarse.fluid.data() + row;
+				for (unsigned int x = 0; x < res.x; ++x)
+				{
+					const unsigned int x0 = 2 * x, x1 = std::min(x0 + 2, fineRes.x);
+					__m128 sum = _mm_setzero_ps();
+					float weight = 0.0f;
+					for (unsigned int fz = z0; fz < z1; ++fz)
+					{
+						for (unsigned int fy = y0; fy < y1; ++fy)
+						{
+							for (unsigned int fx = x0; fx < x1; ++fx)
+							{
+								// Weighted by the fluid cells, so the result is the mean of the fluid cells of the simulation grid
+								const size_t i = fx + fineX * fy + fineSlice * fz;
+								const float w = fine.fluid[i];
+								sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(fine.values.data() + 4 * i), _mm_set1_ps(w)));
+								weight += w;
+							}
+						}
+					}
+					_mm_storeu_ps(out + 4 * x, weight > 0.0f ? _mm_mul_ps(sum, _mm_set1_ps(1.0f / weight)) : _mm_setzero_ps());
+					fluid[x] = weight;
+				}
+			}
+		}
+	}, threads, grain(res));
+}
@@ -0,0 +1,75 @@
+#ifndef FIELD_PYRAMID_H
+#define FIELD_PYRAMID_H
+
+#include "stepListener.h"
+#include "cellType.h"
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+// Mip chain of the velocity and pressure of every simulation step for coarse consumers (overview glyphs, far-field queries), so these
+// read n/8^k cells on level k instead of the full grid. Each cell of level k averages the fluid cells of the 2^k x 2^k x 2^k cells of the
+// simulation grid below it; solid cells are ignored (as inflow and outflow count as fluid), so the no-slip walls do not drag the averages
+// of the cells next to the geometry towards zero. Cells without fluid are 0. Odd resolutions round up; the last cell covers what is left
+//
+// Level 1 is reduced from the fields of the step, every further level from the one below, weighted by the fluid cells; the cells of a
+// level are built per z-slice in parallel in the simulation thread with one SSE vector per cell (velocity xyz and pressure in w)
+// Finished pyramids are immutable and shared with the consumers; the buffers of a pyramid are reused once no consumer holds it
+class FieldPyramid : public StepListener
+{
+public:
+	struct Level
+	{
+		Level();
+		int scale; // Cells of the simulation grid per cell of this level along each axis, 2^level
+		DirectX::XMUINT3 resolution;
+		std::vector<float> values; // Velocity xyz and pressure in w per cell (x fastest), the layout of FieldSampler's velocity
+		std::vector<float> fluid; // Number of fluid cells of the simulation grid within each cell
+
+		DirectX::XMFLOAT4 at(unsigned int x, unsigned int y, unsigned int z) const;
+	};
+
+	struct Pyramid
+	{
+		Pyramid();
+		int step;
+		double time;
+		DirectX::XMUINT3 resolution; // Of the simulation grid
+		std::vector<Level> levels; // levels[i] is level i + 1, down to a single cell
+		double buildTime; // msec in the simulation thread
+
+		const Level* level(int level) const; // Null for level 0 (the fields of the simulation) and below the coarsest level
+	};
+
+	FieldPyramid(int threads = 0);
+
+	// The pyramid is only built while enabled (applies from the next step on)
+	void setEnabled(bool enabled) { m_enabled = enabled; };
+	bool isEnabled() const { return m_enabled; };
+
+	void stepPublished(const FieldFrame& frame) override;
+
+	// Pyramid of the latest step, null before the first one; stays valid while held
+	std::shared_ptr<const Pyramid> getLatest() const;
+
+	// Level, whose cells are at most <spacing> cells of the simulation grid wide (0 below 2 cells), e.g. for the distance of glyphs
+	static int levelFor(float spacing);
+
+	// Reduce the fields of a step (4 floats of velocity per cell, <pressure> and <cellTypes> may be null) to level 1 and a level to the next
+	static void downsample(const float* velocity, const float* pressure, const wtl::CellType* cellTypes, const DirectX::XMUINT3& resolution, Level& level, int threads = 1);
+	static void downsample(const Level& fine, Level& coarse, int threads = 1);
+
+private:
+	int m_threads;
+	std::atomic<bool> m_enabled;
+	std::vector<std::shared_ptr<Pyramid>> m_pyramids; // Of the simulation thread, for reuse
+
+	mutable std::mutex m_mutex; // Guards the latest pyramid
+	std::shared_ptr<const Pyramid> m_latest;
+};
+
+#endif
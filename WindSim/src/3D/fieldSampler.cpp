@@ -0,0 +1,133 @@
+#include "fieldSampler.h"
+#include "parallel.h"
+
+#include <emmintrin.h>
+
+#include <limits>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const int GRAIN = 1024; // Positions per chunk of work of the batch sampling
+
+	inline __m128 lerp(__m128 a, __m128 b, __m128 t)
+	{
+		return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+	}
+
+	// Interpolates the 8 velocity vectors around a position (padding in w)
+	inline __m128 velocityAt(const float* velocity, size_t base, size_t dx, size_t dy, size_t dz, __m128 tx, __m128 ty, __m128 tz)
+	{
+		const float* lower = velocity + 4 * base;
+		const float* upper = lower + 4 * dz;
+		__m128 c00 = lerp(_mm_loadu_ps(lower), _mm_loadu_ps(lower + 4 * dx), tx);
+		__m128 c10 = lerp(_mm_loadu_ps(lower + 4 * dy), _mm_loadu_ps(lower + 4 * (dy + dx)), tx);
+		__m128 c01 = lerp(_mm_loadu_ps(upper), _mm_loadu_ps(upper + 4 * dx), tx);
+		__m128 c11 = lerp(_mm_loadu_ps(upper + 4 * dy), _mm_loadu_ps(upper + 4 * (dy + dx)), tx);
+		return lerp(lerp(c00, c10, ty), lerp(c01, c11, ty), tz);
+	}
+
+	// Interpolates the 8 pressure values around a position: z first on both vectors of corners, then x and y
+	inline float pressureAt(const float* pressure, size_t base, size_t dx, size_t dy, size_t dz, __m128 tx, __m128 ty, __m128 tz)
+	{
+		const float* lower = pressure + base;
+		const float* upper = lower + dz;
+		__m128 c = lerp(_mm_setr_ps(lower[0], lower[dx], lower[dy], lower[dy + dx]), _mm_setr_ps(upper[0], upper[dx], upper[dy], upper[dy + dx]), tz);
+		__m128 rows = lerp(_mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 1, 3, 1)), tx); // (y0, y1, y0, y1)
+		return _mm_cvtss_f32(lerp(rows, _mm_shuffle_ps(rows, rows, _MM_SHUFFLE(1, 1, 1, 1)), ty));
+	}
+}
+
+FieldSampler::FieldSampler(const float* velocity, const float* pressure, const XMUINT3& resolution)
+	: m_velocity(velocity),
+	m_pressure(pressure),
+	m_resolution(resolution),
+	m_max(static_cast<float>(std::max(resolution.x, 1u) - 1), static_cast<float>(std::max(resolution.y, 1u) - 1), static_cast<float>(std::max(resolution.z, 1u) - 1), 0.0f)
+{
+}
+
+void FieldSampler::corners(FXMVECTOR position, Corners& c) const
+{
+	// Relative to the first cell center and clamped to the last one; _mm_max_ps takes the second operand for NaN, so NaN ends up at 0
+	const __m128 max = _mm_loadu_ps(&m_max.x);
+	__m128 f = _mm_min_ps(_mm_max_ps(_mm_sub_ps(position, _mm_set1_ps(0.5f)), _mm_setzero_ps()), max);
+	__m128i cell = _mm_cvttps_epi32(f);
+	__m128 lower = _mm_cvtepi32_ps(cell);
+	__m128 last = _mm_cmpge_ps(lower, max);
+	c.t = _mm_andnot_ps(last, _mm_sub_ps(f, lower));
+
+	int id[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(id), cell);
+	const int clamped = _mm_movemask_ps(last);
+	const size_t slice = static_cast<size_t>(m_resolution.x) * m_resolution.y;
+	c.base = id[0] + static_cast<size_t>(m_resolution.x) * id[1] + slice * id[2];
+	c.dx = clamped & 1 ? 0 : 1;
+	c.dy = clamped & 2 ? 0 : m_resolution.x;
+	c.dz = clamped & 4 ? 0 : slice;
+}
+
+XMFLOAT4 FieldSampler::sample(const XMFLOAT3& position) const
+{
+	Corners c;
+	corners(XMLoadFloat3(&position), c);
+	__m128 tx = _mm_shuffle_ps(c.t, c.t, _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 ty = _mm_shuffle_ps(c.t, c.t, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 tz = _mm_shuffle_ps(c.t, c.t, _MM_SHUFFLE(2, 2, 2, 2));
+
+	XMFLOAT4 result;
+	_mm_storeu_ps(&result.x, velocityAt(m_velocity, c.base, c.dx, c.dy, c.dz, tx, ty, tz));
+	result.w = m_pressure ? pressureAt(m_pressure, c.base, c.dx, c.dy, c.dz, tx, ty, tz) : 0.0f;
+	return result;
+}
+
+XMFLOAT3 FieldSampler::sampleVelocity(const XMFLOAT3& position) const
+{
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, sampleVelocity(XMLoadFloat3(&position)));
+	return result;
+}
+
+XMVECTOR FieldSampler::sampleVelocity(FXMVECTOR position) const
+{
+	Corners c;
+	corners(position, c);
+	return velocityAt(m_velocity, c.base, c.dx, c.dy, c.dz, _mm_shuffle_ps(c.t, c.t, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(c.t, c.t, _MM_SHUFFLE(1, 1, 1, 1)),
+		_mm_shuffle_ps(c.t, c.t, _MM_SHUFFLE(2, 2, 2, 2)));
+}
+
+void FieldSampler::sample(const XMFLOAT3* positions, size_t count, float* values, int threads) const
+{
+	const __m128 invalid = _mm_set1_ps(std::numeric_limits<float>::quiet_NaN());
+
+	Parallel::forRange(0, static_cast<int>(count), [&](int first, int last)
+	{
+		for (int i = first; i < last; ++i)
+		{
+			float* out = values + 4 * static_cast<size_t>(i);
+			if (!isInside(positions[i]))
+			{
+				_mm_storeu_ps(out, invalid);
+				continue;
+			}
+
+			Corners c;
+			corners(XMLoadFloat3(&positions[i]), c);
+			__m128 tx = _mm_shuffle_ps(c.t, c.t, _MM_SHUFFLE(0, 0, 0, 0));
+			__m128 ty = _mm_shuffle_ps(c.t, c.t, _MM_SHUFFLE(1, 1, 1, 1));
+			__m128 tz = _mm_shuffle_ps(c.t, c.t, _MM_SHUFFLE(2, 2, 2, 2));
+			__m128 velocity = velocityAt(m_velocity, c.base, c.dx, c.dy, c.dz, tx, ty, tz);
+			__m128 pressure = _mm_set1_ps(m_pressure ? pressureAt(m_pressure, c.base, c.dx, c.dy, c.dz, tx, ty, tz) : 0.0f);
+
+			// (x, y, z, pressure)
+			_mm_storeu_ps(out, _mm_shuffle_ps(velocity, _mm_unpackhi_ps(velocity, pressure), _MM_SHUFFLE(1, 0, 1, 0)));
+		}
+	}, threads, GRAIN);
+}
+
+bool FieldSampler::isInside(const XMFLOAT3& position) const
+{
+	return position.x >= 0.0f && position.y >= 0.0f && position.z >= 0.0f
+		&& position.x <= m_resolution.x && position.y <= m_resolution.y && position.z <= m_resolution.z;
+}
@@ -0,0 +1,47 @@
+#ifndef FIELD_SAMPLER_H
+#define FIELD_SAMPLER_H
+
+#include <DirectXMath.h>
+
+#include <cstddef>
+
+// Trilinear interpolation of the simulation fields on the CPU, as the linear sampler of the shaders reads the field textures
+// Positions are in voxel space: the grid spans [0, resolution] and cell i has its center at i + 0.5 (see VoxelGrid::voxelize); between the
+// outermost cell centers and the faces of the grid the values of the outermost cells are taken (clamp addressing)
+// The velocity has 4 floats per cell (see Simulator::getVelocity), so every corner is one SSE load; the 8 pressure corners are gathered
+// into two vectors, one per z-slice
+class FieldSampler
+{
+public:
+	// The fields are not copied; <pressure> may be null, then the pressure is sampled as 0
+	FieldSampler(const float* velocity, const float* pressure, const DirectX::XMUINT3& resolution);
+
+	// Velocity in xyz, pressure in w
+	DirectX::XMFLOAT4 sample(const DirectX::XMFLOAT3& position) const;
+	DirectX::XMFLOAT3 sampleVelocity(const DirectX::XMFLOAT3& position) const;
+	DirectX::XMVECTOR sampleVelocity(DirectX::FXMVECTOR position) const; // For integrators; w is undefined
+
+	// Samples <count> positions into <values> (4 floats each, as sample()) with up to <threads> threads
+	// Positions outside of the grid give NaN, so probes, which left the grid, are distinguishable from the clamped values at its faces
+	void sample(const DirectX::XMFLOAT3* positions, size_t count, float* values, int threads = 1) const;
+
+	bool isInside(const DirectX::XMFLOAT3& position) const; // Within [0, resolution]
+	const DirectX::XMUINT3& getResolution() const { return m_resolution; };
+
+private:
+	struct Corners
+	{
+		size_t base; // Cell of the lower corner
+		size_t dx, dy, dz; // Offsets to the upper corners, 0 where the position is clamped
+		DirectX::XMVECTOR t; // Weights of the upper corners along x, y and z
+	};
+
+	void corners(DirectX::FXMVECTOR position, Corners& c) const;
+
+	const float* m_velocity;
+	const float* m_pressure;
+	DirectX::XMUINT3 m_resolution;
+	DirectX::XMFLOAT4 m_max; // Largest coordinate of a cell center, relative to the first one
+};
+
+#endif
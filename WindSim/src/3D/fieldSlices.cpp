@@ -0,0 +1,411 @@
+#include "fieldSlices.h"
+#include "pngFile.h"
+#include "parallel.h"
+
+#include <emmintrin.h>
+
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <iomanip>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const int COPY_GRAIN = 16; // Rows of a plane per chunk of work of the copies
+
+	int normalAxis(FieldSlices::Orientation orientation)
+	{
+		return orientation == FieldSlices::Orientation::XY ? 2 : orientation == FieldSlices::Orientation::XZ ? 1 : 0;
+	}
+
+	int dimension(const XMUINT3& resolution, int axis)
+	{
+		return static_cast<int>(axis == 0 ? resolution.x : axis == 1 ? resolution.y : resolution.z);
+	}
+
+	const char* extension(FieldSlices::Format format)
+	{
+		return format == FieldSlices::Format::Png ? ".png" : format == FieldSlices::Format::Raw ? ".raw" : ".csv";
+	}
+}
+
+FieldSlices::Slice::Slice()
+	: id(-1),
+	name(),
+	orientation(Orientation::XY),
+	position(0.5f),
+	field(Field::Velocity),
+	metric(FlowMetrics::MAGNITUDE),
+	format(Format::Png),
+	interval(1),
+	range(0.0f, 0.0f)
+{
+}
+
+FieldSlices::FieldSlices(int queueSteps, int threads)
+	: m_queueSteps(std::max(queueSteps, 1)),
+	m_threads(threads),
+	m_mutex(),
+	m_slices(),
+	m_nextId(0),
+	m_directory(),
+	m_writer(),
+	m_queueMutex(),
+	m_queueCond(),
+	m_queue(),
+	m_freeBuffers(),
+	m_indexFiles(),
+	m_stopping(false),
+	m_writing(false),
+	m_numSteps(0),
+	m_numDropped(0),
+	m_numFailed(0),
+	m_copyTime(0.0),
+	m_writeTime(0.0)
+{
+}
+
+FieldSlices::~FieldSlices()
+{
+	close();
+}
+
+int FieldSlices::add(const Slice& slice)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_slices.push_back(slice);
+	m_slices.back().id = m_nextId++;
+	m_slices.back().position = std::max(0.0f, std::min(slice.position, 1.0f));
+	m_slices.back().interval = std::max(slice.interval, 1);
+	return m_slices.back().id;
+}
+
+bool FieldSlices::remove(int id)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = std::find_if(m_slices.begin(), m_slices.end(), [id](const Slice& slice) { return slice.id == id; });
+	if (it == m_slices.end())
+		return false;
+
+	m_slices.erase(it);
+	return true;
+}
+
+void FieldSlices::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_slices.clear();
+}
+
+std::vector<FieldSlices::Slice> FieldSlices::getSlices() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_slices;
+}
+
+void FieldSlices::open(const std::string& directory)
+{
+	close();
+	m_directory = directory;
+	m_stopping = false;
+	m_numFailed = 0;
+	m_writer = std::thread(&FieldSlices::write, this);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_writing = true;
+}
+
+void FieldSlices::close()
+{
+	if (!m_writer.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_writing = false;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_stopping = true;
+	}
+	m_queueCond.notify_all();
+	m_writer.join();
+	m_indexFiles.clear();
+	m_freeBuffers.clear();
+}
+
+void FieldSlices::stepPublished(const FieldFrame& frame)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_writing)
+		return;
+
+	std::vector<const Slice*> due;
+	for (const Slice& slice : m_slices)
+	{
+		if (frame.step % slice.interval == 0 && (slice.field != Field::Density || frame.density))
+			due.push_back(&slice);
+	}
+	if (due.empty())
+		return;
+
+	m_numSteps++;
+	Pending pending;
+	pending.step = frame.step;
+	pending.time = frame.time;
+	pending.resolution = frame.resolution;
+	{
+		// Steps, which would be dropped, are not copied; the buffers are reused once the queue is warmed up
+		std::lock_guard<std::mutex> queueLock(m_queueMutex);
+		if (m_queue.size() >= static_cast<size_t>(m_queueSteps))
+		{
+			m_numDropped++;
+			return;
+		}
+
+		pending.planes.resize(due.size());
+		for (Planes& planes : pending.planes)
+		{
+			if (m_freeBuffers.empty())
+				continue;
+			std::swap(planes.data, m_freeBuffers.back());
+			m_freeBuffers.pop_back();
+		}
+	}
+
+	for (size_t i = 0; i < due.size(); ++i)
+	{
+		Planes& planes = pending.planes[i];
+		const Slice& slice = *due[i];
+		planes.slice = slice;
+		planes.axis = normalAxis(slice.orientation);
+		const int depth = dimension(frame.resolution, planes.axis);
+		planes.index = std::min(static_cast<int>(slice.position * depth), depth - 1);
+		planes.width = dimension(frame.resolution, planes.axis == 0 ? 1 : 0);
+		planes.height = dimension(frame.resolution, planes.axis == 2 ? 1 : 2);
+
+		// Metrics with derivatives need the neighbouring planes
+		int count = 1;
+		planes.first = planes.index;
+		if (slice.field == Field::Metric && slice.metric != FlowMetrics::MAGNITUDE)
+			FlowMetrics::planeRange(frame.resolution, planes.axis, planes.index, planes.first, count);
+
+		const bool scalar = slice.field == Field::Pressure || slice.field == Field::Density;
+		const int components = scalar ? 1 : 4;
+		const size_t planeSize = static_cast<size_t>(planes.width) * planes.height * components;
+		planes.data.resize(count * planeSize);
+		const float* field = slice.field == Field::Pressure ? frame.pressure : slice.field == Field::Density ? frame.density : frame.velocity;
+		for (int p = 0; p < count; ++p)
+			copyPlane(field, components, frame.resolution, planes.axis, planes.first + p, planes.data.data() + p * planeSize, m_threads);
+	}
+
+	{
+		std::lock_guard<std::mutex> queueLock(m_queueMutex);
+		m_queue.push_back(std::move(pending));
+	}
+	m_queueCond.notify_one();
+
+	m_copyTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FieldSlices::copyPlane(const float* field, int components, const XMUINT3& resolution, int axis, int index, float* plane, int threads)
+{
+	const size_t resX = resolution.x;
+	const size_t resY = resolution.y;
+	const size_t n = components;
+
+	if (axis == 2)
+	{
+		std::memcpy(plane, field + n * resX * resY * index, n * resX * resY * sizeof(float));
+		return;
+	}
+
+	// The rows along z are independent; each one is a cache line per cell for YZ planes, so they are spread over the threads
+	Parallel::forRange(0, static_cast<int>(resolution.z), [&](int first, int last)
+	{
+		for (int z = first; z < last; ++z)
+		{
+			if (axis == 1)
+			{
+				std::memcpy(plane + n * resX * z, field + n * resX * (index + resY * z), n * resX * sizeof(float));
+			}
+			else if (components == 4)
+			{
+				// One cell per vector
+				const float* in = field + 4 * (index + resX * resY * z);
+				float* out = plane + 4 * resY * z;
+				for (size_t y = 0; y < resY; ++y)
+					_mm_storeu_ps(out + 4 * y, _mm_loadu_ps(in + 4 * resX * y));
+			}
+			else
+			{
+				// 4 cells along y per vector
+				const float* in = field + index + resX * resY * z;
+				float* out = plane + resY * z;
+				size_t y = 0;
+				for (; y + 4 <= resY; y += 4)
+				{
+					const float* p = in + resX * y;
+					_mm_storeu_ps(out + y, _mm_setr_ps(p[0], p[resX], p[2 * resX], p[3 * resX]));
+				}
+				for (; y < resY; ++y)
+					out[y] = in[resX * y];
+			}
+		}
+	}, threads, COPY_GRAIN);
+}
+
+void FieldSlices::write()
+{
+	for (;;)
+	{
+		Pending pending;
+		{
+			std::unique_lock<std::mutex> lock(m_queueMutex);
+			m_queueCond.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+			if (m_queue.empty())
+				return;
+			pending = std::move(m_queue.front());
+			m_queue.pop_front();
+		}
+		auto start = std::chrono::steady_clock::now();
+
+		// The slices of a step are encoded in parallel, the index files are written in order
+		const int numSlices = static_cast<int>(pending.planes.size());
+		std::vector<std::string> files(numSlices);
+		std::vector<XMFLOAT2> ranges(numSlices);
+		std::vector<char> written(numSlices, 0);
+		Parallel::forRange(0, numSlices, [&](int first, int last)
+		{
+			std::vector<float> values;
+			for (int i = first; i < last; ++i)
+				written[i] = writeSlice(pending, pending.planes[i], values, files[i], ranges[i]);
+		}, m_threads);
+
+		for (int i = 0; i < numSlices; ++i)
+		{
+			if (!written[i])
+			{
+				m_numFailed++;
+				continue;
+			}
+
+			const Planes& planes = pending.planes[i];
+			std::unique_ptr<std::ofstream>& index = m_indexFiles[planes.slice.name];
+			if (!index)
+			{
+				index.reset(new std::ofstream(m_directory + "/" + planes.slice.name + ".csv", std::ios::out | std::ios::trunc));
+				*index << std::setprecision(8) << "step,time,file,width,height,min,max\n";
+			}
+			*index << pending.step << ',' << pending.time << ',' << files[i] << ',' << planes.width << ',' << planes.height << ','
+				<< ranges[i].x << ',' << ranges[i].y << '\n';
+		}
+		for (auto& index : m_indexFiles)
+			index.second->flush();
+
+		m_writeTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		for (Planes& planes : pending.planes)
+			m_freeBuffers.push_back(std::move(planes.data));
+	}
+}
+
+bool FieldSlices::writeSlice(const Pending& pending, const Planes& planes, std::vector<float>& values, std::string& file, XMFLOAT2& range) const
+{
+	const Slice& slice = planes.slice;
+	const size_t numCells = static_cast<size_t>(planes.width) * planes.height;
+	const int channels = slice.field == Field::Velocity ? 3 : 1;
+
+	const float* data = planes.data.data();
+	if (slice.field == Field::Velocity)
+	{
+		values.resize(3 * numCells);
+		for (size_t i = 0; i < numCells; ++i)
+		{
+			values[3 * i] = data[4 * i];
+			values[3 * i + 1] = data[4 * i + 1];
+			values[3 * i + 2] = data[4 * i + 2];
+		}
+		data = values.data();
+	}
+	else if (slice.field == Field::Metric)
+	{
+		values.resize(numCells);
+		if (slice.metric == FlowMetrics::MAGNITUDE)
+		{
+			for (size_t i = 0; i < numCells; ++i)
+				values[i] = std::sqrt(data[4 * i] * data[4 * i] + data[4 * i + 1] * data[4 * i + 1] + data[4 * i + 2] * data[4 * i + 2]);
+		}
+		else
+			FlowMetrics::computePlane(data, planes.first, pending.resolution, planes.axis, planes.index, slice.metric, values.data());
+		data = values.data();
+	}
+
+	const size_t numValues = numCells * channels;
+	range = XMFLOAT2(std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity());
+	for (size_t i = 0; i < numValues; ++i)
+	{
+		// NaN fails both comparisons
+		if (data[i] < range.x)
+			range.x = data[i];
+		if (data[i] > range.y)
+			range.y = data[i];
+	}
+
+	file = slice.name + "_" + std::to_string(pending.step) + extension(slice.format);
+	const std::string path = m_directory + "/" + file;
+
+	if (slice.format == Format::Png)
+	{
+		// Rows from the top of the plane, values scaled to the full 16 bits
+		const XMFLOAT2 scaled = slice.range.x < slice.range.y ? slice.range : range;
+		const float scale = scaled.x < scaled.y ? 65535.0f / (scaled.y - scaled.x) : 0.0f;
+		std::vector<uint16_t> pixels(numValues);
+		const size_t rowValues = static_cast<size_t>(planes.width) * channels;
+		for (int row = 0; row < planes.height; ++row)
+		{
+			const float* in = data + (planes.height - 1 - row) * rowValues;
+			uint16_t* out = pixels.data() + row * rowValues;
+			for (size_t i = 0; i < rowValues; ++i)
+			{
+				const float value = (in[i] - scaled.x) * scale;
+				out[i] = value > 0.0f ? static_cast<uint16_t>(std::min(value, 65535.0f) + 0.5f) : 0;
+			}
+		}
+		return PngFile::write(path, planes.width, planes.height, channels, 16, pixels.data());
+	}
+
+	std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (slice.format == Format::Raw)
+	{
+		out.write(reinterpret_cast<const char*>(data), numValues * sizeof(float));
+	}
+	else
+	{
+		// Cell coordinates of the grid and the values
+		out << std::setprecision(8) << (channels == 3 ? "x,y,z,u,v,w\n" : "x,y,z,value\n");
+		const int u = planes.axis == 0 ? 1 : 0;
+		const int v = planes.axis == 2 ? 1 : 2;
+		int cell[3];
+		cell[planes.axis] = planes.index;
+		for (cell[v] = 0; cell[v] < planes.height; ++cell[v])
+		{
+			for (cell[u] = 0; cell[u] < planes.width; ++cell[u])
+			{
+				const float* value = data + channels * (cell[u] + static_cast<size_t>(planes.width) * cell[v]);
+				out << cell[0] << ',' << cell[1] << ',' << cell[2] << ',' << value[0];
+				if (channels == 3)
+					out << ',' << value[1] << ',' << value[2];
+				out << '\n';
+			}
+		}
+	}
+	return static_cast<bool>(out);
+}
@@ -0,0 +1,123 @@
+#ifndef FIELD_SLICES_H
+#define FIELD_SLICES_H
+
+#include "stepListener.h"
+#include "flowMetrics.h"
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+// Axis-aligned planes of the simulation fields after every step, on the CPU like the glyph plane on the GPU: velocity, pressure,
+// density or a metric of FlowMetrics, written as image sequences (16 bit PNG), raw floats or CSV
+//
+// The simulation thread only copies the planes of each slice (with its neighbours for metrics): XY planes are contiguous, XZ planes
+// contiguous rows; YZ planes are gathered 4 cells at a time (one SSE load per velocity, 4 strided loads per vector of scalars). A background
+// thread computes the values and encodes the slices of a step in parallel. Steps are queued up to a limit; when the writer falls behind,
+// further steps are not written and counted as dropped
+class FieldSlices : public StepListener
+{
+public:
+	enum class Orientation { XY, XZ, YZ }; // As VoxelGrid::Orientation: normal along z, y, x
+	enum class Field { Velocity, Pressure, Density, Metric };
+	enum class Format { Png, Raw, Csv };
+
+	struct Slice
+	{
+		Slice();
+		int id;
+		std::string name; // Prefix of the files
+		Orientation orientation;
+		float position; // Along the normal relative to the grid, [0, 1] as the glyph position
+		Field field;
+		FlowMetrics::Type metric; // Of Field::Metric
+		Format format;
+		int interval; // Write every n-th step
+		DirectX::XMFLOAT2 range; // Values mapped to 0 and 65535 in PNGs; each image is scaled to its own range if empty (x >= y)
+	};
+
+	FieldSlices(int queueSteps = 16, int threads = 1);
+	~FieldSlices();
+
+	// Thread safe; the changes apply from the next step
+	int add(const Slice& slice);
+	bool remove(int id);
+	void clear();
+	std::vector<Slice> getSlices() const;
+
+	// Writes <name>_<step>.png/.raw/.csv per slice and step into <directory>, plus <name>.csv with the step, time, file, size and range of the
+	// values of each image. Raw files are float32 little endian, first axis of the plane fastest (x before y before z), the 3 velocity
+	// components interleaved; PNGs have the second axis upwards. close waits for the queued steps
+	void open(const std::string& directory);
+	void close();
+	bool isOpen() const { return m_writer.joinable(); };
+
+	void stepPublished(const FieldFrame& frame) override;
+
+	// Copies plane <index> of a field with 1 or 4 floats per cell (normal <axis>: 0 for x, 1 for y, 2 for z) in the layout of the raw files
+	static void copyPlane(const float* field, int components, const DirectX::XMUINT3& resolution, int axis, int index, float* plane, int threads = 1);
+
+	uint64_t getNumSteps() const { return m_numSteps; }; // Steps with a slice due
+	uint64_t getNumDropped() const { return m_numDropped; }; // Steps, which the writer could not keep up with
+	uint64_t getNumFailed() const { return m_numFailed; }; // Files, which could not be written
+	double getCopyTime() const { return m_copyTime; }; // msec in the simulation thread, summed over all steps
+	double getWriteTime() const { return m_writeTime; }; // msec of the writer, summed over all steps
+
+private:
+	// Planes of one slice in one step
+	struct Planes
+	{
+		Slice slice;
+		int axis;
+		int index; // Of the slice along the normal
+		int first; // Of the copied planes
+		int width, height;
+		std::vector<float> data;
+	};
+
+	struct Pending
+	{
+		int step;
+		double time;
+		DirectX::XMUINT3 resolution;
+		std::vector<Planes> planes;
+	};
+
+	void write();
+	bool writeSlice(const Pending& pending, const Planes& planes, std::vector<float>& values, std::string& file, DirectX::XMFLOAT2& range) const;
+
+	int m_queueSteps;
+	int m_threads;
+
+	mutable std::mutex m_mutex; // Guards the slices
+	std::vector<Slice> m_slices;
+	int m_nextId;
+
+	std::string m_directory;
+	std::thread m_writer;
+	std::mutex m_queueMutex; // Guards the queue and the free buffers
+	std::condition_variable m_queueCond;
+	std::deque<Pending> m_queue;
+	std::vector<std::vector<float>> m_freeBuffers;
+	std::map<std::string, std::unique_ptr<std::ofstream>> m_indexFiles; // Of the writer thread, by slice name
+	bool m_stopping;
+	bool m_writing; // Steps are queued for the writer
+
+	std::atomic<uint64_t> m_numSteps;
+	std::atomic<uint64_t> m_numDropped;
+	std::atomic<uint64_t> m_numFailed;
+	double m_copyTime;
+	double m_writeTime;
+};
+
+#endif
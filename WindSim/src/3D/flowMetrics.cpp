@@ -0,0 +1,585 @@
+#include "flowMetrics.h"
+#include "parallel.h"
+
+#include <xmmintrin.h>
+
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const int SLAB = 8; // z-slices per block of work
+	const int BAND = 16; // Rows per block of work; 3 slices of a band stay in the L2 cache up to a few hundred cells along x
+	const int EDGE = 3; // Distance of the edge cells to the cell they take the values of (clampEdges of volume.fx)
+
+	// Velocity of the 4 cells starting at <cell>, transposed into one vector per component
+	inline void loadCells(const float* velocity, size_t cell, __m128* v)
+	{
+		const float* p = velocity + 4 * cell;
+		__m128 c0 = _mm_loadu_ps(p);
+		__m128 c1 = _mm_loadu_ps(p + 4);
+		__m128 c2 = _mm_loadu_ps(p + 8);
+		__m128 c3 = _mm_loadu_ps(p + 12);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		v[0] = c0;
+		v[1] = c1;
+		v[2] = c2;
+	}
+
+	// Column <axis> of the Jacobians of 4 cells
+	inline void difference(const float* velocity, size_t cell, size_t plus, size_t minus, __m128 scale, int axis, __m128 J[3][3])
+	{
+		__m128 p[3];
+		__m128 m[3];
+		loadCells(velocity, cell + plus, p);
+		loadCells(velocity, cell - minus, m);
+		for (int r = 0; r < 3; ++r)
+			J[r][axis] = _mm_mul_ps(_mm_sub_ps(p[r], m[r]), scale);
+	}
+
+	// Jacobian J[r][c] = d v_r / d x_c of one cell in cell units, central differences inside the grid and one-sided on its faces
+	void jacobian(const float* velocity, const XMUINT3& resolution, int x, int y, int z, float J[3][3])
+	{
+		const int id[3] = { x, y, z };
+		const int dim[3] = { static_cast<int>(resolution.x), static_cast<int>(resolution.y), static_cast<int>(resolution.z) };
+		const size_t stride[3] = { 1, static_cast<size_t>(dim[0]), static_cast<size_t>(dim[0]) * dim[1] };
+		const size_t cell = x + stride[1] * y + stride[2] * z;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			size_t minus = id[i] > 0 ? stride[i] : 0;
+			size_t plus = id[i] < dim[i] - 1 ? stride[i] : 0;
+			int d = (minus ? 1 : 0) + (plus ? 1 : 0);
+
+			const float* p = velocity + 4 * (cell + plus);
+			const float* m = velocity + 4 * (cell - minus);
+			for (int r = 0; r < 3; ++r)
+				J[r][i] = d > 0 ? (p[r] - m[r]) / d : 0.0f;
+		}
+	}
+
+	// Middle eigenvalue of a symmetric 3x3 matrix, trigonometric solution of the characteristic polynomial (Smith 1961)
+	float middleEigenvalue(double m00, double m11, double m22, double m01, double m02, double m12)
+	{
+		const double pi = 3.14159265358979323846;
+
+		double q = (m00 + m11 + m22) / 3.0;
+		double a = m00 - q;
+		double b = m11 - q;
+		double c = m22 - q;
+		double p2 = a * a + b * b + c * c + 2.0 * (m01 * m01 + m02 * m02 + m12 * m12);
+		if (p2 < 1.0e-36)
+			return static_cast<float>(q); // Three equal eigenvalues
+
+		// det(B) / 2 with B = (M - q * I) / p
+		double p = std::sqrt(p2 / 6.0);
+		double det = a * (b * c - m12 * m12) - m01 * (m01 * c - m12 * m02) + m02 * (m01 * m12 - b * m02);
+		double r = std::max(-1.0, std::min(1.0, det / (2.0 * p * p * p)));
+
+		double phi = std::acos(r) / 3.0;
+		double largest = q + 2.0 * p * std::cos(phi);
+		double smallest = q + 2.0 * p * std::cos(phi + 2.0 * pi / 3.0);
+		return static_cast<float>(3.0 * q - largest - smallest);
+	}
+
+	inline __m128 select(__m128 mask, __m128 a, __m128 b) // mask ? a : b
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	// Middle eigenvalues of 4 symmetric 3x3 matrices with the solution above: the middle root is q + 2 p sin(acos(r) / 3 - pi / 6),
+	// acos is approximated as in Abramowitz and Stegun 4.4.46 (error 2e-8) and sin on [-pi / 6, pi / 6] by its Taylor series up to x^7
+	__m128 middleEigenvalue(__m128 m00, __m128 m11, __m128 m22, __m128 m01, __m128 m02, __m128 m12)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+
+		__m128 q = _mm_mul_ps(_mm_add_ps(m00, _mm_add_ps(m11, m22)), _mm_set1_ps(1.0f / 3.0f));
+		__m128 a = _mm_sub_ps(m00, q);
+		__m128 b = _mm_sub_ps(m11, q);
+		__m128 c = _mm_sub_ps(m22, q);
+		__m128 off = _mm_add_ps(_mm_mul_ps(m01, m01), _mm_add_ps(_mm_mul_ps(m02, m02), _mm_mul_ps(m12, m12)));
+		__m128 p2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, a), _mm_add_ps(_mm_mul_ps(b, b), _mm_mul_ps(c, c))), _mm_add_ps(off, off));
+		__m128 distinct = _mm_cmpge_ps(p2, _mm_set1_ps(1.0e-30f));
+
+		__m128 p = _mm_sqrt_ps(_mm_mul_ps(p2, _mm_set1_ps(1.0f / 6.0f)));
+		__m128 det = _mm_sub_ps(_mm_mul_ps(a, _mm_sub_ps(_mm_mul_ps(b, c), _mm_mul_ps(m12, m12))), _mm_mul_ps(m01, _mm_sub_ps(_mm_mul_ps(m01, c), _mm_mul_ps(m12, m02))));
+		det = _mm_add_ps(det, _mm_mul_ps(m02, _mm_sub_ps(_mm_mul_ps(m01, m12), _mm_mul_ps(b, m02))));
+		__m128 r = _mm_div_ps(_mm_mul_ps(det, _mm_set1_ps(0.5f)), _mm_mul_ps(p, _mm_mul_ps(p, p)));
+		r = select(distinct, _mm_max_ps(_mm_set1_ps(-1.0f), _mm_min_ps(one, r)), zero);
+
+		// acos(|r|), mirrored for negative r
+		__m128 x = _mm_andnot_ps(signMask, r);
+		__m128 poly = _mm_set1_ps(-0.0012624911f);
+		poly = _mm_add_ps(_mm_mul_ps(poly, x), _mm_set1_ps(0.0066700901f));
+		poly = _mm_add_ps(_mm_mul_ps(poly, x), _mm_set1_ps(-0.0170881256f));
+		poly = _mm_add_ps(_mm_mul_ps(poly, x), _mm_set1_ps(0.0308918810f));
+		poly = _mm_add_ps(_mm_mul_ps(poly, x), _mm_set1_ps(-0.0501743046f));
+		poly = _mm_add_ps(_mm_mul_ps(poly, x), _mm_set1_ps(0.0889789874f));
+		poly = _mm_add_ps(_mm_mul_ps(poly, x), _mm_set1_ps(-0.2145988016f));
+		poly = _mm_add_ps(_mm_mul_ps(poly, x), _mm_set1_ps(1.5707963050f));
+		__m128 angle = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(one, x)), poly);
+		angle = select(_mm_cmplt_ps(r, zero), _mm_sub_ps(_mm_set1_ps(3.14159265f), angle), angle);
+
+		__m128 t = _mm_sub_ps(_mm_mul_ps(angle, _mm_set1_ps(1.0f / 3.0f)), _mm_set1_ps(3.14159265f / 6.0f));
+		__m128 t2 = _mm_mul_ps(t, t);
+		__m128 sine = _mm_add_ps(_mm_mul_ps(t2, _mm_set1_ps(-1.0f / 5040.0f)), _mm_set1_ps(1.0f / 120.0f));
+		sine = _mm_add_ps(_mm_mul_ps(sine, t2), _mm_set1_ps(-1.0f / 6.0f));
+		sine = _mm_mul_ps(t, _mm_add_ps(_mm_mul_ps(sine, t2), one));
+
+		__m128 middle = _mm_add_ps(q, _mm_mul_ps(_mm_add_ps(p, p), sine));
+		return select(distinct, middle, q);
+	}
+
+	// Second largest eigenvalue with the Jacobi sweeps of computeSecondLargestEigenvalue in volume.fx
+	float jacobiEigenvalue(const float m[3][3])
+	{
+		float m11 = m[0][0];
+		float m12 = m[0][1];
+		float m13 = m[0][2];
+		float m22 = m[1][1];
+		float m23 = m[1][2];
+		float m33 = m[2][2];
+
+		const int maxSweeps = 32;
+		const float epsilon = 1.0e-10f;
+
+		for (int a = 0; a < maxSweeps; ++a)
+		{
+			if ((std::abs(m12) < epsilon) && (std::abs(m13) < epsilon) && (std::abs(m23) < epsilon))
+				break;
+
+			if (m12 != 0.0f)
+			{
+				float u = (m22 - m11) * 0.5f / m12;
+				float u2 = u * u;
+				float u2p1 = u2 + 1.0f;
+				float t = (u2p1 != u2) ? ((u < 0.0f) ? -1.0f : 1.0f) * (std::sqrt(u2p1) - std::abs(u)) : 0.5f / u;
+				float c = 1.0f / std::sqrt(t * t + 1.0f);
+				float s = c * t;
+
+				m11 -= t * m12;
+				m22 += t * m12;
+				m12 = 0.0f;
+
+				float temp = c * m13 - s * m23;
+				m23 = s * m13 + c * m23;
+				m13 = temp;
+			}
+
+			if (m13 != 0.0f)
+			{
+				float u = (m33 - m11) * 0.5f / m13;
+				float u2 = u * u;
+				float u2p1 = u2 + 1.0f;
+				float t = (u2p1 != u2) ? ((u < 0.0f) ? -1.0f : 1.0f) * (std::sqrt(u2p1) - std::abs(u)) : 0.5f / u;
+				float c = 1.0f / std::sqrt(t * t + 1.0f);
+				float s = c * t;
+
+				m11 -= t * m13;
+				m33 += t * m13;
+				m13 = 0.0f;
+
+				float temp = c * m12 - s * m23;
+				m23 = s * m12 + c * m23;
+				m12 = temp;
+			}
+
+			if (m23 != 0.0f)
+			{
+				float u = (m33 - m22) * 0.5f / m23;
+				float u2 = u * u;
+				float u2p1 = u2 + 1.0f;
+				float t = (u2p1 != u2) ? ((u < 0.0f) ? -1.0f : 1.0f) * (std::sqrt(u2p1) - std::abs(u)) : 0.5f / u;
+				float c = 1.0f / std::sqrt(t * t + 1.0f);
+				float s = c * t;
+
+				m22 -= t * m23;
+				m33 += t * m23;
+				m23 = 0.0f;
+
+				float temp = c * m12 - s * m13;
+				m13 = s * m12 + c * m13;
+				m12 = temp;
+			}
+		}
+
+		float lambda[3] = { m11, m22, m33 };
+		std::sort(lambda, lambda + 3);
+		return lambda[1];
+	}
+
+	// Metric of one cell from its velocity and Jacobian; <jacobi> selects the eigenvalue solver of the shader for lambda2
+	float metric(FlowMetrics::Type type, const float* v, const float J[3][3], bool jacobi)
+	{
+		float trace = J[0][0] + J[1][1] + J[2][2];
+		float traceJJ = 0.0f;
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int k = 0; k < 3; ++k)
+				traceJJ += J[i][k] * J[k][i];
+		}
+		float Q = 0.5f * (trace * trace - traceJJ);
+
+		switch (type)
+		{
+		case FlowMetrics::MAGNITUDE:
+			return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		case FlowMetrics::VORTICITY:
+		{
+			float cx = J[2][1] - J[1][2];
+			float cy = J[0][2] - J[2][0];
+			float cz = J[1][0] - J[0][1];
+			return std::sqrt(cx * cx + cy * cy + cz * cz);
+		}
+		case FlowMetrics::DIVERGENCE:
+			return trace;
+		case FlowMetrics::Q_CRITERION:
+			return Q;
+		case FlowMetrics::DELTA_CRITERION:
+		{
+			float det = J[0][0] * (J[1][1] * J[2][2] - J[1][2] * J[2][1]) - J[0][1] * (J[1][0] * J[2][2] - J[1][2] * J[2][0]) + J[0][2] * (J[1][0] * J[2][1] - J[1][1] * J[2][0]);
+			float R = -det;
+			float q3 = Q / 3.0f;
+			return q3 * q3 * q3 + R * R * 0.25f;
+		}
+		case FlowMetrics::LAMBDA2_CRITERION:
+		{
+			// S^2 + Omega^2 = (J^2 + (J^2)^T) / 2
+			float A[3][3];
+			for (int i = 0; i < 3; ++i)
+			{
+				for (int j = 0; j < 3; ++j)
+					A[i][j] = J[i][0] * J[0][j] + J[i][1] * J[1][j] + J[i][2] * J[2][j];
+			}
+			float M[3][3];
+			for (int i = 0; i < 3; ++i)
+			{
+				for (int j = 0; j < 3; ++j)
+					M[i][j] = 0.5f * (A[i][j] + A[j][i]);
+			}
+			return jacobi ? jacobiEigenvalue(M) : middleEigenvalue(M[0][0], M[1][1], M[2][2], M[0][1], M[0][2], M[1][2]);
+		}
+		default:
+			return 0.0f;
+		}
+	}
+
+	// Coordinates of the cell, whose values an edge or corner cell takes (clampEdges of volume.fx); the cell itself, if it is not near two faces
+	void edgeSource(const int dim[3], const int id[3], int src[3])
+	{
+		int near = 0;
+		for (int i = 0; i < 3; ++i)
+			near += (id[i] < EDGE || id[i] > dim[i] - EDGE) ? 1 : 0;
+
+		for (int i = 0; i < 3; ++i)
+			src[i] = near >= 2 ? std::max(EDGE, std::min(id[i], dim[i] - EDGE)) : id[i];
+	}
+
+	size_t edgeSource(const XMUINT3& resolution, int x, int y, int z)
+	{
+		const int id[3] = { x, y, z };
+		const int dim[3] = { static_cast<int>(resolution.x), static_cast<int>(resolution.y), static_cast<int>(resolution.z) };
+		int src[3];
+		edgeSource(dim, id, src);
+		return src[0] + static_cast<size_t>(dim[0]) * (src[1] + static_cast<size_t>(dim[1]) * src[2]);
+	}
+
+	// The edges are only clamped on grids, where the clamped cells are inside of all faces
+	bool hasEdges(const XMUINT3& resolution)
+	{
+		return std::min(resolution.x, std::min(resolution.y, resolution.z)) > 2 * EDGE;
+	}
+}
+
+std::string FlowMetrics::name(Type type)
+{
+	static const char* names[NUM_TYPES] = { "magnitude", "vorticity", "divergence", "qCriterion", "deltaCriterion", "lambda2Criterion" };
+	return names[type];
+}
+
+FlowMetrics::FlowMetrics(int threads)
+	: m_threads(threads),
+	m_resolution(0, 0, 0),
+	m_values(),
+	m_computeTime(0.0)
+{
+}
+
+void FlowMetrics::compute(const float* velocity, const XMUINT3& resolution, unsigned int types)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	m_resolution = resolution;
+	size_t numCells = static_cast<size_t>(resolution.x) * resolution.y * resolution.z;
+	for (int t = 0; t < NUM_TYPES; ++t)
+	{
+		if (types & mask(Type(t)))
+			m_values[t].resize(numCells);
+	}
+	if (numCells == 0)
+		return;
+
+	const int resY = resolution.y;
+	const int resZ = resolution.z;
+	const int bands = (resY + BAND - 1) / BAND;
+	const int slabs = (resZ + SLAB - 1) / SLAB;
+
+	Parallel::forRange(0, slabs * bands, [&](int begin, int end)
+	{
+		for (int block = begin; block < end; ++block)
+		{
+			int zBegin = (block / bands) * SLAB;
+			int yBegin = (block % bands) * BAND;
+			for (int z = zBegin; z < std::min(zBegin + SLAB, resZ); ++z)
+			{
+				for (int y = yBegin; y < std::min(yBegin + BAND, resY); ++y)
+					computeRow(velocity, y, z, types);
+			}
+		}
+	}, m_threads);
+
+	// The edge cells read values of cells inside, so they follow once all rows are done
+	if (hasEdges(resolution))
+	{
+		Parallel::forRange(0, resZ, [&](int begin, int end)
+		{
+			for (int z = begin; z < end; ++z)
+				clampEdges(z, types);
+		}, m_threads);
+	}
+
+	m_computeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FlowMetrics::computeRow(const float* velocity, int y, int z, unsigned int types)
+{
+	const int resX = m_resolution.x;
+	const int resY = m_resolution.y;
+	const int resZ = m_resolution.z;
+	const size_t sx = resX;
+	const size_t sxy = sx * resY;
+	const size_t row = sx * y + sxy * z;
+
+	float* out[NUM_TYPES];
+	for (int t = 0; t < NUM_TYPES; ++t)
+		out[t] = (types & mask(Type(t))) ? m_values[t].data() : nullptr;
+	const bool gradient = (types & ~mask(MAGNITUDE)) != 0;
+
+	// One-sided differences on the faces of y and z apply to the whole row
+	size_t yPlus = y < resY - 1 ? sx : 0;
+	size_t yMinus = y > 0 ? sx : 0;
+	size_t zPlus = z < resZ - 1 ? sxy : 0;
+	size_t zMinus = z > 0 ? sxy : 0;
+	int yCount = (yPlus ? 1 : 0) + (yMinus ? 1 : 0);
+	int zCount = (zPlus ? 1 : 0) + (zMinus ? 1 : 0);
+	const __m128 xScale = _mm_set1_ps(0.5f);
+	const __m128 yScale = _mm_set1_ps(yCount > 0 ? 1.0f / yCount : 0.0f);
+	const __m128 zScale = _mm_set1_ps(zCount > 0 ? 1.0f / zCount : 0.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 third = _mm_set1_ps(1.0f / 3.0f);
+	const __m128 quarter = _mm_set1_ps(0.25f);
+
+	// 4 cells per vector, as long as all of them have both x-neighbours
+	int x = 1;
+	for (; x + 4 <= resX - 1; x += 4)
+	{
+		const size_t cell = row + x;
+
+		if (out[MAGNITUDE])
+		{
+			__m128 v[3];
+			loadCells(velocity, cell, v);
+			__m128 sq = _mm_add_ps(_mm_mul_ps(v[0], v[0]), _mm_add_ps(_mm_mul_ps(v[1], v[1]), _mm_mul_ps(v[2], v[2])));
+			_mm_storeu_ps(out[MAGNITUDE] + cell, _mm_sqrt_ps(sq));
+		}
+		if (!gradient)
+			continue;
+
+		__m128 J[3][3];
+		difference(velocity, cell, 1, 1, xScale, 0, J);
+		difference(velocity, cell, yPlus, yMinus, yScale, 1, J);
+		difference(velocity, cell, zPlus, zMinus, zScale, 2, J);
+
+		if (out[VORTICITY])
+		{
+			__m128 cx = _mm_sub_ps(J[2][1], J[1][2]);
+			__m128 cy = _mm_sub_ps(J[0][2], J[2][0]);
+			__m128 cz = _mm_sub_ps(J[1][0], J[0][1]);
+			__m128 sq = _mm_add_ps(_mm_mul_ps(cx, cx), _mm_add_ps(_mm_mul_ps(cy, cy), _mm_mul_ps(cz, cz)));
+			_mm_storeu_ps(out[VORTICITY] + cell, _mm_sqrt_ps(sq));
+		}
+
+		__m128 trace = _mm_add_ps(J[0][0], _mm_add_ps(J[1][1], J[2][2]));
+		if (out[DIVERGENCE])
+			_mm_storeu_ps(out[DIVERGENCE] + cell, trace);
+
+		if (out[Q_CRITERION] || out[DELTA_CRITERION])
+		{
+			// trace(J * J) = sum of J_ii^2 + 2 * sum of J_ij * J_ji over i < j
+			__m128 diag = _mm_add_ps(_mm_mul_ps(J[0][0], J[0][0]), _mm_add_ps(_mm_mul_ps(J[1][1], J[1][1]), _mm_mul_ps(J[2][2], J[2][2])));
+			__m128 off = _mm_add_ps(_mm_mul_ps(J[0][1], J[1][0]), _mm_add_ps(_mm_mul_ps(J[0][2], J[2][0]), _mm_mul_ps(J[1][2], J[2][1])));
+			__m128 traceJJ = _mm_add_ps(diag, _mm_add_ps(off, off));
+			__m128 Q = _mm_mul_ps(half, _mm_sub_ps(_mm_mul_ps(trace, trace), traceJJ));
+			if (out[Q_CRITERION])
+				_mm_storeu_ps(out[Q_CRITERION] + cell, Q);
+
+			if (out[DELTA_CRITERION])
+			{
+				__m128 c0 = _mm_sub_ps(_mm_mul_ps(J[1][1], J[2][2]), _mm_mul_ps(J[1][2], J[2][1]));
+				__m128 c1 = _mm_sub_ps(_mm_mul_ps(J[1][0], J[2][2]), _mm_mul_ps(J[1][2], J[2][0]));
+				__m128 c2 = _mm_sub_ps(_mm_mul_ps(J[1][0], J[2][1]), _mm_mul_ps(J[1][1], J[2][0]));
+				__m128 det = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(J[0][0], c0), _mm_mul_ps(J[0][1], c1)), _mm_mul_ps(J[0][2], c2));
+				__m128 q3 = _mm_mul_ps(Q, third);
+				__m128 delta = _mm_add_ps(_mm_mul_ps(q3, _mm_mul_ps(q3, q3)), _mm_mul_ps(quarter, _mm_mul_ps(det, det)));
+				_mm_storeu_ps(out[DELTA_CRITERION] + cell, delta);
+			}
+		}
+
+		if (out[LAMBDA2_CRITERION])
+		{
+			// S^2 + Omega^2 = (A + A^T) / 2 with A = J * J
+			__m128 A[3][3];
+			for (int i = 0; i < 3; ++i)
+			{
+				for (int j = 0; j < 3; ++j)
+					A[i][j] = _mm_add_ps(_mm_mul_ps(J[i][0], J[0][j]), _mm_add_ps(_mm_mul_ps(J[i][1], J[1][j]), _mm_mul_ps(J[i][2], J[2][j])));
+			}
+			__m128 m01 = _mm_mul_ps(half, _mm_add_ps(A[0][1], A[1][0]));
+			__m128 m02 = _mm_mul_ps(half, _mm_add_ps(A[0][2], A[2][0]));
+			__m128 m12 = _mm_mul_ps(half, _mm_add_ps(A[1][2], A[2][1]));
+			_mm_storeu_ps(out[LAMBDA2_CRITERION] + cell, middleEigenvalue(A[0][0], A[1][1], A[2][2], m01, m02, m12));
+		}
+	}
+
+	// The first and the remaining cells of the row
+	auto scalarCell = [&](int cx)
+	{
+		const size_t cell = row + cx;
+		const float* v = velocity + 4 * cell;
+		float J[3][3] = {};
+		if (gradient)
+			jacobian(velocity, m_resolution, cx, y, z, J);
+		for (int t = 0; t < NUM_TYPES; ++t)
+		{
+			if (out[t])
+				out[t][cell] = metric(Type(t), v, J, false);
+		}
+	};
+	if (resX > 0)
+		scalarCell(0);
+	for (x = std::max(x, 1); x < resX; ++x)
+		scalarCell(x);
+}
+
+void FlowMetrics::clampEdges(int z, unsigned int types)
+{
+	const int resX = m_resolution.x;
+	const int resY = m_resolution.y;
+	const int resZ = m_resolution.z;
+	const bool nearZ = z < EDGE || z > resZ - EDGE;
+
+	for (int y = 0; y < resY; ++y)
+	{
+		const bool nearY = y < EDGE || y > resY - EDGE;
+		if (!nearY && !nearZ)
+			continue;
+
+		// Near one face of y and z, only the ends of the row are near a second face
+		const size_t row = static_cast<size_t>(resX) * (y + static_cast<size_t>(resY) * z);
+		for (int x = 0; x < resX; ++x)
+		{
+			if (!(nearY && nearZ) && x == EDGE)
+				x = resX - EDGE + 1;
+			if (x >= resX)
+				break;
+
+			size_t src = edgeSource(m_resolution, x, y, z);
+			for (int t = 0; t < NUM_TYPES; ++t)
+			{
+				if (types & mask(Type(t)))
+					m_values[t][row + x] = m_values[t][src];
+			}
+		}
+	}
+}
+
+void FlowMetrics::planeRange(const XMUINT3& resolution, int axis, int index, int& first, int& count)
+{
+	// The neighbours of the plane and of the plane, whose values its edge cells take
+	const int dim = static_cast<int>(axis == 0 ? resolution.x : axis == 1 ? resolution.y : resolution.z);
+	const int source = hasEdges(resolution) ? std::max(EDGE, std::min(index, dim - EDGE)) : index;
+	first = std::max(std::min(index, source) - 1, 0);
+	count = std::min(std::max(index, source) + 1, dim - 1) - first + 1;
+}
+
+void FlowMetrics::computePlane(const float* planes, int first, const XMUINT3& resolution, int axis, int index, Type type, float* values)
+{
+	const int dim[3] = { static_cast<int>(resolution.x), static_cast<int>(resolution.y), static_cast<int>(resolution.z) };
+	const int u = axis == 0 ? 1 : 0;
+	const int v = axis == 2 ? 1 : 2;
+	const bool edges = hasEdges(resolution);
+
+	// Offset of a cell within <planes>
+	const size_t planeSize = static_cast<size_t>(dim[u]) * dim[v];
+	auto offset = [&](const int c[3]) { return 4 * ((c[axis] - first) * planeSize + c[u] + static_cast<size_t>(dim[u]) * c[v]); };
+
+	int id[3];
+	id[axis] = index;
+	for (id[v] = 0; id[v] < dim[v]; ++id[v])
+	{
+		for (id[u] = 0; id[u] < dim[u]; ++id[u])
+		{
+			int src[3] = { id[0], id[1], id[2] };
+			if (edges)
+				edgeSource(dim, id, src);
+
+			// As jacobian(), central differences inside the grid and one-sided on its faces
+			float J[3][3];
+			for (int i = 0; i < 3; ++i)
+			{
+				int plus[3] = { src[0], src[1], src[2] };
+				int minus[3] = { src[0], src[1], src[2] };
+				plus[i] = std::min(src[i] + 1, dim[i] - 1);
+				minus[i] = std::max(src[i] - 1, 0);
+				const int d = plus[i] - minus[i];
+				const float* p = planes + offset(plus);
+				const float* m = planes + offset(minus);
+				for (int r = 0; r < 3; ++r)
+					J[r][i] = d > 0 ? (p[r] - m[r]) / d : 0.0f;
+			}
+			values[id[u] + static_cast<size_t>(dim[u]) * id[v]] = metric(type, planes + offset(src), J, false);
+		}
+	}
+}
+
+void FlowMetrics::computeReference(const float* velocity, const XMUINT3& resolution, Type type, float* values)
+{
+	const int resX = resolution.x;
+	const int resY = resolution.y;
+	const int resZ = resolution.z;
+	const bool edges = hasEdges(resolution);
+
+	for (int z = 0; z < resZ; ++z)
+	{
+		for (int y = 0; y < resY; ++y)
+		{
+			for (int x = 0; x < resX; ++x)
+			{
+				// Coordinates of the cell, whose values are shown
+				size_t src = edges ? edgeSource(resolution, x, y, z) : x + static_cast<size_t>(resX) * (y + static_cast<size_t>(resY) * z);
+				int sx = static_cast<int>(src % resX);
+				int sy = static_cast<int>((src / resX) % resY);
+				int sz = static_cast<int>(src / (static_cast<size_t>(resX) * resY));
+
+				float J[3][3];
+				jacobian(velocity, resolution, sx, sy, sz, J);
+				values[x + static_cast<size_t>(resX) * (y + static_cast<size_t>(resY) * z)] = metric(type, velocity + 4 * src, J, true);
+			}
+		}
+	}
+}
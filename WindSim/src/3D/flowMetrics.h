@@ -0,0 +1,54 @@
+#ifndef FLOW_METRICS_H
+#define FLOW_METRICS_H
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <string>
+
+// CPU implementation of the derived flow metrics of the volume renderer (Metric::Volume, compute shaders of volume.fx), e.g. for the
+// headless runner and exports. The velocity has 4 floats per cell (x fastest) as returned by Simulator::getVelocity; the metrics are
+// computed in cell units from the central-difference Jacobian (one-sided on the faces of the grid), cells on the edges and corners of the
+// grid take the values of the nearest cell, which is 3 cells inside (clampEdges of volume.fx)
+//
+// All requested metrics are computed in one pass: blocks of rows are handed out to the threads (z-slabs by y-bands, so the neighbouring
+// slices stay in the cache), the Jacobians of 4 cells along x are computed per SSE vector and lambda2 is the middle eigenvalue of
+// S^2 + Omega^2 in closed form (instead of the Jacobi sweeps of the shader)
+class FlowMetrics
+{
+public:
+	enum Type { MAGNITUDE = 0, VORTICITY, DIVERGENCE, Q_CRITERION, DELTA_CRITERION, LAMBDA2_CRITERION, NUM_TYPES }; // Order of Metric::Volume
+	static const unsigned int ALL_TYPES = (1u << NUM_TYPES) - 1;
+
+	static unsigned int mask(Type type) { return 1u << type; };
+	static std::string name(Type type); // Channel name for exports, e.g. "qCriterion"
+
+	FlowMetrics(int threads = 0);
+
+	// Computes the metrics of <types> (mask of Type bits); the buffers are reused as long as the resolution stays the same
+	void compute(const float* velocity, const DirectX::XMUINT3& resolution, unsigned int types = ALL_TYPES);
+
+	// Values of the last compute (x fastest), empty if the type was never requested
+	const std::vector<float>& get(Type type) const { return m_values[type]; };
+	double getComputeTime() const { return m_computeTime; }; // msec of the last compute
+
+	// Metric of the cells of one plane (normal <axis>: 0 for x, 1 for y, 2 for z) as compute() gives them, for slices (see FieldSlices)
+	// <planes> holds the velocity of the planes [first, first + count) along the normal, which planeRange returns, each one with the lower
+	// remaining axis fastest (x before y before z); <values> of plane <index> are in the same layout
+	static void planeRange(const DirectX::XMUINT3& resolution, int axis, int index, int& first, int& count);
+	static void computePlane(const float* planes, int first, const DirectX::XMUINT3& resolution, int axis, int index, Type type, float* values);
+
+	// Straightforward per cell port of volume.fx, compute() is verified against it by WindSimHeadless --benchmark-metrics
+	static void computeReference(const float* velocity, const DirectX::XMUINT3& resolution, Type type, float* values);
+
+private:
+	void computeRow(const float* velocity, int y, int z, unsigned int types);
+	void clampEdges(int z, unsigned int types);
+
+	int m_threads;
+	DirectX::XMUINT3 m_resolution;
+	std::vector<float> m_values[NUM_TYPES];
+	double m_computeTime;
+};
+
+#endif
@@ -0,0 +1,498 @@
+#include "isosurface.h"
+#include "parallel.h"
+
+#include <emmintrin.h>
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+
+using namespace DirectX;
+
+namespace
+{
+	const int BRICK = 8; // Cubes per edge of the bricks, which are skipped as a whole
+	const int SLAB = 8; // Cube layers per slab of parallel work
+
+	// Corner i of a cube is at (i & 1, (i >> 1) & 1, (i >> 2) & 1); edge e runs from corner EDGE_CORNER[e] along axis e / 4
+	const int EDGE_CORNER[12] = { 0, 2, 4, 6, 0, 1, 4, 5, 0, 1, 2, 3 };
+
+	// Corners of the faces, counterclockwise seen from outside of the cube
+	const int FACE_CORNERS[6][4] = { { 0, 4, 6, 2 }, { 1, 3, 7, 5 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 2, 3, 1 }, { 4, 5, 7, 6 } };
+
+	int edgeOf(int a, int b)
+	{
+		const int lower = std::min(a, b);
+		switch (a ^ b)
+		{
+		case 1: return lower >> 1;
+		case 2: return 4 + ((lower & 1) | (lower >> 2 << 1));
+		default: return 8 + lower;
+		}
+	}
+
+	// Triangles of the 256 cases (bit i: corner i above the iso value) as edges, built from the faces instead of a typed table:
+	// on each face the isolines run from an edge, where the boundary enters the region above, to the next edge, where it leaves it again,
+	// which cuts off the corners above separately on ambiguous faces. Each cut edge starts one isoline and ends another, so they chain into
+	// closed polygons, which are triangulated as fans
+	struct CaseTable
+	{
+		CaseTable()
+		{
+			for (int c = 0; c < 256; ++c)
+			{
+				int next[12];
+				std::fill(next, next + 12, -1);
+				for (int f = 0; f < 6; ++f)
+				{
+					int cuts[4], numCuts = 0;
+					bool entering[4];
+					for (int k = 0; k < 4; ++k)
+					{
+						const int a = FACE_CORNERS[f][k], b = FACE_CORNERS[f][(k + 1) % 4];
+						const bool inA = (c >> a & 1) != 0, inB = (c >> b & 1) != 0;
+						if (inA != inB)
+						{
+							cuts[numCuts] = edgeOf(a, b);
+							entering[numCuts++] = inB;
+						}
+					}
+
+					// Cuts alternate between entering and leaving, so the next one after an entering cut leaves
+					for (int i = 0; i < numCuts; ++i)
+						if (entering[i])
+							next[cuts[i]] = cuts[(i + 1) % numCuts];
+				}
+
+				int count = 0;
+				bool visited[12] = {};
+				for (int start = 0; start < 12; ++start)
+				{
+					if (next[start] < 0 || visited[start])
+						continue;
+
+					int polygon[12], size = 0;
+					for (int e = start; !visited[e]; e = next[e])
+					{
+						visited[e] = true;
+						polygon[size++] = e;
+					}
+					for (int i = 1; i + 1 < size; ++i)
+					{
+						edges[c][count++] = static_cast<uint8_t>(polygon[0]);
+						edges[c][count++] = static_cast<uint8_t>(polygon[i]);
+						edges[c][count++] = static_cast<uint8_t>(polygon[i + 1]);
+					}
+				}
+				numIndices[c] = static_cast<uint8_t>(count);
+			}
+		}
+
+		uint8_t edges[256][30];
+		uint8_t numIndices[256];
+	};
+
+	const CaseTable CASES;
+
+	// Extraction state of one slab; its vertices on the top plane are the first ones of the next slab, so its indices of them are moved there
+	struct Slab
+	{
+		std::vector<float> vertices;
+		std::vector<uint32_t> indices;
+		uint32_t owned; // Vertices below the top plane
+		uint32_t offset; // Of the owned vertices in the output
+	};
+
+	class Extractor
+	{
+	public:
+		Extractor(const float* values, const XMUINT3& resolution, const XMFLOAT3& voxelSize, float isoValue)
+			: m_values(values),
+			m_nx(resolution.x),
+			m_ny(resolution.y),
+			m_nz(resolution.z),
+			m_slice(static_cast<size_t>(resolution.x) * resolution.y),
+			m_voxelSize(voxelSize),
+			m_iso(isoValue),
+			m_bricksX((m_nx + BRICK - 2) / BRICK),
+			m_bricksY((m_ny + BRICK - 2) / BRICK),
+			m_bricksZ((m_nz + BRICK - 2) / BRICK)
+		{
+		}
+
+		// Marks the bricks, whose values (including the shared faces to the next bricks) contain the iso value; NaN counts as below it
+		int markBricks(int threads)
+		{
+			m_active.assign(static_cast<size_t>(m_bricksX) * m_bricksY * m_bricksZ, 0);
+			std::vector<int> count(m_bricksZ, 0);
+
+			Parallel::forRange(0, m_bricksZ, [&](int first, int last)
+			{
+				const __m128 iso = _mm_set1_ps(m_iso);
+				std::vector<uint8_t> sides(static_cast<size_t>(m_bricksX) * m_bricksY); // Bit 0: a value above the iso value, bit 1: one below
+				for (int bz = first; bz < last; ++bz)
+				{
+					std::fill(sides.begin(), sides.end(), static_cast<uint8_t>(0));
+					const int zEnd = std::min((bz + 1) * BRICK, m_nz - 1);
+					for (int z = bz * BRICK; z <= zEnd; ++z)
+					{
+						for (int y = 0; y < m_ny; ++y)
+						{
+							const float* row = m_values + z * m_slice + static_cast<size_t>(y) * m_nx;
+							for (int bx = 0; bx < m_bricksX; ++bx)
+							{
+								// Points [x0, x0 + 8] in three overlapping vectors
+								const int x0 = bx * BRICK;
+								const int n = std::min(BRICK, m_nx - 1 - x0) + 1;
+								int side = 0;
+								if (n == BRICK + 1)
+								{
+									__m128 a = _mm_cmpgt_ps(_mm_loadu_ps(row + x0), iso);
+									__m128 b = _mm_cmpgt_ps(_mm_loadu_ps(row + x0 + 4), iso);
+									__m128 c = _mm_cmpgt_ps(_mm_loadu_ps(row + x0 + 5), iso);
+									side = (_mm_movemask_ps(_mm_or_ps(a, _mm_or_ps(b, c))) ? 1 : 0) | (_mm_movemask_ps(_mm_and_ps(a, _mm_and_ps(b, c))) != 0xf ? 2 : 0);
+								}
+								else
+								{
+									for (int i = 0; i < n; ++i)
+										side |= row[x0 + i] > m_iso ? 1 : 2;
+								}
+
+								// Rows on the face between two bricks belong to both
+								sides[static_cast<size_t>(std::min(y / BRICK, m_bricksY - 1)) * m_bricksX + bx] |= side;
+								if (y % BRICK == 0 && y > 0 && y / BRICK < m_bricksY)
+									sides[static_cast<size_t>(y / BRICK - 1) * m_bricksX + bx] |= side;
+							}
+						}
+					}
+
+					for (size_t i = 0; i < sides.size(); ++i)
+					{
+						if (sides[i] == 3)
+						{
+							m_active[bz * sides.size() + i] = 1;
+							++count[bz];
+						}
+					}
+				}
+			}, threads);
+
+			int total = 0;
+			for (int c : count)
+				total += c;
+			return total;
+		}
+
+		void extractSlab(int index, Slab& slab)
+		{
+			const int z0 = index * SLAB;
+			const int z1 = std::min(z0 + SLAB, m_nz - 1);
+			// Vertex ids of the edges of two planes; only the entries of cut edges are written and read, so they are not initialized
+			std::unique_ptr<uint32_t[]> lower(new uint32_t[3 * m_slice]), upper(new uint32_t[3 * m_slice]);
+
+			slab.vertices.clear();
+			slab.indices.clear();
+			planeEdges(z0, lower.get(), slab);
+			for (int z = z0; z < z1; ++z)
+			{
+				verticalEdges(z, lower.get(), slab);
+				slab.owned = static_cast<uint32_t>(slab.vertices.size() / 6);
+				planeEdges(z + 1, upper.get(), slab);
+				triangulate(z, lower.get(), upper.get(), slab);
+				lower.swap(upper);
+			}
+			if (z1 == m_nz - 1)
+				slab.owned = static_cast<uint32_t>(slab.vertices.size() / 6);
+		}
+
+		int bricksX() const { return m_bricksX; };
+		int bricksY() const { return m_bricksY; };
+		int bricksZ() const { return m_bricksZ; };
+
+	private:
+		bool isActive(int bx, int by, int bz) const
+		{
+			return m_active[(static_cast<size_t>(bz) * m_bricksY + by) * m_bricksX + bx] != 0;
+		}
+
+		// Points of a brick along one axis: its first cube up to the first one of the next brick, or the last point
+		void points(int brick, int bricks, int n, int& first, int& last) const
+		{
+			first = brick * BRICK;
+			last = brick == bricks - 1 ? n : first + BRICK;
+		}
+
+		float value(int x, int y, int z) const
+		{
+			return m_values[z * m_slice + static_cast<size_t>(y) * m_nx + x];
+		}
+
+		// Central differences, one-sided at the faces of the grid
+		XMVECTOR gradient(int x, int y, int z) const
+		{
+			const int x0 = std::max(x - 1, 0), x1 = std::min(x + 1, m_nx - 1);
+			const int y0 = std::max(y - 1, 0), y1 = std::min(y + 1, m_ny - 1);
+			const int z0 = std::max(z - 1, 0), z1 = std::min(z + 1, m_nz - 1);
+			return XMVectorSet((value(x1, y, z) - value(x0, y, z)) / (std::max(x1 - x0, 1) * m_voxelSize.x),
+				(value(x, y1, z) - value(x, y0, z)) / (std::max(y1 - y0, 1) * m_voxelSize.y),
+				(value(x, y, z1) - value(x, y, z0)) / (std::max(z1 - z0, 1) * m_voxelSize.z), 0.0f);
+		}
+
+		// Adds the vertex on the edge from point (x, y, z) along <axis>, if the edge is cut
+		void edge(int x, int y, int z, int axis, float a, float b, uint32_t& id, Slab& slab)
+		{
+			if ((a > m_iso) == (b > m_iso))
+				return;
+
+			float t = (m_iso - a) / (b - a);
+			if (!(t >= 0.0f))
+				t = 0.0f;
+			t = std::min(t, 1.0f);
+
+			const int dx = axis == 0, dy = axis == 1, dz = axis == 2;
+			XMVECTOR normal = XMVector3Normalize(XMVectorNegate(XMVectorLerp(gradient(x, y, z), gradient(x + dx, y + dy, z + dz), t)));
+			id = static_cast<uint32_t>(slab.vertices.size() / 6);
+			slab.vertices.push_back((x + 0.5f + t * dx) * m_voxelSize.x);
+			slab.vertices.push_back((y + 0.5f + t * dy) * m_voxelSize.y);
+			slab.vertices.push_back((z + 0.5f + t * dz) * m_voxelSize.z);
+			slab.vertices.push_back(XMVectorGetX(normal));
+			slab.vertices.push_back(XMVectorGetY(normal));
+			slab.vertices.push_back(XMVectorGetZ(normal));
+		}
+
+		// Vertices on the x and y edges of plane z
+		// The order only depends on the plane, so the slabs below and above it create the same vertices in the same order
+		void planeEdges(int z, uint32_t* ids, Slab& slab)
+		{
+			const int bz = std::min(z / BRICK, m_bricksZ - 1);
+			for (int by = 0; by < m_bricksY; ++by)
+			{
+				for (int bx = 0; bx < m_bricksX; ++bx)
+				{
+					if (!isActive(bx, by, bz))
+						continue;
+
+					int x0, x1, y0, y1;
+					points(bx, m_bricksX, m_nx, x0, x1);
+					points(by, m_bricksY, m_ny, y0, y1);
+					for (int y = y0; y < y1; ++y)
+					{
+						const float* row = m_values + z * m_slice + static_cast<size_t>(y) * m_nx;
+						uint32_t* id = ids + 3 * static_cast<size_t>(y) * m_nx;
+						for (int x = x0; x < x1; ++x)
+						{
+							if (x + 1 < m_nx)
+								edge(x, y, z, 0, row[x], row[x + 1], id[3 * x], slab);
+							if (y + 1 < m_ny)
+								edge(x, y, z, 1, row[x], row[x + m_nx], id[3 * x + 1], slab);
+						}
+					}
+				}
+			}
+		}
+
+		// Vertices on the z edges from plane z to the next one
+		void verticalEdges(int z, uint32_t* ids, Slab& slab)
+		{
+			const int bz = z / BRICK;
+			for (int by = 0; by < m_bricksY; ++by)
+			{
+				for (int bx = 0; bx < m_bricksX; ++bx)
+				{
+					if (!isActive(bx, by, bz))
+						continue;
+
+					int x0, x1, y0, y1;
+					points(bx, m_bricksX, m_nx, x0, x1);
+					points(by, m_bricksY, m_ny, y0, y1);
+					for (int y = y0; y < y1; ++y)
+					{
+						const float* row = m_values + z * m_slice + static_cast<size_t>(y) * m_nx;
+						uint32_t* id = ids + 3 * static_cast<size_t>(y) * m_nx;
+						for (int x = x0; x < x1; ++x)
+							edge(x, y, z, 2, row[x], row[x + m_slice], id[3 * x + 2], slab);
+					}
+				}
+			}
+		}
+
+		// Triangles of the cubes from plane z to the next one; <lower> and <upper> hold the vertices of the edges of both planes
+		void triangulate(int z, const uint32_t* lower, const uint32_t* upper, Slab& slab)
+		{
+			const int bz = z / BRICK;
+			const size_t dy = m_nx;
+			for (int by = 0; by < m_bricksY; ++by)
+			{
+				const int y0 = by * BRICK, y1 = std::min(y0 + BRICK, m_ny - 1);
+				for (int bx = 0; bx < m_bricksX; ++bx)
+				{
+					if (!isActive(bx, by, bz))
+						continue;
+
+					const int x0 = bx * BRICK, x1 = std::min(x0 + BRICK, m_nx - 1);
+					for (int y = y0; y < y1; ++y)
+					{
+						const float* v0 = m_values + z * m_slice + y * dy;
+						const float* v1 = v0 + m_slice;
+						for (int x = x0; x < x1; ++x)
+						{
+							const int c = (v0[x] > m_iso) | (v0[x + 1] > m_iso) << 1 | (v0[x + dy] > m_iso) << 2 | (v0[x + dy + 1] > m_iso) << 3
+								| (v1[x] > m_iso) << 4 | (v1[x + 1] > m_iso) << 5 | (v1[x + dy] > m_iso) << 6 | (v1[x + dy + 1] > m_iso) << 7;
+							const uint8_t* edges = CASES.edges[c];
+							for (int i = 0; i < CASES.numIndices[c]; ++i)
+							{
+								const int corner = EDGE_CORNER[edges[i]];
+								const size_t point = 3 * ((y + (corner >> 1 & 1)) * dy + x + (corner & 1)) + edges[i] / 4;
+								slab.indices.push_back(corner & 4 ? upper[point] : lower[point]);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		const float* m_values;
+		int m_nx, m_ny, m_nz;
+		size_t m_slice;
+		XMFLOAT3 m_voxelSize;
+		float m_iso;
+		int m_bricksX, m_bricksY, m_bricksZ;
+		std::vector<uint8_t> m_active;
+	};
+}
+
+Isosurface::Isosurface(int threads)
+	: m_threads(threads),
+	m_extractTime(0.0),
+	m_activeBricks(0.0f)
+{
+}
+
+void Isosurface::extract(const float* values, const XMUINT3& resolution, const XMFLOAT3& voxelSize, float isoValue)
+{
+	auto start = std::chrono::steady_clock::now();
+	m_vertexData.clear();
+	m_indexData.clear();
+	m_activeBricks = 0.0f;
+	if (!values || resolution.x < 2 || resolution.y < 2 || resolution.z < 2)
+		return;
+
+	Extractor extractor(values, resolution, voxelSize, isoValue);
+	const int numSlabs = (static_cast<int>(resolution.z) - 1 + SLAB - 1) / SLAB;
+	const int numBricks = extractor.markBricks(m_threads);
+	m_activeBricks = static_cast<float>(numBricks) / (extractor.bricksX() * extractor.bricksY() * extractor.bricksZ());
+
+	std::vector<Slab> slabs(numSlabs);
+	if (numBricks > 0)
+		Parallel::forRange(0, numSlabs, [&](int first, int last)
+		{
+			for (int s = first; s < last; ++s)
+				extractor.extractSlab(s, slabs[s]);
+		}, m_threads);
+	else
+		for (Slab& slab : slabs)
+			slab.owned = 0;
+
+	// Place the slabs in the output and copy them in parallel; indices of top plane vertices continue in the next slab
+	size_t numVertices = 0, numIndices = 0;
+	std::vector<size_t> indexOffset(numSlabs);
+	for (int s = 0; s < numSlabs; ++s)
+	{
+		slabs[s].offset = static_cast<uint32_t>(numVertices);
+		indexOffset[s] = numIndices;
+		numVertices += slabs[s].owned;
+		numIndices += slabs[s].indices.size();
+	}
+	m_vertexData.resize(6 * numVertices);
+	m_indexData.resize(numIndices);
+
+	Parallel::forRange(0, numSlabs, [&](int first, int last)
+	{
+		for (int s = first; s < last; ++s)
+		{
+			const Slab& slab = slabs[s];
+			std::copy(slab.vertices.begin(), slab.vertices.begin() + 6 * static_cast<size_t>(slab.owned), m_vertexData.begin() + 6 * static_cast<size_t>(slab.offset));
+
+			const uint32_t nextOffset = s + 1 < numSlabs ? slabs[s + 1].offset : 0;
+			uint32_t* out = &m_indexData[0] + indexOffset[s];
+			for (uint32_t id : slab.indices)
+				*out++ = id < slab.owned ? slab.offset + id : nextOffset + (id - slab.owned);
+		}
+	}, m_threads);
+
+	m_extractTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Isosurface::writeObj(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		m_error = "Could not open " + path;
+		return false;
+	}
+
+	file << "# Isosurface: " << getNumVertices() << " vertices, " << getNumTriangles() << " triangles\n";
+	for (size_t i = 0; i < m_vertexData.size(); i += 6)
+		file << "v " << m_vertexData[i] << " " << m_vertexData[i + 1] << " " << m_vertexData[i + 2] << "\n";
+	for (size_t i = 0; i < m_vertexData.size(); i += 6)
+		file << "vn " << m_vertexData[i + 3] << " " << m_vertexData[i + 4] << " " << m_vertexData[i + 5] << "\n";
+	for (size_t i = 0; i < m_indexData.size(); i += 3)
+	{
+		// OBJ indices start at 1
+		const uint32_t a = m_indexData[i] + 1, b = m_indexData[i + 1] + 1, c = m_indexData[i + 2] + 1;
+		file << "f " << a << "//" << a << " " << b << "//" << b << " " << c << "//" << c << "\n";
+	}
+
+	if (!file)
+	{
+		m_error = "Could not write " + path;
+		return false;
+	}
+	return true;
+}
+
+bool Isosurface::writePly(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		m_error = "Could not open " + path;
+		return false;
+	}
+
+	file << "ply\nformat binary_little_endian 1.0\n"
+		<< "element vertex " << getNumVertices() << "\n"
+		<< "property float x\nproperty float y\nproperty float z\nproperty float nx\nproperty float ny\nproperty float nz\n"
+		<< "element face " << getNumTriangles() << "\n"
+		<< "property list uchar uint vertex_indices\nend_header\n";
+
+	if (!m_vertexData.empty())
+		file.write(reinterpret_cast<const char*>(&m_vertexData[0]), m_vertexData.size() * sizeof(float));
+
+	// Faces in blocks, each one prefixed with its vertex count
+	const size_t BLOCK = 4096;
+	std::vector<char> buffer(BLOCK * 13);
+	for (size_t first = 0; first < m_indexData.size(); first += 3 * BLOCK)
+	{
+		const size_t last = std::min(first + 3 * BLOCK, m_indexData.size());
+		char* out = &buffer[0];
+		for (size_t i = first; i < last; i += 3)
+		{
+			*out++ = 3;
+			std::memcpy(out, &m_indexData[i], 3 * sizeof(uint32_t));
+			out += 3 * sizeof(uint32_t);
+		}
+		file.write(&buffer[0], out - &buffer[0]);
+	}
+
+	if (!file)
+	{
+		m_error = "Could not write " + path;
+		return false;
+	}
+	return true;
+}
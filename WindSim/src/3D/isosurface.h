@@ -0,0 +1,50 @@
+#ifndef ISOSURFACE_H
+#define ISOSURFACE_H
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Marching cubes on the CPU for scalar fields on the lattice of the voxel grid (one value per cell, x fastest), e.g. the vortex criteria of
+// FlowMetrics. The cubes span the cell centers; the surface separates the values above the iso value from the others (NaN counts as below).
+// Vertices are shared by all triangles on the same cube edge, in grid object space (cell centers at (i + 0.5) * voxelSize) with normals
+// from the gradient of the field, pointing towards smaller values. Triangles are counterclockwise around their normals
+//
+// The cubes are processed in z-slabs in parallel: each slab creates the vertices of the cube edges below its top plane and keeps its own
+// buffers; a prefix sum over the slabs gives the place of every slab in the output, so the slabs are merged without locks. Bricks of 8^3 cubes,
+// whose range of values does not contain the iso value, are skipped. The ambiguous faces always separate the corners above the iso value,
+// decided from the face alone, so neighbouring cubes agree and closed surfaces have no cracks
+class Isosurface
+{
+public:
+	Isosurface(int threads = 0);
+
+	void extract(const float* values, const DirectX::XMUINT3& resolution, const DirectX::XMFLOAT3& voxelSize, float isoValue);
+
+	// Layout of Mesh3D: px, py, pz, nx, ny, nz per vertex and 3 indices per triangle
+	const std::vector<float>& getVertexData() const { return m_vertexData; };
+	const std::vector<uint32_t>& getIndexData() const { return m_indexData; };
+	size_t getNumVertices() const { return m_vertexData.size() / 6; };
+	size_t getNumTriangles() const { return m_indexData.size() / 3; };
+
+	double getExtractTime() const { return m_extractTime; }; // msec of the last extract
+	float getActiveBricks() const { return m_activeBricks; }; // Fraction of the bricks, which were not skipped
+
+	// Write the last surface; false on errors (see errorString)
+	bool writeObj(const std::string& path) const;
+	bool writePly(const std::string& path) const; // Binary little endian
+
+	const std::string& errorString() const { return m_error; };
+
+private:
+	int m_threads;
+	std::vector<float> m_vertexData;
+	std::vector<uint32_t> m_indexData;
+	double m_extractTime;
+	float m_activeBricks;
+	mutable std::string m_error;
+};
+
+#endif
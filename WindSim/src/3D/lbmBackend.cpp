@@ -0,0 +1,539 @@
+#include "lbmBackend.h"
+#include "cellClassifier.h"
+#include "parallel.h"
+
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QElapsedTimer>
+
+#include <sstream>
+#include <stdexcept>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// D3Q19 lattice: rest, 6 faces, 12 edges
+	const int g_c[19][3] =
+	{
+		{ 0, 0, 0 },
+		{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+		{ 1, 1, 0 }, { -1, -1, 0 }, { 1, -1, 0 }, { -1, 1, 0 },
+		{ 1, 0, 1 }, { -1, 0, -1 }, { 1, 0, -1 }, { -1, 0, 1 },
+		{ 0, 1, 1 }, { 0, -1, -1 }, { 0, 1, -1 }, { 0, -1, 1 }
+	};
+	const int g_opposite[19] = { 0, 2, 1, 4, 3, 6, 5, 8, 7, 10, 9, 12, 11, 14, 13, 16, 15, 18, 17 };
+	const float g_w[19] =
+	{
+		1.0f / 3.0f,
+		1.0f / 18.0f, 1.0f / 18.0f, 1.0f / 18.0f, 1.0f / 18.0f, 1.0f / 18.0f, 1.0f / 18.0f,
+		1.0f / 36.0f, 1.0f / 36.0f, 1.0f / 36.0f, 1.0f / 36.0f, 1.0f / 36.0f, 1.0f / 36.0f,
+		1.0f / 36.0f, 1.0f / 36.0f, 1.0f / 36.0f, 1.0f / 36.0f, 1.0f / 36.0f, 1.0f / 36.0f
+	};
+
+	inline __m128 select(__m128 mask, __m128 a, __m128 b) // mask ? a : b
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	inline bool isSolid(wtl::CellType type)
+	{
+		return type == wtl::CELL_TYPE_SOLID_SLIP || type == wtl::CELL_TYPE_SOLID_NO_SLIP || type == wtl::CELL_TYPE_SOLID_BOUNDARY;
+	}
+}
+
+LbmBackend::Parameters::Parameters()
+	: inflowVelocity(10.0f),
+	latticeVelocity(0.05f),
+	relaxationTime(0.6f),
+	airDensity(1.2f)
+{
+}
+
+LbmBackend::Parameters LbmBackend::readParameters(const std::string& settingsFile)
+{
+	Parameters parameters;
+
+	QFile f(QString::fromStdString(settingsFile));
+	if (!f.open(QIODevice::ReadOnly))
+		return parameters;
+
+	QJsonObject lbm = QJsonDocument::fromJson(f.readAll()).object()["lbm"].toObject();
+	parameters.inflowVelocity = static_cast<float>(lbm["inflowVelocity"].toDouble(parameters.inflowVelocity));
+	parameters.latticeVelocity = static_cast<float>(lbm["latticeVelocity"].toDouble(parameters.latticeVelocity));
+	parameters.relaxationTime = static_cast<float>(lbm["relaxationTime"].toDouble(parameters.relaxationTime));
+	parameters.airDensity = static_cast<float>(lbm["airDensity"].toDouble(parameters.airDensity));
+
+	if (parameters.relaxationTime <= 0.5f)
+		throw std::invalid_argument("The LBM relaxation time must be greater than 0.5!");
+	if (parameters.latticeVelocity <= 0.0f || parameters.inflowVelocity <= 0.0f)
+		throw std::invalid_argument("The LBM inflow velocities must be positive!");
+
+	return parameters;
+}
+
+LbmBackend::LbmBackend(const Parameters& parameters, int threads)
+	: m_parameters(parameters),
+	m_threads(threads),
+	m_resolution(0, 0, 0),
+	m_voxelSize(1.0f, 1.0f, 1.0f),
+	m_stride(0, 0, 0),
+	m_guard(4),
+	m_arraySize(0),
+	m_f(),
+	m_current(0),
+	m_solid(),
+	m_inflow(),
+	m_outflow(),
+	m_slipLinks(),
+	m_inflowNormal(1),
+	m_cellTypes(),
+	m_mlups(0.0)
+{
+}
+
+void LbmBackend::setGridDimension(const XMUINT3& resolution, const XMFLOAT3& voxelSize)
+{
+	// The lattice has the same spacing along all axes and one time step for all of them
+	const float tolerance = 1e-4f * voxelSize.x;
+	if (std::fabs(voxelSize.y - voxelSize.x) > tolerance || std::fabs(voxelSize.z - voxelSize.x) > tolerance)
+		throw std::invalid_argument("The LBM solver needs cubic cells, adjust the grid size or the resolution of the voxel grid!");
+
+	m_resolution = resolution;
+	m_voxelSize = voxelSize;
+	m_stride = XMUINT3((resolution.x + 2 + 3) & ~3u, resolution.y + 2, resolution.z + 2);
+	m_arraySize = static_cast<size_t>(m_stride.x) * m_stride.y * m_stride.z + 2 * m_guard;
+
+	for (int q = 0; q < Q; ++q)
+		m_offsets[q] = g_c[q][0] + static_cast<int>(m_stride.x) * (g_c[q][1] + static_cast<int>(m_stride.y) * g_c[q][2]);
+
+	// Without cell types everything is fluid
+	m_cellTypes.assign(static_cast<size_t>(resolution.x) * resolution.y * resolution.z, wtl::CELL_TYPE_FLUID);
+	updateGrid(m_cellTypes);
+	reset();
+}
+
+void LbmBackend::updateGrid(const std::vector<wtl::CellType>& cellTypes)
+{
+	if (cellTypes.size() != static_cast<size_t>(m_resolution.x) * m_resolution.y * m_resolution.z)
+		throw std::invalid_argument("The number of cell types does not match the grid resolution!");
+
+	const bool initialized = !m_f[0].empty();
+	if (!initialized)
+	{
+		m_f[0].assign(m_arraySize * Q, 0.0f);
+		m_f[1].assign(m_arraySize * Q, 0.0f);
+	}
+
+	std::vector<uint32_t> solid(m_arraySize, ~0u); // Ghost layer and padding are solid
+	std::vector<uint8_t> slip(m_arraySize, 0);
+	std::vector<InflowCell> inflow;
+	std::vector<OutflowCell> outflow;
+	std::vector<size_t> outflowDiagonals;
+	const uint32_t res[3] = { m_resolution.x, m_resolution.y, m_resolution.z };
+
+	for (uint32_t z = 0; z < m_resolution.z; ++z)
+	{
+		for (uint32_t y = 0; y < m_resolution.y; ++y)
+		{
+			for (uint32_t x = 0; x < m_resolution.x; ++x)
+			{
+				size_t cell = x + static_cast<size_t>(m_resolution.x) * (y + static_cast<size_t>(m_resolution.y) * z);
+				size_t index = paddedIndex(x, y, z);
+				wtl::CellType type = cellTypes[cell];
+				solid[index] = isSolid(type) ? ~0u : 0u;
+				slip[index] = type == wtl::CELL_TYPE_SOLID_SLIP;
+
+				if (type == wtl::CELL_TYPE_INFLOW || type == wtl::CELL_TYPE_OUTFLOW)
+				{
+					// Lattice directions 1 to 6 are the inward normals of the faces in the order of CellClassifier::Face
+					const CellClassifier::Face face = CellClassifier::faceOf(cellTypes.data(), m_resolution, x, y, z);
+					if (face == CellClassifier::NUM_FACES)
+						throw std::invalid_argument("The LBM solver supports inflow and outflow cells only on the faces of the grid!");
+
+					const int normal = face + 1;
+					if (type == wtl::CELL_TYPE_INFLOW)
+					{
+						InflowCell inflowCell = { index, normal };
+						inflow.push_back(inflowCell);
+					}
+					else
+					{
+						// The inner neighbour along the normal and one step inwards along every axis, on which the cell is at the border;
+						// a single layer has no inner cell
+						const uint32_t p[3] = { x, y, z };
+						int inner[3] = { 0, 0, 0 };
+						for (int a = 0; a < 3; ++a)
+						{
+							if (res[a] > 1)
+								inner[a] = p[a] == 0 ? 1 : p[a] + 1 == res[a] ? -1 : 0;
+						}
+						const int axis = (normal - 1) / 2;
+						if (inner[axis] != 0)
+						{
+							OutflowCell outflowCell = { index, index + m_offsets[normal] };
+							outflow.push_back(outflowCell);
+							outflowDiagonals.push_back(paddedIndex(x + inner[0], y + inner[1], z + inner[2]));
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Specular reflection at slip cells: a diagonal direction, which is blocked along one axis only, comes from the mirrored direction of
+	// the fluid neighbour along the other axis (for flat walls); corners and walls of no-slip cells keep the bounce-back
+	const int axisOffset[3] = { 1, static_cast<int>(m_stride.x), static_cast<int>(m_stride.x * m_stride.y) };
+	std::vector<SlipLink> slipLinks;
+	for (uint32_t z = 0; z < m_resolution.z; ++z)
+	{
+		for (uint32_t y = 0; y < m_resolution.y; ++y)
+		{
+			for (uint32_t x = 0; x < m_resolution.x; ++x)
+			{
+				size_t index = paddedIndex(x, y, z);
+				if (solid[index])
+					continue;
+
+				for (int q = 7; q < Q; ++q)
+				{
+					if (!slip[index - m_offsets[q]])
+						continue;
+
+					int axes[2];
+					int numAxes = 0;
+					for (int a = 0; a < 3; ++a)
+					{
+						if (g_c[q][a])
+							axes[numAxes++] = a;
+					}
+					size_t side[2];
+					for (int k = 0; k < 2; ++k)
+						side[k] = index - g_c[q][axes[k]] * axisOffset[axes[k]];
+					if ((solid[side[0]] != 0) == (solid[side[1]] != 0))
+						continue;
+
+					const int wall = solid[side[0]] ? 0 : 1;
+					if (!slip[side[wall]])
+						continue;
+
+					int mirrored[3] = { g_c[q][0], g_c[q][1], g_c[q][2] };
+					mirrored[axes[wall]] = -mirrored[axes[wall]];
+					int r = 7;
+					while (g_c[r][0] != mirrored[0] || g_c[r][1] != mirrored[1] || g_c[r][2] != mirrored[2])
+						++r;
+
+					SlipLink link = { index, q, r * m_arraySize + side[1 - wall] };
+					slipLinks.push_back(link);
+				}
+			}
+		}
+	}
+
+	// Along a slip wall, which covers the inner neighbour, the flow continues from the diagonal one; outflow cells next to other solids are
+	// streamed like fluid cells
+	for (size_t i = 0; i < outflow.size(); ++i)
+	{
+		if (slip[outflow[i].source])
+			outflow[i].source = outflowDiagonals[i];
+	}
+	outflow.erase(std::remove_if(outflow.begin(), outflow.end(), [&](const OutflowCell& cell) { return solid[cell.source] != 0; }), outflow.end());
+
+	// Cells, which become fluid, start at rest; solid cells hold the rest state, which is never streamed. Only now, as an invalid grid
+	// throws above and leaves the solver as it was
+	if (initialized)
+	{
+		for (uint32_t z = 0; z < m_resolution.z; ++z)
+		{
+			for (uint32_t y = 0; y < m_resolution.y; ++y)
+			{
+				for (uint32_t x = 0; x < m_resolution.x; ++x)
+				{
+					size_t cell = x + static_cast<size_t>(m_resolution.x) * (y + static_cast<size_t>(m_resolution.y) * z);
+					if (isSolid(cellTypes[cell]) == isSolid(m_cellTypes[cell]))
+						continue;
+					size_t index = paddedIndex(x, y, z);
+					setEquilibrium(m_f[0], index, 1.0f, 0.0f, 0.0f, 0.0f);
+					setEquilibrium(m_f[1], index, 1.0f, 0.0f, 0.0f, 0.0f);
+				}
+			}
+		}
+	}
+
+	m_solid.swap(solid);
+	m_inflow.swap(inflow);
+	m_outflow.swap(outflow);
+	m_slipLinks.swap(slipLinks);
+	m_inflowNormal = m_inflow.empty() ? 1 : m_inflow.front().normal;
+	m_cellTypes = cellTypes;
+}
+
+void LbmBackend::reset()
+{
+	// Fluid at the inflow velocity, solids at rest
+	const float u = m_parameters.latticeVelocity;
+	const int* n = g_c[m_inflowNormal];
+	Parallel::forRange(0, m_resolution.z, [&](int zBegin, int zEnd)
+	{
+		for (int z = zBegin; z < zEnd; ++z)
+		{
+			for (uint32_t y = 0; y < m_resolution.y; ++y)
+			{
+				for (uint32_t x = 0; x < m_resolution.x; ++x)
+				{
+					size_t index = paddedIndex(x, y, z);
+					float speed = m_solid[index] ? 0.0f : u;
+					setEquilibrium(m_f[0], index, 1.0f, speed * n[0], speed * n[1], speed * n[2]);
+					setEquilibrium(m_f[1], index, 1.0f, speed * n[0], speed * n[1], speed * n[2]);
+				}
+			}
+		}
+	}, m_threads);
+}
+
+void LbmBackend::setEquilibrium(std::vector<float>& f, size_t index, float rho, float ux, float uy, float uz)
+{
+	float usq = 1.5f * (ux * ux + uy * uy + uz * uz);
+	for (int q = 0; q < Q; ++q)
+	{
+		float cu = 3.0f * (g_c[q][0] * ux + g_c[q][1] * uy + g_c[q][2] * uz);
+		f[q * m_arraySize + index] = g_w[q] * rho * (1.0f + cu + 0.5f * cu * cu - usq);
+	}
+}
+
+float LbmBackend::step()
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	Parallel::forRange(0, m_resolution.z, [&](int zBegin, int zEnd) { collideSlab(zBegin, zEnd); }, m_threads);
+
+	std::vector<float>& f = m_f[1 - m_current];
+	const float u = m_parameters.latticeVelocity;
+	for (const InflowCell& cell : m_inflow)
+		setEquilibrium(f, cell.index, 1.0f, u * g_c[cell.normal][0], u * g_c[cell.normal][1], u * g_c[cell.normal][2]);
+	for (const OutflowCell& cell : m_outflow)
+	{
+		for (int q = 0; q < Q; ++q)
+			f[q * m_arraySize + cell.index] = f[q * m_arraySize + cell.source];
+	}
+
+	m_current = 1 - m_current;
+
+	double cells = static_cast<double>(m_resolution.x) * m_resolution.y * m_resolution.z;
+	m_mlups = cells / (std::max<qint64>(timer.nsecsElapsed(), 1) * 1e-3);
+
+	// The lattice velocity corresponds to the inflow velocity: dt = u_lattice * dx / u_inflow
+	return m_parameters.latticeVelocity * m_voxelSize.x / m_parameters.inflowVelocity;
+}
+
+void LbmBackend::collideSlab(int zBegin, int zEnd)
+{
+	const float* src = m_f[m_current].data();
+	float* dst = m_f[1 - m_current].data();
+	const float* solid = reinterpret_cast<const float*>(m_solid.data());
+
+	const __m128 omega = _mm_set1_ps(1.0f / m_parameters.relaxationTime);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 three = _mm_set1_ps(3.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 oneHalf = _mm_set1_ps(1.5f);
+
+	__m128 g[Q];
+	float lanes[Q][4];
+
+	// The slip links of the slab are visited in the order of the cells
+	const size_t slabStart = paddedIndex(-1, 0, zBegin);
+	auto link = std::lower_bound(m_slipLinks.begin(), m_slipLinks.end(), slabStart, [](const SlipLink& l, size_t index) { return l.index < index; });
+
+	for (int z = zBegin; z < zEnd; ++z)
+	{
+		for (uint32_t y = 0; y < m_resolution.y; ++y)
+		{
+			// Full vectors from the ghost cell at x = -1 on; padding cells are solid and keep their values
+			size_t rowStart = paddedIndex(-1, y, z);
+			for (uint32_t x = 0; x < m_stride.x; x += 4)
+			{
+				size_t i = rowStart + x;
+				__m128 selfSolid = _mm_loadu_ps(solid + i);
+				if (_mm_movemask_ps(selfSolid) == 0xF)
+					continue;
+
+				// Pull streaming, directions from solid neighbours are reflected (half-way bounce-back)
+				for (int q = 0; q < Q; ++q)
+				{
+					size_t n = i - m_offsets[q];
+					__m128 neighbourSolid = _mm_loadu_ps(solid + n);
+					g[q] = select(neighbourSolid, _mm_loadu_ps(src + g_opposite[q] * m_arraySize + i), _mm_loadu_ps(src + q * m_arraySize + n));
+				}
+
+				if (link != m_slipLinks.end() && link->index < i + 4)
+				{
+					for (int q = 0; q < Q; ++q)
+						_mm_storeu_ps(lanes[q], g[q]);
+					for (; link != m_slipLinks.end() && link->index < i + 4; ++link)
+						lanes[link->q][link->index - i] = src[link->source];
+					for (int q = 0; q < Q; ++q)
+						g[q] = _mm_loadu_ps(lanes[q]);
+				}
+
+				// Moments
+				__m128 rho = g[0];
+				__m128 jx = _mm_setzero_ps();
+				__m128 jy = _mm_setzero_ps();
+				__m128 jz = _mm_setzero_ps();
+				for (int q = 1; q < Q; ++q)
+				{
+					rho = _mm_add_ps(rho, g[q]);
+					if (g_c[q][0]) jx = g_c[q][0] > 0 ? _mm_add_ps(jx, g[q]) : _mm_sub_ps(jx, g[q]);
+					if (g_c[q][1]) jy = g_c[q][1] > 0 ? _mm_add_ps(jy, g[q]) : _mm_sub_ps(jy, g[q]);
+					if (g_c[q][2]) jz = g_c[q][2] > 0 ? _mm_add_ps(jz, g[q]) : _mm_sub_ps(jz, g[q]);
+				}
+				rho = select(selfSolid, one, rho); // Avoid divisions by zero in unused lanes
+				__m128 invRho = _mm_div_ps(one, rho);
+				__m128 ux = _mm_mul_ps(jx, invRho);
+				__m128 uy = _mm_mul_ps(jy, invRho);
+				__m128 uz = _mm_mul_ps(jz, invRho);
+				__m128 usq = _mm_mul_ps(oneHalf, _mm_add_ps(_mm_add_ps(_mm_mul_ps(ux, ux), _mm_mul_ps(uy, uy)), _mm_mul_ps(uz, uz)));
+
+				// BGK collision towards the second order equilibrium
+				for (int q = 0; q < Q; ++q)
+				{
+					__m128 cu = _mm_setzero_ps();
+					if (g_c[q][0]) cu = g_c[q][0] > 0 ? _mm_add_ps(cu, ux) : _mm_sub_ps(cu, ux);
+					if (g_c[q][1]) cu = g_c[q][1] > 0 ? _mm_add_ps(cu, uy) : _mm_sub_ps(cu, uy);
+					if (g_c[q][2]) cu = g_c[q][2] > 0 ? _mm_add_ps(cu, uz) : _mm_sub_ps(cu, uz);
+					cu = _mm_mul_ps(three, cu);
+
+					__m128 feq = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(g_w[q]), rho), _mm_sub_ps(_mm_add_ps(_mm_add_ps(one, cu), _mm_mul_ps(half, _mm_mul_ps(cu, cu))), usq));
+					__m128 result = _mm_add_ps(g[q], _mm_mul_ps(omega, _mm_sub_ps(feq, g[q])));
+
+					float* out = dst + q * m_arraySize + i;
+					_mm_storeu_ps(out, select(selfSolid, _mm_loadu_ps(src + q * m_arraySize + i), result));
+				}
+			}
+		}
+	}
+}
+
+void LbmBackend::fillVelocity(std::vector<float>& velocity)
+{
+	fillVelocity(velocity.data(), velocity.size() / 4);
+}
+
+void LbmBackend::fillVelocity(float* velocity, size_t cells)
+{
+	const std::vector<float>& f = m_f[m_current];
+	const float scale = m_parameters.inflowVelocity / m_parameters.latticeVelocity; // Lattice -> m/s
+
+	Parallel::forRange(0, m_resolution.z, [&](int zBegin, int zEnd)
+	{
+		for (int z = zBegin; z < zEnd; ++z)
+		{
+			for (uint32_t y = 0; y < m_resolution.y; ++y)
+			{
+				for (uint32_t x = 0; x < m_resolution.x; ++x)
+				{
+					size_t index = paddedIndex(x, y, z);
+					float* v = &velocity[4 * (x + static_cast<size_t>(m_resolution.x) * (y + static_cast<size_t>(m_resolution.y) * z))];
+					v[0] = v[1] = v[2] = v[3] = 0.0f;
+					if (m_solid[index])
+						continue;
+
+					float rho = 0.0f;
+					for (int q = 0; q < Q; ++q)
+					{
+						float fq = f[q * m_arraySize + index];
+						rho += fq;
+						v[0] += g_c[q][0] * fq;
+						v[1] += g_c[q][1] * fq;
+						v[2] += g_c[q][2] * fq;
+					}
+					float s = scale / rho;
+					v[0] *= s;
+					v[1] *= s;
+					v[2] *= s;
+				}
+			}
+		}
+	}, m_threads);
+}
+
+void LbmBackend::fillPressure(std::vector<float>& pressure)
+{
+	fillPressure(pressure.data(), pressure.size());
+}
+
+void LbmBackend::fillPressure(float* pressure, size_t cells)
+{
+	const std::vector<float>& f = m_f[m_current];
+	const float scale = m_parameters.inflowVelocity / m_parameters.latticeVelocity;
+	const float toPascal = m_parameters.airDensity * scale * scale / 3.0f; // p = c_s^2 * (rho - 1), c_s^2 = 1/3
+
+	Parallel::forRange(0, m_resolution.z, [&](int zBegin, int zEnd)
+	{
+		for (int z = zBegin; z < zEnd; ++z)
+		{
+			for (uint32_t y = 0; y < m_resolution.y; ++y)
+			{
+				for (uint32_t x = 0; x < m_resolution.x; ++x)
+				{
+					size_t index = paddedIndex(x, y, z);
+					float rho = 0.0f;
+					if (!m_solid[index])
+					{
+						for (int q = 0; q < Q; ++q)
+							rho += f[q * m_arraySize + index];
+						rho -= 1.0f;
+					}
+					pressure[x + static_cast<size_t>(m_resolution.x) * (y + static_cast<size_t>(m_resolution.y) * z)] = rho * toPascal;
+				}
+			}
+		}
+	}, m_threads);
+}
+
+std::string LbmBackend::getStats()
+{
+	std::stringstream ss;
+	ss << getName() << ": " << std::fixed << std::setprecision(1) << m_mlups << " MLUPS (" << Parallel::numThreads(m_threads) << " threads)\n";
+	return ss.str();
+}
+
+size_t LbmBackend::getStateSize() const
+{
+	return m_f[m_current].size() * sizeof(float);
+}
+
+void LbmBackend::saveState(char* state) const
+{
+	// Only the distributions of the last step are needed, the other array is completely overwritten by the next step
+	// The lattice directions are copied in parallel, which mostly hides the page faults of a memory-mapped target
+	const float* f = m_f[m_current].data();
+	float* out = reinterpret_cast<float*>(state);
+	Parallel::forRange(0, Q, [&](int first, int last)
+	{
+		std::copy(f + first * m_arraySize, f + last * m_arraySize, out + first * m_arraySize);
+	}, m_threads);
+}
+
+bool LbmBackend::restoreState(const char* state, size_t size)
+{
+	if (size != getStateSize())
+		return false;
+
+	const float* in = reinterpret_cast<const float*>(state);
+	float* f = m_f[m_current].data();
+	Parallel::forRange(0, Q, [&](int first, int last)
+	{
+		std::copy(in + first * m_arraySize, in + last * m_arraySize, f + first * m_arraySize);
+	}, m_threads);
+	return true;
+}
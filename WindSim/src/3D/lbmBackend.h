@@ -0,0 +1,104 @@
+#ifndef LBM_BACKEND_H
+#define LBM_BACKEND_H
+
+#include "solverBackend.h"
+
+#include <vector>
+#include <cstdint>
+
+// Native CPU lattice Boltzmann solver (D3Q19 lattice, BGK collision, fused pull streaming)
+// The distributions are stored as structure of arrays (one array per lattice direction) on the grid extended by a ghost layer,
+// so 4 neighbouring cells along x are streamed and collided as one SSE vector; z-slabs are processed in parallel
+// Solid cells (and the ghost layer) reflect with half-way bounce-back; slip cells reflect the diagonal directions specularly, where one of
+// their two axes is blocked by a slip cell. Inflow and outflow cells must lie on the faces of the grid: inflow cells are held at the
+// equilibrium of the inflow velocity along the inward normal of their face and outflow cells copy their inner neighbour along the normal
+// (or the diagonal one, where a slip wall covers it). The cells must be cubes
+class LbmBackend : public SolverBackend
+{
+public:
+	struct Parameters
+	{
+		Parameters();
+		float inflowVelocity; // m/s into the grid, normal to the inflow faces
+		float latticeVelocity; // Inflow velocity in lattice units; with the cell size it defines the time step (keep well below 0.3)
+		float relaxationTime; // BGK relaxation time (> 0.5); defines the viscosity (tau - 0.5) / 3 in lattice units
+		float airDensity; // kg/m^3, scales the pressure
+	};
+
+	// Reads the optional "lbm" object of the JSON settings file (keys as in Parameters)
+	static Parameters readParameters(const std::string& settingsFile);
+
+	LbmBackend(const Parameters& parameters, int threads = 0);
+
+	std::string getName() const override { return "CPU LBM D3Q19"; };
+
+	void setGridDimension(const DirectX::XMUINT3& resolution, const DirectX::XMFLOAT3& voxelSize) override;
+	void updateGrid(const std::vector<wtl::CellType>& cellTypes) override;
+	float step() override;
+	void reset() override;
+
+	void fillVelocity(std::vector<float>& velocity) override;
+	void fillPressure(std::vector<float>& pressure) override;
+	void fillVelocity(float* velocity, size_t cells) override;
+	void fillPressure(float* pressure, size_t cells) override;
+
+	std::string getStats() override;
+
+	size_t getStateSize() const override;
+	void saveState(char* state) const override;
+	bool restoreState(const char* state, size_t size) override;
+
+	double getMlups() const { return m_mlups; }; // Million lattice cell updates per second of the last step
+
+private:
+	static const int Q = 19;
+
+	// Cell, whose population <q> is pulled from <source> (direction * array size + padded index) instead of being bounced back
+	struct SlipLink
+	{
+		size_t index;
+		int q;
+		size_t source;
+	};
+
+	// Inflow cell and the lattice direction of the inward normal of its grid face
+	struct InflowCell
+	{
+		size_t index;
+		int normal;
+	};
+
+	// Outflow cell and the cell inside the grid, whose distributions it copies
+	struct OutflowCell
+	{
+		size_t index;
+		size_t source;
+	};
+
+	size_t paddedIndex(int x, int y, int z) const { return m_guard + (x + 1) + m_stride.x * ((y + 1) + m_stride.y * static_cast<size_t>(z + 1)); };
+	void setEquilibrium(std::vector<float>& f, size_t index, float rho, float ux, float uy, float uz);
+	void collideSlab(int zBegin, int zEnd);
+
+	Parameters m_parameters;
+	int m_threads;
+
+	DirectX::XMUINT3 m_resolution;
+	DirectX::XMFLOAT3 m_voxelSize;
+	DirectX::XMUINT3 m_stride; // Padded grid: ghost layer on each side, x rounded up to full SSE vectors
+	size_t m_guard; // Padding in front of and behind each array, so the neighbour loads of the outermost cells stay in bounds
+	size_t m_arraySize;
+	int m_offsets[Q]; // Index offset of the neighbour in each lattice direction
+
+	std::vector<float> m_f[2]; // Q arrays each; m_f[m_current] holds the post-collision distributions of the last step
+	int m_current;
+	std::vector<uint32_t> m_solid; // All bits set for solid and ghost cells
+	std::vector<InflowCell> m_inflow;
+	std::vector<OutflowCell> m_outflow;
+	std::vector<SlipLink> m_slipLinks; // Sorted by cell
+	int m_inflowNormal; // Lattice direction of the first inflow face, the initial flow direction
+	std::vector<wtl::CellType> m_cellTypes;
+
+	double m_mlups;
+};
+
+#endif
@@ -2,6 +2,7 @@
 #include "objLoader.h"
 #include "common.h"
 #include "volInt.h"
+#include "settings.h"
 
 #include "d3dx11effect.h"
 #include <d3dcompiler.h>
@@ -12,7 +13,8 @@
 using namespace DirectX;
 
 Mesh3D::Mesh3D(const std::string& path, DX11Renderer* renderer)
-	: Object3D(renderer)
+	: Object3D(renderer),
+	m_distanceField()
 {
 	if (!readObj(path))
 	{
@@ -21,6 +23,15 @@ Mesh3D::Mesh3D(const std::string& path, DX11Renderer* renderer)
 	m_numIndices = m_indexData.size();
 }
 
+Mesh3D::Mesh3D(std::vector<float> vertexData, std::vector<uint32_t> indexData, DX11Renderer* renderer)
+	: Object3D(renderer),
+	m_distanceField()
+{
+	m_vertexData.swap(vertexData);
+	m_indexData.swap(indexData);
+	m_numIndices = m_indexData.size();
+}
+
 HRESULT Mesh3D::createShaderFromFile(const std::wstring& shaderPath, ID3D11Device* device, const bool reload)
 {
 	HRESULT hr;
@@ -117,6 +128,19 @@ void Mesh3D::calcMassProps(const float density, const XMFLOAT3& scale, XMFLOAT3X
 
 }
 
+const DistanceField& Mesh3D::getDistanceField(int resolution, int band)
+{
+	if (!m_distanceField.isValid() || m_distanceField.getResolution() != resolution || m_distanceField.getBand() != band)
+	{
+		QElapsedTimer timer;
+		timer.start();
+		m_distanceField.build(m_vertexData, m_indexData, resolution, band, conf.cpu.threads);
+		log("INFO: Built signed distance field with resolution " + std::to_string(resolution) + " for " + std::to_string(m_indexData.size() / 3) + " triangles in " + std::to_string(timer.nsecsElapsed() * 1e-6) + "msec");
+	}
+
+	return m_distanceField;
+}
+
 Mesh3D::ShaderVariables::ShaderVariables()
 	: worldView(nullptr),
 	worldViewIT(nullptr),
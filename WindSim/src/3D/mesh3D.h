@@ -2,6 +2,7 @@
 #define MESH3D_H
 
 #include "object3D.h"
+#include "distanceField.h"
 
 #include <DirectXPackedVector.h>
 
@@ -19,6 +20,8 @@ public:
 	static ID3D11InputLayout* getInputLayout() { return s_inputLayout; };
 
 	Mesh3D(const std::string& path, DX11Renderer* renderer);
+	// Takes generated geometry in the layout of the obj meshes: px, py, pz, nx, ny, nz per vertex and 3 indices per triangle (see Isosurface)
+	Mesh3D(std::vector<float> vertexData, std::vector<uint32_t> indexData, DX11Renderer* renderer);
 
 	void render(ID3D11Device* device, ID3D11DeviceContext* context, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection, double elapsedTime) override;
 
@@ -28,9 +31,15 @@ public:
 
 	DX11Renderer* getRenderer() { return m_renderer; };
 
+	// Signed distance field of the mesh in object space
+	// Built on first request and cached, as rigid transformations of the mesh do not change it; rebuilt if resolution or band change
+	const DistanceField& getDistanceField(int resolution, int band);
+
 private:
 	bool readObj(const std::string& path);
 
+	DistanceField m_distanceField;
+
 	struct ShaderVariables
 	{
 		ShaderVariables();
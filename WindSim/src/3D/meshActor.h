@@ -45,6 +45,10 @@ public:
 	void setVoxelize(bool voxelize) { m_voxelize = voxelize; };
 	void setDynamics(bool dynamics) { m_calcDynamics = dynamics; m_dynamics.reset(); };
 	void resetDynamics() { m_dynamics.reset(); };
+	bool getDynamics() const { return m_calcDynamics; };
+	Dynamics::State getDynamicsState() const { return m_dynamics.getState(); };
+	void setDynamicsState(const Dynamics::State& state) { m_dynamics.setState(state); };
+	void getAxialMotion(float& torque, float& angVel, float& angAcc) const { m_dynamics.getAxialMotion(torque, angVel, angAcc); };
 	void setDensity(float density) { m_density = density; };
 	void setLocalRotationAxis(const DirectX::XMFLOAT3& axis) { m_dynamics.setRotationAxis(axis); m_dynamics.reset(); };
 	void setShowAccelArrow(bool showAccelArrow) { m_showAccelArrow = showAccelArrow; };
@@ -0,0 +1,417 @@
+#include "multigridSolver.h"
+#include "parallel.h"
+
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const int PRE_SMOOTHING = 2;
+	const int POST_SMOOTHING = 2;
+	const int COARSEST_SMOOTHING = 32;
+	const int MAX_LEVELS = 10;
+
+	inline __m128 select(__m128 mask, __m128 a, __m128 b) // mask ? a : b
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	inline __m128 laplaceSum(const float* p, size_t i, size_t sx, size_t sxy)
+	{
+		__m128 sum = _mm_add_ps(_mm_loadu_ps(p + i - 1), _mm_loadu_ps(p + i + 1));
+		sum = _mm_add_ps(sum, _mm_add_ps(_mm_loadu_ps(p + i - sx), _mm_loadu_ps(p + i + sx)));
+		return _mm_add_ps(sum, _mm_add_ps(_mm_loadu_ps(p + i - sxy), _mm_loadu_ps(p + i + sxy)));
+	}
+}
+
+MultigridSolver::MultigridSolver(int threads)
+	: m_threads(threads),
+	m_singular(false),
+	m_levels()
+{
+}
+
+void MultigridSolver::setDomain(const std::vector<Cell>& cells, const XMUINT3& resolution)
+{
+	m_levels.clear();
+	m_levels.reserve(MAX_LEVELS);
+	m_levels.push_back(Level());
+	initLevel(m_levels.back(), cells, resolution);
+
+	m_singular = std::find(cells.begin(), cells.end(), Cell::Dirichlet) == cells.end();
+
+	// Coarsen while every axis can be halved
+	while (m_levels.size() < MAX_LEVELS)
+	{
+		const Level& fine = m_levels.back();
+		const XMUINT3& f = fine.resolution;
+		if (std::min(f.x, std::min(f.y, f.z)) <= 2)
+			break;
+
+		XMUINT3 res((f.x + 1) / 2, (f.y + 1) / 2, (f.z + 1) / 2);
+		std::vector<Cell> coarse(static_cast<size_t>(res.x) * res.y * res.z);
+		bool anyInterior = false;
+		for (uint32_t z = 0; z < res.z; ++z)
+		{
+			for (uint32_t y = 0; y < res.y; ++y)
+			{
+				for (uint32_t x = 0; x < res.x; ++x)
+				{
+					bool dirichlet = false;
+					bool interior = false;
+					for (uint32_t cz = 2 * z; cz < std::min(2 * z + 2, f.z); ++cz)
+					{
+						for (uint32_t cy = 2 * y; cy < std::min(2 * y + 2, f.y); ++cy)
+						{
+							for (uint32_t cx = 2 * x; cx < std::min(2 * x + 2, f.x); ++cx)
+							{
+								Cell c = fine.cells[cx + f.x * (cy + static_cast<size_t>(f.y) * cz)];
+								dirichlet |= c == Cell::Dirichlet;
+								interior |= c == Cell::Interior;
+							}
+						}
+					}
+					Cell& c = coarse[x + res.x * (y + static_cast<size_t>(res.y) * z)];
+					c = dirichlet ? Cell::Dirichlet : (interior ? Cell::Interior : Cell::Neumann);
+					anyInterior |= c == Cell::Interior;
+				}
+			}
+		}
+		if (!anyInterior)
+			break;
+
+		m_levels.push_back(Level());
+		initLevel(m_levels.back(), coarse, res);
+		m_levels.back().h2 = m_levels[m_levels.size() - 2].h2 * 4.0f;
+	}
+}
+
+void MultigridSolver::initLevel(Level& level, const std::vector<Cell>& cells, const XMUINT3& resolution)
+{
+	level.resolution = resolution;
+	level.stride = XMUINT3((resolution.x + 2 + 3) & ~3u, resolution.y + 2, resolution.z + 2);
+	level.size = static_cast<size_t>(level.stride.x) * level.stride.y * level.stride.z + 2 * GUARD;
+	level.h2 = 1.0f;
+	level.cells = cells;
+	level.p.assign(level.size, 0.0f);
+	level.b.assign(level.size, 0.0f);
+	level.r.assign(level.size, 0.0f);
+	level.diag.assign(level.size, 0.0f);
+	level.invDiag.assign(level.size, 0.0f);
+
+	auto cell = [&](int x, int y, int z)
+	{
+		if (x < 0 || y < 0 || z < 0 || x >= static_cast<int>(resolution.x) || y >= static_cast<int>(resolution.y) || z >= static_cast<int>(resolution.z))
+			return Cell::Neumann;
+		return cells[x + resolution.x * (y + static_cast<size_t>(resolution.y) * z)];
+	};
+
+	Parallel::forRange(0, resolution.z, [&](int zBegin, int zEnd)
+	{
+		for (int z = zBegin; z < zEnd; ++z)
+		{
+			for (int y = 0; y < static_cast<int>(resolution.y); ++y)
+			{
+				for (int x = 0; x < static_cast<int>(resolution.x); ++x)
+				{
+					if (cell(x, y, z) != Cell::Interior)
+						continue;
+
+					const int n[6][3] = { { x - 1, y, z }, { x + 1, y, z }, { x, y - 1, z }, { x, y + 1, z }, { x, y, z - 1 }, { x, y, z + 1 } };
+					int count = 0;
+					for (int i = 0; i < 6; ++i)
+						count += cell(n[i][0], n[i][1], n[i][2]) != Cell::Neumann;
+
+					// Interior cells without any coupling (only possible for enclosed single cells) are treated as Neumann
+					size_t index = level.index(x, y, z);
+					level.diag[index] = static_cast<float>(count);
+					level.invDiag[index] = count > 0 ? 1.0f / count : 0.0f;
+				}
+			}
+		}
+	}, m_threads);
+}
+
+void MultigridSolver::smooth(Level& level, int iterations)
+{
+	const size_t sx = level.stride.x;
+	const size_t sxy = sx * level.stride.y;
+	const __m128 h2 = _mm_set1_ps(level.h2);
+	// Lanes of one colour: a row starts at the ghost cell x = -1, so lane j has the colour (j + 1 + y + z) & 1
+	const __m128 colourMask[2] = { _mm_castsi128_ps(_mm_setr_epi32(-1, 0, -1, 0)), _mm_castsi128_ps(_mm_setr_epi32(0, -1, 0, -1)) };
+
+	for (int it = 0; it < iterations; ++it)
+	{
+		for (int colour = 0; colour < 2; ++colour)
+		{
+			// Cells of one colour only depend on cells of the other colour, so the slabs are independent
+			Parallel::forRange(0, level.resolution.z, [&](int zBegin, int zEnd)
+			{
+				float* p = level.p.data();
+				const float* b = level.b.data();
+				const float* invDiag = level.invDiag.data();
+				for (int z = zBegin; z < zEnd; ++z)
+				{
+					for (int y = 0; y < static_cast<int>(level.resolution.y); ++y)
+					{
+						const __m128 mask = colourMask[(1 + y + z + colour) & 1];
+						const size_t rowStart = level.index(-1, y, z);
+						for (size_t x = 0; x < sx; x += 4)
+						{
+							size_t i = rowStart + x;
+							// Non interior cells have invDiag = 0 and remain zero
+							__m128 value = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(h2, _mm_loadu_ps(b + i)), laplaceSum(p, i, sx, sxy)), _mm_loadu_ps(invDiag + i));
+							_mm_storeu_ps(p + i, select(mask, value, _mm_loadu_ps(p + i)));
+						}
+					}
+				}
+			}, m_threads);
+		}
+	}
+}
+
+double MultigridSolver::residual(Level& level)
+{
+	const size_t sx = level.stride.x;
+	const size_t sxy = sx * level.stride.y;
+	const __m128 invH2 = _mm_set1_ps(1.0f / level.h2);
+	const __m128 zero = _mm_setzero_ps();
+	std::vector<double> norm(level.resolution.z, 0.0);
+
+	Parallel::forRange(0, level.resolution.z, [&](int zBegin, int zEnd)
+	{
+		const float* p = level.p.data();
+		const float* b = level.b.data();
+		const float* diag = level.diag.data();
+		const float* invDiag = level.invDiag.data();
+		float* r = level.r.data();
+		for (int z = zBegin; z < zEnd; ++z)
+		{
+			__m128 sum = _mm_setzero_ps();
+			for (int y = 0; y < static_cast<int>(level.resolution.y); ++y)
+			{
+				const size_t rowStart = level.index(-1, y, z);
+				for (size_t x = 0; x < sx; x += 4)
+				{
+					size_t i = rowStart + x;
+					__m128 ap = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(diag + i), _mm_loadu_ps(p + i)), laplaceSum(p, i, sx, sxy)), invH2);
+					__m128 res = _mm_and_ps(_mm_cmpgt_ps(_mm_loadu_ps(invDiag + i), zero), _mm_sub_ps(_mm_loadu_ps(b + i), ap));
+					_mm_storeu_ps(r + i, res);
+					sum = _mm_add_ps(sum, _mm_mul_ps(res, res));
+				}
+			}
+			float s[4];
+			_mm_storeu_ps(s, sum);
+			norm[z] = static_cast<double>(s[0]) + s[1] + s[2] + s[3];
+		}
+	}, m_threads);
+
+	double total = 0.0;
+	for (double n : norm)
+		total += n;
+	return total;
+}
+
+void MultigridSolver::restrictResidual(const Level& fine, Level& coarse)
+{
+	const XMUINT3& f = fine.resolution;
+	const XMUINT3& c = coarse.resolution;
+	std::fill(coarse.p.begin(), coarse.p.end(), 0.0f);
+
+	Parallel::forRange(0, c.z, [&](int zBegin, int zEnd)
+	{
+		for (int z = zBegin; z < zEnd; ++z)
+		{
+			for (int y = 0; y < static_cast<int>(c.y); ++y)
+			{
+				for (int x = 0; x < static_cast<int>(c.x); ++x)
+				{
+					size_t index = coarse.index(x, y, z);
+					if (coarse.invDiag[index] == 0.0f)
+					{
+						coarse.b[index] = 0.0f;
+						continue;
+					}
+
+					// Transpose of the trilinear prolongation: the 4 fine cells around each axis have the weights 1/4, 3/4, 3/4, 1/4
+					// Cells outside of the fine grid have no residual
+					float sum = 0.0f;
+					for (int cz = 2 * z - 1; cz <= 2 * z + 2; ++cz)
+					{
+						if (cz < 0 || cz >= static_cast<int>(f.z))
+							continue;
+						float wz = (cz == 2 * z - 1 || cz == 2 * z + 2) ? 0.25f : 0.75f;
+						for (int cy = 2 * y - 1; cy <= 2 * y + 2; ++cy)
+						{
+							if (cy < 0 || cy >= static_cast<int>(f.y))
+								continue;
+							float wyz = wz * ((cy == 2 * y - 1 || cy == 2 * y + 2) ? 0.25f : 0.75f);
+							const float* r = &fine.r[fine.index(2 * x - 1, cy, cz)];
+							sum += wyz * (0.25f * r[0] + 0.75f * (r[1] + r[2]) + 0.25f * r[3]);
+						}
+					}
+					coarse.b[index] = 0.125f * sum;
+				}
+			}
+		}
+	}, m_threads);
+}
+
+void MultigridSolver::prolongate(const Level& coarse, Level& fine)
+{
+	const XMUINT3& c = coarse.resolution;
+
+	// Coarse value for the interpolation: Dirichlet cells are zero, Neumann cells take the value of the centre cell
+	auto value = [&](int x, int y, int z, float centre)
+	{
+		if (x < 0 || y < 0 || z < 0 || x >= static_cast<int>(c.x) || y >= static_cast<int>(c.y) || z >= static_cast<int>(c.z))
+			return centre;
+		Cell cell = coarse.cells[x + c.x * (y + static_cast<size_t>(c.y) * z)];
+		if (cell == Cell::Dirichlet)
+			return 0.0f;
+		return cell == Cell::Interior ? coarse.p[coarse.index(x, y, z)] : centre;
+	};
+
+	Parallel::forRange(0, fine.resolution.z, [&](int zBegin, int zEnd)
+	{
+		for (int z = zBegin; z < zEnd; ++z)
+		{
+			for (int y = 0; y < static_cast<int>(fine.resolution.y); ++y)
+			{
+				for (int x = 0; x < static_cast<int>(fine.resolution.x); ++x)
+				{
+					size_t index = fine.index(x, y, z);
+					if (fine.invDiag[index] == 0.0f)
+						continue;
+
+					// Trilinear interpolation between the cell centres: weight 3/4 for the parent, 1/4 for its neighbour on the side of the child
+					int X = x / 2, Y = y / 2, Z = z / 2;
+					int dx = (x & 1) ? 1 : -1, dy = (y & 1) ? 1 : -1, dz = (z & 1) ? 1 : -1;
+					float centre = coarse.p[coarse.index(X, Y, Z)];
+					float e = 0.0f;
+					for (int k = 0; k < 2; ++k)
+					{
+						for (int j = 0; j < 2; ++j)
+						{
+							for (int i = 0; i < 2; ++i)
+							{
+								float w = (i ? 0.25f : 0.75f) * (j ? 0.25f : 0.75f) * (k ? 0.25f : 0.75f);
+								e += w * value(X + i * dx, Y + j * dy, Z + k * dz, centre);
+							}
+						}
+					}
+					fine.p[index] += e;
+				}
+			}
+		}
+	}, m_threads);
+}
+
+void MultigridSolver::vCycle(size_t l)
+{
+	Level& level = m_levels[l];
+	if (l + 1 == m_levels.size())
+	{
+		smooth(level, COARSEST_SMOOTHING);
+		return;
+	}
+
+	smooth(level, PRE_SMOOTHING);
+	residual(level);
+	restrictResidual(level, m_levels[l + 1]);
+	vCycle(l + 1);
+	prolongate(m_levels[l + 1], level);
+	smooth(level, POST_SMOOTHING);
+}
+
+MultigridSolver::Result MultigridSolver::solve(const float* rhs, float* solution, float tolerance, int maxCycles)
+{
+	Result result = { 0, 0.0f, 0.0f, 0.0f };
+	if (m_levels.empty())
+		return result;
+
+	Level& level = m_levels[0];
+	const XMUINT3& res = level.resolution;
+	auto cellIndex = [&](int x, int y, int z) { return x + res.x * (y + static_cast<size_t>(res.y) * z); };
+
+	// Copy into the padded layout
+	std::vector<double> sums(res.z, 0.0);
+	std::vector<double> counts(res.z, 0.0);
+	Parallel::forRange(0, res.z, [&](int zBegin, int zEnd)
+	{
+		for (int z = zBegin; z < zEnd; ++z)
+		{
+			for (int y = 0; y < static_cast<int>(res.y); ++y)
+			{
+				for (int x = 0; x < static_cast<int>(res.x); ++x)
+				{
+					size_t index = level.index(x, y, z);
+					bool interior = level.invDiag[index] != 0.0f;
+					level.b[index] = interior ? rhs[cellIndex(x, y, z)] : 0.0f;
+					level.p[index] = interior ? solution[cellIndex(x, y, z)] : 0.0f;
+					sums[z] += level.b[index];
+					counts[z] += interior;
+				}
+			}
+		}
+	}, m_threads);
+
+	// Without Dirichlet cells, the right hand side must sum up to zero
+	if (m_singular)
+	{
+		double sum = 0.0, count = 0.0;
+		for (uint32_t z = 0; z < res.z; ++z)
+		{
+			sum += sums[z];
+			count += counts[z];
+		}
+		float mean = count > 0.0 ? static_cast<float>(sum / count) : 0.0f;
+		for (size_t i = 0; i < level.size; ++i)
+		{
+			if (level.invDiag[i] != 0.0f)
+				level.b[i] -= mean;
+		}
+	}
+
+	double bNorm = 0.0;
+	for (size_t i = 0; i < level.size; ++i)
+		bNorm += static_cast<double>(level.b[i]) * level.b[i];
+	bNorm = std::sqrt(bNorm);
+
+	if (bNorm > 0.0)
+	{
+		result.initialResidual = static_cast<float>(std::sqrt(residual(level)) / bNorm);
+		result.residual = result.initialResidual;
+		while (result.cycles < maxCycles && result.residual > tolerance)
+		{
+			vCycle(0);
+			result.residual = static_cast<float>(std::sqrt(residual(level)) / bNorm);
+			++result.cycles;
+		}
+		if (result.cycles > 0 && result.initialResidual > 0.0f)
+			result.convergence = std::pow(result.residual / result.initialResidual, 1.0f / result.cycles);
+	}
+	else
+	{
+		std::fill(level.p.begin(), level.p.end(), 0.0f);
+	}
+
+	Parallel::forRange(0, res.z, [&](int zBegin, int zEnd)
+	{
+		for (int z = zBegin; z < zEnd; ++z)
+		{
+			for (int y = 0; y < static_cast<int>(res.y); ++y)
+			{
+				for (int x = 0; x < static_cast<int>(res.x); ++x)
+					solution[cellIndex(x, y, z)] = level.p[level.index(x, y, z)];
+			}
+		}
+	}, m_threads);
+
+	return result;
+}
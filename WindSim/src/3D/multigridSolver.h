@@ -0,0 +1,73 @@
+#ifndef MULTIGRID_SOLVER_H
+#define MULTIGRID_SOLVER_H
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <cstdint>
+
+// Matrix-free geometric multigrid solver for the pressure Poisson equation of a projection step
+// Solves sum over the neighbours n of (p_i - p_n) = b_i for all interior cells with the 7-point stencil, where
+// Neumann cells (solids) drop out of the stencil and Dirichlet cells (p = 0, outflow) only contribute to the diagonal
+//
+// V-cycles with red-black Gauss-Seidel smoothing; the cell classes are coarsened as in McAdams et al. 2010
+// (Dirichlet wins over interior, interior over Neumann), the residual is restricted by averaging and the correction
+// prolongated trilinearly. Each level is stored on a ghost-padded grid, so the smoother and residual stencils process
+// 4 cells along x per SSE vector; all levels run multi-threaded over z
+class MultigridSolver
+{
+public:
+	enum class Cell : uint8_t { Neumann, Interior, Dirichlet };
+
+	struct Result
+	{
+		int cycles; // V-cycles done
+		float initialResidual; // Relative to the norm of b
+		float residual;
+		float convergence; // Average residual reduction per V-cycle
+	};
+
+	MultigridSolver(int threads = 0);
+
+	// Build the level hierarchy for a domain (x fastest)
+	void setDomain(const std::vector<Cell>& cells, const DirectX::XMUINT3& resolution);
+
+	// solution is the initial guess on input; values of non interior cells are set to zero
+	// Stops when the relative residual drops below tolerance or after maxCycles V-cycles
+	Result solve(const float* rhs, float* solution, float tolerance, int maxCycles);
+
+	int getNumLevels() const { return static_cast<int>(m_levels.size()); };
+
+private:
+	struct Level
+	{
+		DirectX::XMUINT3 resolution;
+		DirectX::XMUINT3 stride; // Ghost layer on each side, x rounded up to full SSE vectors
+		size_t size;
+		float h2; // Squared cell size relative to the finest level
+
+		std::vector<Cell> cells; // Unpadded
+		std::vector<float> p;
+		std::vector<float> b;
+		std::vector<float> r;
+		std::vector<float> diag; // Number of interior and Dirichlet neighbours
+		std::vector<float> invDiag; // Zero for all cells, which are not interior
+
+		size_t index(int x, int y, int z) const { return GUARD + (x + 1) + stride.x * ((y + 1) + stride.y * static_cast<size_t>(z + 1)); };
+	};
+
+	static const size_t GUARD = 4;
+
+	void initLevel(Level& level, const std::vector<Cell>& cells, const DirectX::XMUINT3& resolution);
+	void smooth(Level& level, int iterations);
+	double residual(Level& level); // Returns the squared norm
+	void restrictResidual(const Level& fine, Level& coarse);
+	void prolongate(const Level& coarse, Level& fine);
+	void vCycle(size_t l);
+
+	int m_threads;
+	bool m_singular; // No Dirichlet cells: the solution is only defined up to a constant
+	std::vector<Level> m_levels;
+};
+
+#endif
@@ -39,6 +39,10 @@ public:
 	virtual ID3D11Buffer* getIndexBuffer() { return m_indexBuffer; };
 	virtual uint32_t getNumIndices() const { return m_numIndices; };
 
+	// Client side copies of the geometry (only available if not cleared on create)
+	const std::vector<float>& getVertexData() const { return m_vertexData; };
+	const std::vector<uint32_t>& getIndexData() const { return m_indexData; };
+
 	virtual void log(const std::string& msg);
 
 protected:
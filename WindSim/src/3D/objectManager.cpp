@@ -135,6 +135,26 @@ void ObjectManager::triggerObjectFunction(const QJsonObject& data)
 
 	if (fIt->toString() == "restartSimulation")
 		std::dynamic_pointer_cast<VoxelGridActor>(it->second)->getObject()->restartSimulation();
+	else if (fIt->toString() == "exportFields")
+		std::dynamic_pointer_cast<VoxelGridActor>(it->second)->getObject()->exportFields(data["file"].toString());
+	else if (fIt->toString() == "saveCheckpoint")
+		std::dynamic_pointer_cast<VoxelGridActor>(it->second)->getObject()->saveCheckpoint(data["file"].toString());
+	else if (fIt->toString() == "loadCheckpoint")
+		std::dynamic_pointer_cast<VoxelGridActor>(it->second)->getObject()->loadCheckpoint(data["file"].toString());
+	else if (fIt->toString() == "startRecording")
+		std::dynamic_pointer_cast<VoxelGridActor>(it->second)->getObject()->startRecording(data["file"].toString());
+	else if (fIt->toString() == "stopRecording")
+		std::dynamic_pointer_cast<VoxelGridActor>(it->second)->getObject()->stopRecording();
+	else if (fIt->toString() == "startPlayback")
+		std::dynamic_pointer_cast<VoxelGridActor>(it->second)->getObject()->startPlayback(data["file"].toString());
+	else if (fIt->toString() == "stopPlayback")
+		std::dynamic_pointer_cast<VoxelGridActor>(it->second)->getObject()->stopPlayback();
+	else if (fIt->toString() == "seekPlayback")
+		std::dynamic_pointer_cast<VoxelGridActor>(it->second)->getObject()->seekPlayback(data["position"].toDouble());
+	else if (fIt->toString() == "setPlaybackRate")
+		std::dynamic_pointer_cast<VoxelGridActor>(it->second)->getObject()->setPlaybackRate(data["rate"].toDouble());
+	else if (fIt->toString() == "benchmarkVoxelization")
+		std::dynamic_pointer_cast<VoxelGridActor>(it->second)->getObject()->benchmarkVoxelization(data["file"].toString());
 }
 
 void ObjectManager::modify(const QJsonObject& data)
@@ -235,6 +255,8 @@ void ObjectManager::modify(const QJsonObject& data)
 		act->getObject()->resize(res, vs);
 		if (mod.testFlag(VoxelSettings))
 			act->getObject()->setVoxelSettings(data["voxel"].toObject());
+		if (mod.testFlag(VoxelizationSettings))
+			act->getObject()->setVoxelizationSettings(data["voxelization"].toObject());
 		if (mod.testFlag(GlyphSettings))
 			act->getObject()->setGlyphSettings(data["glyphs"].toObject());
 		if (mod.testFlag(VolumeSettings))
@@ -0,0 +1,520 @@
+#include "projectionBackend.h"
+#include "parallel.h"
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QElapsedTimer>
+
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const int OUTSIDE = -1;
+
+	inline bool isSolid(int type)
+	{
+		return type == wtl::CELL_TYPE_SOLID_SLIP || type == wtl::CELL_TYPE_SOLID_NO_SLIP || type == wtl::CELL_TYPE_SOLID_BOUNDARY;
+	}
+}
+
+ProjectionBackend::Parameters::Parameters()
+	: inflowVelocity(10.0f),
+	cfl(1.0f),
+	tolerance(1e-3f),
+	maxCycles(8),
+	airDensity(1.2f)
+{
+}
+
+ProjectionBackend::Parameters ProjectionBackend::readParameters(const std::string& settingsFile)
+{
+	Parameters parameters;
+
+	QFile f(QString::fromStdString(settingsFile));
+	if (!f.open(QIODevice::ReadOnly))
+		return parameters;
+
+	QJsonObject projection = QJsonDocument::fromJson(f.readAll()).object()["projection"].toObject();
+	parameters.inflowVelocity = static_cast<float>(projection["inflowVelocity"].toDouble(parameters.inflowVelocity));
+	parameters.cfl = static_cast<float>(projection["cfl"].toDouble(parameters.cfl));
+	parameters.tolerance = static_cast<float>(projection["tolerance"].toDouble(parameters.tolerance));
+	parameters.maxCycles = projection["maxCycles"].toInt(parameters.maxCycles);
+	parameters.airDensity = static_cast<float>(projection["airDensity"].toDouble(parameters.airDensity));
+
+	if (parameters.inflowVelocity <= 0.0f || parameters.cfl <= 0.0f)
+		throw std::invalid_argument("The inflow velocity and the CFL number of the projection solver must be positive!");
+
+	return parameters;
+}
+
+ProjectionBackend::ProjectionBackend(const Parameters& parameters, int threads)
+	: m_parameters(parameters),
+	m_threads(threads),
+	m_resolution(0, 0, 0),
+	m_voxelSize(1.0f, 1.0f, 1.0f),
+	m_cellTypes(),
+	m_velocity(),
+	m_advected(),
+	m_faceTypes(),
+	m_inflowFace(CellClassifier::X_MIN),
+	m_multigrid(threads),
+	m_divergence(),
+	m_pressure(),
+	m_timeStep(0.0f),
+	m_maxVelocity(0.0f),
+	m_lastSolve(),
+	m_stepTime(0.0),
+	m_solveTime(0.0)
+{
+}
+
+size_t ProjectionBackend::faceIndex(int axis, int x, int y, int z) const
+{
+	const XMUINT3& r = m_resolution;
+	if (axis == 0)
+		return x + (r.x + 1) * (y + static_cast<size_t>(r.y) * z);
+	if (axis == 1)
+		return x + r.x * (y + static_cast<size_t>(r.y + 1) * z);
+	return x + r.x * (y + static_cast<size_t>(r.y) * z);
+}
+
+void ProjectionBackend::setGridDimension(const XMUINT3& resolution, const XMFLOAT3& voxelSize)
+{
+	// The divergence, the gradient and the Poisson stencil are in units of one cell size
+	const float tolerance = 1e-4f * voxelSize.x;
+	if (std::fabs(voxelSize.y - voxelSize.x) > tolerance || std::fabs(voxelSize.z - voxelSize.x) > tolerance)
+		throw std::invalid_argument("The projection solver needs cubic cells, adjust the grid size or the resolution of the voxel grid!");
+
+	m_resolution = resolution;
+	m_voxelSize = voxelSize;
+
+	size_t cells = static_cast<size_t>(resolution.x) * resolution.y * resolution.z;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		size_t faces = static_cast<size_t>(resolution.x + (axis == 0)) * (resolution.y + (axis == 1)) * (resolution.z + (axis == 2));
+		m_velocity[axis].assign(faces, 0.0f);
+		m_advected[axis].assign(faces, 0.0f);
+		m_faceTypes[axis].assign(faces, FACE_FREE);
+	}
+	m_divergence.assign(cells, 0.0f);
+	m_pressure.assign(cells, 0.0f);
+
+	// Without cell types everything is fluid
+	updateGrid(std::vector<wtl::CellType>(cells, wtl::CELL_TYPE_FLUID));
+	reset();
+}
+
+void ProjectionBackend::updateGrid(const std::vector<wtl::CellType>& cellTypes)
+{
+	if (cellTypes.size() != m_pressure.size())
+		throw std::invalid_argument("The number of cell types does not match the grid resolution!");
+
+	// The inflow velocity is normal to the grid face of an inflow cell; the solver stays as it was, if the grid is rejected
+	CellClassifier::Face inflowFace = CellClassifier::X_MIN;
+	bool firstInflow = true;
+	for (uint32_t z = 0; z < m_resolution.z; ++z)
+	{
+		for (uint32_t y = 0; y < m_resolution.y; ++y)
+		{
+			for (uint32_t x = 0; x < m_resolution.x; ++x)
+			{
+				if (cellTypes[cellIndex(x, y, z)] != wtl::CELL_TYPE_INFLOW)
+					continue;
+
+				CellClassifier::Face face = CellClassifier::faceOf(cellTypes.data(), m_resolution, x, y, z);
+				if (face == CellClassifier::NUM_FACES)
+					throw std::invalid_argument("The projection solver supports inflow cells only on the faces of the grid!");
+				if (firstInflow)
+					inflowFace = face;
+				firstInflow = false;
+			}
+		}
+	}
+
+	m_inflowFace = inflowFace;
+	m_cellTypes = cellTypes;
+	buildFaceTypes();
+
+	std::vector<MultigridSolver::Cell> cells(m_cellTypes.size());
+	for (size_t i = 0; i < cells.size(); ++i)
+	{
+		wtl::CellType type = m_cellTypes[i];
+		cells[i] = type == wtl::CELL_TYPE_FLUID ? MultigridSolver::Cell::Interior : (type == wtl::CELL_TYPE_OUTFLOW ? MultigridSolver::Cell::Dirichlet : MultigridSolver::Cell::Neumann);
+		if (type != wtl::CELL_TYPE_FLUID)
+			m_pressure[i] = 0.0f;
+	}
+	m_multigrid.setDomain(cells, m_resolution);
+
+	applyBoundaries();
+}
+
+void ProjectionBackend::buildFaceTypes()
+{
+	const int res[3] = { static_cast<int>(m_resolution.x), static_cast<int>(m_resolution.y), static_cast<int>(m_resolution.z) };
+
+	auto type = [&](int x, int y, int z)
+	{
+		if (x < 0 || y < 0 || z < 0 || x >= res[0] || y >= res[1] || z >= res[2])
+			return OUTSIDE;
+		return static_cast<int>(m_cellTypes[cellIndex(x, y, z)]);
+	};
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const int d[3] = { axis == 0, axis == 1, axis == 2 };
+		Parallel::forRange(0, res[2] + d[2], [&](int zBegin, int zEnd)
+		{
+			for (int z = zBegin; z < zEnd; ++z)
+			{
+				for (int y = 0; y < res[1] + d[1]; ++y)
+				{
+					for (int x = 0; x < res[0] + d[0]; ++x)
+					{
+						int lower = type(x - d[0], y - d[1], z - d[2]);
+						int upper = type(x, y, z);
+
+						FaceType& face = m_faceTypes[axis][faceIndex(axis, x, y, z)];
+						if (isSolid(lower) || isSolid(upper))
+							face = FACE_WALL;
+						else if (lower == wtl::CELL_TYPE_INFLOW || upper == wtl::CELL_TYPE_INFLOW)
+						{
+							// Along the normal of the grid face of the inflow cell (the upper one, if both are inflow cells), zero otherwise
+							const bool isUpper = upper == wtl::CELL_TYPE_INFLOW;
+							const int cell[3] = { x - (isUpper ? 0 : d[0]), y - (isUpper ? 0 : d[1]), z - (isUpper ? 0 : d[2]) };
+							const CellClassifier::Face gridFace = CellClassifier::faceOf(m_cellTypes.data(), m_resolution, cell[0], cell[1], cell[2]);
+							if (gridFace / 2 != axis)
+								face = FACE_WALL;
+							else
+								face = gridFace % 2 == 0 ? FACE_INFLOW_POSITIVE : FACE_INFLOW_NEGATIVE;
+						}
+						else if (lower == OUTSIDE || upper == OUTSIDE)
+							face = (lower == wtl::CELL_TYPE_OUTFLOW || upper == wtl::CELL_TYPE_OUTFLOW) ? FACE_OPEN : FACE_WALL;
+						else
+							face = FACE_FREE;
+					}
+				}
+			}
+		}, m_threads);
+	}
+}
+
+void ProjectionBackend::applyBoundaries()
+{
+	const int res[3] = { static_cast<int>(m_resolution.x), static_cast<int>(m_resolution.y), static_cast<int>(m_resolution.z) };
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const int d[3] = { axis == 0, axis == 1, axis == 2 };
+		const float inflow = m_parameters.inflowVelocity;
+		std::vector<float>& velocity = m_velocity[axis];
+		const std::vector<FaceType>& types = m_faceTypes[axis];
+
+		Parallel::forRange(0, res[2] + d[2], [&](int zBegin, int zEnd)
+		{
+			for (int z = zBegin; z < zEnd; ++z)
+			{
+				for (int y = 0; y < res[1] + d[1]; ++y)
+				{
+					for (int x = 0; x < res[0] + d[0]; ++x)
+					{
+						size_t i = faceIndex(axis, x, y, z);
+						switch (types[i])
+						{
+						case FACE_WALL:
+							velocity[i] = 0.0f;
+							break;
+						case FACE_INFLOW_POSITIVE:
+							velocity[i] = inflow;
+							break;
+						case FACE_INFLOW_NEGATIVE:
+							velocity[i] = -inflow;
+							break;
+						case FACE_OPEN:
+						{
+							// Zero gradient: copy the face on the inner side of the outflow cell
+							int pos[3] = { x, y, z };
+							pos[axis] += pos[axis] == 0 ? 1 : -1;
+							velocity[i] = velocity[faceIndex(axis, pos[0], pos[1], pos[2])];
+							break;
+						}
+						default:
+							break;
+						}
+					}
+				}
+			}
+		}, m_threads);
+	}
+}
+
+float ProjectionBackend::sample(int axis, const std::vector<float>& field, float x, float y, float z) const
+{
+	// The component of an axis is stored on the faces: integer positions along the axis, cell centres along the others
+	const int dims[3] = { static_cast<int>(m_resolution.x) + (axis == 0), static_cast<int>(m_resolution.y) + (axis == 1), static_cast<int>(m_resolution.z) + (axis == 2) };
+	float pos[3] = { axis == 0 ? x : x - 0.5f, axis == 1 ? y : y - 0.5f, axis == 2 ? z : z - 0.5f };
+	int i0[3];
+	float t[3];
+	for (int a = 0; a < 3; ++a)
+	{
+		pos[a] = std::min(std::max(pos[a], 0.0f), static_cast<float>(dims[a] - 1));
+		i0[a] = std::min(static_cast<int>(pos[a]), std::max(dims[a] - 2, 0));
+		t[a] = dims[a] > 1 ? pos[a] - i0[a] : 0.0f;
+	}
+	const int i1[3] = { std::min(i0[0] + 1, dims[0] - 1), std::min(i0[1] + 1, dims[1] - 1), std::min(i0[2] + 1, dims[2] - 1) };
+
+	auto at = [&](int fx, int fy, int fz) { return field[faceIndex(axis, fx, fy, fz)]; };
+	float c00 = at(i0[0], i0[1], i0[2]) + t[0] * (at(i1[0], i0[1], i0[2]) - at(i0[0], i0[1], i0[2]));
+	float c10 = at(i0[0], i1[1], i0[2]) + t[0] * (at(i1[0], i1[1], i0[2]) - at(i0[0], i1[1], i0[2]));
+	float c01 = at(i0[0], i0[1], i1[2]) + t[0] * (at(i1[0], i0[1], i1[2]) - at(i0[0], i0[1], i1[2]));
+	float c11 = at(i0[0], i1[1], i1[2]) + t[0] * (at(i1[0], i1[1], i1[2]) - at(i0[0], i1[1], i1[2]));
+	float c0 = c00 + t[1] * (c10 - c00);
+	float c1 = c01 + t[1] * (c11 - c01);
+	return c0 + t[2] * (c1 - c0);
+}
+
+XMFLOAT3 ProjectionBackend::velocityAt(float x, float y, float z) const
+{
+	return XMFLOAT3(sample(0, m_velocity[0], x, y, z), sample(1, m_velocity[1], x, y, z), sample(2, m_velocity[2], x, y, z));
+}
+
+void ProjectionBackend::advect(float dt)
+{
+	const int res[3] = { static_cast<int>(m_resolution.x), static_cast<int>(m_resolution.y), static_cast<int>(m_resolution.z) };
+	const float scale[3] = { dt / m_voxelSize.x, dt / m_voxelSize.y, dt / m_voxelSize.z }; // m/s -> cells per step
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const int d[3] = { axis == 0, axis == 1, axis == 2 };
+		const std::vector<FaceType>& types = m_faceTypes[axis];
+
+		Parallel::forRange(0, res[2] + d[2], [&](int zBegin, int zEnd)
+		{
+			for (int z = zBegin; z < zEnd; ++z)
+			{
+				for (int y = 0; y < res[1] + d[1]; ++y)
+				{
+					for (int x = 0; x < res[0] + d[0]; ++x)
+					{
+						size_t i = faceIndex(axis, x, y, z);
+						if (types[i] != FACE_FREE)
+						{
+							m_advected[axis][i] = m_velocity[axis][i];
+							continue;
+						}
+
+						// Trace the face centre back along the flow
+						float px = axis == 0 ? static_cast<float>(x) : x + 0.5f;
+						float py = axis == 1 ? static_cast<float>(y) : y + 0.5f;
+						float pz = axis == 2 ? static_cast<float>(z) : z + 0.5f;
+						XMFLOAT3 v = velocityAt(px, py, pz);
+						m_advected[axis][i] = sample(axis, m_velocity[axis], px - scale[0] * v.x, py - scale[1] * v.y, pz - scale[2] * v.z);
+					}
+				}
+			}
+		}, m_threads);
+	}
+
+	for (int axis = 0; axis < 3; ++axis)
+		m_velocity[axis].swap(m_advected[axis]);
+}
+
+void ProjectionBackend::project(float dt)
+{
+	const int res[3] = { static_cast<int>(m_resolution.x), static_cast<int>(m_resolution.y), static_cast<int>(m_resolution.z) };
+
+	// Right hand side: negative net outflow of each fluid cell
+	Parallel::forRange(0, res[2], [&](int zBegin, int zEnd)
+	{
+		for (int z = zBegin; z < zEnd; ++z)
+		{
+			for (int y = 0; y < res[1]; ++y)
+			{
+				for (int x = 0; x < res[0]; ++x)
+				{
+					size_t c = cellIndex(x, y, z);
+					if (m_cellTypes[c] != wtl::CELL_TYPE_FLUID)
+					{
+						m_divergence[c] = 0.0f;
+						continue;
+					}
+					float div = m_velocity[0][faceIndex(0, x + 1, y, z)] - m_velocity[0][faceIndex(0, x, y, z)]
+						+ m_velocity[1][faceIndex(1, x, y + 1, z)] - m_velocity[1][faceIndex(1, x, y, z)]
+						+ m_velocity[2][faceIndex(2, x, y, z + 1)] - m_velocity[2][faceIndex(2, x, y, z)];
+					m_divergence[c] = -div;
+				}
+			}
+		}
+	}, m_threads);
+
+	QElapsedTimer timer;
+	timer.start();
+	m_lastSolve = m_multigrid.solve(m_divergence.data(), m_pressure.data(), m_parameters.tolerance, m_parameters.maxCycles);
+	m_solveTime = timer.nsecsElapsed() * 1e-6;
+
+	// Subtract the gradient; the solution is zero for all cells except the fluid cells
+	float maxVelocity = 0.0f;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const int d[3] = { axis == 0, axis == 1, axis == 2 };
+		std::vector<float>& velocity = m_velocity[axis];
+		const std::vector<FaceType>& types = m_faceTypes[axis];
+		std::vector<float> maxima(res[2] + d[2], 0.0f);
+
+		Parallel::forRange(0, res[2] + d[2], [&](int zBegin, int zEnd)
+		{
+			for (int z = zBegin; z < zEnd; ++z)
+			{
+				float maximum = 0.0f;
+				for (int y = 0; y < res[1] + d[1]; ++y)
+				{
+					for (int x = 0; x < res[0] + d[0]; ++x)
+					{
+						size_t i = faceIndex(axis, x, y, z);
+						if (types[i] == FACE_FREE)
+							velocity[i] -= m_pressure[cellIndex(x, y, z)] - m_pressure[cellIndex(x - d[0], y - d[1], z - d[2])];
+						maximum = std::max(maximum, std::abs(velocity[i]));
+					}
+				}
+				maxima[z] = maximum;
+			}
+		}, m_threads);
+
+		for (float m : maxima)
+			maxVelocity = std::max(maxVelocity, m);
+	}
+	m_maxVelocity = maxVelocity;
+
+	applyBoundaries();
+}
+
+float ProjectionBackend::step()
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	// Semi-Lagrangian advection is unconditionally stable, the CFL number only limits the numerical diffusion
+	const float cellSize = std::min(m_voxelSize.x, std::min(m_voxelSize.y, m_voxelSize.z));
+	m_timeStep = m_parameters.cfl * cellSize / std::max(m_maxVelocity, m_parameters.inflowVelocity);
+
+	applyBoundaries();
+	advect(m_timeStep);
+	applyBoundaries();
+	project(m_timeStep);
+
+	m_stepTime = timer.nsecsElapsed() * 1e-6;
+	return m_timeStep;
+}
+
+void ProjectionBackend::reset()
+{
+	// Uniform flow into the grid through the first inflow face
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float value = m_inflowFace / 2 == axis ? (m_inflowFace % 2 == 0 ? m_parameters.inflowVelocity : -m_parameters.inflowVelocity) : 0.0f;
+		std::fill(m_velocity[axis].begin(), m_velocity[axis].end(), value);
+	}
+	std::fill(m_pressure.begin(), m_pressure.end(), 0.0f);
+	m_maxVelocity = m_parameters.inflowVelocity;
+	m_timeStep = 0.0f;
+	applyBoundaries();
+}
+
+void ProjectionBackend::fillVelocity(std::vector<float>& velocity)
+{
+	fillVelocity(velocity.data(), velocity.size() / 4);
+}
+
+void ProjectionBackend::fillVelocity(float* velocity, size_t cells)
+{
+	Parallel::forRange(0, m_resolution.z, [&](int zBegin, int zEnd)
+	{
+		for (int z = zBegin; z < zEnd; ++z)
+		{
+			for (int y = 0; y < static_cast<int>(m_resolution.y); ++y)
+			{
+				for (int x = 0; x < static_cast<int>(m_resolution.x); ++x)
+				{
+					size_t c = cellIndex(x, y, z);
+					if (c >= cells)
+						return;
+					float* v = &velocity[4 * c];
+					v[3] = 0.0f;
+					if (isSolid(m_cellTypes[c]))
+					{
+						v[0] = v[1] = v[2] = 0.0f;
+						continue;
+					}
+					v[0] = 0.5f * (m_velocity[0][faceIndex(0, x, y, z)] + m_velocity[0][faceIndex(0, x + 1, y, z)]);
+					v[1] = 0.5f * (m_velocity[1][faceIndex(1, x, y, z)] + m_velocity[1][faceIndex(1, x, y + 1, z)]);
+					v[2] = 0.5f * (m_velocity[2][faceIndex(2, x, y, z)] + m_velocity[2][faceIndex(2, x, y, z + 1)]);
+				}
+			}
+		}
+	}, m_threads);
+}
+
+void ProjectionBackend::fillPressure(std::vector<float>& pressure)
+{
+	fillPressure(pressure.data(), pressure.size());
+}
+
+void ProjectionBackend::fillPressure(float* pressure, size_t cells)
+{
+	// The solution is the velocity change across a face: p = rho * dx / dt * solution (the cells are cubes)
+	const float scale = m_timeStep > 0.0f ? m_parameters.airDensity * m_voxelSize.x / m_timeStep : 0.0f;
+	const size_t filled = std::min(cells, m_pressure.size());
+	for (size_t i = 0; i < filled; ++i)
+		pressure[i] = scale * m_pressure[i];
+	std::fill(pressure + filled, pressure + cells, 0.0f);
+}
+
+std::string ProjectionBackend::getStats()
+{
+	std::stringstream ss;
+	ss << getName() << ": " << std::fixed << std::setprecision(1) << m_stepTime << " ms/step (pressure solve " << m_solveTime << " ms)\n";
+	ss << "Multigrid: " << m_multigrid.getNumLevels() << " levels, " << m_lastSolve.cycles << " V-cycles, residual " << std::scientific << std::setprecision(1) << m_lastSolve.residual
+		<< ", " << std::fixed << std::setprecision(2) << m_lastSolve.convergence << " reduction per V-cycle\n";
+	return ss.str();
+}
+
+size_t ProjectionBackend::getStateSize() const
+{
+	// Face velocities of all axes, the pressure (warm start of the next solve), the maximum velocity (next time step) and the last
+	// time step (pressure scale)
+	return (m_velocity[0].size() + m_velocity[1].size() + m_velocity[2].size() + m_pressure.size() + 2) * sizeof(float);
+}
+
+void ProjectionBackend::saveState(char* state) const
+{
+	float* out = reinterpret_cast<float*>(state);
+	for (int axis = 0; axis < 3; ++axis)
+		out = std::copy(m_velocity[axis].begin(), m_velocity[axis].end(), out);
+	out = std::copy(m_pressure.begin(), m_pressure.end(), out);
+	*out++ = m_maxVelocity;
+	*out = m_timeStep;
+}
+
+bool ProjectionBackend::restoreState(const char* state, size_t size)
+{
+	if (size != getStateSize())
+		return false;
+
+	const float* in = reinterpret_cast<const float*>(state);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		std::copy(in, in + m_velocity[axis].size(), m_velocity[axis].begin());
+		in += m_velocity[axis].size();
+	}
+	std::copy(in, in + m_pressure.size(), m_pressure.begin());
+	in += m_pressure.size();
+	m_maxVelocity = *in++;
+	m_timeStep = *in;
+	return true;
+}
@@ -0,0 +1,99 @@
+#ifndef PROJECTION_BACKEND_H
+#define PROJECTION_BACKEND_H
+
+#include "solverBackend.h"
+#include "multigridSolver.h"
+#include "cellClassifier.h"
+
+#include <vector>
+#include <cstdint>
+
+// Native CPU solver for incompressible flow with Chorin's projection method on a staggered (MAC) grid
+// Each step advects the face velocities semi-Lagrangian and projects them onto a divergence free field;
+// the pressure Poisson equation is solved with MultigridSolver, warm started with the pressure of the last step
+// Fluid cells are the unknowns, outflow cells have zero pressure, inflow cells prescribe the inflow velocity along the inward
+// normal of their grid face and solid faces have zero normal velocity (so all solids act as slip walls)
+// The cells must be cubes: the Poisson stencil of MultigridSolver has the same weight along all axes
+class ProjectionBackend : public SolverBackend
+{
+public:
+	struct Parameters
+	{
+		Parameters();
+		float inflowVelocity; // m/s into the grid, normal to the inflow faces
+		float cfl; // Time step as a multiple of the time the fastest flow needs to cross one cell
+		float tolerance; // Relative residual of the pressure solve
+		int maxCycles; // Upper bound of V-cycles per step
+		float airDensity; // kg/m^3, scales the pressure
+	};
+
+	// Reads the optional "projection" object of the JSON settings file (keys as in Parameters)
+	static Parameters readParameters(const std::string& settingsFile);
+
+	ProjectionBackend(const Parameters& parameters, int threads = 0);
+
+	std::string getName() const override { return "CPU Projection (Multigrid)"; };
+
+	void setGridDimension(const DirectX::XMUINT3& resolution, const DirectX::XMFLOAT3& voxelSize) override;
+	void updateGrid(const std::vector<wtl::CellType>& cellTypes) override;
+	float step() override;
+	void reset() override;
+
+	void fillVelocity(std::vector<float>& velocity) override;
+	void fillPressure(std::vector<float>& pressure) override;
+	void fillVelocity(float* velocity, size_t cells) override;
+	void fillPressure(float* pressure, size_t cells) override;
+
+	std::string getStats() override;
+
+	size_t getStateSize() const override;
+	void saveState(char* state) const override;
+	bool restoreState(const char* state, size_t size) override;
+
+	const MultigridSolver::Result& getLastSolve() const { return m_lastSolve; };
+
+private:
+	// Treatment of a face velocity
+	enum FaceType : uint8_t
+	{
+		FACE_FREE = 0, // Advected and projected
+		FACE_WALL, // Zero (solid on either side, or an inflow cell along the axes tangential to its grid face)
+		FACE_INFLOW_POSITIVE, // Inflow velocity along +axis (inflow cell on the lower grid face of the axis)
+		FACE_INFLOW_NEGATIVE, // Inflow velocity along -axis (inflow cell on the upper grid face of the axis)
+		FACE_OPEN // Grid boundary next to an outflow cell: copies the next inner face
+	};
+
+	size_t cellIndex(int x, int y, int z) const { return x + m_resolution.x * (y + static_cast<size_t>(m_resolution.y) * z); };
+	size_t faceIndex(int axis, int x, int y, int z) const; // Face below the cell along the axis
+
+	void buildFaceTypes();
+	void applyBoundaries();
+	void advect(float dt);
+	void project(float dt);
+	float sample(int axis, const std::vector<float>& field, float x, float y, float z) const; // Trilinear, position in cells
+	DirectX::XMFLOAT3 velocityAt(float x, float y, float z) const;
+
+	Parameters m_parameters;
+	int m_threads;
+
+	DirectX::XMUINT3 m_resolution;
+	DirectX::XMFLOAT3 m_voxelSize;
+
+	std::vector<wtl::CellType> m_cellTypes;
+	std::vector<float> m_velocity[3]; // Face velocities in m/s: (res.x + 1) * res.y * res.z for x, ...
+	std::vector<float> m_advected[3];
+	std::vector<FaceType> m_faceTypes[3];
+	CellClassifier::Face m_inflowFace; // Of the first inflow cell, the initial flow direction
+
+	MultigridSolver m_multigrid;
+	std::vector<float> m_divergence;
+	std::vector<float> m_pressure; // Solution of the Poisson equation: velocity change per cell
+	float m_timeStep;
+	float m_maxVelocity;
+
+	MultigridSolver::Result m_lastSolve;
+	double m_stepTime; // msec
+	double m_solveTime; // msec
+};
+
+#endif
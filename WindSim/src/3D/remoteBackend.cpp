@@ -0,0 +1,361 @@
+#include "remoteBackend.h"
+#include "settings.h"
+#include "logger.h"
+
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+
+using namespace DirectX;
+using namespace wtl;
+
+RemoteBackend::RemoteBackend(const std::string& hostProgram, const std::string& settingsFile, SolverType solver, int threads, int timeout, Logger* logger)
+	: m_program(hostProgram),
+	m_settingsFile(settingsFile),
+	m_solver(solver),
+	m_threads(threads),
+	m_timeout(timeout > 0 ? timeout : -1),
+	m_logger(logger),
+	m_process(),
+	m_transport(Transport::create()),
+	m_message(),
+	m_running(false),
+	m_name(),
+	m_resolution(0, 0, 0),
+	m_voxelSize(0.0f, 0.0f, 0.0f),
+	m_hasDimensions(false),
+	m_hasGrid(false),
+	m_smoke(),
+	m_hasSmoke(false),
+	m_lines(),
+	m_hasLines(false),
+	m_shm(),
+	m_layout(),
+	m_lineBufferSize(0),
+	m_requested(),
+	m_ready(),
+	m_current(-1),
+	m_viewed(-1),
+	m_stats()
+{
+	startHost();
+}
+
+RemoteBackend::~RemoteBackend()
+{
+	if (m_running && send(MsgToSimProc::Exit))
+	{
+		// Give the solver the chance to release its device; the receive fails when the host exited
+		m_transport->receive(m_message, 2000);
+	}
+	m_process.kill();
+	m_transport->close();
+}
+
+std::string RemoteBackend::getName() const
+{
+	return (m_name.empty() ? "Unknown solver" : m_name) + " (simulation host)";
+}
+
+void RemoteBackend::setGridDimension(const XMUINT3& resolution, const XMFLOAT3& voxelSize)
+{
+	m_resolution = resolution;
+	m_voxelSize = voxelSize;
+	m_hasDimensions = true;
+	m_hasGrid = false;
+
+	// A host, which failed meanwhile, is restarted with the new dimensions
+	if (m_running && dropSteps() && (!m_shm.isOpen() || (send(MsgToSimProc::CloseShm) && await(MsgFromSimProc::ClosedShm))) && initDimensions())
+		return;
+	startHost();
+}
+
+void RemoteBackend::updateGrid(const std::vector<CellType>& cellTypes)
+{
+	if (!m_shm.isOpen() || cellTypes.size() != m_layout.numCells)
+		return;
+
+	// Steps, which the host computed ahead with the old cell types, are discarded; a host, which fails meanwhile, is stopped
+	if (m_running)
+		dropSteps();
+
+	// The host reads the cell types only while it handles the request; a host, which is down, gets them when it is restarted
+	std::memcpy(m_shm.data() + m_layout.cellTypesOffset, cellTypes.data(), cellTypes.size() * sizeof(CellType));
+	m_hasGrid = true;
+	if (m_running && send(MsgToSimProc::UpdateGrid))
+		await(MsgFromSimProc::FinishedVoxelGridAccess);
+}
+
+float RemoteBackend::step()
+{
+	if (!m_running || !m_shm.isOpen() || !requestSteps())
+		return 0.0f;
+
+	while (m_ready.empty())
+	{
+		if (!await(MsgFromSimProc::FinishedVelocityAccess))
+			return 0.0f;
+	}
+
+	Step step = m_ready.front();
+	m_ready.pop_front();
+	m_current = step.slot;
+	m_stats = step.stats;
+
+	// Keep the host busy while the caller processes this step
+	requestSteps();
+	return step.timeStep;
+}
+
+void RemoteBackend::reset()
+{
+	if (m_running && dropSteps() && send(MsgToSimProc::Reset))
+		return;
+	// The restarted host got the cell types from the shared memory, so the flow starts over with them
+	if (startHost())
+		send(MsgToSimProc::Reset);
+}
+
+void RemoteBackend::fillVelocity(std::vector<float>& velocity)
+{
+	if (m_current < 0)
+		std::fill(velocity.begin(), velocity.end(), 0.0f);
+	else
+		std::memcpy(velocity.data(), slot(m_current) + m_layout.velocityOffset, std::min<size_t>(velocity.size(), m_layout.numCells * 4) * sizeof(float));
+}
+
+void RemoteBackend::fillPressure(std::vector<float>& pressure)
+{
+	if (m_current < 0)
+		std::fill(pressure.begin(), pressure.end(), 0.0f);
+	else
+		std::memcpy(pressure.data(), slot(m_current) + m_layout.pressureOffset, std::min<size_t>(pressure.size(), m_layout.numCells) * sizeof(float));
+}
+
+void RemoteBackend::fillDensity(std::vector<float>& density, std::vector<float>& densitySum)
+{
+	if (m_current < 0 || !slotHeader()->density)
+	{
+		SolverBackend::fillDensity(density, densitySum);
+		return;
+	}
+	std::memcpy(density.data(), slot(m_current) + m_layout.densityOffset, std::min<size_t>(density.size(), m_layout.numCells) * sizeof(float));
+	std::memcpy(densitySum.data(), slot(m_current) + m_layout.densitySumOffset, std::min<size_t>(densitySum.size(), m_layout.numCells) * sizeof(float));
+}
+
+bool RemoteBackend::viewFields(FieldView& view)
+{
+	if (!m_running || m_current < 0)
+		return false;
+
+	// The slot of the previous view is free for the host from now on
+	m_viewed = m_current;
+	view.velocity = reinterpret_cast<const float*>(slot(m_current) + m_layout.velocityOffset);
+	view.pressure = reinterpret_cast<const float*>(slot(m_current) + m_layout.pressureOffset);
+	return true;
+}
+
+void RemoteBackend::setSmokeSettings(const SmokeSettings& settings)
+{
+	m_smoke = settings;
+	m_hasSmoke = true;
+	if (m_running)
+		send(MsgToSimProc::SmokeSettings, &settings, sizeof(settings));
+}
+
+void RemoteBackend::setLineSettings(const LineSettings& settings)
+{
+	m_lines = settings;
+	m_hasLines = true;
+	if (m_running)
+		send(MsgToSimProc::LineSettings, &settings, sizeof(settings));
+}
+
+void RemoteBackend::fillLines(std::vector<char>& lines, int& reseedCounter, int& numLines)
+{
+	if (m_current < 0 || !slotHeader()->lines)
+	{
+		numLines = 0;
+		return;
+	}
+	std::memcpy(lines.data(), slot(m_current) + m_layout.linesOffset, std::min<size_t>(lines.size(), m_layout.lineBufferSize));
+	reseedCounter = slotHeader()->reseedCounter;
+	numLines = slotHeader()->numLines;
+}
+
+std::string RemoteBackend::getStats()
+{
+	if (!m_running)
+		return "Simulation host stopped, reset the simulation to restart it\n";
+	return m_stats;
+}
+
+bool RemoteBackend::startHost()
+{
+	m_process.kill();
+	m_running = false;
+	m_requested.clear();
+	m_ready.clear();
+	m_current = m_viewed = -1;
+
+	log("INFO: Starting simulation host '" + m_program + "' ...");
+	std::string endpoint = SharedMemory::uniqueName("windsim-host");
+	if (!m_transport->listen(endpoint))
+		return fail(m_transport->errorString());
+	if (!m_process.start(m_program, std::vector<std::string>(1, endpoint)))
+		return fail(m_process.errorString());
+
+	// Do not wait for the timeout if the host exits right away, e.g. because of a missing library
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(m_timeout, 0));
+	while (!m_transport->accept(100))
+	{
+		if (!m_process.isRunning())
+			return fail("The host exited before it connected.");
+		if (m_timeout >= 0 && std::chrono::steady_clock::now() >= deadline)
+			return fail("The host did not connect within " + std::to_string(m_timeout) + " ms.");
+	}
+	m_running = true;
+
+	std::string payload(sizeof(SimProcInit), '\0');
+	SimProcInit init = { static_cast<uint32_t>(m_solver), m_threads, conf.opencl.platform, conf.opencl.device };
+	std::memcpy(&payload[0], &init, sizeof(init));
+	payload += m_settingsFile;
+	if (!send(MsgToSimProc::InitSim, payload.data(), payload.size()) || !await(MsgFromSimProc::Initialized, &m_name))
+		return false;
+
+	if (m_hasDimensions && !initDimensions())
+		return false;
+	if (m_hasSmoke && !send(MsgToSimProc::SmokeSettings, &m_smoke, sizeof(m_smoke)))
+		return false;
+	if (m_hasLines && !send(MsgToSimProc::LineSettings, &m_lines, sizeof(m_lines)))
+		return false;
+
+	// The cell types survive in the shared memory unless it was reallocated for a new layout, also if the host fails again
+	if (m_hasGrid && m_shm.isOpen() && send(MsgToSimProc::UpdateGrid))
+		await(MsgFromSimProc::FinishedVoxelGridAccess);
+
+	log("INFO: Simulation host runs '" + m_name + "'.");
+	return m_running;
+}
+
+bool RemoteBackend::initDimensions()
+{
+	m_requested.clear();
+	m_ready.clear();
+	m_current = m_viewed = -1;
+
+	SimProcDimensions dimensions = { { m_resolution.x, m_resolution.y, m_resolution.z }, { m_voxelSize.x, m_voxelSize.y, m_voxelSize.z }, 0 };
+	std::string answer;
+	if (!send(MsgToSimProc::UpdateDimensions, &dimensions, sizeof(dimensions)) || !await(MsgFromSimProc::Initialized, &answer))
+		return false;
+	if (answer.size() != sizeof(dimensions))
+		return fail("Invalid answer to the grid dimensions.");
+	std::memcpy(&dimensions, answer.data(), sizeof(dimensions));
+	m_lineBufferSize = std::max(dimensions.lineBufferSize, 0);
+
+	// Reuse the memory if the layout did not change, e.g. when the host is restarted
+	uint64_t numCells = static_cast<uint64_t>(m_resolution.x) * m_resolution.y * m_resolution.z;
+	SimShmHeader layout = simShmLayout(numCells, m_lineBufferSize, NUM_SLOTS);
+	if (!m_shm.isOpen() || layout.numCells != m_layout.numCells || layout.lineBufferSize != m_layout.lineBufferSize)
+	{
+		m_shm.close();
+		m_hasGrid = false;
+		if (!m_shm.create(SharedMemory::uniqueName("windsim-sim"), simShmSize(layout)))
+			return fail(m_shm.errorString());
+		std::memcpy(m_shm.data(), &layout, sizeof(layout));
+		m_layout = layout;
+	}
+
+	return send(MsgToSimProc::OpenShm, m_shm.getName().data(), m_shm.getName().size()) && await(MsgFromSimProc::OpenedShm);
+}
+
+bool RemoteBackend::send(MsgToSimProc type, const void* payload, size_t size)
+{
+	// Batched by the transport until the next await()
+	if (!m_transport->send(static_cast<uint32_t>(type), payload, size))
+		return fail(m_transport->errorString());
+	return true;
+}
+
+bool RemoteBackend::await(MsgFromSimProc type, std::string* payload)
+{
+	for (;;)
+	{
+		if (!m_transport->receive(m_message, m_timeout))
+			return fail(m_transport->errorString());
+
+		MsgFromSimProc answer = static_cast<MsgFromSimProc>(m_message.type);
+		if (answer == MsgFromSimProc::Error)
+			return fail(std::string(m_message.data(), m_message.size));
+
+		if (answer == MsgFromSimProc::FinishedVelocityAccess)
+		{
+			SimProcFilled filled;
+			if (m_message.size < sizeof(filled) || m_requested.empty())
+				return fail("Unexpected answer to a step.");
+			std::memcpy(&filled, m_message.data(), sizeof(filled));
+			if (static_cast<int>(filled.slot) != m_requested.front())
+				return fail("The steps were answered out of order.");
+
+			Step step = { m_requested.front(), filled.timeStep, std::string(m_message.data() + sizeof(filled), m_message.size - sizeof(filled)) };
+			m_requested.pop_front();
+			m_ready.push_back(step);
+			if (type == answer)
+				return true;
+			continue;
+		}
+
+		if (answer != type)
+			return fail("Unexpected answer " + std::to_string(m_message.type) + " to request " + std::to_string(static_cast<int>(type)) + ".");
+		if (payload)
+			payload->assign(m_message.data(), m_message.size);
+		return true;
+	}
+}
+
+bool RemoteBackend::requestSteps()
+{
+	for (int i = 0; i < NUM_SLOTS; ++i)
+	{
+		bool used = i == m_current || i == m_viewed || std::find(m_requested.begin(), m_requested.end(), i) != m_requested.end();
+		for (const Step& step : m_ready)
+			used |= step.slot == i;
+		if (used)
+			continue;
+
+		SimProcFill fill = { static_cast<uint32_t>(i), m_hasSmoke && m_smoke.enabled, m_hasLines && m_lines.enabled };
+		if (!send(MsgToSimProc::FillVelocity, &fill, sizeof(fill)))
+			return false;
+		m_requested.push_back(i);
+	}
+	return true;
+}
+
+bool RemoteBackend::dropSteps()
+{
+	while (!m_requested.empty())
+	{
+		if (!await(MsgFromSimProc::FinishedVelocityAccess))
+			return false;
+	}
+	m_ready.clear();
+	return true;
+}
+
+bool RemoteBackend::fail(const std::string& msg)
+{
+	log("ERROR: Simulation host: " + msg);
+	m_process.kill();
+	m_transport->close();
+	m_running = false;
+	m_requested.clear();
+	m_ready.clear();
+	m_current = -1;
+	return false;
+}
+
+void RemoteBackend::log(const std::string& msg)
+{
+	if (m_logger)
+		m_logger->logit(QString::fromStdString(msg));
+}
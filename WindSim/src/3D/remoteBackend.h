@@ -0,0 +1,101 @@
+#ifndef REMOTE_BACKEND_H
+#define REMOTE_BACKEND_H
+
+#include "solverBackend.h"
+#include "common.h"
+#include "msgDef.h"
+#include "sharedMemory.h"
+#include "childProcess.h"
+#include "transport.h"
+
+#include <deque>
+
+class Logger;
+
+// Runs a solver in the simulation host process (WindSimHost), so a crash of the solver or its OpenCL driver only ends the host
+// The requests go through a Transport, the cell types and the results of the steps through shared memory owned by this process (see msgDef.h); the host computes
+// the next steps into free slots while the last one is rendered; after a crash or timeout the fields stay zero until reset() or
+// setGridDimension() restart the host
+class RemoteBackend : public SolverBackend
+{
+public:
+	// <timeout>: maximum time for an answer of the host in ms, e.g. a step; 0 waits forever
+	RemoteBackend(const std::string& hostProgram, const std::string& settingsFile, SolverType solver, int threads, int timeout, Logger* logger);
+	~RemoteBackend();
+
+	std::string getName() const override;
+
+	void setGridDimension(const DirectX::XMUINT3& resolution, const DirectX::XMFLOAT3& voxelSize) override;
+	void updateGrid(const std::vector<wtl::CellType>& cellTypes) override;
+	float step() override;
+	void reset() override;
+
+	void fillVelocity(std::vector<float>& velocity) override;
+	void fillPressure(std::vector<float>& pressure) override;
+	void fillDensity(std::vector<float>& density, std::vector<float>& densitySum) override;
+	bool viewFields(FieldView& view) override;
+
+	void setSmokeSettings(const SmokeSettings& settings) override;
+	void setLineSettings(const LineSettings& settings) override;
+	int getLineBufferSize() override { return m_lineBufferSize; };
+	void fillLines(std::vector<char>& lines, int& reseedCounter, int& numLines) override;
+
+	std::string getStats() override;
+
+private:
+	static const int NUM_SLOTS = 3; // The rendered step, the last step and one computed ahead
+
+	struct Step
+	{
+		int slot;
+		float timeStep;
+		std::string stats;
+	};
+
+	bool startHost(); // Restores the dimensions, cell types and settings of the last host
+	bool initDimensions();
+	bool send(MsgToSimProc type, const void* payload = nullptr, size_t size = 0);
+	bool await(MsgFromSimProc type, std::string* payload = nullptr); // Queues the answers of steps in between
+	bool requestSteps(); // Requests a step for every free slot
+	bool dropSteps(); // Waits for the requested steps and discards them
+	bool fail(const std::string& msg); // Stops the host
+	void log(const std::string& msg);
+
+	const char* slot(int index) const { return m_shm.data() + m_layout.slotOffset + index * m_layout.slotSize; };
+	const SimShmSlot* slotHeader() const { return reinterpret_cast<const SimShmSlot*>(slot(m_current)); };
+
+	std::string m_program;
+	std::string m_settingsFile;
+	SolverType m_solver;
+	int m_threads;
+	int m_timeout;
+	Logger* m_logger;
+
+	ChildProcess m_process;
+	std::unique_ptr<Transport> m_transport;
+	Transport::Message m_message; // Reused, so the payloads come from the pool of the transport
+	bool m_running; // The host is started and did not fail
+	std::string m_name; // Solver name reported by the host
+
+	// State, which is restored when the host is restarted
+	DirectX::XMUINT3 m_resolution;
+	DirectX::XMFLOAT3 m_voxelSize;
+	bool m_hasDimensions;
+	bool m_hasGrid; // The cell types in the shared memory are valid
+	SmokeSettings m_smoke;
+	bool m_hasSmoke;
+	LineSettings m_lines;
+	bool m_hasLines;
+
+	SharedMemory m_shm;
+	SimShmHeader m_layout;
+	int m_lineBufferSize;
+
+	std::deque<int> m_requested; // Slots of the steps, the host works on, oldest first
+	std::deque<Step> m_ready; // Answered steps, which were not returned by step() yet
+	int m_current; // Slot of the last step, -1 if none
+	int m_viewed; // Slot exposed by viewFields, -1 if none
+	std::string m_stats;
+};
+
+#endif
@@ -152,7 +152,7 @@ float computeSecondLargestEigenvalue(in float3x3 m)
 	}
 
 	// Return second largest eigenvalue
-	int second;
+	float second;
 	if (m11 < m22)
 	{
 		if (m22 < m33) second = m22;
@@ -1,13 +1,25 @@
 #include "simulator.h"
 #include "dx11Renderer.h"
 #include "settings.h"
+#include "windTunnelBackend.h"
+#include "lbmBackend.h"
+#include "projectionBackend.h"
+#include "remoteBackend.h"
 
 #include <QThread>
+#include <QFile>
+#include <QDir>
+#include <QCoreApplication>
 
 #include <DirectXMath.h>
 
 #include <Windows.h>
 
+#include <cstring>
+#include <stdexcept>
+#include <cstdint>
+#include <algorithm>
+
 using namespace DirectX;
 
 using namespace wtl;
@@ -15,12 +27,50 @@ using namespace wtl;
 const int stepTimesSaved = 20;
 const float stepTimesWeight = 1.0 / stepTimesSaved;
 
+namespace
+{
+	// Checkpoint file layout: header, cell types, solver state and dynamics records; the sections start at cache line boundaries
+	const char CHECKPOINT_MAGIC[8] = "WSCHKPT";
+	const uint32_t CHECKPOINT_VERSION = 2;
+	const uint64_t CHECKPOINT_ALIGNMENT = 64;
+
+	struct CheckpointHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t resolution[3];
+		float voxelSize[3];
+		float time;
+		int32_t stepCount;
+		char solver[64];
+		uint64_t cellTypesOffset;
+		uint64_t stateOffset;
+		uint64_t stateSize;
+		uint64_t dynamicsOffset;
+		uint64_t numDynamics;
+	};
+
+	struct CheckpointDynamics
+	{
+		char name[64];
+		Dynamics::State state;
+	};
+
+	uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + CHECKPOINT_ALIGNMENT - 1) & ~(CHECKPOINT_ALIGNMENT - 1);
+	}
+}
+
 QMutex Simulator::m_openCLMutex;
 int Simulator::m_clDevice = -2;
 int Simulator::m_clPlatform = -2;
 
 bool Simulator::initOpenCLNecessary()
 {
+	if (conf.sim.solver != SolverType::OpenCL)
+		return false;
+
 	return (conf.opencl.device != m_clDevice || conf.opencl.platform != m_clPlatform);
 }
 
@@ -57,19 +107,24 @@ QJsonObject Simulator::getLineSettingsDefault()
 
 Simulator::Simulator(const QString& settingsFile, const XMUINT3& resolution, const XMFLOAT3& voxelSize, DX11Renderer* renderer, QObject* parent)
 	: QObject(parent)
-	, m_windTunnel()
+	, m_solver()
+	, m_checkpoints(false)
+	, m_solverReady(false)
 	, m_settingsFile(settingsFile)
 	, m_smokeSettingsGUI(getSmokeSettingsDefault())
 	, m_lineSettingsGUI(getLineSettingsDefault())
 	, m_cellTypes()
-	, m_velocity()
-	, m_pressure()
-	, m_density()
+	, m_solverCellTypes()
+	, m_bufferPool()
+	, m_buffers()
+	, m_fields()
 	, m_densitySum()
 	, m_lines()
 	, m_reseedCounter(0)
 	, m_numLines(0)
 	, m_timeStep(0.0)
+	, m_stepCount(0)
+	, m_simTime(0.0)
 	, m_resolution(resolution)
 	, m_voxelSize(voxelSize)
 	, m_simSmoke(true)
@@ -82,7 +137,10 @@ Simulator::Simulator(const QString& settingsFile, const XMUINT3& resolution, con
 	, m_skipSteps(false)
 	, m_simRunning()
 	, m_simulatorLock(m_simRunning, std::defer_lock)
+	, m_stepListeners()
+	, m_stepListenerMutex()
 	, m_renderer(renderer)
+	, m_signals(nullptr)
 	, m_stepTimer()
 	, m_totalStepTimes(stepTimesSaved, 0.0)
 {
@@ -112,8 +170,9 @@ void Simulator::reinitWindTunnel()
 	log("INFO: Reinitializing WindTunnel...");
 	// Silently recreate windtunnel with the existing settings
 	// Necessary when the static OpenCL context and queue are recreated
-	m_windTunnel = WindTunnel(m_settingsFile.toStdString());
-	m_windTunnel.setGridDimension(m_resolution, m_voxelSize);
+	m_solver = createSolver(m_settingsFile);
+	m_solver->setGridDimension(m_resolution, m_voxelSize);
+	m_checkpoints = m_solver->getStateSize() > 0;
 	changeSmokeSettings(m_smokeSettingsGUI);
 	changeLineSettings(m_lineSettingsGUI);
 	log("INFO: Done.");
@@ -148,16 +207,59 @@ void Simulator::pause()
 		m_simulatorLock.unlock();
 }
 
-void Simulator::changeSimSettings(const QString& settingsFile)
+void Simulator::changeSimSettings(const QString& settingsFile, bool keepFlow)
 {
+	// Snapshot the state, which the new solver continues from; the solver type is chosen by settings.ini and does not change with the settings file
+	std::vector<char> state(keepFlow ? m_solver->getStateSize() : 0);
+	std::vector<wtl::CellType> cellTypes;
+	const std::string solver = m_solver->getName();
+	const int stepCount = m_stepCount;
+	const double simTime = m_simTime;
+	if (!state.empty())
+	{
+		m_solver->saveState(state.data());
+		cellTypes = m_solverCellTypes;
+	}
+	else if (keepFlow)
+	{
+		log("INFO: The solver '" + QString::fromStdString(solver) + "' does not support checkpoints, the flow restarts from rest.");
+	}
+
 	createWindTunnel(settingsFile);
 	setGridDimension(m_resolution, m_voxelSize);
+
+	if (state.empty() || !m_solverReady)
+		return;
+
+	// The state of the solver refers to its cell types, so they are restored first (as by loadCheckpoint)
+	if (m_solver->getName() != solver || m_solver->getStateSize() != state.size())
+	{
+		log("WARNING: The solver changed to '" + QString::fromStdString(m_solver->getName()) + "', the flow restarts from rest.");
+		return;
+	}
+	m_solver->updateGrid(cellTypes);
+	m_solverCellTypes = cellTypes;
+	if (!m_solver->restoreState(state.data(), state.size()))
+	{
+		log("WARNING: The solver state could not be restored, the flow restarts from rest.");
+		m_solver->reset();
+		return;
+	}
+	m_stepCount = stepCount;
+	m_simTime = simTime;
+	fillFields();
+	log("INFO: Kept the flow across the settings reload (simulated time " + QString::number(m_simTime) + "s).");
 }
 
 void Simulator::resetSimulation()
 {
+	if (!m_solverReady)
+		return;
+
 	log("INFO: Reset WindTunnel.");
-	m_windTunnel.reset();
+	m_solver->reset();
+	m_stepCount = 0;
+	m_simTime = 0.0;
 }
 
 void Simulator::createWindTunnel(const QString& settingsFile)
@@ -165,7 +267,56 @@ void Simulator::createWindTunnel(const QString& settingsFile)
 	// Only create one windtunnel at a time (releasing windtunnel includes opencl operations)
 	QMutexLocker lock(&m_openCLMutex);
 	log("INFO: Create virtual WindTunnel with settings file '" + settingsFile + "'.");
-	m_windTunnel = WindTunnel(settingsFile.toStdString()); // Move assignment
+	m_solver = createSolver(settingsFile);
+	m_settingsFile = settingsFile;
+	log("INFO: Solver: " + QString::fromStdString(m_solver->getName()));
+}
+
+std::unique_ptr<SolverBackend> Simulator::createSolver(const QString& settingsFile) const
+{
+	if (conf.sim.outOfProcess)
+	{
+		QString host = QDir(QCoreApplication::applicationDirPath()).filePath("WindSimHost.exe");
+		return std::unique_ptr<SolverBackend>(new RemoteBackend(QDir::toNativeSeparators(host).toStdString(), settingsFile.toStdString(), conf.sim.solver, conf.cpu.threads, conf.sim.hostTimeout, m_renderer->getLogger()));
+	}
+
+	if (conf.sim.solver == SolverType::CpuLbm)
+		return std::unique_ptr<SolverBackend>(new LbmBackend(LbmBackend::readParameters(settingsFile.toStdString()), conf.cpu.threads));
+	if (conf.sim.solver == SolverType::CpuProjection)
+		return std::unique_ptr<SolverBackend>(new ProjectionBackend(ProjectionBackend::readParameters(settingsFile.toStdString()), conf.cpu.threads));
+
+	return std::unique_ptr<SolverBackend>(new WindTunnelBackend(settingsFile.toStdString()));
+}
+
+void Simulator::fillFields()
+{
+	m_buffers = nextBuffers();
+	m_solver->fillVelocity(m_buffers->velocity);
+	m_solver->fillPressure(m_buffers->pressure);
+	m_solver->fillDensity(m_buffers->density, m_densitySum);
+	m_fields.velocity = m_buffers->velocity.data();
+	m_fields.pressure = m_buffers->pressure.data();
+}
+
+std::shared_ptr<FieldBuffers> Simulator::nextBuffers()
+{
+	// The renderer is done with the last step, so its buffers are filled again in place, unless a listener holds them; only then
+	// further buffers are allocated (the pool and m_buffers hold two references)
+	if (m_buffers.use_count() == 2)
+		return m_buffers;
+	for (const auto& buffers : m_bufferPool)
+	{
+		if (buffers.use_count() == 1)
+			return buffers;
+	}
+
+	size_t size = static_cast<size_t>(m_resolution.x) * m_resolution.y * m_resolution.z;
+	std::shared_ptr<FieldBuffers> buffers = std::make_shared<FieldBuffers>();
+	buffers->velocity.resize(size * 4); // float3 + 1 padding
+	buffers->pressure.resize(size);
+	buffers->density.resize(size);
+	m_bufferPool.push_back(buffers);
+	return buffers;
 }
 
 void Simulator::updateGrid()
@@ -173,7 +324,18 @@ void Simulator::updateGrid()
 	// Skip if currently windTunnels not available
 	if (!checkContinue()) return;
 
-	m_windTunnel.updateGrid(m_cellTypes);
+	try
+	{
+		m_solver->updateGrid(m_cellTypes);
+	}
+	catch (const std::exception& e)
+	{
+		// E.g. inflow cells inside an imported grid, which the CPU solvers do not support; the solver keeps its cell types
+		log("ERROR: " + QString(e.what()) + " The previous cell types are kept.");
+		emit simUpdated();
+		return;
+	}
+	m_solverCellTypes = m_cellTypes;
 	OutputDebugStringA("INFO: Updated celltypes in WindTunnel!\n");
 	emit simUpdated();
 }
@@ -187,20 +349,42 @@ void Simulator::setGridDimension(const XMUINT3& resolution, const XMFLOAT3& voxe
 		m_resolution = resolution;
 		m_voxelSize = voxelSize;
 
-		m_windTunnel.setGridDimension(resolution, voxelSize);
-
-		int lineBufferSize = m_windTunnel.getLineBufferSize();
+		try
+		{
+			m_solver->setGridDimension(resolution, voxelSize);
+			m_solverReady = true;
+		}
+		catch (const std::exception& e)
+		{
+			// E.g. the CPU solvers with non-cubic cells; OpenCL may not be initialized, so there is no fallback to the OpenCL solver
+			log("ERROR: " + QString(e.what()) + " The simulation is unavailable until the grid dimensions change.");
+			m_solverReady = false;
+		}
+		m_checkpoints = m_solverReady && m_solver->getStateSize() > 0;
+
+		int lineBufferSize = m_solver->getLineBufferSize();
 
 		int size = resolution.x * resolution.y * resolution.z;
 
 		m_cellTypes.resize(size);
-
-		m_velocity.resize(size * 4); // float3 + 1 padding
-		m_pressure.resize(size);
-		m_density.resize(size);
+		m_solverCellTypes = m_cellTypes;
+		m_solidFractions.assign(size * 4, 0.0f);
+
+		// Buffers, which listeners still hold, are released with the last reference
+		m_bufferPool.clear();
+		m_buffers.reset();
+		m_buffers = nextBuffers();
+		m_fields.velocity = m_buffers->velocity.data();
+		m_fields.pressure = m_buffers->pressure.data();
 		m_densitySum.resize(size);
 		m_lines.resize(lineBufferSize);
 
+		m_stepCount = 0;
+		m_simTime = 0.0;
+
+		if (!m_solverReady)
+			return;
+
 		log("INFO: Done.");
 
 		emit simulatorReady(); // Set sim availbale
@@ -222,10 +406,12 @@ void Simulator::changeSmokeSettings(const QJsonObject& settings)
 	if (!checkContinue()) return;
 
 	m_simSmoke = settings["enabled"].toBool();
-	m_windTunnel.smokeSim(m_simSmoke ? Smoke::Enabled : Smoke::Disabled);
 	const QJsonObject& pos = settings["seedPosition"].toObject();
-	m_windTunnel.setSmokePosition({ static_cast<float>(pos["x"].toDouble()), static_cast<float>(pos["y"].toDouble()), static_cast<float>(pos["z"].toDouble()) });
-	m_windTunnel.setSmokeSeedRadius(static_cast<float>(settings["seedRadius"].toDouble()));
+	SolverBackend::SmokeSettings smoke;
+	smoke.enabled = m_simSmoke;
+	smoke.position = { static_cast<float>(pos["x"].toDouble()), static_cast<float>(pos["y"].toDouble()), static_cast<float>(pos["z"].toDouble()) };
+	smoke.seedRadius = static_cast<float>(settings["seedRadius"].toDouble());
+	m_solver->setSmokeSettings(smoke);
 
 }
 
@@ -236,12 +422,14 @@ void Simulator::changeLineSettings(const QJsonObject& settings)
 	if (!checkContinue()) return;
 
 	m_simLines = settings["enabled"].toBool();
-	m_windTunnel.lineSim(m_simLines ? Line::Enabled : Line::Disabled);
 	QString ori = settings["orientation"].toString();
-	m_windTunnel.setLineOrientation(ori == "X" ? Line::X : (ori == "Y" ? Line::Y : Line::Z));
 	QString type = settings["type"].toString();
-	m_windTunnel.setLineType(type == "Streamline" ? Line::StreamLine : Line::StreakLine);
-	m_windTunnel.setLinePosition(static_cast<float>(settings["position"].toObject()[ori].toDouble()));
+	SolverBackend::LineSettings lines;
+	lines.enabled = m_simLines;
+	lines.axis = ori == "X" ? 0 : (ori == "Y" ? 1 : 2);
+	lines.streamLines = type == "Streamline";
+	lines.position = static_cast<float>(settings["position"].toObject()[ori].toDouble());
+	m_solver->setLineSettings(lines);
 }
 
 void Simulator::step()
@@ -259,7 +447,7 @@ void Simulator::step()
 	QElapsedTimer timer;
 
 	timer.start();
-	m_timeStep = m_windTunnel.step(); // nanosec to sec
+	m_timeStep = m_solver->step(); // in sec
 	OutputDebugStringA(("INFO: Simulation step lasted " + std::to_string(timer.nsecsElapsed() * 1e-6) + "msec\n").c_str());
 
 	// Wait until the simulation results of last step were processed
@@ -279,12 +467,35 @@ void Simulator::step()
 	}
 	m_simMutex.unlock();
 
-	m_windTunnel.fillVelocity(m_velocity);
-	m_windTunnel.fillPressure(m_pressure);
+	// Solvers in another process share their fields, so the large ones are not copied
+	std::shared_ptr<FieldBuffers> buffers = nextBuffers();
+	bool viewed = m_solver->viewFields(m_fields);
+	if (!viewed)
+	{
+		m_solver->fillVelocity(buffers->velocity);
+		m_solver->fillPressure(buffers->pressure);
+		m_fields.velocity = buffers->velocity.data();
+		m_fields.pressure = buffers->pressure.data();
+	}
+	// Without smoke the density is neither rendered nor published, so buffers, which were held meanwhile, keep an older one
 	if (m_simSmoke)
-		m_windTunnel.fillDensity(m_density, m_densitySum);
+		m_solver->fillDensity(buffers->density, m_densitySum);
+	m_buffers = buffers;
 	if (m_simLines)
-		m_windTunnel.fillLines(m_lines, m_reseedCounter, m_numLines);
+		m_solver->fillLines(m_lines, m_reseedCounter, m_numLines);
+
+	m_stepCount++;
+	m_simTime += m_timeStep;
+	{
+		std::lock_guard<std::mutex> lock(m_stepListenerMutex);
+		if (!m_stepListeners.empty())
+		{
+			FieldFrame frame = { m_stepCount, m_simTime, m_resolution, m_fields.velocity, m_fields.pressure, m_simSmoke ? m_buffers->density.data() : nullptr,
+				reinterpret_cast<const char*>(m_solverCellTypes.data()), viewed ? nullptr : m_buffers };
+			for (StepListener* listener : m_stepListeners)
+				listener->stepPublished(frame);
+		}
+	}
 
 	// Calculate average steps per second here, as it depends on the number of times this function is called and not on the elapsed time for calculating the simulation step itself
 	long long et = m_stepTimer.nsecsElapsed();
@@ -293,11 +504,175 @@ void Simulator::step()
 	m_totalStepTimes.push_front(1.0e9 / et); // 1 sec / elapsedTime nsec = fps
 	float sps = std::accumulate(m_totalStepTimes.begin(), m_totalStepTimes.end(), 0.0, [](float acc, const float& val) {return acc + stepTimesWeight * val; });
 
-	m_renderer->drawInfo(QString::fromStdString(m_windTunnel.getOpenCLStats() + "Avg steps per sec: " + std::to_string(sps)));
+	// The summary is formatted by the thread of the statistics
+	std::string info = m_solver->getStats() + "Avg steps per sec: " + std::to_string(sps);
+	std::string summary = m_signals ? m_signals->getSummary() : "";
+	if (!summary.empty())
+		info += "\n" + summary;
+	m_renderer->drawInfo(QString::fromStdString(info));
 
 	emit stepDone();
 }
 
+bool Simulator::saveCheckpoint(const QString& file, const CheckpointData& data)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	uint64_t stateSize = m_solver->getStateSize();
+	if (stateSize == 0)
+	{
+		log("ERROR: The solver '" + QString::fromStdString(m_solver->getName()) + "' does not support checkpoints.");
+		return false;
+	}
+
+	CheckpointHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+	header.version = CHECKPOINT_VERSION;
+	header.resolution[0] = m_resolution.x;
+	header.resolution[1] = m_resolution.y;
+	header.resolution[2] = m_resolution.z;
+	header.voxelSize[0] = m_voxelSize.x;
+	header.voxelSize[1] = m_voxelSize.y;
+	header.voxelSize[2] = m_voxelSize.z;
+	header.time = data.time;
+	header.stepCount = m_stepCount;
+	strncpy_s(header.solver, m_solver->getName().c_str(), _TRUNCATE);
+	header.cellTypesOffset = alignOffset(sizeof(header));
+	header.stateOffset = alignOffset(header.cellTypesOffset + m_cellTypes.size() * sizeof(wtl::CellType));
+	header.stateSize = stateSize;
+	header.dynamicsOffset = alignOffset(header.stateOffset + stateSize);
+	header.numDynamics = data.dynamics.size();
+	uint64_t size = header.dynamicsOffset + header.numDynamics * sizeof(CheckpointDynamics);
+
+	// The solver writes its state directly into the mapping, so there is no intermediate copy of the (large) distributions
+	QFile f(file);
+	uchar* map = nullptr;
+	if (!f.open(QIODevice::ReadWrite | QIODevice::Truncate) || !f.resize(size) || !(map = f.map(0, size)))
+	{
+		log("ERROR: Failed to write the checkpoint '" + file + "': " + f.errorString());
+		return false;
+	}
+
+	std::memcpy(map, &header, sizeof(header));
+	std::memcpy(map + header.cellTypesOffset, m_cellTypes.data(), m_cellTypes.size() * sizeof(wtl::CellType));
+	m_solver->saveState(reinterpret_cast<char*>(map + header.stateOffset));
+	for (size_t i = 0; i < data.dynamics.size(); ++i)
+	{
+		CheckpointDynamics record;
+		std::memset(&record, 0, sizeof(record));
+		strncpy_s(record.name, data.dynamics[i].first.c_str(), _TRUNCATE);
+		record.state = data.dynamics[i].second;
+		std::memcpy(map + header.dynamicsOffset + i * sizeof(CheckpointDynamics), &record, sizeof(record));
+	}
+
+	f.unmap(map);
+	f.close();
+
+	log("INFO: Saved checkpoint '" + file + "' (" + QString::number(size / (1024.0 * 1024.0), 'f', 1) + " MB) in " + QString::number(timer.nsecsElapsed() * 1e-6) + "msec.");
+	return true;
+}
+
+bool Simulator::loadCheckpoint(const QString& file, CheckpointData& data)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	auto fail = [&](const QString& msg)
+	{
+		log("ERROR: Failed to load the checkpoint '" + file + "': " + msg);
+		return false;
+	};
+
+	QFile f(file);
+	if (!f.open(QIODevice::ReadOnly))
+		return fail(f.errorString());
+
+	uint64_t size = f.size();
+	const uchar* map = size >= sizeof(CheckpointHeader) ? f.map(0, size) : nullptr;
+	if (!map)
+		return fail("The file is no checkpoint.");
+
+	CheckpointHeader header;
+	std::memcpy(&header, map, sizeof(header));
+	if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 || header.version != CHECKPOINT_VERSION)
+		return fail("The file is no checkpoint of this version.");
+
+	uint64_t cellTypesSize = m_cellTypes.size() * sizeof(wtl::CellType);
+	if (header.resolution[0] != m_resolution.x || header.resolution[1] != m_resolution.y || header.resolution[2] != m_resolution.z
+		|| header.voxelSize[0] != m_voxelSize.x || header.voxelSize[1] != m_voxelSize.y || header.voxelSize[2] != m_voxelSize.z)
+		return fail("The grid dimensions differ from the current voxel grid.");
+
+	header.solver[sizeof(header.solver) - 1] = '\0';
+	if (m_solver->getName() != header.solver || m_solver->getStateSize() != header.stateSize)
+		return fail("The checkpoint was written by the solver '" + QString(header.solver) + "', not by '" + QString::fromStdString(m_solver->getName()) + "'.");
+
+	if (header.cellTypesOffset + cellTypesSize > size || header.stateOffset + header.stateSize > size || header.dynamicsOffset + header.numDynamics * sizeof(CheckpointDynamics) > size)
+		return fail("The file is truncated.");
+
+	// The state of the solver refers to its cell types, so they are restored first; if the solver rejects either, the previous grid is
+	// restored and the simulation starts over, since the solver may have overwritten parts of its state already
+	std::vector<wtl::CellType> previousCellTypes = m_cellTypes;
+	std::vector<wtl::CellType> previousSolverCellTypes = m_solverCellTypes;
+	std::memcpy(m_cellTypes.data(), map + header.cellTypesOffset, cellTypesSize);
+	bool restored = false;
+	try
+	{
+		m_solver->updateGrid(m_cellTypes);
+		m_solverCellTypes = m_cellTypes;
+		restored = m_solver->restoreState(reinterpret_cast<const char*>(map + header.stateOffset), header.stateSize);
+	}
+	catch (const std::invalid_argument& e)
+	{
+		log("ERROR: " + QString(e.what()));
+	}
+	if (!restored)
+	{
+		m_cellTypes.swap(previousCellTypes);
+		m_solverCellTypes.swap(previousSolverCellTypes);
+		m_solver->updateGrid(m_solverCellTypes);
+		m_solver->reset();
+		m_stepCount = 0;
+		m_simTime = 0.0;
+		return fail("The solver state could not be restored, the simulation was reset.");
+	}
+
+	data.time = header.time;
+	m_stepCount = header.stepCount;
+	m_simTime = header.time;
+	data.dynamics.clear();
+	for (uint64_t i = 0; i < header.numDynamics; ++i)
+	{
+		CheckpointDynamics record;
+		std::memcpy(&record, map + header.dynamicsOffset + i * sizeof(CheckpointDynamics), sizeof(record));
+		record.name[sizeof(record.name) - 1] = '\0';
+		data.dynamics.push_back(std::make_pair(std::string(record.name), record.state));
+	}
+
+	f.unmap(const_cast<uchar*>(map));
+	f.close();
+
+	// Show the restored flow right away, even if the simulation is paused
+	fillFields();
+
+	log("INFO: Restored checkpoint '" + file + "' (simulated time " + QString::number(data.time) + "s) in " + QString::number(timer.nsecsElapsed() * 1e-6) + "msec.");
+	return true;
+}
+
+void Simulator::addStepListener(StepListener* listener)
+{
+	std::lock_guard<std::mutex> lock(m_stepListenerMutex);
+	if (std::find(m_stepListeners.begin(), m_stepListeners.end(), listener) == m_stepListeners.end())
+		m_stepListeners.push_back(listener);
+}
+
+void Simulator::removeStepListener(StepListener* listener)
+{
+	std::lock_guard<std::mutex> lock(m_stepListenerMutex);
+	m_stepListeners.erase(std::remove(m_stepListeners.begin(), m_stepListeners.end(), listener), m_stepListeners.end());
+}
+
 void Simulator::log(const QString& msg)
 {
 	OutputDebugStringA((msg.toStdString() + "\n").c_str());
@@ -306,6 +681,8 @@ void Simulator::log(const QString& msg)
 
 bool Simulator::checkContinue()
 {
+	if (!m_solverReady)
+		return false;
 	if (!m_openCLMutex.tryLock(1000))
 		return false;
 
@@ -14,8 +14,14 @@
 #include <vector>
 #include <mutex>
 #include <list>
+#include <memory>
+#include <atomic>
 
-#include <WindTunnel.h>
+#include "cellType.h"
+#include "solverBackend.h"
+#include "dynamics.h"
+#include "stepListener.h"
+#include "signalStatistics.h"
 
 class DX11Renderer;
 
@@ -31,19 +37,40 @@ public:
 	static QJsonObject getSmokeSettingsDefault();
 	static QJsonObject getLineSettingsDefault();
 
+	// State of the caller, which is stored along with the flow in a checkpoint
+	struct CheckpointData
+	{
+		float time; // Simulated time in seconds
+		std::vector<std::pair<std::string, Dynamics::State>> dynamics; // Per mesh name (at most 63 characters are stored)
+	};
+
 	Simulator(const QString& settingsFile, const DirectX::XMUINT3& resolution, const DirectX::XMFLOAT3& voxelSize, DX11Renderer* renderer = nullptr, QObject* parent = nullptr);
 
 	void continueSim(bool skip = false); // Continue simulation after simulation results are processed by rendering thread, say if future steps should be skipped
 	void reinitWindTunnel(); // Called from the rendering thread when static OpenCL was reinitialized; the static m_openCLMutex must be locked
 	std::mutex& getRunningMutex() { return m_simRunning; }; // Get mutex, which indicates if simulation is currently running or not
 
+	// Write the solver state and cell types with <data> to a memory-mapped file, or restore them; the grid dimensions and the solver must match
+	// Must not be called while a step is computed, i.e. only while the simulation is paused or waits for its results to be processed
+	bool saveCheckpoint(const QString& file, const CheckpointData& data);
+	bool loadCheckpoint(const QString& file, CheckpointData& data);
+	bool supportsCheckpoints() const { return m_checkpoints; }; // Of the current solver; may be called from any thread
+
+	// Listeners receive the fields after every step in the simulation thread; removeStepListener returns after a running call finished
+	void addStepListener(StepListener* listener);
+	void removeStepListener(StepListener* listener);
+
+	// Summary appended to the info overlay after every step, null for none; set before the simulation thread starts
+	void setSignalStatistics(const SignalStatistics* statistics) { m_signals = statistics; };
+
 	// Get vectors for writing
 	std::vector<wtl::CellType>& getCellTypes() { return m_cellTypes; };
+	std::vector<float>& getSolidFractions() { return m_solidFractions; };
 
-	// Get vectors for reading
-	const std::vector<float>& getVelocity() const { return m_velocity; };
-	const std::vector<float>& getPressure() const { return m_pressure; };
-	const std::vector<float>& getDensity() const { return m_density; };
+	// Get fields for reading; velocity and pressure may be shared with the solver, e.g. its simulation host, and are valid until the next step
+	const float* getVelocity() const { return m_fields.velocity; };
+	const float* getPressure() const { return m_fields.pressure; };
+	const std::vector<float>& getDensity() const { return m_buffers->density; };
 	const std::vector<float>& getDensitySum() const { return m_densitySum; };
 	const std::vector<char>& getLines() const { return m_lines; };
 	const int getReseedCounter() const { return m_reseedCounter; };
@@ -60,7 +87,7 @@ public slots:
 	void stop(); // Stop thread loop
 	void pause(); // Pause thread loop
 
-	void changeSimSettings(const QString& settingsFile); // Called when the json settings file changed
+	void changeSimSettings(const QString& settingsFile, bool keepFlow); // Called when the json settings file changed; the flow is kept if the solver supports checkpoints
 	void resetSimulation();
 	void createWindTunnel(const QString& settingsFile); // Construct new windtunnel
 	void updateGrid(); // Update CellTypes and solid velocity from local vectors
@@ -75,12 +102,16 @@ private slots:
 private:
 	void log(const QString& msg);
 	bool checkContinue();
-
+	std::unique_ptr<SolverBackend> createSolver(const QString& settingsFile) const; // Backend chosen by the settings
+	void fillFields(); // Copy the fields of the solver to the output vectors, e.g. after its state was restored while paused
+	std::shared_ptr<FieldBuffers> nextBuffers(); // Buffers to fill with the next step, which no listener holds
 	static QMutex m_openCLMutex;
 	static int m_clDevice;
 	static int m_clPlatform;
 
-	wtl::WindTunnel m_windTunnel;
+	std::unique_ptr<SolverBackend> m_solver;
+	std::atomic<bool> m_checkpoints; // m_solver->getStateSize() > 0 after its grid dimensions were set
+	bool m_solverReady; // The solver accepted the grid dimensions; steps and grid updates are skipped otherwise
 
 	// WindTunnel creation parameters
 	QString m_settingsFile;
@@ -90,16 +121,20 @@ private:
 
 	// WindTunnel input
 	std::vector<wtl::CellType> m_cellTypes;
+	std::vector<wtl::CellType> m_solverCellTypes; // Last passed to the solver, for the step listeners; m_cellTypes is rewritten by the voxelization
+	std::vector<float> m_solidFractions; // Per cell: area weighted surface normal (xyz) and solid volume fraction (w); all zero if disabled
 
 	// WindTunnel output
-	std::vector<float> m_velocity;
-	std::vector<float> m_pressure;
-	std::vector<float> m_density;
+	std::vector<std::shared_ptr<FieldBuffers>> m_bufferPool; // Of the grid dimensions; listeners hold further references while they read
+	std::shared_ptr<FieldBuffers> m_buffers; // Of the last step
+	SolverBackend::FieldView m_fields; // Velocity and pressure of the last step, in memory of the solver or the buffers above
 	std::vector<float> m_densitySum;
 	std::vector<char> m_lines;
 	int m_reseedCounter;
 	int m_numLines;
 	float m_timeStep; // in seconds
+	int m_stepCount; // Since the last reset
+	double m_simTime; // Simulated time since the last reset in seconds
 
 	// Grid variables
 	DirectX::XMUINT3 m_resolution;
@@ -120,7 +155,11 @@ private:
 	std::mutex m_simRunning; // If sim thread holds lock -> sim is running/ timers running, use std::mutex as QMutex does not provide
 	std::unique_lock<std::mutex> m_simulatorLock;
 
+	std::vector<StepListener*> m_stepListeners;
+	std::mutex m_stepListenerMutex;
+
 	DX11Renderer* m_renderer;
+	const SignalStatistics* m_signals;
 
 	QElapsedTimer m_stepTimer;
 	std::list<float> m_totalStepTimes;
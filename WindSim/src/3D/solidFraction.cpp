@@ -0,0 +1,221 @@
+#include "solidFraction.h"
+#include "objLoader.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <limits>
+
+using namespace DirectX;
+using namespace objLoader;
+
+namespace
+{
+	// Surface integrals of one voxel
+	struct Accum
+	{
+		float s1; // Integral of n.x over the surface piece in the voxel
+		float s2; // Integral of (x - x0) * n.x, with x0 the lower x bound of the voxel
+		Vec3 n; // Integral of the normal (area weighted normal)
+	};
+
+	// Clip a convex polygon against the half space <sign> * (p[axis] - value) >= 0
+	int clipPolygon(const Vec3* in, int count, Vec3* out, int axis, float value, float sign)
+	{
+		int outCount = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			const Vec3& a = in[i];
+			const Vec3& b = in[(i + 1) % count];
+			float da = sign * ((&a.x)[axis] - value);
+			float db = sign * ((&b.x)[axis] - value);
+
+			if (da >= 0.0f)
+				out[outCount++] = a;
+			if ((da >= 0.0f) != (db >= 0.0f))
+			{
+				Vec3 p = a + (b - a) * (da / (da - db));
+				(&p.x)[axis] = value; // Avoid drifting off the plane
+				out[outCount++] = p;
+			}
+		}
+		return outCount;
+	}
+}
+
+void SolidFraction::compute(const std::vector<Mesh>& meshes, const XMUINT3& resolution, const XMFLOAT3& voxelSize, std::vector<float>& fractions, int threads)
+{
+	const int resX = resolution.x;
+	const int resY = resolution.y;
+	const int resZ = resolution.z;
+
+	fractions.assign(static_cast<size_t>(resX) * resY * resZ * 4, 0.0f);
+
+	// Area weighted normals scale with the cofactors of the voxel -> grid object space scaling
+	const Vec3 normalScale = { voxelSize.y * voxelSize.z, voxelSize.x * voxelSize.z, voxelSize.x * voxelSize.y };
+
+	for (const Mesh& mesh : meshes)
+	{
+		const std::vector<float>& vertexData = *mesh.vertexData;
+		const std::vector<uint32_t>& indexData = *mesh.indexData;
+
+		// Vertices in voxel space
+		XMMATRIX toVoxel = XMLoadFloat4x4(&mesh.objectToVoxel);
+		std::vector<Vec3> pos(vertexData.size() / 6);
+		for (size_t i = 0; i < pos.size(); ++i)
+		{
+			XMFLOAT3 p;
+			XMStoreFloat3(&p, XMVector3TransformCoord(XMVectorSet(vertexData[i * 6], vertexData[i * 6 + 1], vertexData[i * 6 + 2], 1.0f), toVoxel));
+			pos[i] = { p.x, p.y, p.z };
+		}
+
+		// The winding of the mesh defines the normal direction; orient outwards by the sign of the enclosed volume
+		size_t numTriangles = indexData.size() / 3;
+		double volume = 0.0;
+		for (size_t t = 0; t < numTriangles; ++t)
+		{
+			const Vec3& a = pos[indexData[t * 3]];
+			const Vec3& b = pos[indexData[t * 3 + 1]];
+			const Vec3& c = pos[indexData[t * 3 + 2]];
+			volume += Vec3::dotProduct(a, Vec3::crossProduct(b, c));
+		}
+		const bool flip = volume < 0.0;
+
+		Parallel::forRange(0, resZ, [&](int zBegin, int zEnd)
+		{
+			// Key: row (z, y) and x + 1, so the sorted keys enumerate each row from left to right; x = -1 collects everything left of the grid
+			auto key = [&](int x, int y, int z) { return (static_cast<uint64_t>(z) * resY + y) * (resX + 1) + (x + 1); };
+			std::unordered_map<uint64_t, Accum> cut;
+
+			Vec3 polyA[9];
+			Vec3 polyB[9];
+
+			for (size_t t = 0; t < numTriangles; ++t)
+			{
+				Vec3 tri[3] = { pos[indexData[t * 3]], pos[indexData[t * 3 + 1]], pos[indexData[t * 3 + 2]] };
+				if (flip)
+					std::swap(tri[1], tri[2]);
+
+				float minZ = std::min({ tri[0].z, tri[1].z, tri[2].z });
+				float maxZ = std::max({ tri[0].z, tri[1].z, tri[2].z });
+				int z0 = std::max(static_cast<int>(std::floor(minZ)), zBegin);
+				int z1 = std::min(std::max(static_cast<int>(std::ceil(maxZ)) - 1, static_cast<int>(std::floor(minZ))), zEnd - 1);
+				if (z0 > z1)
+					continue;
+
+				float minY = std::min({ tri[0].y, tri[1].y, tri[2].y });
+				float maxY = std::max({ tri[0].y, tri[1].y, tri[2].y });
+				int y0 = std::max(static_cast<int>(std::floor(minY)), 0);
+				int y1 = std::min(std::max(static_cast<int>(std::ceil(maxY)) - 1, static_cast<int>(std::floor(minY))), resY - 1);
+				if (y0 > y1)
+					continue;
+
+				float minX = std::min({ tri[0].x, tri[1].x, tri[2].x });
+				float maxX = std::max({ tri[0].x, tri[1].x, tri[2].x });
+				int x0 = std::max(static_cast<int>(std::floor(minX)), -1);
+				int x1 = std::min(std::max({ static_cast<int>(std::ceil(maxX)) - 1, static_cast<int>(std::floor(minX)), -1 }), resX - 1);
+				if (x0 > x1)
+					continue;
+
+				for (int z = z0; z <= z1; ++z)
+				{
+					for (int y = y0; y <= y1; ++y)
+					{
+						// Clip against the row first, then against the single voxels
+						int rowCount = clipPolygon(tri, 3, polyA, 1, static_cast<float>(y), 1.0f);
+						rowCount = clipPolygon(polyA, rowCount, polyB, 1, static_cast<float>(y + 1), -1.0f);
+						rowCount = clipPolygon(polyB, rowCount, polyA, 2, static_cast<float>(z), 1.0f);
+						rowCount = clipPolygon(polyA, rowCount, polyB, 2, static_cast<float>(z + 1), -1.0f);
+						if (rowCount < 3)
+							continue;
+						Vec3 row[9];
+						std::copy(polyB, polyB + rowCount, row);
+
+						for (int x = x0; x <= x1; ++x)
+						{
+							int count;
+							if (x >= 0)
+							{
+								count = clipPolygon(row, rowCount, polyA, 0, static_cast<float>(x), 1.0f);
+								count = clipPolygon(polyA, count, polyB, 0, static_cast<float>(x + 1), -1.0f);
+							}
+							else
+							{
+								count = clipPolygon(row, rowCount, polyB, 0, 0.0f, -1.0f); // Everything left of the grid
+							}
+							if (count < 3)
+								continue;
+
+							// Fan triangulation of the planar piece
+							Accum acc = { 0.0f, 0.0f, { 0.0f, 0.0f, 0.0f } };
+							for (int i = 1; i + 1 < count; ++i)
+							{
+								Vec3 a = Vec3::crossProduct(polyB[i] - polyB[0], polyB[i + 1] - polyB[0]) * 0.5f;
+								acc.n += a;
+								acc.s1 += a.x;
+								acc.s2 += a.x * ((polyB[0].x + polyB[i].x + polyB[i + 1].x) / 3.0f - x);
+							}
+
+							Accum& dst = cut.emplace(key(x, y, z), Accum{ 0.0f, 0.0f, { 0.0f, 0.0f, 0.0f } }).first->second;
+							dst.s1 += acc.s1;
+							dst.s2 += acc.s2;
+							dst.n += acc.n;
+						}
+					}
+				}
+			}
+
+			if (cut.empty())
+				return;
+
+			std::vector<std::pair<uint64_t, Accum>> sorted(cut.begin(), cut.end());
+			std::sort(sorted.begin(), sorted.end(), [](const std::pair<uint64_t, Accum>& a, const std::pair<uint64_t, Accum>& b) { return a.first < b.first; });
+
+			// Sweep each row along x with the solid area on the left voxel face:
+			// Divergence theorem on (solid intersected with voxel) for F = (1, 0, 0): A(x + 1) = A(x) - s1
+			// and for F = (x - x0, 0, 0): V(x) = s2 + A(x + 1)
+			size_t i = 0;
+			while (i < sorted.size())
+			{
+				uint64_t rowKey = sorted[i].first / (resX + 1);
+				float* cells = &fractions[rowKey * resX * 4];
+
+				double area = 0.0;
+				for (int x = -1; x < resX; ++x)
+				{
+					bool isCut = i < sorted.size() && sorted[i].first == rowKey * (resX + 1) + (x + 1);
+					if (x < 0)
+					{
+						if (isCut)
+							area = -sorted[i++].second.s1;
+						continue;
+					}
+
+					float* cell = cells + x * 4;
+					if (isCut)
+					{
+						const Accum& acc = sorted[i++].second;
+						double next = area - acc.s1;
+						cell[0] += acc.n.x * normalScale.x;
+						cell[1] += acc.n.y * normalScale.y;
+						cell[2] += acc.n.z * normalScale.z;
+						cell[3] += static_cast<float>(std::min(std::max(acc.s2 + next, 0.0), 1.0));
+						area = next;
+					}
+					else
+					{
+						cell[3] += static_cast<float>(std::min(std::max(area, 0.0), 1.0));
+					}
+				}
+			}
+		}, threads);
+	}
+
+	// Overlapping meshes may add up to more than one
+	Parallel::forRange(0, resZ, [&](int zBegin, int zEnd)
+	{
+		size_t end = static_cast<size_t>(zEnd) * resX * resY * 4;
+		for (size_t i = static_cast<size_t>(zBegin) * resX * resY * 4 + 3; i < end; i += 4)
+			fractions[i] = std::min(fractions[i], 1.0f);
+	}, threads);
+}
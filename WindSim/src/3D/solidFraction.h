@@ -0,0 +1,28 @@
+#ifndef SOLID_FRACTION_H
+#define SOLID_FRACTION_H
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <cstdint>
+
+// Exact solid volume fractions of voxels cut by closed triangle meshes
+// Every triangle is clipped against the boxes of the voxels it touches; the fractions follow from the clipped surface pieces with
+// the divergence theorem, swept along the x rows of the grid, so only cut voxels are ever touched
+class SolidFraction
+{
+public:
+	struct Mesh
+	{
+		const std::vector<float>* vertexData; // 6 floats per vertex (position, normal) as in Mesh3D
+		const std::vector<uint32_t>* indexData; // 3 indices per triangle
+		DirectX::XMFLOAT4X4 objectToVoxel; // Mesh object space -> voxel space (voxel (x, y, z) covers [x, x + 1] x [y, y + 1] x [z, z + 1])
+	};
+
+	// Computes 4 floats per cell (x fastest): the area weighted outward surface normal of the solid within the cell in grid object space
+	// (i.e. the integral of the normal over the surface piece) and the solid volume fraction [0, 1]
+	// Overlapping meshes are combined by adding their fractions (clamped to 1) and normals
+	static void compute(const std::vector<Mesh>& meshes, const DirectX::XMUINT3& resolution, const DirectX::XMFLOAT3& voxelSize, std::vector<float>& fractions, int threads = 0);
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef SOLVER_BACKEND_H
+#define SOLVER_BACKEND_H
+
+#include "cellType.h"
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+// Flow solver driven by the Simulator
+// All fields are stored x fastest with resolution.x * resolution.y * resolution.z cells
+class SolverBackend
+{
+public:
+	struct SmokeSettings
+	{
+		bool enabled;
+		DirectX::XMFLOAT3 position; // Relative to the grid [0, 1]
+		float seedRadius;
+	};
+
+	struct LineSettings
+	{
+		bool enabled;
+		int axis; // Orientation of the seed line: 0 = x, 1 = y, 2 = z
+		bool streamLines; // Stream lines or streak lines
+		float position; // Relative position along the axis [0, 1]
+	};
+
+	virtual ~SolverBackend() {};
+
+	virtual std::string getName() const = 0;
+
+	virtual void setGridDimension(const DirectX::XMUINT3& resolution, const DirectX::XMFLOAT3& voxelSize) = 0;
+	virtual void updateGrid(const std::vector<wtl::CellType>& cellTypes) = 0;
+	virtual float step() = 0; // Advance the simulation, returns the simulated time in seconds
+	virtual void reset() = 0;
+
+	virtual void fillVelocity(std::vector<float>& velocity) = 0; // 4 floats per cell (xyz, padding)
+	virtual void fillPressure(std::vector<float>& pressure) = 0;
+	virtual void fillDensity(std::vector<float>& density, std::vector<float>& densitySum); // Smoke density; zero if not supported
+
+	// Fill memory of the caller, e.g. shared with another process, of <cells> cells; the defaults go through temporary vectors
+	virtual void fillVelocity(float* velocity, size_t cells);
+	virtual void fillPressure(float* pressure, size_t cells);
+	virtual void fillDensity(float* density, float* densitySum, size_t cells);
+
+	// Velocity and pressure of the last step in memory of the solver, which saves the copy of the fill functions
+	// The pointers stay valid until viewFields is called again after the next step; false if only the fill functions are supported
+	struct FieldView
+	{
+		const float* velocity;
+		const float* pressure;
+	};
+	virtual bool viewFields(FieldView& view) { return false; };
+
+	// Visualization features, which are optional for a solver
+	virtual void setSmokeSettings(const SmokeSettings& settings) {};
+	virtual void setLineSettings(const LineSettings& settings) {};
+	virtual int getLineBufferSize() { return 0; };
+	virtual void fillLines(std::vector<char>& lines, int& reseedCounter, int& numLines) { numLines = 0; };
+
+	virtual std::string getStats() { return ""; }; // Performance information for the info overlay, one line per entry
+
+	// Checkpoints (see Simulator::saveCheckpoint): the state holds everything step() depends on besides the cell types and the parameters
+	// A size of 0 means the solver can not be checkpointed; restoreState expects the cell types of the checkpoint to be set with updateGrid
+	virtual size_t getStateSize() const { return 0; };
+	virtual void saveState(char* state) const {};
+	virtual bool restoreState(const char* state, size_t size) { return false; };
+};
+
+inline void SolverBackend::fillDensity(std::vector<float>& density, std::vector<float>& densitySum)
+{
+	std::fill(density.begin(), density.end(), 0.0f);
+	std::fill(densitySum.begin(), densitySum.end(), 0.0f);
+}
+
+inline void SolverBackend::fillVelocity(float* velocity, size_t cells)
+{
+	std::vector<float> tmp(cells * 4);
+	fillVelocity(tmp);
+	std::copy(tmp.begin(), tmp.end(), velocity);
+}
+
+inline void SolverBackend::fillPressure(float* pressure, size_t cells)
+{
+	std::vector<float> tmp(cells);
+	fillPressure(tmp);
+	std::copy(tmp.begin(), tmp.end(), pressure);
+}
+
+inline void SolverBackend::fillDensity(float* density, float* densitySum, size_t cells)
+{
+	std::vector<float> tmp(cells);
+	std::vector<float> tmpSum(cells);
+	fillDensity(tmp, tmpSum);
+	std::copy(tmp.begin(), tmp.end(), density);
+	std::copy(tmpSum.begin(), tmpSum.end(), densitySum);
+}
+
+#endif
@@ -0,0 +1,151 @@
+#include "stepStatistics.h"
+
+#include <chrono>
+#include <algorithm>
+
+StepStatistics::Snapshot::Snapshot()
+	: step(0),
+	metric(FlowMetrics::MAGNITUDE),
+	values(),
+	pressure(),
+	density(),
+	copyTime(0.0),
+	computeTime(0.0)
+{
+}
+
+StepStatistics::StepStatistics(int threads)
+	: m_threads(threads),
+	m_metric(FlowMetrics::MAGNITUDE),
+	m_metrics(threads),
+	m_step(0),
+	m_resolution(0, 0, 0),
+	m_buffers(),
+	m_velocity(nullptr),
+	m_pressure(nullptr),
+	m_density(nullptr),
+	m_velocityCopy(),
+	m_pressureCopy(),
+	m_densityCopy(),
+	m_copyTime(0.0),
+	m_worker(),
+	m_mutex(),
+	m_cond(),
+	m_busy(false),
+	m_stopping(false),
+	m_numSkipped(0),
+	m_latest(),
+	m_hasLatest(false)
+{
+}
+
+StepStatistics::~StepStatistics()
+{
+	if (!m_worker.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_cond.notify_all();
+	m_worker.join();
+}
+
+void StepStatistics::setMetric(FlowMetrics::Type metric)
+{
+	m_metric = metric;
+}
+
+void StepStatistics::stepPublished(const FieldFrame& frame)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	{
+		// The fields belong to the background thread until it is done with them
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_busy)
+		{
+			m_numSkipped++;
+			return;
+		}
+	}
+	if (!m_worker.joinable())
+		m_worker = std::thread(&StepStatistics::compute, this);
+
+	m_step = frame.step;
+	m_resolution = frame.resolution;
+	m_buffers = frame.buffers;
+	if (m_buffers)
+	{
+		// The simulation does not refill the buffers while they are held
+		m_velocity = frame.velocity;
+		m_pressure = frame.pressure;
+		m_density = frame.density;
+	}
+	else
+	{
+		size_t numCells = static_cast<size_t>(frame.resolution.x) * frame.resolution.y * frame.resolution.z;
+		m_velocityCopy.assign(frame.velocity, frame.velocity + 4 * numCells);
+		m_pressureCopy.assign(frame.pressure, frame.pressure + numCells);
+		if (frame.density)
+			m_densityCopy.assign(frame.density, frame.density + numCells);
+		m_velocity = m_velocityCopy.data();
+		m_pressure = m_pressureCopy.data();
+		m_density = frame.density ? m_densityCopy.data() : nullptr;
+	}
+	m_copyTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_busy = true;
+	}
+	m_cond.notify_one();
+}
+
+void StepStatistics::compute()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_cond.wait(lock, [this]() { return m_busy || m_stopping; });
+		if (m_stopping)
+			return;
+		lock.unlock();
+
+		auto start = std::chrono::steady_clock::now();
+
+		size_t numCells = static_cast<size_t>(m_resolution.x) * m_resolution.y * m_resolution.z;
+		FlowMetrics::Type metric = FlowMetrics::Type(m_metric.load());
+		m_metrics.compute(m_velocity, m_resolution, FlowMetrics::mask(metric));
+
+		Snapshot snapshot;
+		snapshot.step = m_step;
+		snapshot.metric = metric;
+		snapshot.values = FieldStatistics::compute(m_metrics.get(metric).data(), numCells, m_threads);
+		snapshot.pressure = FieldStatistics::compute(m_pressure, numCells, m_threads);
+		if (m_density)
+			snapshot.density = FieldStatistics::compute(m_density, numCells, m_threads);
+		snapshot.copyTime = m_copyTime;
+		snapshot.computeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		// The simulation may fill the buffers again
+		m_buffers.reset();
+
+		lock.lock();
+		std::swap(m_latest, snapshot);
+		m_hasLatest = true;
+		m_busy = false;
+	}
+}
+
+bool StepStatistics::takeLatest(Snapshot& snapshot)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_hasLatest)
+		return false;
+
+	snapshot = m_latest;
+	m_hasLatest = false;
+	return true;
+}
@@ -0,0 +1,77 @@
+#ifndef STEP_STATISTICS_H
+#define STEP_STATISTICS_H
+
+#include "stepListener.h"
+#include "fieldStatistics.h"
+#include "flowMetrics.h"
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+// Statistics of the simulation steps for the automatic range of the volume renderer (see VolumeRenderer::updateRange)
+// The selected metric is computed from the velocity of the step (see FlowMetrics), so the statistics describe the rendered values;
+// the pressure and the density are reduced as they are. If the background thread is idle, the simulation thread hands the fields of a step
+// to it by holding their buffers (only fields without buffers, e.g. of a simulation host, are copied); the background thread computes the
+// metric and the statistics multi-threaded, steps which arrive meanwhile are skipped, as only the latest counts
+class StepStatistics : public StepListener
+{
+public:
+	struct Snapshot
+	{
+		Snapshot();
+		int step;
+		FlowMetrics::Type metric;
+		FieldStatistics::Result values; // Of the metric
+		FieldStatistics::Result pressure;
+		FieldStatistics::Result density; // Empty, if the step has no density
+		double copyTime; // msec in the simulation thread, the handoff or the copy of the fields
+		double computeTime; // msec in the background thread, including the metric
+	};
+
+	StepStatistics(int threads = 0);
+	~StepStatistics();
+
+	void setMetric(FlowMetrics::Type metric); // Applies from the next step on
+	void stepPublished(const FieldFrame& frame) override;
+
+	// Copies the statistics of the latest computed step; false if there was none since the last call
+	bool takeLatest(Snapshot& snapshot);
+
+	uint64_t getNumSkipped() const { return m_numSkipped; }; // Steps, which arrived while the background thread was busy
+
+private:
+	void compute();
+
+	int m_threads;
+	std::atomic<int> m_metric;
+	FlowMetrics m_metrics; // Of the background thread
+
+	// Fields of the step handed to the background thread, in the held buffers of the simulation or the copies below
+	int m_step;
+	DirectX::XMUINT3 m_resolution;
+	std::shared_ptr<const FieldBuffers> m_buffers;
+	const float* m_velocity;
+	const float* m_pressure;
+	const float* m_density; // Null, if the step has no density
+	std::vector<float> m_velocityCopy;
+	std::vector<float> m_pressureCopy;
+	std::vector<float> m_densityCopy;
+	double m_copyTime;
+
+	std::thread m_worker;
+	std::mutex m_mutex; // Guards the handoff and the latest snapshot
+	std::condition_variable m_cond;
+	bool m_busy; // The fields are handed to the background thread
+	bool m_stopping;
+	std::atomic<uint64_t> m_numSkipped;
+
+	Snapshot m_latest;
+	bool m_hasLatest;
+};
+
+#endif
@@ -0,0 +1,327 @@
+#include "streamTracer.h"
+#include "parallel.h"
+
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const int GRAIN = 32; // Lines per chunk of work
+	const float MAX_PATH_STEP = 0.5f; // Cells per RK4 substep of the pathlines
+	const int MAX_SUBSTEPS = 64;
+
+	// Dormand-Prince 5(4): stage coefficients, the last stage is the 5th order solution (first same as last), and the difference of the
+	// 5th and 4th order weights for the error estimate
+	const float A[6][6] = {
+		{ 1.0f / 5.0f },
+		{ 3.0f / 40.0f, 9.0f / 40.0f },
+		{ 44.0f / 45.0f, -56.0f / 15.0f, 32.0f / 9.0f },
+		{ 19372.0f / 6561.0f, -25360.0f / 2187.0f, 64448.0f / 6561.0f, -212.0f / 729.0f },
+		{ 9017.0f / 3168.0f, -355.0f / 33.0f, 46732.0f / 5247.0f, 49.0f / 176.0f, -5103.0f / 18656.0f },
+		{ 35.0f / 384.0f, 0.0f, 500.0f / 1113.0f, 125.0f / 192.0f, -2187.0f / 6784.0f, 11.0f / 84.0f } };
+	const float E[7] = { 71.0f / 57600.0f, 0.0f, -71.0f / 16695.0f, 71.0f / 1920.0f, -17253.0f / 339200.0f, 22.0f / 525.0f, -1.0f / 40.0f };
+
+	bool isSolid(wtl::CellType type)
+	{
+		return type == wtl::CELL_TYPE_SOLID_SLIP || type == wtl::CELL_TYPE_SOLID_NO_SLIP || type == wtl::CELL_TYPE_SOLID_BOUNDARY;
+	}
+
+	// Velocity at <p> (xyz) and its length (w)
+	inline XMVECTOR velocity(const FieldSampler& sampler, FXMVECTOR p)
+	{
+		XMVECTOR v = sampler.sampleVelocity(p);
+		return XMVectorSetW(v, XMVectorGetX(XMVector3Length(v)));
+	}
+
+	// Direction of the streamline at <p> (normalized velocity times <sign>); speed in w
+	inline XMVECTOR direction(const FieldSampler& sampler, FXMVECTOR p, float sign, float minSpeed)
+	{
+		XMVECTOR v = velocity(sampler, p);
+		float speed = XMVectorGetW(v);
+		if (speed < minSpeed || speed <= 0.0f)
+			return XMVectorSet(0.0f, 0.0f, 0.0f, speed);
+		return XMVectorSetW(v * (sign / speed), speed);
+	}
+
+	inline XMFLOAT4 vertex(FXMVECTOR p, float speed)
+	{
+		XMFLOAT4 result;
+		XMStoreFloat4(&result, XMVectorSetW(p, speed));
+		return result;
+	}
+}
+
+const uint32_t Polylines::STRIP_CUT;
+
+void Polylines::clear()
+{
+	vertices.clear();
+	first.assign(1, 0);
+	end.clear();
+}
+
+void Polylines::stripIndices(std::vector<uint32_t>& indices) const
+{
+	indices.clear();
+	indices.reserve(vertices.size() + numLines());
+	for (size_t line = 0; line < numLines(); ++line)
+	{
+		for (uint32_t i = first[line]; i < first[line + 1]; ++i)
+			indices.push_back(i);
+		indices.push_back(STRIP_CUT);
+	}
+}
+
+StreamTracer::Options::Options()
+	: integrator(Integrator::RK45),
+	direction(Direction::Both),
+	stepSize(0.5f),
+	minStep(0.05f),
+	maxStep(2.0f),
+	tolerance(1e-3f),
+	minSpeed(1e-6f),
+	maxVertices(2048),
+	threads(0)
+{
+}
+
+StreamTracer::StreamTracer(const Options& options)
+	: m_options(options),
+	m_pathVertices(),
+	m_pathEnd(),
+	m_pathlines(),
+	m_numActive(0),
+	m_traceTime(0.0)
+{
+	m_pathlines.clear();
+}
+
+Polylines::End StreamTracer::check(const FieldSampler& sampler, const wtl::CellType* cellTypes, const XMFLOAT3& position, float speed) const
+{
+	if (!sampler.isInside(position))
+		return Polylines::OUTSIDE;
+
+	if (cellTypes)
+	{
+		const XMUINT3& res = sampler.getResolution();
+		size_t x = std::min(static_cast<uint32_t>(position.x), res.x - 1);
+		size_t y = std::min(static_cast<uint32_t>(position.y), res.y - 1);
+		size_t z = std::min(static_cast<uint32_t>(position.z), res.z - 1);
+		if (isSolid(cellTypes[x + res.x * (y + res.y * z)]))
+			return Polylines::SOLID;
+	}
+
+	if (speed < m_options.minSpeed || speed <= 0.0f)
+		return Polylines::STALLED;
+	return Polylines::ACTIVE;
+}
+
+Polylines::End StreamTracer::traceLine(const FieldSampler& sampler, const wtl::CellType* cellTypes, const XMFLOAT3& seed, float sign, std::vector<XMFLOAT4>& vertices) const
+{
+	const float minSpeed = m_options.minSpeed;
+	XMVECTOR p = XMLoadFloat3(&seed);
+	XMVECTOR k[7];
+	k[0] = direction(sampler, p, sign, minSpeed);
+
+	Polylines::End end = check(sampler, cellTypes, seed, XMVectorGetW(k[0]));
+	if (end != Polylines::ACTIVE)
+		return end;
+	vertices.push_back(vertex(p, XMVectorGetW(k[0])));
+
+	float h = m_options.stepSize;
+	for (int n = 1; n < m_options.maxVertices;)
+	{
+		XMVECTOR next;
+		if (m_options.integrator == Integrator::RK4)
+		{
+			k[1] = direction(sampler, p + k[0] * (0.5f * h), sign, minSpeed);
+			k[2] = direction(sampler, p + k[1] * (0.5f * h), sign, minSpeed);
+			k[3] = direction(sampler, p + k[2] * h, sign, minSpeed);
+			next = p + (k[0] + 2.0f * (k[1] + k[2]) + k[3]) * (h / 6.0f);
+			k[0] = direction(sampler, next, sign, minSpeed);
+		}
+		else
+		{
+			for (int s = 0; s < 6; ++s)
+			{
+				XMVECTOR sum = XMVectorZero();
+				for (int j = 0; j <= s; ++j)
+					sum += k[j] * A[s][j];
+				next = p + sum * h;
+				k[s + 1] = direction(sampler, next, sign, minSpeed);
+			}
+
+			// The last stage is the 5th order solution, so the error is the difference to the 4th order one
+			XMVECTOR error = XMVectorZero();
+			for (int s = 0; s < 7; ++s)
+				error += k[s] * E[s];
+			float err = XMVectorGetX(XMVector3Length(error)) * h;
+			float scale = err > 0.0f ? 0.9f * std::pow(m_options.tolerance / err, 0.2f) : 5.0f;
+			float nextH = std::min(std::max(h * std::min(std::max(scale, 0.2f), 5.0f), m_options.minStep), m_options.maxStep);
+			if (err > m_options.tolerance && h > m_options.minStep)
+			{
+				h = nextH;
+				continue;
+			}
+
+			k[0] = k[6];
+			h = nextH;
+		}
+
+		p = next;
+		XMFLOAT3 position;
+		XMStoreFloat3(&position, p);
+		end = check(sampler, cellTypes, position, XMVectorGetW(k[0]));
+		if (end == Polylines::OUTSIDE || end == Polylines::SOLID)
+			return end;
+
+		// The stalled position is still part of the line
+		vertices.push_back(vertex(p, XMVectorGetW(k[0])));
+		if (end == Polylines::STALLED)
+			return end;
+		++n;
+	}
+	return Polylines::LENGTH;
+}
+
+void StreamTracer::trace(const FieldSampler& sampler, const wtl::CellType* cellTypes, const std::vector<XMFLOAT3>& seeds, Polylines& lines) const
+{
+	auto start = std::chrono::steady_clock::now();
+
+	// Each chunk of seeds traces into its own buffers, which are concatenated in the order of the seeds
+	struct Chunk
+	{
+		std::vector<XMFLOAT4> vertices;
+		std::vector<uint32_t> counts;
+		std::vector<uint8_t> ends;
+	};
+	const int numSeeds = static_cast<int>(seeds.size());
+	std::vector<Chunk> chunks((numSeeds + GRAIN - 1) / GRAIN);
+
+	Parallel::forRange(0, static_cast<int>(chunks.size()), [&](int firstChunk, int lastChunk)
+	{
+		std::vector<XMFLOAT4> backward;
+		std::vector<XMFLOAT4> forward;
+		for (int c = firstChunk; c < lastChunk; ++c)
+		{
+			Chunk& chunk = chunks[c];
+			for (int i = c * GRAIN; i < std::min((c + 1) * GRAIN, numSeeds); ++i)
+			{
+				size_t before = chunk.vertices.size();
+				Polylines::End end = Polylines::LENGTH;
+				if (m_options.direction != Direction::Forward)
+				{
+					backward.clear();
+					end = traceLine(sampler, cellTypes, seeds[i], -1.0f, backward);
+					chunk.vertices.insert(chunk.vertices.end(), backward.rbegin(), backward.rend());
+				}
+				if (m_options.direction != Direction::Backward)
+				{
+					// The seed is the last vertex of the backward part already
+					forward.clear();
+					end = traceLine(sampler, cellTypes, seeds[i], 1.0f, forward);
+					size_t skip = chunk.vertices.size() > before && !forward.empty() ? 1 : 0;
+					chunk.vertices.insert(chunk.vertices.end(), forward.begin() + skip, forward.end());
+				}
+				chunk.counts.push_back(static_cast<uint32_t>(chunk.vertices.size() - before));
+				chunk.ends.push_back(static_cast<uint8_t>(end));
+			}
+		}
+	}, m_options.threads);
+
+	size_t numVertices = 0;
+	for (const Chunk& chunk : chunks)
+		numVertices += chunk.vertices.size();
+
+	lines.clear();
+	lines.vertices.reserve(numVertices);
+	lines.first.reserve(seeds.size() + 1);
+	lines.end.reserve(seeds.size());
+	for (const Chunk& chunk : chunks)
+	{
+		lines.vertices.insert(lines.vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+		for (size_t i = 0; i < chunk.counts.size(); ++i)
+			lines.first.push_back(lines.first.back() + chunk.counts[i]);
+		lines.end.insert(lines.end.end(), chunk.ends.begin(), chunk.ends.end());
+	}
+
+	m_traceTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void StreamTracer::seedPathlines(const std::vector<XMFLOAT3>& seeds)
+{
+	m_pathVertices.assign(seeds.size(), std::vector<XMFLOAT4>());
+	m_pathEnd.assign(seeds.size(), Polylines::ACTIVE);
+	for (size_t i = 0; i < seeds.size(); ++i)
+		m_pathVertices[i].push_back(XMFLOAT4(seeds[i].x, seeds[i].y, seeds[i].z, 0.0f));
+	m_numActive = seeds.size();
+
+	m_pathlines.clear();
+	for (size_t i = 0; i < seeds.size(); ++i)
+	{
+		m_pathlines.vertices.push_back(m_pathVertices[i].front());
+		m_pathlines.first.push_back(static_cast<uint32_t>(i + 1));
+	}
+	m_pathlines.end = m_pathEnd;
+}
+
+void StreamTracer::advancePathlines(const FieldSampler& sampler, const wtl::CellType* cellTypes, float duration)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	Parallel::forRange(0, static_cast<int>(m_pathVertices.size()), [&](int first, int last)
+	{
+		for (int i = first; i < last; ++i)
+		{
+			if (m_pathEnd[i] != Polylines::ACTIVE)
+				continue;
+
+			std::vector<XMFLOAT4>& vertices = m_pathVertices[i];
+			XMVECTOR p = XMLoadFloat4(&vertices.back());
+			XMVECTOR k1 = velocity(sampler, p);
+
+			// RK4 in the field of this step; the substeps keep the particles from skipping cells
+			int substeps = std::min(std::max(static_cast<int>(std::ceil(XMVectorGetW(k1) * std::abs(duration) / MAX_PATH_STEP)), 1), MAX_SUBSTEPS);
+			float h = duration / substeps;
+			for (int s = 0; s < substeps; ++s)
+			{
+				if (s > 0)
+					k1 = velocity(sampler, p);
+				XMVECTOR k2 = velocity(sampler, p + k1 * (0.5f * h));
+				XMVECTOR k3 = velocity(sampler, p + k2 * (0.5f * h));
+				XMVECTOR k4 = velocity(sampler, p + k3 * h);
+				p = XMVectorSetW(p + (k1 + 2.0f * (k2 + k3) + k4) * (h / 6.0f), 0.0f);
+			}
+
+			XMFLOAT3 position;
+			XMStoreFloat3(&position, p);
+			float speed = XMVectorGetW(velocity(sampler, p));
+			Polylines::End end = check(sampler, cellTypes, position, speed);
+			if (end == Polylines::OUTSIDE || end == Polylines::SOLID)
+			{
+				m_pathEnd[i] = static_cast<uint8_t>(end);
+				continue;
+			}
+
+			// Stalled particles may move again with a later step
+			vertices.push_back(vertex(p, speed));
+			if (static_cast<int>(vertices.size()) >= m_options.maxVertices)
+				m_pathEnd[i] = Polylines::LENGTH;
+		}
+	}, m_options.threads, GRAIN);
+
+	m_numActive = std::count(m_pathEnd.begin(), m_pathEnd.end(), static_cast<uint8_t>(Polylines::ACTIVE));
+
+	m_pathlines.clear();
+	for (const auto& vertices : m_pathVertices)
+	{
+		m_pathlines.vertices.insert(m_pathlines.vertices.end(), vertices.begin(), vertices.end());
+		m_pathlines.first.push_back(static_cast<uint32_t>(m_pathlines.vertices.size()));
+	}
+	m_pathlines.end = m_pathEnd;
+
+	m_traceTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
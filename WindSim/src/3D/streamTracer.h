@@ -0,0 +1,91 @@
+#ifndef STREAM_TRACER_H
+#define STREAM_TRACER_H
+
+#include "fieldSampler.h"
+#include "cellType.h"
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <cstdint>
+
+// Streamlines and pathlines of the simulated velocity on the CPU, from any set of seeds
+// Everything is in voxel space (see FieldSampler), so the vertices are drawn with the voxel -> world transformation of the grid
+//
+// Streamlines follow the normalized velocity of one step, so the step size is the arc length in cells: RK4 takes fixed steps, RK45
+// (Dormand-Prince) adapts them to keep the local error of each step below the tolerance. Pathlines move particles with the velocity of
+// consecutive steps (RK4 with substeps of at most half a cell), one vertex per step. Lines end when they leave the grid, enter a solid
+// cell, the flow stalls or they reach the vertex limit. The seeds are traced in parallel; the lines are returned in one compact buffer
+struct Polylines
+{
+	static const uint32_t STRIP_CUT = 0xffffffff; // Strip cut index of 32 bit index buffers
+
+	// Why a line ended; ACTIVE for pathlines, which still move
+	enum End : uint8_t { ACTIVE = 0, LENGTH, OUTSIDE, SOLID, STALLED };
+
+	std::vector<DirectX::XMFLOAT4> vertices; // Position in voxel space, speed in w (for coloring)
+	std::vector<uint32_t> first; // First vertex of each line, plus the total number of vertices at the end
+	std::vector<uint8_t> end; // Of the forward part for streamlines in both directions
+
+	size_t numLines() const { return end.size(); };
+	uint32_t numVertices(size_t line) const { return first[line + 1] - first[line]; };
+
+	void clear();
+
+	// Index buffer of all lines for a line strip topology, separated by STRIP_CUT
+	void stripIndices(std::vector<uint32_t>& indices) const;
+};
+
+class StreamTracer
+{
+public:
+	enum class Integrator { RK4, RK45 };
+	enum class Direction { Forward, Backward, Both };
+
+	struct Options
+	{
+		Options();
+		Integrator integrator;
+		Direction direction;
+		float stepSize; // Cells; RK45 starts with it
+		float minStep, maxStep; // Range of the RK45 steps
+		float tolerance; // Local error per RK45 step in cells
+		float minSpeed; // Lines end below this speed (velocity units)
+		int maxVertices; // Per line (per direction of a streamline)
+		int threads;
+	};
+
+	StreamTracer(const Options& options = Options());
+
+	void setOptions(const Options& options) { m_options = options; };
+	const Options& getOptions() const { return m_options; };
+
+	// Streamlines from <seeds>; <cellTypes> may be null to ignore solids
+	// Both directions make one line per seed, which runs from the end of the backward part through the seed
+	void trace(const FieldSampler& sampler, const wtl::CellType* cellTypes, const std::vector<DirectX::XMFLOAT3>& seeds, Polylines& lines) const;
+
+	// Pathlines: seedPathlines starts a particle at each seed, advancePathlines moves the remaining ones by <duration> (positions change by
+	// velocity * duration cells) and adds a vertex to their lines
+	void seedPathlines(const std::vector<DirectX::XMFLOAT3>& seeds);
+	void advancePathlines(const FieldSampler& sampler, const wtl::CellType* cellTypes, float duration);
+	const Polylines& getPathlines() const { return m_pathlines; };
+	size_t getNumActivePathlines() const { return m_numActive; };
+
+	double getTraceTime() const { return m_traceTime; }; // msec of the last trace or advance
+
+private:
+	Polylines::End traceLine(const FieldSampler& sampler, const wtl::CellType* cellTypes, const DirectX::XMFLOAT3& seed, float sign, std::vector<DirectX::XMFLOAT4>& vertices) const;
+	Polylines::End check(const FieldSampler& sampler, const wtl::CellType* cellTypes, const DirectX::XMFLOAT3& position, float speed) const;
+
+	Options m_options;
+
+	// Pathlines; the vertices of each line are kept separately, as all lines grow with each step
+	std::vector<std::vector<DirectX::XMFLOAT4>> m_pathVertices;
+	std::vector<uint8_t> m_pathEnd;
+	Polylines m_pathlines;
+	size_t m_numActive;
+
+	mutable double m_traceTime;
+};
+
+#endif
@@ -0,0 +1,506 @@
+#include "volumeRaycaster.h"
+#include "parallel.h"
+#include "pngFile.h"
+
+#include <emmintrin.h>
+
+#include <chrono>
+#include <atomic>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const float MAX_OPACITY = 0.99f; // Early ray termination as in volume.fx
+
+	// saturate of HLSL, which maps NaN to 0
+	inline __m128 saturate(__m128 v)
+	{
+		return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	}
+
+	inline __m128 lerp(__m128 a, __m128 b, __m128 t)
+	{
+		return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+	}
+
+	// intersectAlignedBox of common.fx; min and max of HLSL ignore NaN (0 * inf for a zero direction on the border)
+	bool intersectBox(const XMFLOAT3& origin, const XMFLOAT3& dir, const XMFLOAT3& boxMax, float& t0, float& t1)
+	{
+		const float o[3] = { origin.x, origin.y, origin.z };
+		const float d[3] = { dir.x, dir.y, dir.z };
+		const float b[3] = { boxMax.x, boxMax.y, boxMax.z };
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float invDir = 1.0f / d[axis];
+			const float tbot = (0.0f - o[axis]) * invDir;
+			const float ttop = (b[axis] - o[axis]) * invDir;
+			const float enter = d[axis] >= 0.0f ? tbot : ttop;
+			const float leave = d[axis] >= 0.0f ? ttop : tbot;
+			t0 = axis == 0 ? enter : std::fmax(enter, t0);
+			t1 = axis == 0 ? leave : std::fmin(leave, t1);
+		}
+		return t0 <= t1 && t1 >= 0.0f;
+	}
+}
+
+VolumeRaycaster::VolumeRaycaster(int threads)
+	: m_threads(threads),
+	m_values(nullptr),
+	m_resolution(0, 0, 0),
+	m_voxelSize(1.0f, 1.0f, 1.0f),
+	m_txfn(4 * TXFN_RESOLUTION, 0.0f),
+	m_nextOpaque(TXFN_RESOLUTION, static_cast<uint8_t>(TXFN_RESOLUTION)),
+	m_rangeMin(0.0f),
+	m_rangeMax(1000.0f),
+	m_stepSize(0.5f),
+	m_macrocells(0, 0, 0),
+	m_macrocellRanges(),
+	m_empty(),
+	m_classified(false),
+	m_worldViewProjInv(),
+	m_camPosOS(0.0f, 0.0f, 0.0f),
+	m_depthVS(0.0f, 0.0f, 0.0f, 0.0f),
+	m_farZ(0.0f),
+	m_image(),
+	m_width(0),
+	m_height(0),
+	m_renderTime(0.0),
+	m_samplesPerRay(0.0),
+	m_emptyMacrocells(0.0f),
+	m_error()
+{
+}
+
+void VolumeRaycaster::setField(const float* values, const XMUINT3& resolution, const XMFLOAT3& voxelSize)
+{
+	m_values = values;
+	m_resolution = resolution;
+	m_voxelSize = voxelSize;
+	buildMacrocells();
+	m_classified = false;
+}
+
+void VolumeRaycaster::setTransferFunction(const std::vector<char>& texture, float rangeMin, float rangeMax)
+{
+	const int entries = static_cast<int>(std::min(texture.size() / 4, static_cast<size_t>(TXFN_RESOLUTION)));
+	std::fill(m_txfn.begin(), m_txfn.end(), 0.0f);
+	for (int i = 0; i < 4 * entries; ++i)
+		m_txfn[i] = static_cast<uint8_t>(texture[i]) / 255.0f;
+
+	// Entries with an alpha of 0 contribute nothing, whatever their color
+	int next = TXFN_RESOLUTION;
+	for (int i = TXFN_RESOLUTION - 1; i >= 0; --i)
+	{
+		if (m_txfn[4 * i + 3] > 0.0f)
+			next = i;
+		m_nextOpaque[i] = static_cast<uint8_t>(next);
+	}
+
+	m_rangeMin = rangeMin;
+	m_rangeMax = rangeMax;
+	m_classified = false;
+}
+
+void VolumeRaycaster::setStepSize(float stepSize)
+{
+	m_stepSize = std::max(0.001f, stepSize);
+}
+
+void VolumeRaycaster::buildMacrocells()
+{
+	const XMUINT3 res = m_resolution;
+	m_macrocells = XMUINT3((res.x + MACROCELL_SIZE - 1) / MACROCELL_SIZE, (res.y + MACROCELL_SIZE - 1) / MACROCELL_SIZE, (res.z + MACROCELL_SIZE - 1) / MACROCELL_SIZE);
+	m_macrocellRanges.resize(static_cast<size_t>(m_macrocells.x) * m_macrocells.y * m_macrocells.z);
+	if (!m_values || m_macrocellRanges.empty())
+		return;
+
+	const size_t sliceSize = static_cast<size_t>(res.x) * res.y;
+	Parallel::forRange(0, static_cast<int>(m_macrocells.z), [&](int first, int last)
+	{
+		for (unsigned int mz = first; mz < static_cast<unsigned int>(last); ++mz)
+		{
+			for (unsigned int my = 0; my < m_macrocells.y; ++my)
+			{
+				for (unsigned int mx = 0; mx < m_macrocells.x; ++mx)
+				{
+					// Samples within the macrocell interpolate the cells from the one before it to the first one behind it
+					const unsigned int x0 = mx * MACROCELL_SIZE, x1 = std::min(x0 + MACROCELL_SIZE + 1, res.x);
+					const unsigned int y0 = my * MACROCELL_SIZE, y1 = std::min(y0 + MACROCELL_SIZE + 1, res.y);
+					const unsigned int z0 = mz * MACROCELL_SIZE, z1 = std::min(z0 + MACROCELL_SIZE + 1, res.z);
+
+					Range range = { std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), false };
+					for (unsigned int z = z0 > 0 ? z0 - 1 : 0; z < z1; ++z)
+					{
+						for (unsigned int y = y0 > 0 ? y0 - 1 : 0; y < y1; ++y)
+						{
+							const float* row = m_values + y * static_cast<size_t>(res.x) + z * sliceSize;
+							for (unsigned int x = x0 > 0 ? x0 - 1 : 0; x < x1; ++x)
+							{
+								const float v = row[x];
+								if (v != v)
+								{
+									range.nan = true;
+									continue;
+								}
+								range.min = std::min(range.min, v);
+								range.max = std::max(range.max, v);
+							}
+						}
+					}
+					m_macrocellRanges[mx + m_macrocells.x * (my + static_cast<size_t>(m_macrocells.y) * mz)] = range;
+				}
+			}
+		}
+	}, m_threads);
+}
+
+void VolumeRaycaster::classifyMacrocells()
+{
+	m_empty.assign(m_macrocellRanges.size(), 0);
+	m_classified = true;
+
+	const float range = m_rangeMax - m_rangeMin;
+	if (!(range != 0.0f) || !std::isfinite(range))
+	{
+		m_emptyMacrocells = 0.0f;
+		return;
+	}
+
+	// Entries of the transfer function, which are interpolated for values in [lo, hi] of [0, 1], with one more on both sides for rounding
+	auto isTransparent = [this](float lo, float hi)
+	{
+		const float uLo = std::min(std::max(lo * TXFN_RESOLUTION - 0.5f, 0.0f), TXFN_RESOLUTION - 1.0f);
+		const float uHi = std::min(std::max(hi * TXFN_RESOLUTION - 0.5f, 0.0f), TXFN_RESOLUTION - 1.0f);
+		const int first = std::max(static_cast<int>(uLo) - 1, 0);
+		const int last = std::min(static_cast<int>(uHi) + 2, TXFN_RESOLUTION - 1);
+		return m_nextOpaque[first] > last;
+	};
+
+	size_t numEmpty = 0;
+	for (size_t i = 0; i < m_macrocellRanges.size(); ++i)
+	{
+		const Range& r = m_macrocellRanges[i];
+		float lo = 1.0f, hi = 0.0f;
+		if (r.min <= r.max)
+		{
+			lo = std::min(std::max((r.min - m_rangeMin) / range, 0.0f), 1.0f);
+			hi = std::min(std::max((r.max - m_rangeMin) / range, 0.0f), 1.0f);
+			if (lo > hi)
+				std::swap(lo, hi);
+		}
+		if (r.nan)
+			lo = 0.0f; // NaN is saturated to 0
+		if (lo <= hi && isTransparent(lo, hi))
+		{
+			m_empty[i] = 1;
+			++numEmpty;
+		}
+	}
+	m_emptyMacrocells = m_empty.empty() ? 0.0f : static_cast<float>(numEmpty) / m_empty.size();
+}
+
+void VolumeRaycaster::render(const XMFLOAT4X4& world, const XMFLOAT4X4& view, const XMFLOAT4X4& projection, int width, int height)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	m_width = std::max(width, 0);
+	m_height = std::max(height, 0);
+	m_image.assign(4 * static_cast<size_t>(m_width) * m_height, 0.0f);
+	m_samplesPerRay = 0.0;
+	if (!m_values || m_macrocellRanges.empty() || m_image.empty())
+	{
+		m_renderTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return;
+	}
+
+	if (!m_classified)
+		classifyMacrocells();
+
+	// As VolumeRenderer::render
+	XMMATRIX mWorld = XMLoadFloat4x4(&world);
+	XMMATRIX mView = XMLoadFloat4x4(&view);
+	XMMATRIX mProj = XMLoadFloat4x4(&projection);
+	XMMATRIX mWorldView = mWorld * mView;
+	XMStoreFloat4x4(&m_worldViewProjInv, XMMatrixInverse(nullptr, mWorldView * mProj));
+
+	XMVECTOR camPos = XMVector3Transform(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMMatrixInverse(nullptr, mView));
+	XMStoreFloat3(&m_camPosOS, XMVector3Transform(camPos, XMMatrixInverse(nullptr, mWorld)));
+
+	XMFLOAT4X4 worldView;
+	XMStoreFloat4x4(&worldView, mWorldView);
+	m_depthVS = XMFLOAT4(worldView._13, worldView._23, worldView._33, worldView._43);
+
+	// The depth buffer is cleared to the far plane, there is no geometry in front of the volume
+	m_farZ = XMVectorGetZ(XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, 1.0f, 1.0f), XMMatrixInverse(nullptr, mProj)));
+
+	const int tilesX = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+	const int tilesY = (m_height + TILE_SIZE - 1) / TILE_SIZE;
+	std::atomic<uint64_t> numRays(0), numSamples(0);
+	Parallel::forRange(0, tilesX * tilesY, [&](int first, int last)
+	{
+		uint64_t rays = 0, samples = 0;
+		for (int tile = first; tile < last; ++tile)
+			renderTile(tile % tilesX, tile / tilesX, rays, samples);
+		numRays += rays;
+		numSamples += samples;
+	}, m_threads);
+
+	m_samplesPerRay = numRays > 0 ? static_cast<double>(numSamples) / numRays : 0.0;
+	m_renderTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void VolumeRaycaster::renderTile(int tileX, int tileY, uint64_t& rays, uint64_t& samples)
+{
+	const float stepSize = m_stepSize * std::max(m_voxelSize.x, std::max(m_voxelSize.y, m_voxelSize.z));
+	const float ocExp = m_stepSize / 10.0f;
+	const XMFLOAT3 boxMax(m_voxelSize.x * m_resolution.x, m_voxelSize.y * m_resolution.y, m_voxelSize.z * m_resolution.z);
+	const XMMATRIX worldViewProjInv = XMLoadFloat4x4(&m_worldViewProjInv);
+	const XMVECTOR camPos = XMLoadFloat3(&m_camPosOS);
+
+	const size_t resX = m_resolution.x;
+	const size_t sliceSize = resX * m_resolution.y;
+	const __m128 maxCellX = _mm_set1_ps(m_resolution.x - 1.0f);
+	const __m128 maxCellY = _mm_set1_ps(m_resolution.y - 1.0f);
+	const __m128 maxCellZ = _mm_set1_ps(m_resolution.z - 1.0f);
+	const __m128 maxMacrocellX = _mm_set1_ps(m_macrocells.x - 1.0f);
+	const __m128 maxMacrocellY = _mm_set1_ps(m_macrocells.y - 1.0f);
+	const __m128 maxMacrocellZ = _mm_set1_ps(m_macrocells.z - 1.0f);
+	const __m128 invMacrocell = _mm_set1_ps(1.0f / MACROCELL_SIZE);
+	const __m128 maxEntry = _mm_set1_ps(TXFN_RESOLUTION - 1.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 rangeMin = _mm_set1_ps(m_rangeMin);
+	const __m128 invRange = _mm_set1_ps(1.0f / (m_rangeMax - m_rangeMin));
+	const __m128 maxOpacity = _mm_set1_ps(MAX_OPACITY);
+	const __m128 step = _mm_set1_ps(stepSize);
+
+	const int x0 = tileX * TILE_SIZE, x1 = std::min(x0 + TILE_SIZE, m_width);
+	const int y0 = tileY * TILE_SIZE, y1 = std::min(y0 + TILE_SIZE, m_height);
+	for (int py = y0; py < y1; py += 2)
+	{
+		for (int px = x0; px < x1; px += 2)
+		{
+			// Packet of the 2x2 pixels (px, py), (px + 1, py), (px, py + 1), (px + 1, py + 1); the positions are in cells
+			XMFLOAT3 origin[4], dir[4];
+			float tStart[4], tEnd[4], steps[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			int lanes = 0;
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				const int x = px + (lane & 1), y = py + (lane >> 1);
+				tStart[lane] = 0.0f;
+				tEnd[lane] = -1.0f;
+				origin[lane] = XMFLOAT3(0.0f, 0.0f, 0.0f);
+				dir[lane] = XMFLOAT3(0.0f, 0.0f, 0.0f);
+				if (x >= x1 || y >= y1)
+					continue;
+
+				// Pixel center on the near plane, as interpolated from the screen triangle of vsScreenTri
+				const float ndcX = (x + 0.5f) / m_width * 2.0f - 1.0f;
+				const float ndcY = 1.0f - (y + 0.5f) / m_height * 2.0f;
+				XMVECTOR posOS = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 0.0f, 1.0f), worldViewProjInv);
+				XMVECTOR rayDir = XMVector3Normalize(XMVectorSubtract(posOS, camPos));
+
+				XMFLOAT3 pos, d;
+				XMStoreFloat3(&pos, posOS);
+				XMStoreFloat3(&d, rayDir);
+				float tmin = 0.0f, tmax = -1.0f;
+				if (!intersectBox(pos, d, boxMax, tmin, tmax))
+					continue;
+
+				// The view space depth grows linearly along the ray
+				const float depth = pos.x * m_depthVS.x + pos.y * m_depthVS.y + pos.z * m_depthVS.z + m_depthVS.w;
+				const float depthInc = d.x * m_depthVS.x + d.y * m_depthVS.y + d.z * m_depthVS.z;
+				float tFar = std::numeric_limits<float>::infinity();
+				if (depthInc > 0.0f)
+					tFar = (m_farZ - depth) / depthInc;
+				else if (depth > m_farZ)
+					tFar = -std::numeric_limits<float>::infinity();
+
+				tStart[lane] = tmin > 0.0f ? tmin : 0.0f;
+				tEnd[lane] = std::min(tmax, tFar);
+				origin[lane] = XMFLOAT3(pos.x / m_voxelSize.x, pos.y / m_voxelSize.y, pos.z / m_voxelSize.z);
+				dir[lane] = XMFLOAT3(d.x / m_voxelSize.x, d.y / m_voxelSize.y, d.z / m_voxelSize.z);
+				++lanes;
+			}
+			if (lanes == 0)
+				continue;
+			rays += lanes;
+
+			// Texel coordinates of the samples are half a cell below the positions (cell centers)
+			const __m128 ox = _mm_sub_ps(_mm_setr_ps(origin[0].x, origin[1].x, origin[2].x, origin[3].x), half);
+			const __m128 oy = _mm_sub_ps(_mm_setr_ps(origin[0].y, origin[1].y, origin[2].y, origin[3].y), half);
+			const __m128 oz = _mm_sub_ps(_mm_setr_ps(origin[0].z, origin[1].z, origin[2].z, origin[3].z), half);
+			const __m128 dx = _mm_setr_ps(dir[0].x, dir[1].x, dir[2].x, dir[3].x);
+			const __m128 dy = _mm_setr_ps(dir[0].y, dir[1].y, dir[2].y, dir[3].y);
+			const __m128 dz = _mm_setr_ps(dir[0].z, dir[1].z, dir[2].z, dir[3].z);
+			const __m128 start = _mm_loadu_ps(tStart);
+			const __m128 end = _mm_loadu_ps(tEnd);
+
+			__m128 accR = _mm_setzero_ps(), accG = _mm_setzero_ps(), accB = _mm_setzero_ps(), accA = _mm_setzero_ps();
+			for (;;)
+			{
+				const __m128 t = _mm_add_ps(start, _mm_mul_ps(_mm_loadu_ps(steps), step));
+				const __m128 active = _mm_and_ps(_mm_cmple_ps(t, end), _mm_cmplt_ps(accA, maxOpacity));
+				const int activeMask = _mm_movemask_ps(active);
+				if (activeMask == 0)
+					break;
+
+				const __m128 posX = _mm_add_ps(ox, _mm_mul_ps(dx, t));
+				const __m128 posY = _mm_add_ps(oy, _mm_mul_ps(dy, t));
+				const __m128 posZ = _mm_add_ps(oz, _mm_mul_ps(dz, t));
+
+				// Rays within empty macrocells move on to their first sample behind it, where they are tested again
+				int macrocell[3][4];
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(macrocell[0]), _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_add_ps(posX, half), invMacrocell), _mm_setzero_ps()), maxMacrocellX)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(macrocell[1]), _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_add_ps(posY, half), invMacrocell), _mm_setzero_ps()), maxMacrocellY)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(macrocell[2]), _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_add_ps(posZ, half), invMacrocell), _mm_setzero_ps()), maxMacrocellZ)));
+				bool skipped = false;
+				for (int lane = 0; lane < 4; ++lane)
+				{
+					if (!(activeMask & (1 << lane)) || !m_empty[macrocell[0][lane] + m_macrocells.x * (macrocell[1][lane] + static_cast<size_t>(m_macrocells.y) * macrocell[2][lane])])
+						continue;
+
+					const float tLane = tStart[lane] + steps[lane] * stepSize;
+					const float p[3] = { origin[lane].x + dir[lane].x * tLane, origin[lane].y + dir[lane].y * tLane, origin[lane].z + dir[lane].z * tLane };
+					const float d[3] = { dir[lane].x, dir[lane].y, dir[lane].z };
+					float tExit = std::numeric_limits<float>::infinity();
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						if (d[axis] > 0.0f)
+							tExit = std::min(tExit, tLane + ((macrocell[axis][lane] + 1) * MACROCELL_SIZE - p[axis]) / d[axis]);
+						else if (d[axis] < 0.0f)
+							tExit = std::min(tExit, tLane + (macrocell[axis][lane] * MACROCELL_SIZE - p[axis]) / d[axis]);
+					}
+					steps[lane] = std::max(steps[lane] + 1.0f, std::ceil((tExit - tStart[lane]) / stepSize));
+					skipped = true;
+				}
+				if (skipped)
+					continue;
+
+				// Trilinear filtering with the coordinates clamped to the border cells, as the linear sampler with clamped addressing
+				const __m128 cx = _mm_min_ps(_mm_max_ps(posX, _mm_setzero_ps()), maxCellX);
+				const __m128 cy = _mm_min_ps(_mm_max_ps(posY, _mm_setzero_ps()), maxCellY);
+				const __m128 cz = _mm_min_ps(_mm_max_ps(posZ, _mm_setzero_ps()), maxCellZ);
+				const __m128i ix = _mm_cvttps_epi32(cx), iy = _mm_cvttps_epi32(cy), iz = _mm_cvttps_epi32(cz);
+				const __m128 fx = _mm_sub_ps(cx, _mm_cvtepi32_ps(ix));
+				const __m128 fy = _mm_sub_ps(cy, _mm_cvtepi32_ps(iy));
+				const __m128 fz = _mm_sub_ps(cz, _mm_cvtepi32_ps(iz));
+
+				int cellX[4], cellY[4], cellZ[4];
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(cellX), ix);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(cellY), iy);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(cellZ), iz);
+				float corners[8][4];
+				for (int lane = 0; lane < 4; ++lane)
+				{
+					const float* v = m_values + cellX[lane] + resX * cellY[lane] + sliceSize * cellZ[lane];
+					const size_t offX = cellX[lane] + 1u < m_resolution.x ? 1 : 0;
+					const size_t offY = cellY[lane] + 1u < m_resolution.y ? resX : 0;
+					const size_t offZ = cellZ[lane] + 1u < m_resolution.z ? sliceSize : 0;
+					corners[0][lane] = v[0];
+					corners[1][lane] = v[offX];
+					corners[2][lane] = v[offY];
+					corners[3][lane] = v[offY + offX];
+					corners[4][lane] = v[offZ];
+					corners[5][lane] = v[offZ + offX];
+					corners[6][lane] = v[offZ + offY];
+					corners[7][lane] = v[offZ + offY + offX];
+				}
+				const __m128 c00 = lerp(_mm_loadu_ps(corners[0]), _mm_loadu_ps(corners[1]), fx);
+				const __m128 c10 = lerp(_mm_loadu_ps(corners[2]), _mm_loadu_ps(corners[3]), fx);
+				const __m128 c01 = lerp(_mm_loadu_ps(corners[4]), _mm_loadu_ps(corners[5]), fx);
+				const __m128 c11 = lerp(_mm_loadu_ps(corners[6]), _mm_loadu_ps(corners[7]), fx);
+				const __m128 scalar = lerp(lerp(c00, c10, fy), lerp(c01, c11, fy), fz);
+
+				// Transfer function texture with linear filtering between the entry centers
+				const __m128 val = saturate(_mm_mul_ps(_mm_sub_ps(scalar, rangeMin), invRange));
+				const __m128 u = _mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_mul_ps(val, _mm_set1_ps(static_cast<float>(TXFN_RESOLUTION))), half), _mm_setzero_ps()), maxEntry);
+				const __m128i entry = _mm_cvttps_epi32(u);
+				int entries[4];
+				float weights[4];
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(entries), entry);
+				_mm_storeu_ps(weights, _mm_sub_ps(u, _mm_cvtepi32_ps(entry)));
+				__m128 col[4];
+				for (int lane = 0; lane < 4; ++lane)
+				{
+					const float* e0 = m_txfn.data() + 4 * entries[lane];
+					const float* e1 = m_txfn.data() + 4 * std::min(entries[lane] + 1, TXFN_RESOLUTION - 1);
+					col[lane] = lerp(_mm_loadu_ps(e0), _mm_loadu_ps(e1), _mm_set1_ps(weights[lane]));
+				}
+				_MM_TRANSPOSE4_PS(col[0], col[1], col[2], col[3]);
+
+				// Opacity correction; rays, which are done, take no more color
+				float alpha[4];
+				_mm_storeu_ps(alpha, _mm_and_ps(col[3], active));
+				for (int lane = 0; lane < 4; ++lane)
+				{
+					if (alpha[lane] > 0.0f)
+						alpha[lane] = std::min(std::max(1.0f - std::pow(1.0f - std::min(alpha[lane], 1.0f), ocExp), 0.0f), 1.0f);
+				}
+				const __m128 a = _mm_loadu_ps(alpha);
+
+				// Alpha blending
+				const __m128 weight = _mm_mul_ps(_mm_sub_ps(one, accA), a);
+				accR = _mm_min_ps(_mm_add_ps(accR, _mm_mul_ps(weight, col[0])), one);
+				accG = _mm_min_ps(_mm_add_ps(accG, _mm_mul_ps(weight, col[1])), one);
+				accB = _mm_min_ps(_mm_add_ps(accB, _mm_mul_ps(weight, col[2])), one);
+				accA = _mm_min_ps(_mm_add_ps(accA, weight), one);
+
+				for (int lane = 0; lane < 4; ++lane)
+				{
+					if (activeMask & (1 << lane))
+					{
+						steps[lane] += 1.0f;
+						++samples;
+					}
+				}
+			}
+
+			// Store the pixels of the packet
+			__m128 pixels[4] = { accR, accG, accB, accA };
+			_MM_TRANSPOSE4_PS(pixels[0], pixels[1], pixels[2], pixels[3]);
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				const int x = px + (lane & 1), y = py + (lane >> 1);
+				if (x < x1 && y < y1)
+					_mm_storeu_ps(m_image.data() + 4 * (x + static_cast<size_t>(m_width) * y), pixels[lane]);
+			}
+		}
+	}
+}
+
+void VolumeRaycaster::getImageR8G8B8A8(std::vector<uint8_t>& image, const XMFLOAT4& background) const
+{
+	image.resize(m_image.size());
+
+	// Blending as onto the render target (one, inverse source alpha), the background is not premultiplied
+	const float bgAlpha = std::min(std::max(background.w, 0.0f), 1.0f);
+	const float bg[3] = { background.x * bgAlpha, background.y * bgAlpha, background.z * bgAlpha };
+	for (size_t i = 0; i < m_image.size(); i += 4)
+	{
+		const float* pixel = m_image.data() + i;
+		const float transmittance = 1.0f - pixel[3];
+		const float alpha = pixel[3] + transmittance * bgAlpha;
+		const float scale = alpha > 0.0f ? 1.0f / alpha : 0.0f;
+		for (int c = 0; c < 3; ++c)
+			image[i + c] = static_cast<uint8_t>(std::min(std::max((pixel[c] + transmittance * bg[c]) * scale, 0.0f), 1.0f) * 255.0f + 0.5f);
+		image[i + 3] = static_cast<uint8_t>(std::min(std::max(alpha, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+}
+
+bool VolumeRaycaster::writePng(const std::string& path, const XMFLOAT4& background) const
+{
+	if (m_image.empty())
+	{
+		m_error = "No image was rendered.";
+		return false;
+	}
+
+	std::vector<uint8_t> image;
+	getImageR8G8B8A8(image, background);
+	return PngFile::write(path, m_width, m_height, 4, 8, image.data(), 6, &m_error);
+}
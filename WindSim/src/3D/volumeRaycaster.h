@@ -0,0 +1,105 @@
+#ifndef VOLUME_RAYCASTER_H
+#define VOLUME_RAYCASTER_H
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Direct volume rendering of a scalar field on the CPU, for snapshots without a graphics device. The rays are cast as by the Direct pass
+// of VolumeRenderer (volume.fx): one ray per pixel center from the near plane, through the grid box in grid object space, samples every
+// stepSize * max(voxelSize) with trilinear filtering (clamped to the border cells), the transfer function texture filtered linearly, the
+// same opacity correction and front-to-back blending, until the opacity reaches 0.99, the ray leaves the box or passes the far plane
+//
+// The image is split into tiles of 16x16 pixels, which are rendered in parallel; each tile is cast in packets of 2x2 rays with SSE. Every
+// ray keeps its own position along its samples, so the rays of a packet may skip at different places. The grid is split into macrocells of
+// 8^3 cells, which keep the range of the values their samples may interpolate (with the neighbouring cells). Macrocells, whose range only
+// maps to transparent entries of the transfer function, are skipped to the next sample behind them, so the image is the same as without
+// skipping
+class VolumeRaycaster
+{
+public:
+	static const int TXFN_RESOLUTION = 64; // Entries of the transfer function texture of VolumeRenderer
+
+	VolumeRaycaster(int threads = 0);
+
+	// One value per cell, x fastest, e.g. a metric of FlowMetrics; the values are not copied and must live until the last render.
+	// The macrocells are built here
+	void setField(const float* values, const DirectX::XMUINT3& resolution, const DirectX::XMFLOAT3& voxelSize);
+
+	// <texture> as from TransferFunction::getTexR8G8B8A8 (RGBA8 per entry); <rangeMin> and <rangeMax> are mapped to its first and last entry
+	void setTransferFunction(const std::vector<char>& texture, float rangeMin, float rangeMax);
+
+	// Distance of the samples in voxels of the largest voxel size, as the stepSize of the volume settings
+	void setStepSize(float stepSize);
+
+	// Matrices as for VolumeRenderer::render (the world matrix of the grid, left-handed view and projection); the image replaces the last one
+	void render(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection, int width, int height);
+
+	// Premultiplied RGBA of the last image, rows top to bottom
+	const std::vector<float>& getImage() const { return m_image; };
+	int getWidth() const { return m_width; };
+	int getHeight() const { return m_height; };
+
+	// 8 bit RGBA (not premultiplied) of the last image over <background> (RGBA in [0, 1]); a transparent background keeps the opacity of the volume
+	void getImageR8G8B8A8(std::vector<uint8_t>& image, const DirectX::XMFLOAT4& background) const;
+
+	// Writes the last image as 8 bit RGBA PNG over <background>; false on errors (see errorString)
+	bool writePng(const std::string& path, const DirectX::XMFLOAT4& background) const;
+
+	double getRenderTime() const { return m_renderTime; }; // msec of the last render
+	double getSamplesPerRay() const { return m_samplesPerRay; }; // Of the rays, which hit the grid, in the last render
+	float getEmptyMacrocells() const { return m_emptyMacrocells; }; // Fraction of the macrocells, which were skipped in the last render
+
+	const std::string& errorString() const { return m_error; };
+
+private:
+	static const int MACROCELL_SIZE = 8;
+	static const int TILE_SIZE = 16;
+
+	struct Range
+	{
+		float min;
+		float max;
+		bool nan;
+	};
+
+	void buildMacrocells();
+	void classifyMacrocells();
+	void renderTile(int tileX, int tileY, uint64_t& rays, uint64_t& samples);
+
+	int m_threads;
+
+	const float* m_values;
+	DirectX::XMUINT3 m_resolution;
+	DirectX::XMFLOAT3 m_voxelSize;
+
+	std::vector<float> m_txfn; // RGBA in [0, 1] per entry, not premultiplied
+	std::vector<uint8_t> m_nextOpaque; // Per entry, the first entry at or behind it with a non-zero alpha (TXFN_RESOLUTION for none)
+	float m_rangeMin;
+	float m_rangeMax;
+	float m_stepSize;
+
+	DirectX::XMUINT3 m_macrocells; // Macrocells per axis
+	std::vector<Range> m_macrocellRanges;
+	std::vector<uint8_t> m_empty; // Per macrocell, for the current transfer function and range
+	bool m_classified;
+
+	// Of the current render
+	DirectX::XMFLOAT4X4 m_worldViewProjInv;
+	DirectX::XMFLOAT3 m_camPosOS;
+	DirectX::XMFLOAT4 m_depthVS; // Row of the world view matrix, which gives the view space depth of a position in grid object space
+	float m_farZ;
+
+	std::vector<float> m_image;
+	int m_width;
+	int m_height;
+
+	double m_renderTime;
+	double m_samplesPerRay;
+	float m_emptyMacrocells;
+	mutable std::string m_error;
+};
+
+#endif
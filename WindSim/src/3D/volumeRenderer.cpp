@@ -82,6 +82,8 @@ VolumeRenderer::VolumeRenderer()
 	, m_rangeMin(0.0)
 	, m_rangeMax(1000.0)
 	, m_stepSize(0.5)
+	, m_autoRange(false)
+	, m_rangeFromStatistics(false)
 {
 }
 
@@ -204,19 +206,56 @@ void VolumeRenderer::changeSettings(ID3D11Device* device, const QJsonObject& set
 {
 	m_enabled = settings["enabled"].toBool();
 	const QString& metric = settings["metric"].toString();
+	Metric::Volume previousMetric = m_metric;
 	m_metric = Metric::toMetric(metric);
+	bool autoRange = settings["autoRange"].toBool();
 
 	TransferFunction txfn = TransferFunction::fromJson(settings["transferFunctions"].toObject()[metric].toObject());
 
 	if (createFunction)
 		createTxFn(device, txfn);
 
-	m_rangeMin = txfn.rangeMin;
-	m_rangeMax = txfn.rangeMax;
+	// The automatic range is kept while only the transfer function changes
+	if (!autoRange || !m_autoRange || m_metric != previousMetric || !m_rangeFromStatistics)
+	{
+		m_rangeMin = txfn.rangeMin;
+		m_rangeMax = txfn.rangeMax;
+		m_rangeFromStatistics = false;
+	}
+	m_autoRange = autoRange;
 
 	m_stepSize = max(0.001, settings["stepSize"].toDouble());
 }
 
+void VolumeRenderer::updateRange(const FieldStatistics::Result& statistics)
+{
+	if (statistics.count == 0)
+		return;
+
+	double rangeMin = statistics.percentile(0.01);
+	double rangeMax = statistics.percentile(0.99);
+	if (rangeMax <= rangeMin)
+	{
+		// Constant field
+		double pad = max(std::abs(rangeMax), 1.0e-6);
+		rangeMin -= pad;
+		rangeMax += pad;
+	}
+
+	if (!m_rangeFromStatistics)
+	{
+		m_rangeMin = rangeMin;
+		m_rangeMax = rangeMax;
+		m_rangeFromStatistics = true;
+		return;
+	}
+
+	// Exponential smoothing, so single steps do not make the rendering flicker
+	const double smoothing = 0.1;
+	m_rangeMin += (rangeMin - m_rangeMin) * smoothing;
+	m_rangeMax += (rangeMax - m_rangeMax) * smoothing;
+}
+
 HRESULT VolumeRenderer::createTxFn(ID3D11Device* device, const TransferFunction& txfn)
 {
 	SAFE_RELEASE(m_txfnTex);
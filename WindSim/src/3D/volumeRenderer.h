@@ -2,6 +2,7 @@
 #define VOLUME_RENDERER_H
 
 #include "transferFunction.h"
+#include "fieldStatistics.h"
 
 #include <string>
 #include <Windows.h>
@@ -37,6 +38,12 @@ public:
 
 	void changeSettings(ID3D11Device* device, const QJsonObject& settings, bool createFunction = true);
 
+	// With "autoRange" in the settings, the range of the transfer function follows the statistics of the shown metric: the 1st and 99th
+	// percentile, smoothed over the steps; the range of the transfer function applies until the first statistics arrive
+	bool isAutoRange() const { return m_enabled && m_autoRange; };
+	Metric::Volume getMetric() const { return m_metric; };
+	void updateRange(const FieldStatistics::Result& statistics);
+
 private:
 	struct ShaderVariables
 	{
@@ -78,6 +85,8 @@ private:
 	double m_rangeMin;
 	double m_rangeMax;
 	double m_stepSize;
+	bool m_autoRange;
+	bool m_rangeFromStatistics; // The range has been set by updateRange since the metric or the mode changed
 };
 
 
@@ -5,6 +5,9 @@
 #include "depthStencil.h"
 #include "dx11renderer.h"
 #include "settings.h"
+#include "distanceField.h"
+#include "solidFraction.h"
+#include "brickFile.h"
 
 #include <d3d11.h>
 #include <d3dcompiler.h>
@@ -14,14 +17,21 @@
 #include <QFileInfo>
 #include <QPropertyAnimation>
 
+#include <algorithm>
 #include <mutex>
 #include <future>
+#include <chrono>
 #include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+#include <cmath>
 
 using namespace DirectX;
 
 static float s_t = 0.1;
 static float s_time = 0.0;
+static const int s_benchmarkRuns = 10; // Of each voxelization in the benchmark, the fastest counts
 
 VoxelGrid::VoxelGrid(ObjectManager* manager, const QString& windTunnelSettings, XMUINT3 resolution, XMFLOAT3 voxelSize, DX11Renderer* renderer, QObject* parent)
 	: QObject(parent),
@@ -30,6 +40,7 @@ VoxelGrid::VoxelGrid(ObjectManager* manager, const QString& windTunnelSettings,
 	m_resolution(resolution),
 	m_voxelSize(voxelSize),
 	m_voxelType(Solid),
+	m_voxelizationMode(VoxelizationMode::Rasterization),
 	m_glyphQuantity(32, 32),
 	m_glyphOrientation(XY_PLANE),
 	m_glyphPosition(0.5),
@@ -45,6 +56,10 @@ VoxelGrid::VoxelGrid(ObjectManager* manager, const QString& windTunnelSettings,
 	m_renderGlyphs(false),
 	m_calculateDynamics(true),
 	m_conservative(true),
+	m_computeFractions(false),
+	m_classifyCells(true),
+	m_removeCavities(true),
+	m_boundaryFaces(),
 	m_gridTextureGPU(nullptr),
 	m_gridAllTextureGPU(nullptr),
 	m_gridAllTextureStaging(nullptr),
@@ -52,18 +67,46 @@ VoxelGrid::VoxelGrid(ObjectManager* manager, const QString& windTunnelSettings,
 	m_gridSRV(nullptr),
 	m_gridAllUAV(nullptr),
 	m_gridAllSRV(nullptr),
+	m_cpuGrid(),
+	m_importFile(),
+	m_exportFile(),
+	m_checkpointFile(),
+	m_restoreFile(),
+	m_voxelizationQueries(),
+	m_voxelizationQueryPending(false),
+	m_benchmarkFile(),
+	m_solidFractions(),
+	m_fractionsTask(),
 	m_velocityTexture(nullptr),
 	m_velocityTextureStaging(nullptr),
 	m_velocitySRV(nullptr),
 	m_pressureTexture(nullptr),
 	m_pressureTextureStaging(nullptr),
 	m_pressureSRV(nullptr),
+	m_glyphTexture(nullptr),
+	m_glyphSRV(nullptr),
+	m_glyphTextureResolution(0, 0, 0),
+	m_glyphLevel(0),
+	m_glyphStep(-1),
 	m_wtRenderer(windTunnelSettings.toStdString()),
 	m_wtSettings(windTunnelSettings),
 	m_lastMod(QFileInfo(windTunnelSettings).lastModified()),
 	m_volumeRenderer(),
+	m_signals(),
+	m_statistics(conf.cpu.threads),
+	m_probes(512, conf.cpu.threads),
+	m_slices(16, conf.cpu.threads),
+	m_pyramid(conf.cpu.threads),
 	m_simulator(windTunnelSettings, resolution, voxelSize, m_renderer),
-	m_simulationThread()
+	m_simulationThread(),
+	m_recorder(),
+	m_publisher(),
+	m_playback(),
+	m_playbackTime(0.0),
+	m_playbackRate(1.0),
+	m_playbackFrame(-1),
+	m_playbackSeek(true),
+	m_playbackDensitySum()
 {
 	createGridData();
 
@@ -91,6 +134,14 @@ VoxelGrid::VoxelGrid(ObjectManager* manager, const QString& windTunnelSettings,
 	connect(&m_simulator, &Simulator::simUpdated, this, &VoxelGrid::enableGridUpdate);
 	connect(&m_simulator, &Simulator::simulatorReady, this, &VoxelGrid::simulatorReady);
 
+	if (conf.pub.enabled)
+		startPublishing();
+	m_probes.setStatistics(&m_signals);
+	m_simulator.setSignalStatistics(&m_signals);
+	m_simulator.addStepListener(&m_probes); // Returns right away without probes
+	m_simulator.addStepListener(&m_slices); // Returns right away until opened
+	m_simulator.addStepListener(&m_pyramid); // Returns right away until enabled
+
 	m_simulationThread.start(QThread::TimeCriticalPriority);
 }
 
@@ -99,6 +150,9 @@ VoxelGrid::~VoxelGrid()
 	emit stopSimulation();
 	m_simulator.continueSim(true);
 	m_simulationThread.wait(); // Wait until simulation thread finished
+	stopRecording();
+	stopPublishing();
+	m_playback.close();
 }
 
 
@@ -181,6 +235,12 @@ QJsonObject VoxelGrid::getVoxelSettingsDefault()
 	return QJsonObject{ { "enabled", false }, { "type", Solid } };
 }
 
+QJsonObject VoxelGrid::getVoxelizationSettingsDefault()
+{
+	QJsonObject faces{ { "-x", "Inflow" }, { "+x", "Outflow" }, { "-y", "SolidSlip" }, { "+y", "SolidSlip" }, { "-z", "SolidSlip" }, { "+z", "SolidSlip" } };
+	return QJsonObject{ { "mode", "Rasterization" }, { "file", "" }, { "fractions", false }, { "classify", true }, { "removeCavities", true }, { "faces", faces } };
+}
+
 QJsonObject VoxelGrid::getGlyphSettingsDefault(XMUINT3 resolution)
 {
 	QJsonObject tmp{ { "x", static_cast<int>(resolution.x) }, { "y", static_cast<int>(resolution.y) } };
@@ -229,6 +289,15 @@ HRESULT VoxelGrid::create(ID3D11Device* device, bool clearClientBuffers)
 	td.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
 	V_RETURN(device->CreateTexture3D(&td, nullptr, &m_gridAllTextureStaging));
 
+	// Queries for timing the rasterized voxelization
+	D3D11_QUERY_DESC qd = {};
+	qd.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+	V_RETURN(device->CreateQuery(&qd, &m_voxelizationQueries[0]));
+	qd.Query = D3D11_QUERY_TIMESTAMP;
+	V_RETURN(device->CreateQuery(&qd, &m_voxelizationQueries[1]));
+	V_RETURN(device->CreateQuery(&qd, &m_voxelizationQueries[2]));
+	m_voxelizationQueryPending = false;
+
 
 	// Create velocity field textures
 	// Use one staging texture for writing the velocities from CPU to GPU and use CopyResource to copy the staging texture to a GPU usable default texture
@@ -289,12 +358,17 @@ void VoxelGrid::release()
 	SAFE_RELEASE(m_gridSRV);
 	SAFE_RELEASE(m_gridAllUAV);
 	SAFE_RELEASE(m_gridAllSRV);
+	for (auto& query : m_voxelizationQueries)
+		SAFE_RELEASE(query);
 	SAFE_RELEASE(m_velocityTexture);
 	SAFE_RELEASE(m_velocityTextureStaging);
 	SAFE_RELEASE(m_velocitySRV);
 	SAFE_RELEASE(m_pressureTexture);
 	SAFE_RELEASE(m_pressureTextureStaging);
 	SAFE_RELEASE(m_pressureSRV);
+	SAFE_RELEASE(m_glyphTexture);
+	SAFE_RELEASE(m_glyphSRV);
+	m_glyphLevel = 0;
 	m_wtRenderer.release();
 	m_volumeRenderer.release();
 }
@@ -304,8 +378,15 @@ void VoxelGrid::render(ID3D11Device* device, ID3D11DeviceContext* context, const
 	//QElapsedTimer timer;
 	//timer.start();
 
+	// Probes stay in place in world space, when the grid is moved or resized
+	m_probes.setGridTransform(world, m_voxelSize);
+
+	// A recording replaces the simulation results; pending results are processed after the playback
+	if (m_playback.isOpen() && m_dynamicsCounter == -1)
+		updatePlayback(context, elapsedTime);
+
 	// Process simulation results
-	if (m_simAvailable && m_processSimResults && m_dynamicsCounter == -1)
+	if (m_simAvailable && m_processSimResults && m_dynamicsCounter == -1 && !m_playback.isOpen())
 	{
 		m_simTimeStep = m_simulator.getTimeStep();
 		s_time += m_simTimeStep;
@@ -317,7 +398,7 @@ void VoxelGrid::render(ID3D11Device* device, ID3D11DeviceContext* context, const
 		}
 		QElapsedTimer t;
 		t.start();
-		updateVelocityPressure(context);
+		updateVelocityPressure(context, m_simulator.getVelocity(), m_simulator.getPressure());
 		OutputDebugStringA(("INFO: Update velocity lasted " + std::to_string(t.nsecsElapsed() * 1e-6) + "msec\n").c_str());
 		t.restart();
 		m_wtRenderer.updateDensity(context, m_simulator.getDensity(), m_simulator.getDensitySum());
@@ -326,6 +407,22 @@ void VoxelGrid::render(ID3D11Device* device, ID3D11DeviceContext* context, const
 		m_wtRenderer.updateLines(context, m_simulator.getLines(), m_simulator.getReseedCounter(), m_simulator.getNumLines());
 		m_processSimResults = false;
 		OutputDebugStringA(("INFO: Update lines lasted " + std::to_string(t.nsecsElapsed() * 1e-6) + "msec\n").c_str());
+		if (!m_exportFile.isEmpty())
+		{
+			writeFields(m_exportFile);
+			m_exportFile.clear();
+		}
+		// The simulator waits for continueSim, so its solver is idle
+		if (!m_checkpointFile.isEmpty())
+		{
+			writeCheckpoint(m_checkpointFile);
+			m_checkpointFile.clear();
+		}
+		if (!m_restoreFile.isEmpty())
+		{
+			readCheckpoint(m_restoreFile);
+			m_restoreFile.clear();
+		}
 		m_simulator.continueSim();
 		m_dynamicsCounter = 0;
 	}
@@ -338,6 +435,14 @@ void VoxelGrid::render(ID3D11Device* device, ID3D11DeviceContext* context, const
 	if (m_dynamicsCounter > -1)
 		m_dynamicsCounter++;
 
+	// The benchmark reuses the voxelization textures, so it waits until no voxelization is copied to the simulation
+	if (!m_benchmarkFile.isEmpty() && m_voxelizationCounter == -1)
+	{
+		runVoxelizationBenchmark(device, context, world, m_benchmarkFile);
+		m_benchmarkFile.clear();
+		m_voxelize = true; // Restore the grid of the current mode
+	}
+
 	// Voxelization
 	if (m_voxelize)
 	{
@@ -354,7 +459,8 @@ void VoxelGrid::render(ID3D11Device* device, ID3D11DeviceContext* context, const
 	}
 	// Make sure, the cpu only accesses the voxel grid if the GPU copying is done, to avoid pipeline stalling ( GPU copying needs 2 frames)
 	// Additionally only copy to cpu if former grid was written to shared memory and upgrad is necessary or simulation should be reinitialized
-	if (m_voxelizationCounter >= 2)
+	// The solid fractions of the same voxelization may still be computed on their worker thread
+	if (m_voxelizationCounter >= 2 && (!m_fractionsTask.valid() || m_fractionsTask.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
 	{
 		copyGrid(context);
 
@@ -374,13 +480,23 @@ void VoxelGrid::render(ID3D11Device* device, ID3D11DeviceContext* context, const
 	if (m_voxelizationCounter > -1)
 		m_voxelizationCounter++;
 
+	if (m_voxelizationQueryPending)
+	{
+		double msec = readVoxelizationTiming(context);
+		if (msec >= 0.0)
+			OutputDebugStringA(("INFO: Rasterized voxelization lasted " + std::to_string(msec) + "msec on the GPU\n").c_str());
+	}
+
 	renderGridBox(device, context, world, view, projection);
 
 	if (m_renderVoxel)
 		renderVoxel(device, context, world, view, projection);
 
 	if (m_renderGlyphs)
+	{
+		updateGlyphLevel(device, context);
 		renderGlyphs(device, context, world, view, projection);
+	}
 
 	//OutputDebugStringA(("INFO: VoxelGrid render lasted " + std::to_string(timer.nsecsElapsed() * 1e-6) + "msec\n").c_str());
 }
@@ -390,6 +506,10 @@ void VoxelGrid::renderVolume(ID3D11Device* device, ID3D11DeviceContext* context,
 
 	DepthStencil::update(context);
 
+	StepStatistics::Snapshot statistics;
+	if (m_volumeRenderer.isAutoRange() && m_statistics.takeLatest(statistics) && statistics.metric == FlowMetrics::Type(m_volumeRenderer.getMetric()))
+		m_volumeRenderer.updateRange(statistics.values);
+
 	m_volumeRenderer.render(context, m_velocitySRV, DepthStencil::srv(), world, view, projection, m_resolution, m_voxelSize);
 
 	XMFLOAT3 gridPos;
@@ -413,17 +533,35 @@ bool VoxelGrid::resize(XMUINT3 resolution, XMFLOAT3 voxelSize)
 	if (resEqual && vsEqual)
 		return false;
 
+	if (m_recorder.isOpen())
+	{
+		log("INFO: The grid dimensions changed, the recording is stopped.");
+		stopRecording();
+	}
+	if (m_playback.isOpen())
+	{
+		log("INFO: The grid dimensions changed, the playback is stopped.");
+		stopPlayback();
+	}
+
 	m_resolution = resolution;
 	m_voxelSize = voxelSize;
 
+	// The subscribers follow to the ring of the new dimensions
+	if (m_publisher.isOpen())
+		startPublishing();
+
 	// Recreate with new dimensions
 	createGridData();
 	create(m_renderer->getDevice(), false);
 
+	// The flow of the old grid can not be carried over, not even by solvers with checkpoints
+	log("INFO: The grid dimensions changed, the flow restarts from rest.");
 	emit gridResized(m_resolution, m_voxelSize);
 
 	s_t = 0.1f;
 	s_time = 0.0f;
+	m_signals.clear();
 
 	m_updateGrid = false;
 	m_processSimResults = false;
@@ -443,6 +581,76 @@ void VoxelGrid::setVoxelSettings(const QJsonObject& settings)
 	m_voxelType = VoxelType(settings["type"].toInt());
 }
 
+void VoxelGrid::setVoxelizationSettings(const QJsonObject& settings)
+{
+	VoxelizationMode mode = VoxelizationMode::Rasterization;
+	if (settings["mode"].toString() == "DistanceField")
+		mode = VoxelizationMode::DistanceField;
+	else if (settings["mode"].toString() == "File")
+		mode = VoxelizationMode::File;
+	bool fractions = settings["fractions"].toBool();
+
+	// Cell classification only affects the grid handed to the simulation
+	bool classify = settings["classify"].toBool(true);
+	bool removeCavities = settings["removeCavities"].toBool(true);
+	CellClassifier::Faces faces;
+	QJsonObject facesJson = settings["faces"].toObject();
+	const char* faceNames[] = { "-x", "+x", "-y", "+y", "-z", "+z" };
+	for (int i = 0; i < CellClassifier::NUM_FACES; ++i)
+	{
+		if (!facesJson.contains(faceNames[i]))
+			continue;
+
+		QString type = facesJson[faceNames[i]].toString();
+		if (type == "Fluid")
+			faces.type[i] = wtl::CELL_TYPE_FLUID;
+		else if (type == "Inflow")
+			faces.type[i] = wtl::CELL_TYPE_INFLOW;
+		else if (type == "Outflow")
+			faces.type[i] = wtl::CELL_TYPE_OUTFLOW;
+		else if (type == "SolidSlip")
+			faces.type[i] = wtl::CELL_TYPE_SOLID_SLIP;
+		else if (type == "SolidNoSlip")
+			faces.type[i] = wtl::CELL_TYPE_SOLID_NO_SLIP;
+		else
+			log("WARNING: Unknown boundary type \"" + type.toStdString() + "\" for grid face " + faceNames[i] + ".");
+	}
+	if (classify != m_classifyCells || removeCavities != m_removeCavities || !std::equal(faces.type, faces.type + CellClassifier::NUM_FACES, m_boundaryFaces.type))
+	{
+		m_classifyCells = classify;
+		m_removeCavities = removeCavities;
+		m_boundaryFaces = faces;
+		m_voxelize = true;
+		m_updateGrid = true;
+	}
+
+	QString file = settings["file"].toString();
+	if (mode == VoxelizationMode::File && file != m_importFile)
+	{
+		m_importFile = file;
+		m_cpuGrid.clear(); // Reload
+		m_voxelize = true;
+		m_updateGrid = true;
+	}
+
+	if (mode == m_voxelizationMode && fractions == m_computeFractions)
+		return;
+
+	if (mode != m_voxelizationMode)
+	{
+		const char* modeNames[] = { "rasterization.", "distance field lookup.", "import from file." };
+		log(std::string("INFO: Voxelization mode changed to ") + modeNames[static_cast<int>(mode)]);
+		m_cpuGrid.clear();
+	}
+	if (fractions != m_computeFractions)
+		log(std::string("INFO: Solid volume fractions ") + (fractions ? "enabled." : "disabled."));
+
+	m_voxelizationMode = mode;
+	m_computeFractions = fractions;
+	m_voxelize = true;
+	m_updateGrid = true;
+}
+
 void VoxelGrid::setGlyphSettings(const QJsonObject& settings)
 {
 	m_renderGlyphs = settings["enabled"].toBool();
@@ -451,9 +659,11 @@ void VoxelGrid::setGlyphSettings(const QJsonObject& settings)
 	m_glyphPosition = settings["position"].toObject()[key].toDouble();
 	QJsonObject json = settings["quantity"].toObject();
 	m_glyphQuantity = XMUINT2(json["x"].toInt(), json["y"].toInt());
+	m_pyramid.setEnabled(m_renderGlyphs);
+	m_glyphStep = -1;
 }
 
-bool VoxelGrid::changeSimSettings(const QString& settingsFile)
+bool VoxelGrid::changeSimSettings(const QString& settingsFile, bool keepFlow)
 {
 	// Currently simulation settings file also contains rendering settings
 	// -> Create new renderer with new file and initialize properly
@@ -468,9 +678,15 @@ bool VoxelGrid::changeSimSettings(const QString& settingsFile)
 	m_wtSettings = settingsFile;
 	m_lastMod = lastMod;
 
-	emit simSettingsChanged(settingsFile);
+	// The simulator continues from a snapshot of the flow; the solver does not change with the settings file
+	keepFlow = keepFlow && m_simulator.supportsCheckpoints();
+	emit simSettingsChanged(settingsFile, keepFlow);
 	s_t = 0.1f;
-	s_time = 0.0f;
+	if (!keepFlow)
+	{
+		s_time = 0.0f;
+		m_signals.clear();
+	}
 
 	m_updateGrid = false;
 	m_processSimResults = false;
@@ -488,23 +704,29 @@ void VoxelGrid::runSimulation(bool enabled)
 {
 	if (enabled)
 	{
-		emit startSimulation();
-		m_simRunning = true;
-		for (auto& it: m_manager->getActors())
+		if (m_playback.isOpen())
 		{
-			if (it.second->getType() == ObjectType::Mesh)
-				std::dynamic_pointer_cast<MeshActor>(it.second)->setSimRunning(true);
+			log("INFO: The simulation is continued, the playback is stopped.");
+			stopPlayback();
 		}
+		emit startSimulation();
+		m_simRunning = true;
+		setMeshesSimRunning(true);
 	}
 	else
 	{
 		emit pauseSimulation();
 		m_simRunning = false;
-		for (auto& it : m_manager->getActors())
-		{
-			if (it.second->getType() == ObjectType::Mesh)
-				std::dynamic_pointer_cast<MeshActor>(it.second)->setSimRunning(false);
-		}
+		setMeshesSimRunning(false);
+	}
+}
+
+void VoxelGrid::setMeshesSimRunning(bool running)
+{
+	for (auto& it : m_manager->getActors())
+	{
+		if (it.second->getType() == ObjectType::Mesh)
+			std::dynamic_pointer_cast<MeshActor>(it.second)->setSimRunning(running);
 	}
 }
 
@@ -525,16 +747,28 @@ void VoxelGrid::changeLineSettings(const QJsonObject& settings)
 void VoxelGrid::changeVolumeSettings(const QJsonObject& settings)
 {
 	m_volumeRenderer.changeSettings(m_renderer->getDevice(), settings);
+
+	// The statistics are only computed while they are used
+	if (m_volumeRenderer.isAutoRange())
+	{
+		m_statistics.setMetric(FlowMetrics::Type(m_volumeRenderer.getMetric()));
+		m_simulator.addStepListener(&m_statistics);
+	}
+	else
+	{
+		m_simulator.removeStepListener(&m_statistics);
+	}
 }
 
 void VoxelGrid::restartSimulation()
 {
-	if (!changeSimSettings(m_wtSettings))
+	if (!changeSimSettings(m_wtSettings, false))
 	{
 		emit resetSimulation();
 	}
 	s_t = 0.1f;
 	s_time = 0.0f;
+	m_signals.clear();
 }
 
 void VoxelGrid::runSimulationSync(bool enabled)
@@ -615,19 +849,19 @@ void VoxelGrid::createGridData()
 
 }
 
-void VoxelGrid::updateVelocityPressure(ID3D11DeviceContext* context)
+void VoxelGrid::updateVelocityPressure(ID3D11DeviceContext* context, const float* velocity, const float* pressure)
 {
 	// Map staging texture, write velocity field to it, unmap, copy resource to gpu
 	D3D11_MAPPED_SUBRESOURCE msr;
 	context->Map(m_velocityTextureStaging, 0, D3D11_MAP_WRITE, 0, &msr);
-	write3DTexture(&msr, m_simulator.getVelocity().data(), sizeof(float) * 4);
+	write3DTexture(&msr, velocity, sizeof(float) * 4);
 	context->Unmap(m_velocityTextureStaging, 0);
 
 	context->CopyResource(m_velocityTexture, m_velocityTextureStaging);
 
 	// Map staging texture, write pressure field to it, unmap, copy resource to gpu
 	context->Map(m_pressureTextureStaging, 0, D3D11_MAP_WRITE, 0, &msr);
-	write3DTexture(&msr, m_simulator.getPressure().data(), sizeof(float));
+	write3DTexture(&msr, pressure, sizeof(float));
 	context->Unmap(m_pressureTextureStaging, 0);
 
 	context->CopyResource(m_pressureTexture, m_pressureTextureStaging);
@@ -637,10 +871,34 @@ void VoxelGrid::copyGrid(ID3D11DeviceContext* context)
 {
 	// Copy grid cell types
 	std::vector<wtl::CellType>& cellTypes = m_simulator.getCellTypes();
-	D3D11_MAPPED_SUBRESOURCE msr;
-	context->Map(m_gridAllTextureStaging, 0, D3D11_MAP_READ, 0, &msr);
-	read3DTexture(&msr, cellTypes.data(), sizeof(wtl::CellType));
-	context->Unmap(m_gridAllTextureStaging, 0);
+	if (m_voxelizationMode != VoxelizationMode::Rasterization && m_cpuGrid.size() == cellTypes.size())
+	{
+		std::copy(m_cpuGrid.begin(), m_cpuGrid.end(), cellTypes.begin());
+	}
+	else
+	{
+		D3D11_MAPPED_SUBRESOURCE msr;
+		context->Map(m_gridAllTextureStaging, 0, D3D11_MAP_READ, 0, &msr);
+		read3DTexture(&msr, cellTypes.data(), sizeof(wtl::CellType));
+		context->Unmap(m_gridAllTextureStaging, 0);
+	}
+
+	if (m_classifyCells)
+	{
+		QElapsedTimer timer;
+		timer.start();
+		uint64_t reclaimed = CellClassifier::classify(cellTypes.data(), m_resolution, m_boundaryFaces, m_removeCavities, conf.cpu.threads);
+		OutputDebugStringA(("INFO: Cell classification lasted " + std::to_string(timer.nsecsElapsed() * 1e-6) + "msec (" + std::to_string(reclaimed) + " enclosed fluid cells filled)\n").c_str());
+	}
+
+	// Copy solid fractions (cleared if disabled)
+	if (m_fractionsTask.valid())
+		m_fractionsTask.get();
+	std::vector<float>& fractions = m_simulator.getSolidFractions();
+	if (m_computeFractions && m_solidFractions.size() == fractions.size())
+		std::copy(m_solidFractions.begin(), m_solidFractions.end(), fractions.begin());
+	else
+		std::fill(fractions.begin(), fractions.end(), 0.0f);
 }
 
 void VoxelGrid::read3DTexture(D3D11_MAPPED_SUBRESOURCE* msr, void* outData, int bytePerElem)
@@ -728,6 +986,29 @@ void VoxelGrid::voxelize(ID3D11Device* device, ID3D11DeviceContext* context, con
 	//    a 90 deg rotation in 2D is x1 = -x2, x2 = x1; so one of the axises has to be mirrored)
 	// -> On accessing the grid in the pixel shader (voxelGrid.fx -> psVoxelize()), the x and z values a switched (rotation and mirroring)
 
+	// The fractions are computed on the CPU from the same mesh transformations and handed to the simulation with the cell types
+	if (m_computeFractions && copyStaging && m_voxelizationMode != VoxelizationMode::File)
+		computeSolidFractions(world);
+
+	if (m_voxelizationMode == VoxelizationMode::DistanceField)
+	{
+		voxelizeDistanceField(context, world);
+		return;
+	}
+	if (m_voxelizationMode == VoxelizationMode::File)
+	{
+		voxelizeFromFile(context);
+		return;
+	}
+
+	// Time the rasterization on the GPU; the result is read a few frames later without stalling the pipeline
+	bool timeVoxelization = !m_voxelizationQueryPending && m_voxelizationQueries[0];
+	if (timeVoxelization)
+	{
+		context->Begin(m_voxelizationQueries[0]);
+		context->End(m_voxelizationQueries[1]);
+	}
+
 	// Save old renderTarget
 	ID3D11RenderTargetView* tempRTV = nullptr;
 	ID3D11DepthStencilView* tempDSV = nullptr;
@@ -909,6 +1190,13 @@ void VoxelGrid::voxelize(ID3D11Device* device, ID3D11DeviceContext* context, con
 	//s_shaderVariables.gridAllUAV->SetUnorderedAccessView(nullptr);
 	//s_effect->GetTechniqueByIndex(0)->GetPassByName("CellTypeSolidBoundary")->Apply(0, context);
 
+	if (timeVoxelization)
+	{
+		context->End(m_voxelizationQueries[2]);
+		context->End(m_voxelizationQueries[0]);
+		m_voxelizationQueryPending = true;
+	}
+
 	// Copy texture from GPU memory to system memory where it is accessable by the cpu
 	if (copyStaging)
 	{
@@ -924,6 +1212,563 @@ void VoxelGrid::voxelize(ID3D11Device* device, ID3D11DeviceContext* context, con
 	SAFE_RELEASE(tempDSV);
 }
 
+void VoxelGrid::voxelizeDistanceField(ID3D11DeviceContext* context, const XMFLOAT4X4& world)
+{
+	// Every voxel center is transformed into the object space of each mesh and looked up in its cached signed distance field
+	// -> Moving meshes only change the transformation, the cost is independent of the number of triangles
+	QElapsedTimer timer;
+	timer.start();
+
+	m_cpuGrid.assign(static_cast<size_t>(m_resolution.x) * m_resolution.y * m_resolution.z, wtl::CELL_TYPE_FLUID);
+
+	// Voxel Space -> Grid Object Space -> World Space
+	XMMATRIX voxelToWorld = XMMatrixScalingFromVector(XMLoadFloat3(&m_voxelSize)) * XMLoadFloat4x4(&world);
+
+	uint64_t numTested = 0;
+	for (const auto& act : m_manager->getActors())
+	{
+		if (act.second->getType() != ObjectType::Mesh)
+			continue;
+
+		std::shared_ptr<MeshActor> ma = std::dynamic_pointer_cast<MeshActor>(act.second);
+		if (!ma->getVoxelize())
+			continue;
+
+		const DistanceField& df = ma->getMesh().getDistanceField(conf.vox.sdfResolution, conf.vox.sdfBand);
+
+		// Voxel Space -> World Space -> Mesh Object Space
+		XMMATRIX voxelToObj = voxelToWorld * XMMatrixInverse(nullptr, XMLoadFloat4x4(&ma->getDynWorld()));
+
+		// Conservative: every voxel, which may be touched by the surface, is solid
+		// -> Dilate by an upper bound of the half voxel diagonal in object space
+		float dilation = 0.0f;
+		if (m_conservative)
+		{
+			dilation = 0.5f * (XMVectorGetX(XMVector3Length(voxelToObj.r[0])) + XMVectorGetX(XMVector3Length(voxelToObj.r[1])) + XMVectorGetX(XMVector3Length(voxelToObj.r[2])));
+		}
+
+		XMFLOAT4X4 voxelToObject;
+		XMStoreFloat4x4(&voxelToObject, voxelToObj);
+		numTested += df.voxelize(voxelToObject, m_resolution, dilation, m_cpuGrid.data(), conf.cpu.threads);
+	}
+
+	// Upload for voxel rendering; one R32_UINT texel holds 4 cells, so the row pitch in bytes equals the x resolution
+	context->UpdateSubresource(m_gridAllTextureGPU, 0, nullptr, m_cpuGrid.data(), m_resolution.x * sizeof(wtl::CellType), m_resolution.x * m_resolution.y * sizeof(wtl::CellType));
+
+	OutputDebugStringA(("INFO: Distance field voxelization lasted " + std::to_string(timer.nsecsElapsed() * 1e-6) + "msec (" + std::to_string(numTested) + " voxels tested)\n").c_str());
+}
+
+void VoxelGrid::computeSolidFractions(const XMFLOAT4X4& world)
+{
+	// The fractions are computed on a worker thread, while the voxelization is copied to the CPU; copyGrid waits for them
+	// -> The task gets copies of the meshes, which may be modified or removed meanwhile
+	if (m_fractionsTask.valid())
+		m_fractionsTask.wait();
+
+	// World Space -> Grid Object Space -> Voxel Space
+	XMMATRIX worldToVoxel = XMMatrixInverse(nullptr, XMLoadFloat4x4(&world)) * XMMatrixScaling(1.0f / m_voxelSize.x, 1.0f / m_voxelSize.y, 1.0f / m_voxelSize.z);
+
+	auto meshData = std::make_shared<std::vector<std::pair<std::vector<float>, std::vector<uint32_t>>>>();
+	std::vector<SolidFraction::Mesh> meshes;
+	for (const auto& act : m_manager->getActors())
+	{
+		if (act.second->getType() != ObjectType::Mesh)
+			continue;
+
+		std::shared_ptr<MeshActor> ma = std::dynamic_pointer_cast<MeshActor>(act.second);
+		if (!ma->getVoxelize())
+			continue;
+
+		meshData->push_back(std::make_pair(ma->getMesh().getVertexData(), ma->getMesh().getIndexData()));
+		SolidFraction::Mesh mesh;
+		XMStoreFloat4x4(&mesh.objectToVoxel, XMLoadFloat4x4(&ma->getDynWorld()) * worldToVoxel);
+		meshes.push_back(mesh);
+	}
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		meshes[i].vertexData = &(*meshData)[i].first;
+		meshes[i].indexData = &(*meshData)[i].second;
+	}
+
+	const XMUINT3 resolution = m_resolution;
+	const XMFLOAT3 voxelSize = m_voxelSize;
+	m_fractionsTask = std::async(std::launch::async, [this, meshData, meshes, resolution, voxelSize]()
+	{
+		QElapsedTimer timer;
+		timer.start();
+
+		SolidFraction::compute(meshes, resolution, voxelSize, m_solidFractions, conf.cpu.threads);
+
+		OutputDebugStringA(("INFO: Solid fraction computation lasted " + std::to_string(timer.nsecsElapsed() * 1e-6) + "msec (" + std::to_string(meshes.size()) + " meshes)\n").c_str());
+	});
+}
+
+void VoxelGrid::voxelizeFromFile(ID3D11DeviceContext* context)
+{
+	// The imported grid does not depend on the meshes, so it is only loaded once
+	const size_t numCells = static_cast<size_t>(m_resolution.x) * m_resolution.y * m_resolution.z;
+	if (m_cpuGrid.size() != numCells)
+	{
+		QElapsedTimer timer;
+		timer.start();
+
+		m_cpuGrid.assign(numCells, wtl::CELL_TYPE_FLUID);
+
+		BrickReader reader;
+		if (!reader.open(m_importFile))
+		{
+			log("ERROR: Failed to import cell types: " + reader.errorString().toStdString());
+		}
+		else
+		{
+			XMUINT3 res = reader.getResolution();
+			int channel = reader.findChannel("cellTypes");
+			if (res.x != m_resolution.x || res.y != m_resolution.y || res.z != m_resolution.z)
+				log("ERROR: The resolution (" + std::to_string(res.x) + ", " + std::to_string(res.y) + ", " + std::to_string(res.z) + ") of '" + m_importFile.toStdString() + "' does not match the voxel grid.");
+			else if (channel < 0 || reader.getChannels()[channel].elementSize() != sizeof(wtl::CellType))
+				log("ERROR: '" + m_importFile.toStdString() + "' does not contain cell types.");
+			else
+			{
+				reader.readChannel(channel, m_cpuGrid.data(), conf.cpu.threads);
+				log("INFO: Imported cell types from '" + m_importFile.toStdString() + "' in " + std::to_string(timer.nsecsElapsed() * 1e-6) + "msec.");
+			}
+		}
+	}
+
+	context->UpdateSubresource(m_gridAllTextureGPU, 0, nullptr, m_cpuGrid.data(), m_resolution.x * sizeof(wtl::CellType), m_resolution.x * m_resolution.y * sizeof(wtl::CellType));
+}
+
+void VoxelGrid::exportFields(const QString& file)
+{
+	// While running, the simulator fills its output vectors concurrently; they are consistent while it waits for the results to be processed
+	if (m_simRunning)
+		m_exportFile = file;
+	else
+		writeFields(file);
+}
+
+void VoxelGrid::writeFields(const QString& file)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	BrickWriter writer;
+	bool success = writer.open(file, m_resolution, m_voxelSize)
+		&& writer.writeChannel("cellTypes", BrickFile::ElementType::UInt8, 1, m_simulator.getCellTypes().data())
+		&& writer.writeChannel("velocity", BrickFile::ElementType::Float32, 4, m_simulator.getVelocity())
+		&& writer.writeChannel("pressure", BrickFile::ElementType::Float32, 1, m_simulator.getPressure())
+		&& writer.writeChannel("density", BrickFile::ElementType::Float32, 1, m_simulator.getDensity().data())
+		&& (!m_computeFractions || m_voxelizationMode == VoxelizationMode::File || writer.writeChannel("solidFractions", BrickFile::ElementType::Float32, 4, m_simulator.getSolidFractions().data()))
+		&& writer.close();
+
+	if (!success)
+	{
+		log("ERROR: Failed to export voxel grid: " + writer.errorString().toStdString());
+		return;
+	}
+
+	log("INFO: Exported voxel grid to '" + file.toStdString() + "' (" + std::to_string(writer.getNumActiveBricks()) + " of " + std::to_string(writer.getNumBricks()) + " bricks stored densely) in " + std::to_string(timer.nsecsElapsed() * 1e-6) + "msec.");
+}
+
+void VoxelGrid::saveCheckpoint(const QString& file)
+{
+	if (m_simRunning)
+		m_checkpointFile = file;
+	else
+		writeCheckpoint(file);
+}
+
+void VoxelGrid::loadCheckpoint(const QString& file)
+{
+	if (m_simRunning)
+		m_restoreFile = file;
+	else
+		readCheckpoint(file);
+}
+
+void VoxelGrid::startRecording(const QString& file)
+{
+	stopRecording();
+
+	FieldRecorder::Options options;
+	options.errorBound = conf.rec.errorBound;
+	options.interval = conf.rec.interval;
+	options.queueFrames = conf.rec.queueFrames;
+	options.threads = conf.rec.threads;
+	options.policy = conf.rec.dropFrames ? FieldRecorder::Policy::Drop : FieldRecorder::Policy::Block;
+
+	if (!m_recorder.open(file, m_resolution, m_voxelSize, options))
+	{
+		log("ERROR: Failed to start the recording: " + m_recorder.errorString().toStdString());
+		return;
+	}
+
+	m_simulator.addStepListener(&m_recorder);
+	log("INFO: Recording the simulation to '" + file.toStdString() + "'" + (options.errorBound > 0.0f ? " with an error bound of " + std::to_string(options.errorBound) : " lossless") + ".");
+}
+
+void VoxelGrid::stopRecording()
+{
+	if (!m_recorder.isOpen())
+		return;
+
+	m_simulator.removeStepListener(&m_recorder);
+	bool success = m_recorder.close();
+
+	if (!success)
+	{
+		log("ERROR: The recording is incomplete: " + m_recorder.errorString().toStdString());
+		return;
+	}
+
+	double ratio = m_recorder.getCompressedBytes() > 0 ? static_cast<double>(m_recorder.getRawBytes()) / m_recorder.getCompressedBytes() : 0.0;
+	log("INFO: Recorded " + std::to_string(m_recorder.getNumFrames()) + " frames (" + std::to_string(m_recorder.getNumDropped()) + " dropped), compression ratio " + std::to_string(ratio)
+		+ ", " + std::to_string(m_recorder.getNumFrames() > 0 ? m_recorder.getSubmitTime() / m_recorder.getNumFrames() : 0.0) + "msec per frame in the simulation thread.");
+}
+
+void VoxelGrid::startPublishing()
+{
+	m_simulator.removeStepListener(&m_publisher);
+	if (!m_publisher.open(conf.pub.name, m_resolution, m_voxelSize, conf.pub.slots, conf.pub.interval))
+	{
+		log("ERROR: Failed to publish the fields as '" + conf.pub.name + "': " + m_publisher.errorString());
+		return;
+	}
+
+	m_simulator.addStepListener(&m_publisher);
+	log("INFO: Publishing the fields as '" + conf.pub.name + "' (" + std::to_string(m_resolution.x) + "x" + std::to_string(m_resolution.y) + "x" + std::to_string(m_resolution.z) + ").");
+}
+
+void VoxelGrid::stopPublishing()
+{
+	if (!m_publisher.isOpen())
+		return;
+
+	m_simulator.removeStepListener(&m_publisher);
+	double publishTime = m_publisher.getNumPublished() > 0 ? m_publisher.getPublishTime() / m_publisher.getNumPublished() : 0.0;
+	log("INFO: Published " + std::to_string(m_publisher.getNumPublished()) + " steps, " + std::to_string(publishTime) + "msec per step in the simulation thread.");
+	m_publisher.close();
+}
+
+void VoxelGrid::startPlayback(const QString& file)
+{
+	stopPlayback();
+
+	QElapsedTimer timer;
+	timer.start();
+
+	if (!m_playback.open(file, conf.play.prefetchFrames, conf.play.threads, conf.play.loop))
+	{
+		log("ERROR: Failed to open the recording: " + m_playback.errorString().toStdString());
+		return;
+	}
+
+	const FieldRecordingReader& reader = m_playback.getReader();
+	XMUINT3 res = reader.getResolution();
+	if (res.x != m_resolution.x || res.y != m_resolution.y || res.z != m_resolution.z)
+	{
+		log("ERROR: The resolution (" + std::to_string(res.x) + ", " + std::to_string(res.y) + ", " + std::to_string(res.z) + ") of '" + file.toStdString() + "' does not match the voxel grid.");
+		m_playback.close();
+		return;
+	}
+
+	// The solver stays idle during the playback; the meshes follow the recorded flow
+	if (m_simRunning)
+		emit pauseSimulation();
+	setMeshesSimRunning(true);
+
+	m_playbackTime = reader.getFrameInfo(0).time;
+	m_playbackFrame = -1;
+	m_playbackSeek = true;
+	m_playbackDensitySum.assign(static_cast<size_t>(m_resolution.x) * m_resolution.y * m_resolution.z, 0.0f);
+
+	log("INFO: Playing " + std::to_string(reader.getNumFrames()) + " frames of '" + file.toStdString() + "' (opened in " + std::to_string(timer.nsecsElapsed() * 1e-6) + "msec).");
+}
+
+void VoxelGrid::stopPlayback()
+{
+	if (!m_playback.isOpen())
+		return;
+
+	m_playback.close();
+	m_playbackFrame = -1;
+	m_playbackDensitySum = std::vector<float>();
+
+	// Continue a simulation, which was paused by the playback
+	if (m_simRunning)
+		emit startSimulation();
+	else
+		setMeshesSimRunning(false);
+}
+
+void VoxelGrid::seekPlayback(double position)
+{
+	if (!m_playback.isOpen())
+		return;
+
+	const FieldRecordingReader& reader = m_playback.getReader();
+	double start = reader.getFrameInfo(0).time;
+	double end = reader.getFrameInfo(reader.getNumFrames() - 1).time;
+	m_playbackTime = start + std::max(0.0, std::min(position, 1.0)) * (end - start);
+	m_playbackSeek = true;
+}
+
+void VoxelGrid::setPlaybackRate(double rate)
+{
+	m_playbackRate = rate;
+}
+
+void VoxelGrid::benchmarkVoxelization(const QString& file)
+{
+	m_benchmarkFile = file;
+}
+
+void VoxelGrid::updatePlayback(ID3D11DeviceContext* context, double elapsedTime)
+{
+	const FieldRecordingReader& reader = m_playback.getReader();
+	const int numFrames = reader.getNumFrames();
+	double start = reader.getFrameInfo(0).time;
+	double end = reader.getFrameInfo(numFrames - 1).time;
+
+	m_playbackTime += elapsedTime * m_playbackRate;
+	if (m_playbackTime > end || m_playbackTime < start)
+	{
+		double span = end - start;
+		if (conf.play.loop && span > 0.0)
+		{
+			m_playbackTime = start + std::fmod(m_playbackTime - start, span);
+			if (m_playbackTime < start)
+				m_playbackTime += span;
+		}
+		else
+			m_playbackTime = std::max(start, std::min(m_playbackTime, end));
+	}
+
+	int frame = reader.findFrame(m_playbackTime);
+	std::shared_ptr<const FieldRecording::Fields> fields = m_playback.request(frame, m_playbackRate < 0.0 ? -1 : 1);
+	if (!fields || frame == m_playbackFrame)
+		return; // Keep showing the last frame until the requested one is decoded
+
+	// Only integrate the dynamics over the recorded time, if the playback continues forward
+	double timeStep = 0.0;
+	if (!m_playbackSeek && m_playbackFrame >= 0 && frame > m_playbackFrame)
+		timeStep = fields->time - reader.getFrameInfo(m_playbackFrame).time;
+
+	updateVelocityPressure(context, fields->velocity.data(), fields->pressure.data());
+	m_wtRenderer.updateDensity(context, fields->density, m_playbackDensitySum);
+
+	m_playbackFrame = frame;
+	m_playbackSeek = false;
+	m_simTimeStep = static_cast<float>(timeStep);
+	s_time = static_cast<float>(fields->time);
+	m_dynamicsCounter = 0;
+
+	m_renderer->drawInfo(QString::fromStdString("Playback frame " + std::to_string(frame + 1) + "/" + std::to_string(numFrames) + ", step " + std::to_string(fields->step) + ", time " + std::to_string(fields->time) + "s\n"));
+}
+
+void VoxelGrid::writeCheckpoint(const QString& file)
+{
+	if (!m_simAvailable)
+	{
+		log("WARNING: The simulation is being recreated, no checkpoint was written.");
+		return;
+	}
+
+	Simulator::CheckpointData data;
+	data.time = s_time;
+	for (auto it : m_manager->getActors())
+	{
+		if (it.second->getType() != ObjectType::Mesh)
+			continue;
+
+		auto mesh = std::dynamic_pointer_cast<MeshActor>(it.second);
+		if (mesh->getDynamics())
+			data.dynamics.push_back(std::make_pair(mesh->getName(), mesh->getDynamicsState()));
+	}
+
+	m_simulator.saveCheckpoint(file, data);
+}
+
+void VoxelGrid::readCheckpoint(const QString& file)
+{
+	if (!m_simAvailable)
+	{
+		log("WARNING: The simulation is being recreated, the checkpoint was not restored.");
+		return;
+	}
+
+	Simulator::CheckpointData data;
+	if (!m_simulator.loadCheckpoint(file, data))
+		return;
+
+	s_time = data.time;
+	s_t = std::floor(s_time * 10.0f + 1.0f) * 0.1f;
+
+	for (const auto& dynamics : data.dynamics)
+	{
+		bool found = false;
+		for (auto it : m_manager->getActors())
+		{
+			if (it.second->getType() != ObjectType::Mesh || it.second->getName() != dynamics.first)
+				continue;
+
+			std::dynamic_pointer_cast<MeshActor>(it.second)->setDynamicsState(dynamics.second);
+			found = true;
+		}
+		if (!found)
+			log("WARNING: The checkpoint contains dynamics of the mesh '" + dynamics.first + "', which does not exist.");
+	}
+
+	// Voxelize the meshes at their restored rotation
+	m_voxelize = true;
+	m_updateGrid = true;
+}
+
+double VoxelGrid::readVoxelizationTiming(ID3D11DeviceContext* context, bool wait)
+{
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+	HRESULT hr;
+	while ((hr = context->GetData(m_voxelizationQueries[0], &disjoint, sizeof(disjoint), wait ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH)) == S_FALSE && wait)
+		std::this_thread::yield();
+	if (hr != S_OK)
+		return -1.0; // Not yet available
+
+	m_voxelizationQueryPending = false;
+
+	UINT64 start = 0;
+	UINT64 end = 0;
+	if (disjoint.Disjoint || context->GetData(m_voxelizationQueries[1], &start, sizeof(start), 0) != S_OK || context->GetData(m_voxelizationQueries[2], &end, sizeof(end), 0) != S_OK)
+		return -1.0;
+
+	return (end - start) * 1e3 / disjoint.Frequency;
+}
+
+void VoxelGrid::runVoxelizationBenchmark(ID3D11Device* device, ID3D11DeviceContext* context, const XMFLOAT4X4& world, const QString& file)
+{
+	// Every mesh alone and, with several meshes, all of them together, as the simulation receives them: rasterized on the GPU (timed with the
+	// timestamp queries and on the CPU including the copy into system memory) and looked up in the cached distance fields (including the upload
+	// for the voxel rendering; the build of a field is timed separately). The first run of each warms up, the fastest of the others counts
+	// The GPU is waited for after every run, so the frame stalls for the duration of the benchmark
+	std::vector<std::shared_ptr<MeshActor>> meshes;
+	for (const auto& act : m_manager->getActors())
+	{
+		if (act.second->getType() == ObjectType::Mesh && std::dynamic_pointer_cast<MeshActor>(act.second)->getVoxelize())
+			meshes.push_back(std::dynamic_pointer_cast<MeshActor>(act.second));
+	}
+	if (meshes.empty())
+	{
+		log("WARNING: There are no voxelized meshes for the voxelization benchmark.");
+		return;
+	}
+
+	std::ofstream out(file.toStdString(), std::ios::out | std::ios::trunc);
+	if (!out)
+	{
+		log("ERROR: Failed to open '" + file.toStdString() + "' for the voxelization benchmark.");
+		return;
+	}
+	out << std::fixed << std::setprecision(3);
+	out << "mesh,triangles,resolution,conservative,rasterizedGpuMs,rasterizedReadbackMs,distanceFieldBuildMs,distanceFieldMs,rasterizedSolid,distanceFieldSolid,differing" << std::endl;
+
+	// The runs change the mode, the CPU grid (the imported cell types of VoxelizationMode::File) and a pending timing of the regular voxelization
+	const VoxelizationMode mode = m_voxelizationMode;
+	const bool computeFractions = m_computeFractions;
+	std::vector<wtl::CellType> cpuGrid;
+	cpuGrid.swap(m_cpuGrid);
+	m_computeFractions = false;
+	if (m_voxelizationQueryPending)
+		readVoxelizationTiming(context, true);
+
+	// The distance fields are cached by the meshes, so a copy is built for the timing
+	std::vector<double> buildTimes;
+	for (const auto& mesh : meshes)
+	{
+		QElapsedTimer timer;
+		timer.start();
+		DistanceField df;
+		df.build(mesh->getMesh().getVertexData(), mesh->getMesh().getIndexData(), conf.vox.sdfResolution, conf.vox.sdfBand, conf.cpu.threads);
+		buildTimes.push_back(timer.nsecsElapsed() * 1e-6);
+	}
+
+	const size_t numCells = static_cast<size_t>(m_resolution.x) * m_resolution.y * m_resolution.z;
+	std::vector<wtl::CellType> rasterized(numCells);
+	const std::string resolution = std::to_string(m_resolution.x) + "x" + std::to_string(m_resolution.y) + "x" + std::to_string(m_resolution.z);
+
+	// Row i < meshes.size() voxelizes mesh i alone, the last row all meshes
+	const size_t numRows = meshes.size() > 1 ? meshes.size() + 1 : 1;
+	for (size_t i = 0; i < numRows; ++i)
+	{
+		const bool all = i == meshes.size();
+		std::string name = all ? "all" : meshes[i]->getName();
+		uint64_t triangles = 0;
+		double build = 0.0;
+		for (size_t j = 0; j < meshes.size(); ++j)
+		{
+			meshes[j]->setVoxelize(all || i == j);
+			if (all || i == j)
+			{
+				triangles += meshes[j]->getMesh().getNumIndices() / 3;
+				build += buildTimes[j];
+			}
+		}
+
+		double gpu = -1.0;
+		double readback = -1.0;
+		double lookup = -1.0;
+		for (int run = -1; run < s_benchmarkRuns; ++run)
+		{
+			QElapsedTimer timer;
+			timer.start();
+			m_voxelizationMode = VoxelizationMode::Rasterization;
+			voxelize(device, context, world, true);
+			D3D11_MAPPED_SUBRESOURCE msr;
+			context->Map(m_gridAllTextureStaging, 0, D3D11_MAP_READ, 0, &msr); // Waits for the copy
+			read3DTexture(&msr, rasterized.data(), sizeof(wtl::CellType));
+			context->Unmap(m_gridAllTextureStaging, 0);
+			double rasterizedTime = timer.nsecsElapsed() * 1e-6;
+			double gpuTime = readVoxelizationTiming(context, true);
+
+			timer.restart();
+			voxelizeDistanceField(context, world);
+			double lookupTime = timer.nsecsElapsed() * 1e-6;
+
+			if (run < 0)
+				continue;
+			if (gpuTime >= 0.0 && (gpu < 0.0 || gpuTime < gpu))
+				gpu = gpuTime;
+			readback = readback < 0.0 ? rasterizedTime : std::min(readback, rasterizedTime);
+			lookup = lookup < 0.0 ? lookupTime : std::min(lookup, lookupTime);
+		}
+
+		// Both results of the last run
+		uint64_t rasterizedSolid = 0;
+		uint64_t distanceFieldSolid = 0;
+		uint64_t differing = 0;
+		for (size_t c = 0; c < numCells; ++c)
+		{
+			bool r = rasterized[c] != wtl::CELL_TYPE_FLUID;
+			bool d = m_cpuGrid[c] != wtl::CELL_TYPE_FLUID;
+			rasterizedSolid += r;
+			distanceFieldSolid += d;
+			differing += r != d;
+		}
+
+		out << name << "," << triangles << "," << resolution << "," << m_conservative << "," << gpu << "," << readback << "," << build << "," << lookup << ","
+			<< rasterizedSolid << "," << distanceFieldSolid << "," << differing << std::endl;
+		log("INFO: Voxelization of '" + name + "' (" + std::to_string(triangles) + " triangles): rasterized " + std::to_string(gpu) + "msec on the GPU ("
+			+ std::to_string(readback) + "msec with the readback), distance field " + std::to_string(lookup) + "msec (built in " + std::to_string(build) + "msec); "
+			+ std::to_string(differing) + " cells differ, " + std::to_string(rasterizedSolid) + " and " + std::to_string(distanceFieldSolid) + " solid.");
+	}
+
+	for (const auto& mesh : meshes)
+		mesh->setVoxelize(true);
+	m_voxelizationMode = mode;
+	m_computeFractions = computeFractions;
+	m_cpuGrid.swap(cpuGrid);
+
+	log("INFO: Wrote the voxelization benchmark to '" + file.toStdString() + "'.");
+}
+
 void VoxelGrid::renderVoxel(ID3D11Device* device, ID3D11DeviceContext* context, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection)
 {
 	XMMATRIX w = XMLoadFloat4x4(&world);
@@ -955,6 +1800,58 @@ void VoxelGrid::renderVoxel(ID3D11Device* device, ID3D11DeviceContext* context,
 	s_effect->GetTechniqueByIndex(0)->GetPassByName(passName.c_str())->Apply(0, context);
 }
 
+void VoxelGrid::updateGlyphLevel(ID3D11Device* device, ID3D11DeviceContext* context)
+{
+	// Glyphs, which are several cells apart, read the level of the pyramid with about their spacing, so they show the mean flow of the
+	// fluid around them instead of single cells; the shader samples in texture space, so the coarse texture replaces the velocity as it is
+	const float resolution[3] = { static_cast<float>(m_resolution.x), static_cast<float>(m_resolution.y), static_cast<float>(m_resolution.z) };
+	const int axisU = m_glyphOrientation == YZ_PLANE ? 2 : 0;
+	const int axisV = m_glyphOrientation == XZ_PLANE ? 2 : 1;
+	const float spacing = std::min(resolution[axisU] / m_glyphQuantity.x, resolution[axisV] / m_glyphQuantity.y);
+
+	std::shared_ptr<const FieldPyramid::Pyramid> pyramid = m_pyramid.getLatest();
+	const bool current = pyramid && pyramid->resolution.x == m_resolution.x && pyramid->resolution.y == m_resolution.y && pyramid->resolution.z == m_resolution.z;
+	const int levelIndex = current ? FieldPyramid::levelFor(spacing) : 0;
+	const FieldPyramid::Level* level = current ? pyramid->level(levelIndex) : nullptr;
+	if (!level)
+	{
+		m_glyphLevel = 0;
+		return;
+	}
+	if (levelIndex == m_glyphLevel && pyramid->step == m_glyphStep)
+		return;
+
+	if (!m_glyphTexture || level->resolution.x != m_glyphTextureResolution.x || level->resolution.y != m_glyphTextureResolution.y || level->resolution.z != m_glyphTextureResolution.z)
+	{
+		SAFE_RELEASE(m_glyphTexture);
+		SAFE_RELEASE(m_glyphSRV);
+		m_glyphLevel = 0;
+
+		D3D11_TEXTURE3D_DESC td;
+		td.Width = level->resolution.x;
+		td.Height = level->resolution.y;
+		td.Depth = level->resolution.z;
+		td.MipLevels = 1;
+		td.Format = DXGI_FORMAT_R32G32B32A32_FLOAT; // Velocity and pressure in w, which the glyphs ignore
+		td.Usage = D3D11_USAGE_DEFAULT;
+		td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		td.CPUAccessFlags = 0;
+		td.MiscFlags = 0;
+		if (FAILED(device->CreateTexture3D(&td, nullptr, &m_glyphTexture)) || FAILED(device->CreateShaderResourceView(m_glyphTexture, nullptr, &m_glyphSRV)))
+		{
+			SAFE_RELEASE(m_glyphTexture);
+			SAFE_RELEASE(m_glyphSRV);
+			return;
+		}
+		m_glyphTextureResolution = level->resolution;
+	}
+
+	const UINT rowPitch = level->resolution.x * 4 * sizeof(float);
+	context->UpdateSubresource(m_glyphTexture, 0, nullptr, level->values.data(), rowPitch, rowPitch * level->resolution.y);
+	m_glyphLevel = levelIndex;
+	m_glyphStep = pyramid->step;
+}
+
 void VoxelGrid::renderGlyphs(ID3D11Device* device, ID3D11DeviceContext* context, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection)
 {
 	XMMATRIX w = XMLoadFloat4x4(&world);
@@ -978,7 +1875,7 @@ void VoxelGrid::renderGlyphs(ID3D11Device* device, ID3D11DeviceContext* context,
 	s_shaderVariables.glyphPosition->SetFloat(m_glyphPosition);
 	s_shaderVariables.glyphQuantity->SetIntVector(reinterpret_cast<int*>(&m_glyphQuantity));
 
-	s_shaderVariables.velocityField->SetResource(m_velocitySRV);
+	s_shaderVariables.velocityField->SetResource(m_glyphLevel > 0 ? m_glyphSRV : m_velocitySRV);
 
 	s_effect->GetTechniqueByIndex(0)->GetPassByName("VelocityGlyph")->Apply(0, context);
 
@@ -1006,6 +1903,16 @@ void VoxelGrid::calculateDynamics(ID3D11Device* device, ID3D11DeviceContext* con
 		{
 			std::shared_ptr<MeshActor> ma = std::dynamic_pointer_cast<MeshActor>(act.second);
 			ma->calculateDynamics(device, context, worldToVoxelTex, m_resolution, m_voxelSize, conf.dyn.method == Pressure ? m_pressureSRV : m_velocitySRV, elapsedTime);
+
+			// Only with simulated time, not while the playback is paused or seeks
+			if (ma->getDynamics() && elapsedTime > 0.0)
+			{
+				float torque, angVel, angAcc;
+				ma->getAxialMotion(torque, angVel, angAcc);
+				m_signals.add(ma->getName() + "/torque", s_time, torque);
+				m_signals.add(ma->getName() + "/angVel", s_time, angVel);
+				m_signals.add(ma->getName() + "/angAcc", s_time, angAcc);
+			}
 		}
 	}
 }
@@ -6,12 +6,22 @@
 #include "common.h"
 #include "volumeRenderer.h"
 #include "transferFunction.h"
+#include "cellClassifier.h"
+#include "fieldRecording.h"
+#include "fieldPlayback.h"
+#include "fieldPublishing.h"
+#include "stepStatistics.h"
+#include "fieldProbes.h"
+#include "fieldSlices.h"
+#include "fieldPyramid.h"
+#include "signalStatistics.h"
 
 #include <WindTunnelRenderer.h>
 
 #include <DirectXMath.h>
 
 #include <vector>
+#include <future>
 
 #include <QObject>
 #include <QThread>
@@ -29,6 +39,7 @@ struct ID3DX11EffectUnorderedAccessViewVariable;
 struct ID3DX11EffectShaderResourceVariable;
 struct ID3DX11Effect;
 struct ID3D11InputLayout;
+struct ID3D11Query;
 struct D3D11_MAPPED_SUBRESOURCE;
 class Logger;
 
@@ -40,6 +51,7 @@ public:
 	static void releaseShader();
 
 	static QJsonObject getVoxelSettingsDefault();
+	static QJsonObject getVoxelizationSettingsDefault();
 	static QJsonObject getGlyphSettingsDefault(DirectX::XMUINT3 resolution);
 
 	VoxelGrid(ObjectManager* manager, const QString& windTunnelSettings, DirectX::XMUINT3 resolution, DirectX::XMFLOAT3 voxelSize, DX11Renderer* renderer, QObject* parent = nullptr);
@@ -54,13 +66,18 @@ public:
 
 	DirectX::XMUINT3 getResolution() const { return m_resolution; };
 	DirectX::XMFLOAT3 getVoxelSize() const { return m_voxelSize; };
+	FieldProbes& getProbes() { return m_probes; }; // Probes in world space, sampled after every simulation step
+	FieldSlices& getSlices() { return m_slices; }; // Planes of the fields, written after every simulation step once opened
+	SignalStatistics& getSignals() { return m_signals; }; // Of the dynamics of the meshes and of the probes, shown in the info overlay
+	FieldPyramid& getPyramid() { return m_pyramid; }; // Coarse levels of velocity and pressure, built after every simulation step while enabled
 
 	// GUI Settings
 	bool resize(DirectX::XMUINT3 resolution, DirectX::XMFLOAT3 voxelSize);
 	void setVoxelize(bool voxelize) { m_voxelize = voxelize; };
 	void setVoxelSettings(const QJsonObject& settings);
+	void setVoxelizationSettings(const QJsonObject& settings);
 	void setGlyphSettings(const QJsonObject& settings);
-	bool changeSimSettings(const QString& settingsFile);
+	bool changeSimSettings(const QString& settingsFile, bool keepFlow = true); // The flow is kept if the solver supports checkpoints
 	void runSimulation(bool enabled);
 	void changeSmokeSettings(const QJsonObject& settings);
 	void changeLineSettings(const QJsonObject& settings);
@@ -69,6 +86,16 @@ public:
 	void changeVolumeSettings(const QJsonObject& txfn);
 
 	void restartSimulation();
+	void exportFields(const QString& file); // Write cell types and simulation fields to a brick file (with the next simulation results, if running)
+	void saveCheckpoint(const QString& file); // Snapshot of the flow, mesh dynamics and simulated time (with the next simulation results, if running)
+	void loadCheckpoint(const QString& file); // Continue from a checkpoint of a grid with the same dimensions and solver
+	void startRecording(const QString& file); // Record the fields of the following steps in the background (see FieldRecorder)
+	void stopRecording();
+	void startPlayback(const QString& file); // Show a recording instead of the simulation, which is paused meanwhile
+	void stopPlayback();
+	void seekPlayback(double position); // Relative position in the recorded time span [0, 1]
+	void setPlaybackRate(double rate); // Recorded seconds per second; negative plays backwards, 0 pauses
+	void benchmarkVoxelization(const QString& file); // Time the rasterized and the distance field voxelization of every mesh and write a CSV file (with the next idle frame)
 	void runSimulationSync(bool enabled);
 
 public slots:
@@ -79,7 +106,7 @@ public slots:
 signals:
 	void gridUpdated();
 	void gridResized(const DirectX::XMUINT3& resolution, const DirectX::XMFLOAT3& voxelSize);
-	void simSettingsChanged(const QString& settingsFile);
+	void simSettingsChanged(const QString& settingsFile, bool keepFlow);
 	void resetSimulation();
 	void startSimulation();
 	void stopSimulation();
@@ -90,7 +117,9 @@ signals:
 
 private:
 	void createGridData(); // Create cube for line rendering
-	void updateVelocityPressure(ID3D11DeviceContext* context);
+	void updateVelocityPressure(ID3D11DeviceContext* context, const float* velocity, const float* pressure);
+	void updatePlayback(ID3D11DeviceContext* context, double elapsedTime);
+	void setMeshesSimRunning(bool running);
 	void copyGrid(ID3D11DeviceContext* context);
 	void read3DTexture(D3D11_MAPPED_SUBRESOURCE* msr, void* outData, int bytePerElem = 1);
 	void write3DTexture(D3D11_MAPPED_SUBRESOURCE* msr, const void* inData, int bytePerElem = 1);
@@ -98,7 +127,18 @@ private:
 
 	void renderGridBox(ID3D11Device* device, ID3D11DeviceContext* context, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection);
 	void voxelize(ID3D11Device* device, ID3D11DeviceContext* context, const DirectX::XMFLOAT4X4& world, bool copyStaging);
+	void voxelizeDistanceField(ID3D11DeviceContext* context, const DirectX::XMFLOAT4X4& world);
+	void computeSolidFractions(const DirectX::XMFLOAT4X4& world);
+	void voxelizeFromFile(ID3D11DeviceContext* context);
+	void writeFields(const QString& file);
+	void writeCheckpoint(const QString& file);
+	void readCheckpoint(const QString& file);
+	void startPublishing(); // Publish the steps for other processes with the current dimensions ([Publishing] section of the settings)
+	void stopPublishing();
+	double readVoxelizationTiming(ID3D11DeviceContext* context, bool wait = false); // msec of the last rasterization on the GPU, negative if not (yet) available
+	void runVoxelizationBenchmark(ID3D11Device* device, ID3D11DeviceContext* context, const DirectX::XMFLOAT4X4& world, const QString& file);
 	void renderVoxel(ID3D11Device* device, ID3D11DeviceContext* context, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection);
+	void updateGlyphLevel(ID3D11Device* device, ID3D11DeviceContext* context);
 	void renderGlyphs(ID3D11Device* device, ID3D11DeviceContext* context, const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection);
 	void calculateDynamics(ID3D11Device* device, ID3D11DeviceContext* context, const DirectX::XMFLOAT4X4& world, double elapsedTime);
 
@@ -139,6 +179,7 @@ private:
 	DirectX::XMUINT3 m_resolution; // Resolution of the grid
 	DirectX::XMFLOAT3 m_voxelSize; // Size of one voxel in object space of the grid
 	VoxelType m_voxelType;
+	VoxelizationMode m_voxelizationMode;
 	DirectX::XMUINT2 m_glyphQuantity;
 	Orientation m_glyphOrientation;
 	float m_glyphPosition;
@@ -157,6 +198,10 @@ private:
 	bool m_renderGlyphs;
 	bool m_calculateDynamics;
 	bool m_conservative;
+	bool m_computeFractions; // Compute the exact solid volume fraction of the boundary voxels along with the cell types
+	bool m_classifyCells; // Classify grid faces and solid boundary cells before handing the grid to the simulation
+	bool m_removeCavities; // Fill enclosed fluid pockets during the classification
+	CellClassifier::Faces m_boundaryFaces;
 
 	float m_simTimeStep;
 
@@ -168,6 +213,17 @@ private:
 	ID3D11UnorderedAccessView* m_gridAllUAV; // UAV for all Voxelizations
 	ID3D11ShaderResourceView* m_gridAllSRV; // SRV for volume rendering
 
+	std::vector<wtl::CellType> m_cpuGrid; // Result of the distance field voxelization or the imported cell types, replaces the staging texture in these modes
+	QString m_importFile; // Brick file with the cell types for VoxelizationMode::File
+	QString m_exportFile; // Pending export, written as soon as the simulation results are consistent
+	QString m_checkpointFile; // Pending checkpoint, written while the simulator waits for its results to be processed
+	QString m_restoreFile; // Pending restore, see m_checkpointFile
+	ID3D11Query* m_voxelizationQueries[3]; // Timestamp disjoint, start and end queries for timing the rasterized voxelization on the GPU
+	bool m_voxelizationQueryPending;
+	QString m_benchmarkFile; // Pending voxelization benchmark, run when no voxelization is on its way to the simulation
+	std::vector<float> m_solidFractions; // Result of the last voxelization which is copied to the simulation (see SolidFraction::compute)
+	std::future<void> m_fractionsTask; // Computes m_solidFractions on a worker thread; the grid is copied to the simulation once it is done
+
 	ID3D11Texture3D* m_velocityTexture;
 	ID3D11Texture3D* m_velocityTextureStaging;
 	ID3D11ShaderResourceView* m_velocitySRV;
@@ -176,14 +232,36 @@ private:
 	ID3D11Texture3D* m_pressureTextureStaging;
 	ID3D11ShaderResourceView* m_pressureSRV;
 
+	// Pyramid level of the velocity read by the glyphs, if they are several cells apart
+	ID3D11Texture3D* m_glyphTexture;
+	ID3D11ShaderResourceView* m_glyphSRV;
+	DirectX::XMUINT3 m_glyphTextureResolution;
+	int m_glyphLevel; // 0 for the full resolution
+	int m_glyphStep; // Of the uploaded level
+
 	wtl::WindTunnelRenderer m_wtRenderer;
 	QString m_wtSettings;
 	QDateTime m_lastMod;
 
 	VolumeRenderer m_volumeRenderer;
+	SignalStatistics m_signals; // Before the producers, which keep a pointer
+	StepStatistics m_statistics; // For the automatic range of the volume rendering
+	FieldProbes m_probes;
+	FieldSlices m_slices;
+	FieldPyramid m_pyramid;
 
 	Simulator m_simulator;
 	QThread m_simulationThread;
 
+	FieldRecorder m_recorder;
+	FieldPublisher m_publisher;
+
+	FieldPlayback m_playback;
+	double m_playbackTime; // Recorded time, which is shown
+	double m_playbackRate;
+	int m_playbackFrame; // Frame in the textures, -1 if none yet
+	bool m_playbackSeek; // The next frame does not continue the shown one, so the dynamics are not integrated
+	std::vector<float> m_playbackDensitySum; // Not recorded, all zero
+
 };
 #endif
\ No newline at end of file
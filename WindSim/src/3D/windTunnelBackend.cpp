@@ -0,0 +1,74 @@
+#include "windTunnelBackend.h"
+
+using namespace DirectX;
+using namespace wtl;
+
+WindTunnelBackend::WindTunnelBackend(const std::string& settingsFile)
+	: m_windTunnel(settingsFile)
+{
+}
+
+void WindTunnelBackend::setGridDimension(const XMUINT3& resolution, const XMFLOAT3& voxelSize)
+{
+	m_windTunnel.setGridDimension(resolution, voxelSize);
+}
+
+void WindTunnelBackend::updateGrid(const std::vector<CellType>& cellTypes)
+{
+	m_windTunnel.updateGrid(cellTypes);
+}
+
+float WindTunnelBackend::step()
+{
+	return m_windTunnel.step();
+}
+
+void WindTunnelBackend::reset()
+{
+	m_windTunnel.reset();
+}
+
+void WindTunnelBackend::fillVelocity(std::vector<float>& velocity)
+{
+	m_windTunnel.fillVelocity(velocity);
+}
+
+void WindTunnelBackend::fillPressure(std::vector<float>& pressure)
+{
+	m_windTunnel.fillPressure(pressure);
+}
+
+void WindTunnelBackend::fillDensity(std::vector<float>& density, std::vector<float>& densitySum)
+{
+	m_windTunnel.fillDensity(density, densitySum);
+}
+
+void WindTunnelBackend::setSmokeSettings(const SmokeSettings& settings)
+{
+	m_windTunnel.smokeSim(settings.enabled ? Smoke::Enabled : Smoke::Disabled);
+	m_windTunnel.setSmokePosition(settings.position);
+	m_windTunnel.setSmokeSeedRadius(settings.seedRadius);
+}
+
+void WindTunnelBackend::setLineSettings(const LineSettings& settings)
+{
+	m_windTunnel.lineSim(settings.enabled ? Line::Enabled : Line::Disabled);
+	m_windTunnel.setLineOrientation(settings.axis == 0 ? Line::X : (settings.axis == 1 ? Line::Y : Line::Z));
+	m_windTunnel.setLineType(settings.streamLines ? Line::StreamLine : Line::StreakLine);
+	m_windTunnel.setLinePosition(settings.position);
+}
+
+int WindTunnelBackend::getLineBufferSize()
+{
+	return m_windTunnel.getLineBufferSize();
+}
+
+void WindTunnelBackend::fillLines(std::vector<char>& lines, int& reseedCounter, int& numLines)
+{
+	m_windTunnel.fillLines(lines, reseedCounter, numLines);
+}
+
+std::string WindTunnelBackend::getStats()
+{
+	return m_windTunnel.getOpenCLStats();
+}
@@ -0,0 +1,37 @@
+#ifndef WIND_TUNNEL_BACKEND_H
+#define WIND_TUNNEL_BACKEND_H
+
+#include "solverBackend.h"
+
+#include <WindTunnel.h>
+
+// OpenCL solver of the WindTunnel library
+// The library gives no access to its distributions, so it does not support checkpoints
+class WindTunnelBackend : public SolverBackend
+{
+public:
+	WindTunnelBackend(const std::string& settingsFile);
+
+	std::string getName() const override { return "OpenCL WindTunnel"; };
+
+	void setGridDimension(const DirectX::XMUINT3& resolution, const DirectX::XMFLOAT3& voxelSize) override;
+	void updateGrid(const std::vector<wtl::CellType>& cellTypes) override;
+	float step() override;
+	void reset() override;
+
+	void fillVelocity(std::vector<float>& velocity) override;
+	void fillPressure(std::vector<float>& pressure) override;
+	void fillDensity(std::vector<float>& density, std::vector<float>& densitySum) override;
+
+	void setSmokeSettings(const SmokeSettings& settings) override;
+	void setLineSettings(const LineSettings& settings) override;
+	int getLineBufferSize() override;
+	void fillLines(std::vector<char>& lines, int& reseedCounter, int& numLines) override;
+
+	std::string getStats() override;
+
+private:
+	wtl::WindTunnel m_windTunnel;
+};
+
+#endif
@@ -27,10 +27,10 @@ DX11Widget::DX11Widget(QWidget* parent, Qt::WindowFlags flags)
 		static auto info = wtl::getOpenCLInfo();
 		if (info.size() == 0 || std::accumulate(info.begin(), info.end(), 0, [](int v, const std::pair<wtl::description, std::vector<wtl::description>>& e) { return v + static_cast<int>(e.second.size()); }) == 0)
 		{
-			QMessageBox::critical(parent, "OpenCL Error", "No OpenCL platforms and devices available! Install the necessary SDK's by Intel or AMD!");
-			throw std::runtime_error("ERROR: Failed to initialize OpenCL!");
+			QMessageBox::warning(parent, "OpenCL Warning", "No OpenCL platforms and devices available! Falling back to the CPU solver, install the necessary SDK's by Intel or AMD for the OpenCL solver!");
+			conf.sim.solver = SolverType::CpuLbm;
 		}
-		if (conf.opencl.device < 0 || conf.opencl.platform < 0)
+		else if (conf.opencl.device < 0 || conf.opencl.platform < 0)
 		{
 			QMessageBox::information(parent, "OpenCL Information", "Please enter an OpenCL platform and device in the next dialogs!");
 			QStringList platforms;
@@ -54,7 +54,8 @@ DX11Widget::DX11Widget(QWidget* parent, Qt::WindowFlags flags)
 			conf.opencl.platform = pid;
 			conf.opencl.device = did;
 		}
-		Simulator::initOpenCL();
+		if (Simulator::initOpenCLNecessary())
+			Simulator::initOpenCL();
 	}
 
 
@@ -308,6 +308,8 @@ bool ObjectContainer::verifyData(QJsonObject& object)
 			object["rotation"] = QJsonObject{ { "ax", 0.0 }, { "ay", 1.0 }, { "az", 0.0 }, { "angle", 0.0 } };
 		if (!object.contains("voxel"))
 			object["voxel"] = VoxelGrid::getVoxelSettingsDefault();
+		if (!object.contains("voxelization"))
+			object["voxelization"] = VoxelGrid::getVoxelizationSettingsDefault();
 		if (!object.contains("glyphs"))
 		{
 			QJsonObject res = object["resolution"].toObject();
@@ -318,7 +320,7 @@ bool ObjectContainer::verifyData(QJsonObject& object)
 			QJsonObject functions;
 			for (const auto& metric : Metric::names)
 				functions[metric] = TransferFunction().toJson();
-			object["volume"] = QJsonObject{ { "enabled", false }, { "stepSize", 0.5 }, { "metric", Metric::toString(Metric::Magnitude)}, { "transferFunctions", functions } };
+			object["volume"] = QJsonObject{ { "enabled", false }, { "stepSize", 0.5 }, { "autoRange", false }, { "metric", Metric::toString(Metric::Magnitude)}, { "transferFunctions", functions } };
 		}
 		if (!object.contains("windTunnelSettings"))
 			object["windTunnelSettings"] = ""; // Simulation uses default values
@@ -51,6 +51,12 @@ bool Project::open(ObjectContainer& container, const QString& path)
 			obj["obj-file"] = absolutePath(path, obj["obj-file"].toString());
 		if (obj.contains("windTunnelSettings"))
 			obj["windTunnelSettings"] = absolutePath(path, obj["windTunnelSettings"].toString());
+		if (obj["voxelization"].toObject().contains("file"))
+		{
+			QJsonObject voxelization = obj["voxelization"].toObject();
+			voxelization["file"] = absolutePath(path, voxelization["file"].toString());
+			obj["voxelization"] = voxelization;
+		}
 		container.addCmd(obj);
 	}
 
@@ -87,6 +93,12 @@ bool Project::saveAs(ObjectContainer& container, const QString& path)
 			json["obj-file"] = relativePath(path, json["obj-file"].toString());
 		if (json.contains("windTunnelSettings"))
 			json["windTunnelSettings"] = relativePath(path, json["windTunnelSettings"].toString());
+		if (!json["voxelization"].toObject()["file"].toString().isEmpty())
+		{
+			QJsonObject voxelization = json["voxelization"].toObject();
+			voxelization["file"] = relativePath(path, voxelization["file"].toString());
+			json["voxelization"] = voxelization;
+		}
 		objects.append(json);
 	}
 	QJsonDocument doc(objects);
@@ -25,6 +25,14 @@ VoxelGridProperties::VoxelGridProperties(QJsonObject properties, QWidget* parent
 	connect(ui.leSim, SIGNAL(textChanged(const QString &)), this, SLOT(simulatorSettingsChanged()));
 	connect(ui.pbSim, SIGNAL(clicked()), this, SLOT(chooseSimulatorSettings()));
 	connect(ui.pbReinit, SIGNAL(clicked()), this, SLOT(restartSimulation()));
+	connect(ui.pbExport, SIGNAL(clicked()), this, SLOT(exportFields()));
+	connect(ui.pbCheckpoint, SIGNAL(clicked()), this, SLOT(saveCheckpoint()));
+	connect(ui.pbRestore, SIGNAL(clicked()), this, SLOT(loadCheckpoint()));
+	connect(ui.pbBenchmark, SIGNAL(clicked()), this, SLOT(benchmarkVoxelization()));
+	connect(ui.pbRecord, SIGNAL(toggled(bool)), this, SLOT(recordingToggled(bool)));
+	connect(ui.pbPlayback, SIGNAL(toggled(bool)), this, SLOT(playbackToggled(bool)));
+	connect(ui.hsPlayback, SIGNAL(valueChanged(int)), this, SLOT(playbackPositionChanged(int)));
+	connect(ui.dspPlaybackRate, SIGNAL(valueChanged(double)), this, SLOT(playbackRateChanged(double)));
 
 	// Voxel settings
 	connect(ui.gbVoxel, SIGNAL(toggled(bool)), this, SLOT(voxelSettingsChanged()));
@@ -59,6 +67,7 @@ VoxelGridProperties::VoxelGridProperties(QJsonObject properties, QWidget* parent
 	connect(ui.cmbMetric, SIGNAL(currentTextChanged(const QString&)), this, SLOT(switchVolumeMetric(const QString&)));
 	connect(ui.gbVolume, SIGNAL(toggled(bool)), this, SLOT(volumeSettingsChanged()));
 	connect(ui.hsStepSize, SIGNAL(valueChanged(int)), this, SLOT(volumeSettingsChanged()));
+	connect(ui.cbAutoRange, SIGNAL(toggled(bool)), this, SLOT(volumeSettingsChanged()));
 	connect(ui.gradient, SIGNAL(transferFunctionChanged()), this, SLOT(volumeSettingsChanged()));
 
 	// WindTunnel
@@ -164,6 +173,7 @@ void VoxelGridProperties::updateProperties(const QJsonObject& properties)
 		const QJsonObject& volume = properties.find("volume")->toObject();
 		ui.gbVolume->setChecked(volume["enabled"].toBool());
 		setSliderValue(ui.hsStepSize, volume["stepSize"].toDouble());
+		ui.cbAutoRange->setChecked(volume["autoRange"].toBool());
 		const QString& metric = volume["metric"].toString();
 		ui.cmbMetric->setCurrentText(Metric::toGUI(metric));
 		const QJsonObject& fcntns = volume["transferFunctions"].toObject();
@@ -322,6 +332,7 @@ void VoxelGridProperties::volumeSettingsChanged()
 	{
 		{ "enabled", ui.gbVolume->isChecked() },
 		{ "stepSize", sliderFloatValue(ui.hsStepSize) },
+		{ "autoRange", ui.cbAutoRange->isChecked() },
 		{ "metric", currentMetric },
 		{ "transferFunctions", functions }
 	};
@@ -395,6 +406,105 @@ void VoxelGridProperties::restartSimulation()
 	emit triggerFunction(data);
 }
 
+void VoxelGridProperties::exportFields()
+{
+	QString file = QFileDialog::getSaveFileName(this, tr("Export voxel grid"), QString(), tr("Brick files (*.wsb)"));
+	if (file.isEmpty())
+		return;
+
+	QJsonObject data{ { "id", m_properties["id"].toInt() }, { "function", "exportFields" }, { "file", file } };
+	emit triggerFunction(data);
+}
+
+void VoxelGridProperties::saveCheckpoint()
+{
+	QString file = QFileDialog::getSaveFileName(this, tr("Save checkpoint"), QString(), tr("Checkpoints (*.wsc)"));
+	if (file.isEmpty())
+		return;
+
+	QJsonObject data{ { "id", m_properties["id"].toInt() }, { "function", "saveCheckpoint" }, { "file", file } };
+	emit triggerFunction(data);
+}
+
+void VoxelGridProperties::loadCheckpoint()
+{
+	QString file = QFileDialog::getOpenFileName(this, tr("Restore checkpoint"), QString(), tr("Checkpoints (*.wsc)"));
+	if (file.isEmpty())
+		return;
+
+	QJsonObject data{ { "id", m_properties["id"].toInt() }, { "function", "loadCheckpoint" }, { "file", file } };
+	emit triggerFunction(data);
+}
+
+void VoxelGridProperties::benchmarkVoxelization()
+{
+	QString file = QFileDialog::getSaveFileName(this, tr("Benchmark voxelization"), QString(), tr("CSV files (*.csv)"));
+	if (file.isEmpty())
+		return;
+
+	QJsonObject data{ { "id", m_properties["id"].toInt() }, { "function", "benchmarkVoxelization" }, { "file", file } };
+	emit triggerFunction(data);
+}
+
+void VoxelGridProperties::recordingToggled(bool checked)
+{
+	if (!checked)
+	{
+		QJsonObject data{ { "id", m_properties["id"].toInt() }, { "function", "stopRecording" } };
+		emit triggerFunction(data);
+		return;
+	}
+
+	QString file = QFileDialog::getSaveFileName(this, tr("Record simulation"), QString(), tr("Recordings (*.wsr)"));
+	if (file.isEmpty())
+	{
+		ui.pbRecord->setChecked(false); // Emits toggled(false), which is a no-op if not recording
+		return;
+	}
+
+	QJsonObject data{ { "id", m_properties["id"].toInt() }, { "function", "startRecording" }, { "file", file } };
+	emit triggerFunction(data);
+}
+
+void VoxelGridProperties::playbackToggled(bool checked)
+{
+	ui.hsPlayback->setEnabled(false);
+	ui.dspPlaybackRate->setEnabled(false);
+
+	if (!checked)
+	{
+		QJsonObject data{ { "id", m_properties["id"].toInt() }, { "function", "stopPlayback" } };
+		emit triggerFunction(data);
+		return;
+	}
+
+	QString file = QFileDialog::getOpenFileName(this, tr("Play recording"), QString(), tr("Recordings (*.wsr)"));
+	if (file.isEmpty())
+	{
+		ui.pbPlayback->setChecked(false);
+		return;
+	}
+
+	QJsonObject data{ { "id", m_properties["id"].toInt() }, { "function", "startPlayback" }, { "file", file } };
+	emit triggerFunction(data);
+	playbackRateChanged(ui.dspPlaybackRate->value());
+
+	ui.hsPlayback->setEnabled(true);
+	ui.dspPlaybackRate->setEnabled(true);
+}
+
+void VoxelGridProperties::playbackPositionChanged(int position)
+{
+	QJsonObject data{ { "id", m_properties["id"].toInt() }, { "function", "seekPlayback" }, { "position", static_cast<double>(position) / ui.hsPlayback->maximum() } };
+	emit triggerFunction(data);
+}
+
+void VoxelGridProperties::playbackRateChanged(double rate)
+{
+	QJsonObject data{ { "id", m_properties["id"].toInt() }, { "function", "setPlaybackRate" }, { "rate", rate } };
+	emit triggerFunction(data);
+}
+
 void VoxelGridProperties::buttonClicked(QAbstractButton* button)
 {
 	// Apply or Ok button was clicked
@@ -445,6 +555,7 @@ void VoxelGridProperties::blockSignals(bool b)
 	ui.gbVolume->blockSignals(b);
 	ui.cmbMetric->blockSignals(b);
 	ui.hsStepSize->blockSignals(b);
+	ui.cbAutoRange->blockSignals(b);
 	ui.gradient->blockSignals(b);
 
 	// WindTunnel
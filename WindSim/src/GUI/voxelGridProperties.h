@@ -38,6 +38,14 @@ private slots:
 	void smokeSettingsChanged();
 	void lineSettingsChanged();
 	void restartSimulation();
+	void exportFields(); // Open Filedialog to choose the export file
+	void saveCheckpoint(); // Open Filedialog to choose the checkpoint file
+	void loadCheckpoint();
+	void benchmarkVoxelization(); // Open Filedialog to choose the file of the results
+	void recordingToggled(bool checked); // Open Filedialog to choose the recording file or stop the recording
+	void playbackToggled(bool checked); // Open Filedialog to choose the recording to play or stop the playback
+	void playbackPositionChanged(int position);
+	void playbackRateChanged(double rate);
 
 	void buttonClicked(QAbstractButton* button);
 
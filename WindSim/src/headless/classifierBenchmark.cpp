@@ -0,0 +1,208 @@
+#include "classifierBenchmark.h"
+#include "../3D/cellClassifier.h"
+#include "parallel.h"
+
+#include <chrono>
+#include <vector>
+#include <random>
+#include <new>
+#include <iomanip>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const unsigned int g_benchmarkSizes[] = { 256, 512 };
+	const int g_benchmarkRepeats = 3; // The fastest run counts
+	const wtl::CellType g_faceTypes[] = { wtl::CELL_TYPE_FLUID, wtl::CELL_TYPE_INFLOW, wtl::CELL_TYPE_OUTFLOW, wtl::CELL_TYPE_SOLID_SLIP, wtl::CELL_TYPE_SOLID_NO_SLIP };
+	const int g_numFaceTypes = sizeof(g_faceTypes) / sizeof(g_faceTypes[0]);
+	const float g_solidDensities[] = { 0.2f, 0.5f, 0.7f }; // Dense grids enclose many fluid pockets
+	const unsigned int g_columns[] = { 1, 2, 63, 64, 65, 127, 128, 129, 200 }; // x resolutions of the random grids
+	const int g_randomFaces = 24; // Random face configurations per random grid
+	const int g_spheres = 48; // Of the timed grids; the last one is hollow
+
+	// Face configuration <index> in [0, g_numFaceTypes^NUM_FACES)
+	CellClassifier::Faces faceConfiguration(int index)
+	{
+		CellClassifier::Faces faces;
+		for (int f = 0; f < CellClassifier::NUM_FACES; ++f)
+		{
+			faces.type[f] = g_faceTypes[index % g_numFaceTypes];
+			index /= g_numFaceTypes;
+		}
+		return faces;
+	}
+
+	void randomGrid(std::vector<wtl::CellType>& cells, size_t numCells, float density, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		cells.resize(numCells);
+		for (wtl::CellType& cell : cells)
+			cell = uniform(random) < density ? wtl::CELL_TYPE_SOLID_NO_SLIP : wtl::CELL_TYPE_FLUID;
+	}
+
+	// Classifies copies of <grid> with both implementations; false if they differ
+	bool matches(const std::vector<wtl::CellType>& grid, const XMUINT3& res, const CellClassifier::Faces& faces, bool fillCavities, int threads,
+		std::vector<wtl::CellType>& cells, std::vector<wtl::CellType>& reference)
+	{
+		cells = grid;
+		reference = grid;
+		const uint64_t reclaimed = CellClassifier::classify(cells.data(), res, faces, fillCavities, threads);
+		const uint64_t referenceReclaimed = CellClassifier::classifyReference(reference.data(), res, faces, fillCavities);
+		return reclaimed == referenceReclaimed && cells == reference;
+	}
+
+	// Solid spheres at random positions, as a voxelized scene; the last sphere is a shell around a sealed fluid pocket
+	void sphereGrid(std::vector<wtl::CellType>& cells, unsigned int size, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		std::fill(cells.begin(), cells.end(), wtl::CELL_TYPE_FLUID);
+		for (int s = 0; s < g_spheres; ++s)
+		{
+			const bool hollow = s + 1 == g_spheres;
+			const float radius = size * (hollow ? 0.2f : 0.03f + 0.09f * uniform(random));
+			const float inner = hollow ? radius - 3.0f : 0.0f;
+			const float center[3] = { size * (0.2f + 0.6f * uniform(random)), size * (0.2f + 0.6f * uniform(random)), size * (0.2f + 0.6f * uniform(random)) };
+			const int zBegin = std::max(0, static_cast<int>(center[2] - radius));
+			const int zEnd = std::min(static_cast<int>(size), static_cast<int>(center[2] + radius) + 1);
+			for (int z = zBegin; z < zEnd; ++z)
+			{
+				for (int y = std::max(0, static_cast<int>(center[1] - radius)); y < std::min(static_cast<int>(size), static_cast<int>(center[1] + radius) + 1); ++y)
+				{
+					for (int x = std::max(0, static_cast<int>(center[0] - radius)); x < std::min(static_cast<int>(size), static_cast<int>(center[0] + radius) + 1); ++x)
+					{
+						const float d[3] = { x + 0.5f - center[0], y + 0.5f - center[1], z + 0.5f - center[2] };
+						const float distance2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+						if (distance2 <= radius * radius && distance2 >= inner * inner)
+							cells[x + static_cast<size_t>(size) * (y + static_cast<size_t>(size) * z)] = wtl::CELL_TYPE_SOLID_NO_SLIP;
+					}
+				}
+			}
+		}
+	}
+
+	// Classifies a fresh copy of <grid> per run; the copy is not timed
+	template <typename Function>
+	double fastest(const std::vector<wtl::CellType>& grid, std::vector<wtl::CellType>& cells, Function func)
+	{
+		double best = 0.0;
+		for (int i = 0; i < g_benchmarkRepeats; ++i)
+		{
+			std::copy(grid.begin(), grid.end(), cells.begin());
+			auto start = std::chrono::steady_clock::now();
+			func(cells.data());
+			double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			best = i == 0 ? time : std::min(best, time);
+		}
+		return best;
+	}
+
+	void report(std::ostream& out, const char* kernel, double single, double multi, unsigned int threads)
+	{
+		out << "  " << std::left << std::setw(22) << kernel << std::right << std::setw(10) << single << " ms 1 thread" << std::setw(10) << multi << " ms "
+			<< threads << " threads" << std::setw(8) << single / multi << "x" << std::endl;
+	}
+}
+
+int runClassifierBenchmark(std::ostream& out, int threads)
+{
+	out << std::fixed << std::setprecision(2);
+
+	std::mt19937 random(1);
+	std::vector<wtl::CellType> grid, cells, reference;
+
+	// Every face configuration on small grids, which are mostly faces and edges
+	int numConfigurations = 1;
+	for (int f = 0; f < CellClassifier::NUM_FACES; ++f)
+		numConfigurations *= g_numFaceTypes;
+	const XMUINT3 small(11, 7, 5);
+	for (int configuration = 0; configuration < numConfigurations; ++configuration)
+	{
+		const CellClassifier::Faces faces = faceConfiguration(configuration);
+		randomGrid(grid, static_cast<size_t>(small.x) * small.y * small.z, g_solidDensities[configuration % 3], random);
+		for (int fillCavities = 0; fillCavities < 2; ++fillCavities)
+		{
+			if (!matches(grid, small, faces, fillCavities != 0, threads, cells, reference))
+			{
+				out << "ERROR: classify() differs from the reference for the face configuration " << configuration << (fillCavities ? " with" : " without")
+					<< " cavity filling" << std::endl;
+				return 1;
+			}
+		}
+	}
+
+	// Rows of one to four words with partial last words, random face configurations
+	std::uniform_int_distribution<unsigned int> extent(1, 40);
+	std::uniform_int_distribution<int> anyConfiguration(0, numConfigurations - 1);
+	int numGrids = 0;
+	for (unsigned int columns : g_columns)
+	{
+		for (float density : g_solidDensities)
+		{
+			const XMUINT3 res(columns, extent(random), extent(random));
+			randomGrid(grid, static_cast<size_t>(res.x) * res.y * res.z, density, random);
+			++numGrids;
+			for (int i = 0; i < g_randomFaces; ++i)
+			{
+				const int configuration = anyConfiguration(random);
+				for (int fillCavities = 0; fillCavities < 2; ++fillCavities)
+				{
+					if (!matches(grid, res, faceConfiguration(configuration), fillCavities != 0, threads, cells, reference))
+					{
+						out << "ERROR: classify() differs from the reference at " << res.x << "x" << res.y << "x" << res.z << " (" << density * 100.0f
+							<< "% solid) for the face configuration " << configuration << (fillCavities ? " with" : " without") << " cavity filling" << std::endl;
+						return 1;
+					}
+				}
+			}
+		}
+	}
+	out << "classify() matches the reference for all " << numConfigurations << " face configurations at " << small.x << "x" << small.y << "x" << small.z
+		<< " and for " << g_randomFaces << " random ones on " << numGrids << " random grids, with and without cavity filling" << std::endl;
+
+	const unsigned int numThreads = Parallel::numThreads(threads);
+	const CellClassifier::Faces faces;
+	out << "Cell classification with 1 and " << numThreads << " threads, best of " << g_benchmarkRepeats << " runs" << std::endl;
+
+	for (unsigned int size : g_benchmarkSizes)
+	{
+		const XMUINT3 res(size, size, size);
+		const size_t numCells = static_cast<size_t>(size) * size * size;
+		try
+		{
+			grid.assign(numCells, wtl::CELL_TYPE_FLUID);
+			cells.resize(numCells);
+			reference.resize(numCells);
+		}
+		catch (const std::bad_alloc&)
+		{
+			out << size << "^3: not enough memory" << std::endl;
+			continue;
+		}
+
+		sphereGrid(grid, size, random);
+		const size_t solid = std::count(grid.begin(), grid.end(), wtl::CELL_TYPE_SOLID_NO_SLIP);
+		out << size << "^3 (" << 100.0 * solid / numCells << "% solid):" << std::endl;
+
+		for (int fillCavities = 0; fillCavities < 2; ++fillCavities)
+		{
+			const double single = fastest(grid, cells, [&](wtl::CellType* c) { CellClassifier::classify(c, res, faces, fillCavities != 0, 1); });
+			const double multi = fastest(grid, cells, [&](wtl::CellType* c) { CellClassifier::classify(c, res, faces, fillCavities != 0, threads); });
+			report(out, fillCavities ? "classify + cavities" : "classify", single, multi, numThreads);
+		}
+
+		std::copy(grid.begin(), grid.end(), reference.begin());
+		auto start = std::chrono::steady_clock::now();
+		CellClassifier::classifyReference(reference.data(), res, faces, true);
+		out << "  " << std::left << std::setw(22) << "reference + cavities" << std::right << std::setw(10)
+			<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms 1 thread" << std::endl;
+
+		if (cells != reference)
+		{
+			out << "ERROR: classify() differs from the reference at " << size << "^3" << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef CLASSIFIER_BENCHMARK_H
+#define CLASSIFIER_BENCHMARK_H
+
+#include <ostream>
+
+// Verifies and times CellClassifier (WindSimHeadless --benchmark-classifier): classify() is compared with classifyReference() on small
+// random grids for every configuration of the grid faces (fluid, inflow, outflow, slip or no-slip walls), and on random grids with x
+// resolutions around multiples of 64 for random face configurations, each with and without cavity filling. Then both are timed on
+// voxelized spheres at 256^3 and 512^3 with one and with <threads> threads (0 for all); returns 1 if the results differ
+int runClassifierBenchmark(std::ostream& out, int threads);
+
+#endif
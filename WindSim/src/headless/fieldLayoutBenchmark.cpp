@@ -0,0 +1,236 @@
+#include "fieldLayoutBenchmark.h"
+#include "../3D/brickedField.h"
+#include "../3D/fieldSampler.h"
+#include "parallel.h"
+
+#include <emmintrin.h>
+
+#include <chrono>
+#include <vector>
+#include <random>
+#include <new>
+#include <iomanip>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const unsigned int g_benchmarkSizes[] = { 256, 512 };
+	const int g_benchmarkRepeats = 3; // The fastest run counts
+	const size_t g_benchmarkPositions = 1 << 22;
+	const float g_walkStep = 0.5f; // Cells per step of the random walks
+
+	template <typename Function>
+	double fastest(Function func)
+	{
+		double best = 0.0;
+		for (int i = 0; i < g_benchmarkRepeats; ++i)
+		{
+			auto start = std::chrono::steady_clock::now();
+			func();
+			double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			best = i == 0 ? time : std::min(best, time);
+		}
+		return best;
+	}
+
+	void report(std::ostream& out, const char* kernel, double linear, double bricked)
+	{
+		out << "  " << std::left << std::setw(20) << kernel << std::right << std::setw(10) << linear << " ms linear" << std::setw(10) << bricked << " ms bricked"
+			<< std::setw(8) << linear / bricked << "x" << std::endl;
+	}
+
+	// Divergence of the interior cells, linear layout
+	void divergenceLinear(const float* velocity, const XMUINT3& res, float* divergence, int threads)
+	{
+		const size_t dy = 4 * static_cast<size_t>(res.x);
+		const size_t dz = dy * res.y;
+		Parallel::forRange(1, static_cast<int>(res.z) - 1, [&](int first, int last)
+		{
+			for (int z = first; z < last; ++z)
+			{
+				for (size_t y = 1; y + 1 < res.y; ++y)
+				{
+					const size_t row = res.x * (y + static_cast<size_t>(res.y) * z);
+					const float* v = velocity + 4 * row;
+					float* out = divergence + row;
+					for (size_t x = 1; x + 1 < res.x; ++x)
+					{
+						const float* c = v + 4 * x;
+						out[x] = 0.5f * (c[4] - c[-4] + c[dy + 1] - c[1 - dy] + c[dz + 2] - c[2 - dz]);
+					}
+				}
+			}
+		}, threads);
+	}
+
+	// Divergence of the interior rows, brick by brick: 8 cells along x per row and two SSE vectors; the neighbours along y and z are the
+	// rows next to it within the component block of the brick (or of the neighbouring brick), so only the x derivative needs a shuffle
+	// The resolution along x has to be a multiple of the brick size
+	void divergenceBricked(const BrickedField& velocity, BrickedField& divergence, int threads)
+	{
+		const XMUINT3& res = velocity.getResolution();
+		const int size = BrickedField::BRICK_SIZE;
+		const int bricksX = (res.x + size - 1) / size;
+		const int bricksY = (res.y + size - 1) / size;
+		const int n = BrickedField::BRICK_CELLS;
+		const __m128 half = _mm_set1_ps(0.5f);
+		const float* v = velocity.data();
+		float* out = divergence.data();
+		Parallel::forRange(0, static_cast<int>(velocity.getNumBricks()), [&](int first, int last)
+		{
+			float row[BrickedField::BRICK_SIZE + 2];
+			for (int brick = first; brick < last; ++brick)
+			{
+				const int x0 = (brick % bricksX) * size;
+				const int y0 = (brick / bricksX % bricksY) * size;
+				const int z0 = (brick / bricksX / bricksY) * size;
+				const int y1 = std::min(y0 + size, static_cast<int>(res.y) - 1);
+				const int z1 = std::min(z0 + size, static_cast<int>(res.z) - 1);
+				for (int z = std::max(z0, 1); z < z1; ++z)
+				{
+					for (int y = std::max(y0, 1); y < y1; ++y)
+					{
+						const float* u = v + velocity.offset(x0, y, z);
+						row[0] = x0 > 0 ? v[velocity.offset(x0 - 1, y, z)] : u[0];
+						std::memcpy(row + 1, u, size * sizeof(float));
+						row[size + 1] = x0 + size < static_cast<int>(res.x) ? v[velocity.offset(x0 + size, y, z)] : u[size - 1];
+						const float* v0 = v + velocity.offset(x0, y - 1, z) + n;
+						const float* v1 = v + velocity.offset(x0, y + 1, z) + n;
+						const float* w0 = v + velocity.offset(x0, y, z - 1) + 2 * n;
+						const float* w1 = v + velocity.offset(x0, y, z + 1) + 2 * n;
+						float* d = out + divergence.offset(x0, y, z);
+						for (int i = 0; i < size; i += 4)
+						{
+							__m128 du = _mm_sub_ps(_mm_loadu_ps(row + i + 2), _mm_loadu_ps(row + i));
+							__m128 dv = _mm_sub_ps(_mm_loadu_ps(v1 + i), _mm_loadu_ps(v0 + i));
+							__m128 dw = _mm_sub_ps(_mm_loadu_ps(w1 + i), _mm_loadu_ps(w0 + i));
+							_mm_storeu_ps(d + i, _mm_mul_ps(half, _mm_add_ps(du, _mm_add_ps(dv, dw))));
+						}
+					}
+				}
+			}
+		}, threads, 16);
+	}
+}
+
+int runLayoutBenchmark(std::ostream& out, int threads)
+{
+	out << std::fixed << std::setprecision(2);
+	out << "Field layouts with " << Parallel::numThreads(threads) << " threads, best of " << g_benchmarkRepeats << " runs" << std::endl;
+
+	for (unsigned int size : g_benchmarkSizes)
+	{
+		const XMUINT3 res(size, size, size);
+		const size_t numCells = static_cast<size_t>(size) * size * size;
+		std::vector<float> velocity;
+		try
+		{
+			velocity.resize(4 * numCells);
+		}
+		catch (const std::bad_alloc&)
+		{
+			out << size << "^3: not enough memory" << std::endl;
+			continue;
+		}
+
+		// A smooth field, so the samples of both layouts can be compared
+		Parallel::forRange(0, static_cast<int>(size), [&](int first, int last)
+		{
+			for (int z = first; z < last; ++z)
+			{
+				for (size_t y = 0; y < size; ++y)
+				{
+					float* v = velocity.data() + 4 * size * (y + size * static_cast<size_t>(z));
+					for (size_t x = 0; x < size; ++x)
+					{
+						v[4 * x] = std::sin(0.05f * y) * std::cos(0.03f * z);
+						v[4 * x + 1] = std::sin(0.04f * z + 0.02f * x);
+						v[4 * x + 2] = std::cos(0.05f * x) * std::sin(0.03f * y);
+						v[4 * x + 3] = 0.0f;
+					}
+				}
+			}
+		}, threads);
+
+		out << size << "^3 (" << velocity.size() * sizeof(float) / static_cast<double>(1 << 20) << " MB linear):" << std::endl;
+
+		BrickedField bricked(3);
+		const double toBricks = fastest([&] { bricked.fromLinear(velocity.data(), 4, res, threads); });
+		const double toLinear = fastest([&] { bricked.toLinear(velocity.data(), 4, threads); });
+		const double gb = velocity.size() * sizeof(float) * 7.0 / 4.0 / (1 << 30); // Read and written
+		out << "  " << std::left << std::setw(20) << "fromLinear" << std::right << std::setw(10) << toBricks << " ms (" << gb / (toBricks * 1e-3) << " GB/s), toLinear "
+			<< toLinear << " ms (" << gb / (toLinear * 1e-3) << " GB/s)" << std::endl;
+
+		{
+			std::vector<float> linearDivergence(numCells);
+			BrickedField brickedDivergence(1);
+			brickedDivergence.resize(res);
+			const double linear = fastest([&] { divergenceLinear(velocity.data(), res, linearDivergence.data(), threads); });
+			const double bricks = fastest([&] { divergenceBricked(bricked, brickedDivergence, threads); });
+			report(out, "divergence", linear, bricks);
+
+			float difference = 0.0f;
+			for (unsigned int z = 1; z + 1 < size; ++z)
+			{
+				for (unsigned int y = 1; y + 1 < size; ++y)
+				{
+					for (unsigned int x = 1; x + 1 < size; ++x)
+						difference = std::max(difference, std::fabs(linearDivergence[x + size * (y + static_cast<size_t>(size) * z)] - brickedDivergence.get(x, y, z)));
+				}
+			}
+			if (difference > 1e-5f)
+			{
+				out << "ERROR: The divergence of the layouts differs by " << difference << std::endl;
+				return 1;
+			}
+		}
+
+		// Uniformly random positions and random walks (e.g. tracers, probes along a path)
+		std::vector<XMFLOAT3> positions(g_benchmarkPositions);
+		std::mt19937 random(size);
+		std::uniform_real_distribution<float> uniform(0.0f, static_cast<float>(size));
+		std::uniform_real_distribution<float> direction(-g_walkStep, g_walkStep);
+		std::vector<float> linearValues(4 * positions.size());
+		std::vector<float> brickedValues(3 * positions.size());
+		FieldSampler sampler(velocity.data(), nullptr, res);
+		for (int pattern = 0; pattern < 2; ++pattern)
+		{
+			XMFLOAT3 p(uniform(random), uniform(random), uniform(random));
+			for (XMFLOAT3& position : positions)
+			{
+				if (pattern == 0)
+				{
+					position = XMFLOAT3(uniform(random), uniform(random), uniform(random));
+				}
+				else
+				{
+					p = XMFLOAT3(p.x + direction(random), p.y + direction(random), p.z + direction(random));
+					if (p.x < 0.0f || p.y < 0.0f || p.z < 0.0f || p.x > size || p.y > size || p.z > size)
+						p = XMFLOAT3(uniform(random), uniform(random), uniform(random));
+					position = p;
+				}
+			}
+
+			const double linear = fastest([&] { sampler.sample(positions.data(), positions.size(), linearValues.data(), threads); });
+			const double bricks = fastest([&] { bricked.sample(positions.data(), positions.size(), brickedValues.data(), threads); });
+			report(out, pattern == 0 ? "sample random" : "sample walk", linear, bricks);
+
+			float difference = 0.0f;
+			for (size_t i = 0; i < positions.size(); ++i)
+			{
+				for (int c = 0; c < 3; ++c)
+					difference = std::max(difference, std::fabs(linearValues[4 * i + c] - brickedValues[3 * i + c]));
+			}
+			if (difference > 1e-5f)
+			{
+				out << "ERROR: The samples of the layouts differ by " << difference << std::endl;
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,11 @@
+#ifndef FIELD_LAYOUT_BENCHMARK_H
+#define FIELD_LAYOUT_BENCHMARK_H
+
+#include <ostream>
+
+// Compares the linear velocity layout of the simulator with BrickedField (WindSimHeadless --benchmark-layout) at 256^3 and 512^3: the
+// conversions between both, a neighbour stencil (divergence by central differences) and trilinear sampling at random positions and along
+// random walks; reports the time of each kernel with <threads> threads (0 for all) and the speedup of the bricks
+int runLayoutBenchmark(std::ostream& out, int threads);
+
+#endif
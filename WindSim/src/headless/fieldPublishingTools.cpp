@@ -0,0 +1,164 @@
+#include "fieldPublishingTools.h"
+#include "fieldPublishing.h"
+#include "sharedMemory.h"
+
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	const int g_attachInterval = 100; // msec between attempts to attach
+	const int g_waitTimeout = 1000; // msec without a step, before the reader checks the publisher
+
+	const XMUINT3 g_benchmarkResolution(128, 64, 64);
+	const int g_benchmarkSteps = 300;
+	const int g_benchmarkRate = 100; // Steps per second
+	const int g_benchmarkReaders = 2;
+	const int g_benchmarkSlots = 3;
+
+	struct ReaderStats
+	{
+		ReaderStats() : latencies(), missed(0) {};
+		std::vector<double> latencies; // usec from the end of publishing until the copy is complete
+		uint64_t missed;
+	};
+
+	void read(const std::string& name, ReaderStats& stats)
+	{
+		FieldSubscriber subscriber;
+		FieldSubscriber::Frame frame;
+		if (!subscriber.attach(name))
+			return;
+
+		while (true)
+		{
+			if (subscriber.waitNext(frame, g_waitTimeout))
+				stats.latencies.push_back((FieldPublishing::now() - frame.publishTime) * 1e-3);
+			else if (subscriber.isClosed())
+				break;
+		}
+		stats.missed = subscriber.getNumMissed();
+	}
+
+	void printLatencies(std::ostream& out, std::vector<double> latencies)
+	{
+		if (latencies.empty())
+		{
+			out << "no steps";
+			return;
+		}
+		std::sort(latencies.begin(), latencies.end());
+		double sum = 0.0;
+		for (double t : latencies)
+			sum += t;
+		out << "mean " << sum / latencies.size() << " us, median " << latencies[latencies.size() / 2] << " us, 99% " << latencies[latencies.size() * 99 / 100] << " us";
+	}
+}
+
+int runFieldSubscriber(const std::string& name, int steps, std::ostream& out)
+{
+	FieldSubscriber subscriber;
+	FieldSubscriber::Frame frame;
+	bool waiting = false;
+
+	for (int numRead = 0; numRead < steps;)
+	{
+		if (!subscriber.isAttached() || subscriber.isClosed())
+		{
+			if (!subscriber.attach(name))
+			{
+				if (!waiting)
+					out << "INFO: Waiting for a publisher of '" << name << "' (" << subscriber.errorString() << ")" << std::endl;
+				waiting = true;
+				std::this_thread::sleep_for(std::chrono::milliseconds(g_attachInterval));
+				continue;
+			}
+			out << "INFO: Attached to '" << name << "'" << std::endl;
+			waiting = false;
+		}
+
+		if (!subscriber.waitNext(frame, g_waitTimeout))
+			continue;
+		double latency = (FieldPublishing::now() - frame.publishTime) * 1e-3;
+
+		size_t numCells = frame.pressure.size();
+		float maxSpeed = 0.0f;
+		double pressureSum = 0.0;
+		for (size_t i = 0; i < numCells; ++i)
+		{
+			const float* v = &frame.velocity[i * 4];
+			maxSpeed = std::max(maxSpeed, v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+			pressureSum += frame.pressure[i];
+		}
+
+		out << "Step " << frame.step << ", time " << frame.time << "s, " << frame.resolution.x << "x" << frame.resolution.y << "x" << frame.resolution.z
+			<< ", latency " << latency << " us, max |v| " << std::sqrt(maxSpeed) << ", mean p " << (numCells > 0 ? pressureSum / numCells : 0.0)
+			<< ", missed " << subscriber.getNumMissed() << std::endl;
+		++numRead;
+	}
+	return 0;
+}
+
+int runPublishingBenchmark(std::ostream& out)
+{
+	std::string name = SharedMemory::uniqueName("windsim-benchmark");
+	size_t numCells = static_cast<size_t>(g_benchmarkResolution.x) * g_benchmarkResolution.y * g_benchmarkResolution.z;
+	std::vector<float> velocity(numCells * 4, 1.0f);
+	std::vector<float> pressure(numCells, 1.0f);
+	std::vector<float> density(numCells, 1.0f);
+
+	FieldPublisher publisher;
+	if (!publisher.open(name, g_benchmarkResolution, XMFLOAT3(0.01f, 0.01f, 0.01f), g_benchmarkSlots, 1))
+	{
+		out << "ERROR: " << publisher.errorString() << std::endl;
+		return 1;
+	}
+
+	std::vector<ReaderStats> stats(g_benchmarkReaders);
+	std::vector<std::thread> readers;
+	for (int i = 0; i < g_benchmarkReaders; ++i)
+		readers.push_back(std::thread(read, name, std::ref(stats[i])));
+
+	// The readers attach before the first step
+	std::this_thread::sleep_for(std::chrono::milliseconds(g_attachInterval));
+
+	auto period = std::chrono::microseconds(1000000 / g_benchmarkRate);
+	auto next = std::chrono::steady_clock::now();
+	for (int step = 1; step <= g_benchmarkSteps; ++step)
+	{
+		velocity[0] = static_cast<float>(step);
+		FieldFrame frame = { step, step * 1e-3, g_benchmarkResolution, velocity.data(), pressure.data(), density.data() };
+		publisher.stepPublished(frame);
+
+		next += period;
+		std::this_thread::sleep_until(next);
+	}
+	uint64_t numPublished = publisher.getNumPublished();
+	double publishTime = publisher.getPublishTime();
+	publisher.close();
+
+	for (auto& reader : readers)
+		reader.join();
+
+	double mb = numCells * 6 * sizeof(float) / static_cast<double>(1 << 20);
+	out << std::fixed << std::setprecision(2);
+	out << "Publisher (" << g_benchmarkResolution.x << "x" << g_benchmarkResolution.y << "x" << g_benchmarkResolution.z << ", " << mb << " MB per step, "
+		<< numPublished << " steps at " << g_benchmarkRate << "/s): " << publishTime / numPublished << " ms per step, " << mb * numPublished / (publishTime * 1e-3) / 1024.0 << " GB/s" << std::endl;
+	for (int i = 0; i < g_benchmarkReaders; ++i)
+	{
+		out << "Reader " << i + 1 << ": " << stats[i].latencies.size() << " steps, " << stats[i].missed << " missed, latency ";
+		printLatencies(out, stats[i].latencies);
+		out << std::endl;
+	}
+
+	bool success = true;
+	for (const ReaderStats& s : stats)
+		success &= !s.latencies.empty();
+	return success ? 0 : 1;
+}
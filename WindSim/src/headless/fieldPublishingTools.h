@@ -0,0 +1,15 @@
+#ifndef FIELD_PUBLISHING_TOOLS_H
+#define FIELD_PUBLISHING_TOOLS_H
+
+#include <string>
+#include <ostream>
+
+// Reference reader of the published fields (WindSimHeadless --subscribe <name>): prints step, latency and a summary of the fields of
+// the next <steps> steps; waits for the publisher to start and follows it across restarts
+int runFieldSubscriber(const std::string& name, int steps, std::ostream& out);
+
+// Measures FieldPublisher and FieldSubscriber within this process (WindSimHeadless --benchmark-publishing): a publisher thread writes
+// synthetic steps at a fixed rate, two reader threads copy them; reports the cost per step for the publisher and the latency of the readers
+int runPublishingBenchmark(std::ostream& out);
+
+#endif
@@ -0,0 +1,1333 @@
+#include "headlessRunner.h"
+#include "../3D/objLoader.h"
+#include "../3D/volInt.h"
+#include "../3D/lbmBackend.h"
+#include "../3D/projectionBackend.h"
+#include "../3D/volumeRaycaster.h"
+#include "../3D/solidFraction.h"
+#include "brickFile.h"
+#include "settings.h"
+#include "parallel.h"
+#include "transferFunction.h"
+#include "fieldStatistics.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QElapsedTimer>
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+using namespace DirectX;
+
+namespace
+{
+	// Paths within a project file are relative to its directory (see Project::absolutePath)
+	QString absolutePath(const QString& projectFile, const QString& dataFile)
+	{
+		QDir dir = QFileInfo(projectFile).absoluteDir();
+		return QFileInfo(dir.absoluteFilePath(dataFile)).absoluteFilePath();
+	}
+
+	QJsonObject vectorToJson(const XMFLOAT3& v)
+	{
+		QJsonObject json;
+		json["x"] = v.x;
+		json["y"] = v.y;
+		json["z"] = v.z;
+		return json;
+	}
+}
+
+std::mutex HeadlessRunner::s_logMutex;
+std::mutex HeadlessRunner::s_massPropsMutex;
+
+HeadlessRunner::Options::Options()
+	: projectFile(),
+	outputDir("."),
+	solver(),
+	name(),
+	steps(1000),
+	fieldsInterval(0),
+	writeFields(true),
+	writeMetrics(false),
+	threads(-1),
+	recordFile(),
+	publishName(),
+	probesFile(),
+	slicesFile(),
+	isosurfaces(),
+	snapshotsFile(),
+	streamlinesFile()
+{
+}
+
+HeadlessRunner::MeshResult::MeshResult()
+	: name(),
+	dynamics(false),
+	torque(0.0f, 0.0f, 0.0f),
+	meanTorque(0.0f, 0.0f, 0.0f),
+	angularVelocity(0.0f, 0.0f, 0.0f)
+{
+}
+
+HeadlessRunner::Result::Result()
+	: steps(0),
+	threads(0),
+	simulatedTime(0.0),
+	totalTime(0.0),
+	stepsPerSecond(0.0),
+	mlups(0.0),
+	meshes(),
+	signalStatistics()
+{
+}
+
+HeadlessRunner::Mesh::Mesh()
+	: name(),
+	vertexData(),
+	indexData(),
+	distanceField(),
+	position(0.0f, 0.0f, 0.0f),
+	scale(1.0f, 1.0f, 1.0f),
+	rotation(0.0f, 0.0f, 0.0f, 1.0f),
+	world(),
+	voxelizedWorld(),
+	voxelize(false),
+	dynamics(false),
+	motion(),
+	torque(0.0f, 0.0f, 0.0f),
+	torqueSum(0.0f, 0.0f, 0.0f),
+	torqueSamples(0)
+{
+}
+
+HeadlessRunner::Snapshot::Snapshot()
+	: name(),
+	metric(FlowMetrics::MAGNITUDE),
+	width(1280),
+	height(720),
+	position(0.0f, 0.0f, 0.0f),
+	target(0.0f, 0.0f, 0.0f),
+	up(0.0f, 1.0f, 0.0f),
+	fov(degToRad(60.0f)),
+	nearZ(0.1f),
+	farZ(1000.0f),
+	stepSize(0.5f),
+	autoRange(false),
+	range(0.0f, 0.0f),
+	background(240.0f / 255.0f, 240.0f / 255.0f, 240.0f / 255.0f, 1.0f) // Qt pale gray as the render target of the GUI
+{
+}
+
+HeadlessRunner::Timings::Timings()
+	: load(0.0),
+	voxelization(0.0),
+	classification(0.0),
+	simulation(0.0),
+	dynamics(0.0),
+	output(0.0)
+{
+}
+
+HeadlessRunner::HeadlessRunner(const Options& options, const QJsonArray& project)
+	: m_options(options),
+	m_project(project),
+	m_threads(options.threads >= 0 ? options.threads : conf.cpu.threads),
+	m_meshes(),
+	m_hasGrid(false),
+	m_resolution(0, 0, 0),
+	m_voxelSize(0.0f, 0.0f, 0.0f),
+	m_gridWorld(),
+	m_voxelizationMode(VoxelizationMode::DistanceField),
+	m_importFile(),
+	m_computeFractions(false),
+	m_classifyCells(true),
+	m_removeCavities(true),
+	m_boundaryFaces(),
+	m_volumeSettings(),
+	m_solver(),
+	m_voxelized(),
+	m_cellTypes(),
+	m_solidFractions(),
+	m_velocity(),
+	m_pressure(),
+	m_density(),
+	m_densitySum(),
+	m_metrics(m_threads),
+	m_torqueFile(),
+	m_recorder(),
+	m_publisher(),
+	m_signals(),
+	m_probes(512, m_threads),
+	m_slices(16, m_threads),
+	m_isosurfaces(),
+	m_snapshots(),
+	m_streamlines(),
+	m_timings(),
+	m_result()
+{
+	XMStoreFloat4x4(&m_gridWorld, XMMatrixIdentity());
+}
+
+void HeadlessRunner::run()
+{
+	QElapsedTimer total;
+	total.start();
+
+	if (!QDir().mkpath(m_options.outputDir))
+		throw std::runtime_error("Failed to create the output directory '" + m_options.outputDir.toStdString() + "'.");
+	parseIsosurfaces();
+
+	QElapsedTimer timer;
+	timer.start();
+	loadProject();
+	m_timings.load = timer.nsecsElapsed() * 1e-6;
+
+	m_torqueFile.open(outputPath("torques.csv").toStdString(), std::ios::out | std::ios::trunc);
+	if (!m_torqueFile.is_open())
+		throw std::runtime_error("Failed to open '" + outputPath("torques.csv").toStdString() + "' for writing.");
+	m_torqueFile << "step,time,mesh,torqueX,torqueY,torqueZ,angVelX,angVelY,angVelZ" << std::endl;
+
+	// Only moving meshes require a new voxelization after each step
+	bool moving = false;
+	for (const auto& mesh : m_meshes)
+		moving |= mesh->voxelize && mesh->dynamics;
+
+	voxelize();
+	m_solver->updateGrid(m_cellTypes);
+
+	if (!m_options.recordFile.isEmpty())
+		startRecording();
+	if (!m_options.publishName.isEmpty())
+		startPublishing();
+	if (!m_options.probesFile.isEmpty())
+		loadProbes();
+	if (!m_options.slicesFile.isEmpty())
+		loadSlices();
+	if (!m_options.snapshotsFile.isEmpty())
+		loadSnapshots();
+	if (!m_options.streamlinesFile.isEmpty())
+		loadStreamlines();
+	const bool probing = m_probes.getNumPoints() > 0;
+	const bool slicing = m_slices.isOpen();
+
+	log("INFO: Running " + std::to_string(m_options.steps) + " steps with " + m_solver->getName() + " on a " + std::to_string(m_resolution.x) + "x" + std::to_string(m_resolution.y) + "x" + std::to_string(m_resolution.z) + " grid.");
+
+	double time = 0.0;
+	for (int step = 1; step <= m_options.steps; ++step)
+	{
+		timer.restart();
+		float timeStep = m_solver->step();
+		m_solver->fillVelocity(m_velocity);
+		m_solver->fillPressure(m_pressure);
+		time += timeStep;
+		if (m_recorder.isOpen() || m_publisher.isOpen() || probing || slicing)
+		{
+			// Part of the step time, so the steps/s include the overhead of the recording, publishing, probing and slicing
+			m_solver->fillDensity(m_density, m_densitySum);
+			FieldFrame frame = { step, time, m_resolution, m_velocity.data(), m_pressure.data(), m_density.data(), reinterpret_cast<const char*>(m_cellTypes.data()) };
+			if (m_recorder.isOpen())
+				m_recorder.submit(frame);
+			m_publisher.stepPublished(frame);
+			m_probes.stepPublished(frame);
+			m_slices.stepPublished(frame);
+		}
+		m_timings.simulation += timer.nsecsElapsed() * 1e-6;
+
+		// The torque of the first half of the run is dominated by the start-up of the flow
+		calculateDynamics(timeStep, step > m_options.steps / 2);
+		writeTorques(step, time);
+
+		if (moving && step < m_options.steps)
+		{
+			voxelize();
+			m_solver->updateGrid(m_cellTypes);
+		}
+
+		if (m_options.fieldsInterval > 0 && step % m_options.fieldsInterval == 0 && step < m_options.steps)
+			writeFields(outputPath(QString("fields_%1.wsb").arg(step)));
+
+		if (step % 100 == 0)
+			log("INFO: Step " + std::to_string(step) + "/" + std::to_string(m_options.steps) + ", simulated time " + std::to_string(time) + "s");
+	}
+
+	if (m_recorder.isOpen())
+		stopRecording();
+	if (m_publisher.isOpen())
+		stopPublishing();
+	if (probing)
+		stopProbes();
+	if (slicing)
+		stopSlices();
+	if (m_options.writeFields)
+		writeFields(outputPath("fields.wsb"));
+	if (!m_isosurfaces.empty())
+		writeIsosurfaces();
+	if (!m_snapshots.empty())
+		writeSnapshots();
+	if (!m_streamlines.empty())
+		writeStreamlines();
+	m_torqueFile.close();
+
+	collectResult(m_options.steps, time, total.nsecsElapsed() * 1e-6);
+	writeSummary();
+}
+
+QJsonArray HeadlessRunner::readProject(const QString& file)
+{
+	QFile f(file);
+	if (!f.open(QIODevice::ReadOnly))
+		throw std::runtime_error("Failed to open the project file '" + file.toStdString() + "'.");
+
+	QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
+	f.close();
+
+	if (!doc.isArray())
+		throw std::runtime_error("Objects not saved as Json-Array within the project file '" + file.toStdString() + "'!");
+
+	return doc.array();
+}
+
+void HeadlessRunner::loadProject()
+{
+	for (auto i : m_project)
+	{
+		QJsonObject obj = i.toObject();
+		ObjectType type = stringToObjectType(obj["type"].toString().toStdString());
+		if (type == ObjectType::Mesh)
+		{
+			addMesh(obj);
+		}
+		else if (type == ObjectType::VoxelGrid)
+		{
+			if (m_hasGrid)
+				log("WARNING: Only the first voxel grid is simulated, '" + obj["name"].toString().toStdString() + "' is ignored.");
+			else
+				setGrid(obj);
+		}
+		// Sky and axes are pure visualization
+	}
+
+	if (!m_hasGrid)
+		throw std::runtime_error("The project '" + m_options.projectFile.toStdString() + "' contains no voxel grid.");
+}
+
+void HeadlessRunner::addMesh(const QJsonObject& data)
+{
+	std::unique_ptr<Mesh> mesh(new Mesh());
+	mesh->name = data["name"].toString().toStdString();
+
+	if (!data.contains("obj-file"))
+		throw std::invalid_argument("Failed to create Mesh object '" + mesh->name + "' because no OBJ-Path was given!");
+
+	// Same preparation as Mesh3D::readObj
+	std::string path = absolutePath(m_options.projectFile, data["obj-file"].toString()).toStdString();
+	if (!ObjLoader::loadObj(path, mesh->vertexData, mesh->indexData))
+		throw std::runtime_error("Failed to load the OBJ file '" + path + "' of mesh '" + mesh->name + "'.");
+	ObjLoader::calculateNormals(mesh->vertexData, mesh->indexData);
+
+	QJsonObject jPos = data["position"].toObject();
+	mesh->position = XMFLOAT3(jPos["x"].toDouble(), jPos["y"].toDouble(), jPos["z"].toDouble());
+
+	QJsonObject jScale = data["scaling"].toObject();
+	mesh->scale = XMFLOAT3(jScale["x"].toDouble(), jScale["y"].toDouble(), jScale["z"].toDouble());
+
+	QJsonObject jRot = data["rotation"].toObject();
+	XMVECTOR axis = XMVectorSet(jRot["ax"].toDouble(), jRot["ay"].toDouble(), jRot["az"].toDouble(), 0.0);
+	if (XMVector3Equal(axis, XMVectorZero()))
+		XMStoreFloat4(&mesh->rotation, XMQuaternionIdentity());
+	else
+		XMStoreFloat4(&mesh->rotation, XMQuaternionRotationAxis(axis, degToRad(jRot["angle"].toDouble())));
+
+	// Disabled meshes are hidden in the view, but still take part in the simulation
+	mesh->voxelize = data["voxelize"].toBool();
+	mesh->dynamics = data["dynamics"].toBool();
+
+	float density = data["density"].toDouble();
+	if (density > 0)
+	{
+		std::vector<float> inertia;
+		std::vector<float> com;
+		std::vector<float> scaling{ mesh->scale.x, mesh->scale.y, mesh->scale.z };
+		float mass;
+		{
+			std::lock_guard<std::mutex> guard(s_massPropsMutex);
+			VolInt::calcMassProps(mesh->indexData, mesh->vertexData, scaling, density, inertia, com, &mass, nullptr);
+		}
+		mesh->motion.setMass(mass);
+		mesh->motion.setInertia(XMFLOAT3X3(inertia.data()));
+		mesh->motion.setCenterOfMass(XMFLOAT3(com[0], com[1], com[2]));
+		log("VERBOSE: Calculated mass " + std::to_string(mass) + "kg for mesh '" + mesh->name + "'");
+	}
+	else if (mesh->dynamics)
+	{
+		log("WARNING: Mesh '" + mesh->name + "' has no density, its dynamics are disabled.");
+		mesh->dynamics = false;
+	}
+
+	QJsonObject jAxis = data["localRotAxis"].toObject();
+	if (jAxis["enabled"].toBool())
+		mesh->motion.setRotationAxis(XMFLOAT3(jAxis["x"].toDouble(), jAxis["y"].toDouble(), jAxis["z"].toDouble()));
+
+	mesh->world = mesh->motion.getDynamicWorld(mesh->scale, mesh->rotation, mesh->position);
+
+	if (mesh->voxelize)
+	{
+		QElapsedTimer timer;
+		timer.start();
+		mesh->distanceField.build(mesh->vertexData, mesh->indexData, conf.vox.sdfResolution, conf.vox.sdfBand, m_threads);
+		log("INFO: Built signed distance field with resolution " + std::to_string(conf.vox.sdfResolution) + " for " + std::to_string(mesh->indexData.size() / 3) + " triangles in " + std::to_string(timer.nsecsElapsed() * 1e-6) + "msec");
+	}
+
+	m_meshes.push_back(std::move(mesh));
+}
+
+void HeadlessRunner::setGrid(const QJsonObject& data)
+{
+	if (!data.contains("resolution") || !data.contains("gridSize"))
+		throw std::invalid_argument("Failed to create VoxelGrid object '" + data["name"].toString().toStdString() + "' because no resolution or gridSize was given!");
+
+	QJsonObject jRes = data["resolution"].toObject();
+	m_resolution = XMUINT3(jRes["x"].toInt(), jRes["y"].toInt(), jRes["z"].toInt());
+	if (m_resolution.x == 0 || m_resolution.y == 0 || m_resolution.z == 0)
+		throw std::invalid_argument("The voxel grid '" + data["name"].toString().toStdString() + "' has an empty resolution.");
+
+	QJsonObject jS = data["gridSize"].toObject();
+	m_voxelSize = XMFLOAT3(jS["x"].toDouble() / m_resolution.x, jS["y"].toDouble() / m_resolution.y, jS["z"].toDouble() / m_resolution.z);
+
+	QJsonObject jPos = data["position"].toObject();
+	XMStoreFloat4x4(&m_gridWorld, XMMatrixTranslation(jPos["x"].toDouble(), jPos["y"].toDouble(), jPos["z"].toDouble()));
+	m_volumeSettings = data["volume"].toObject();
+
+	// Voxelization settings as in VoxelGrid::setVoxelizationSettings; there is no rasterizer, so meshes always use their distance fields
+	QJsonObject settings = data["voxelization"].toObject();
+	if (settings["mode"].toString() == "File")
+	{
+		m_voxelizationMode = VoxelizationMode::File;
+		m_importFile = absolutePath(m_options.projectFile, settings["file"].toString());
+	}
+	else if (settings["mode"].toString() != "DistanceField")
+	{
+		log("INFO: Rasterization is not available without a graphics device, the meshes are voxelized with their distance fields.");
+	}
+	m_computeFractions = settings["fractions"].toBool() && m_voxelizationMode != VoxelizationMode::File;
+	m_classifyCells = settings["classify"].toBool(true);
+	m_removeCavities = settings["removeCavities"].toBool(true);
+
+	QJsonObject facesJson = settings["faces"].toObject();
+	const char* faceNames[] = { "-x", "+x", "-y", "+y", "-z", "+z" };
+	for (int i = 0; i < CellClassifier::NUM_FACES; ++i)
+	{
+		if (!facesJson.contains(faceNames[i]))
+			continue;
+
+		QString type = facesJson[faceNames[i]].toString();
+		if (type == "Fluid")
+			m_boundaryFaces.type[i] = wtl::CELL_TYPE_FLUID;
+		else if (type == "Inflow")
+			m_boundaryFaces.type[i] = wtl::CELL_TYPE_INFLOW;
+		else if (type == "Outflow")
+			m_boundaryFaces.type[i] = wtl::CELL_TYPE_OUTFLOW;
+		else if (type == "SolidSlip")
+			m_boundaryFaces.type[i] = wtl::CELL_TYPE_SOLID_SLIP;
+		else if (type == "SolidNoSlip")
+			m_boundaryFaces.type[i] = wtl::CELL_TYPE_SOLID_NO_SLIP;
+		else
+			log("WARNING: Unknown boundary type \"" + type.toStdString() + "\" for grid face " + faceNames[i] + ".");
+	}
+
+	size_t size = static_cast<size_t>(m_resolution.x) * m_resolution.y * m_resolution.z;
+	m_cellTypes.resize(size);
+	m_velocity.resize(size * 4); // float3 + 1 padding
+	m_pressure.resize(size);
+	m_density.resize(size);
+	m_densitySum.resize(size);
+
+	createSolver(absolutePath(m_options.projectFile, data["windTunnelSettings"].toString()));
+	m_hasGrid = true;
+}
+
+void HeadlessRunner::createSolver(const QString& settingsFile)
+{
+	SolverType solver = conf.sim.solver;
+	if (m_options.solver == "CpuLbm")
+		solver = SolverType::CpuLbm;
+	else if (m_options.solver == "CpuProjection")
+		solver = SolverType::CpuProjection;
+	else if (!m_options.solver.isEmpty())
+		throw std::invalid_argument("Unknown solver '" + m_options.solver.toStdString() + "', expected CpuLbm or CpuProjection.");
+
+	// The WindTunnel library needs an OpenCL device shared with Direct3D
+	if (solver == SolverType::OpenCL)
+	{
+		log("WARNING: The OpenCL solver is not available in headless mode, using the CPU lattice Boltzmann solver instead.");
+		solver = SolverType::CpuLbm;
+	}
+
+	if (solver == SolverType::CpuProjection)
+		m_solver.reset(new ProjectionBackend(ProjectionBackend::readParameters(settingsFile.toStdString()), m_threads));
+	else
+		m_solver.reset(new LbmBackend(LbmBackend::readParameters(settingsFile.toStdString()), m_threads));
+
+	m_solver->setGridDimension(m_resolution, m_voxelSize);
+}
+
+void HeadlessRunner::voxelize()
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	const size_t numCells = m_cellTypes.size();
+	if (m_voxelizationMode == VoxelizationMode::File)
+	{
+		// The imported grid does not depend on the meshes, so it is only loaded once
+		if (m_voxelized.size() != numCells)
+		{
+			m_voxelized.assign(numCells, wtl::CELL_TYPE_FLUID);
+
+			BrickReader reader;
+			if (!reader.open(m_importFile))
+				throw std::runtime_error("Failed to import cell types: " + reader.errorString().toStdString());
+
+			XMUINT3 res = reader.getResolution();
+			int channel = reader.findChannel("cellTypes");
+			if (res.x != m_resolution.x || res.y != m_resolution.y || res.z != m_resolution.z)
+				throw std::runtime_error("The resolution of '" + m_importFile.toStdString() + "' does not match the voxel grid.");
+			if (channel < 0 || reader.getChannels()[channel].elementSize() != sizeof(wtl::CellType))
+				throw std::runtime_error("'" + m_importFile.toStdString() + "' does not contain cell types.");
+			reader.readChannel(channel, m_voxelized.data(), m_threads);
+		}
+	}
+	else
+	{
+		m_voxelized.assign(numCells, wtl::CELL_TYPE_FLUID);
+
+		// Voxel Space -> Grid Object Space -> World Space
+		XMMATRIX voxelToWorld = XMMatrixScalingFromVector(XMLoadFloat3(&m_voxelSize)) * XMLoadFloat4x4(&m_gridWorld);
+		for (const auto& mesh : m_meshes)
+		{
+			if (!mesh->voxelize)
+				continue;
+
+			// Voxel Space -> World Space -> Mesh Object Space
+			XMMATRIX voxelToObj = voxelToWorld * XMMatrixInverse(nullptr, XMLoadFloat4x4(&mesh->world));
+
+			// Conservative as in VoxelGrid::voxelizeDistanceField: dilate by an upper bound of the half voxel diagonal in object space
+			float dilation = 0.5f * (XMVectorGetX(XMVector3Length(voxelToObj.r[0])) + XMVectorGetX(XMVector3Length(voxelToObj.r[1])) + XMVectorGetX(XMVector3Length(voxelToObj.r[2])));
+
+			XMFLOAT4X4 voxelToObject;
+			XMStoreFloat4x4(&voxelToObject, voxelToObj);
+			mesh->distanceField.voxelize(voxelToObject, m_resolution, dilation, m_voxelized.data(), m_threads);
+			mesh->voxelizedWorld = mesh->world;
+		}
+	}
+	m_timings.voxelization += timer.nsecsElapsed() * 1e-6;
+
+	timer.restart();
+	std::copy(m_voxelized.begin(), m_voxelized.end(), m_cellTypes.begin());
+	if (m_classifyCells)
+		CellClassifier::classify(m_cellTypes.data(), m_resolution, m_boundaryFaces, m_removeCavities, m_threads);
+	m_timings.classification += timer.nsecsElapsed() * 1e-6;
+}
+
+void HeadlessRunner::computeSolidFractions()
+{
+	// World Space -> Grid Object Space -> Voxel Space
+	XMMATRIX worldToVoxel = XMMatrixInverse(nullptr, XMLoadFloat4x4(&m_gridWorld)) * XMMatrixScaling(1.0f / m_voxelSize.x, 1.0f / m_voxelSize.y, 1.0f / m_voxelSize.z);
+
+	std::vector<SolidFraction::Mesh> meshes;
+	for (const auto& mesh : m_meshes)
+	{
+		if (!mesh->voxelize)
+			continue;
+
+		SolidFraction::Mesh fractionMesh;
+		fractionMesh.vertexData = &mesh->vertexData;
+		fractionMesh.indexData = &mesh->indexData;
+		XMStoreFloat4x4(&fractionMesh.objectToVoxel, XMLoadFloat4x4(&mesh->voxelizedWorld) * worldToVoxel);
+		meshes.push_back(fractionMesh);
+	}
+
+	SolidFraction::compute(meshes, m_resolution, m_voxelSize, m_solidFractions, m_threads);
+}
+
+void HeadlessRunner::calculateDynamics(float timeStep, bool accumulate)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	// World Space -> Grid Object Space -> Voxel Space
+	XMFLOAT4X4 worldToVoxel;
+	XMStoreFloat4x4(&worldToVoxel, XMMatrixInverse(nullptr, XMLoadFloat4x4(&m_gridWorld)) * XMMatrixScaling(1.0f / m_voxelSize.x, 1.0f / m_voxelSize.y, 1.0f / m_voxelSize.z));
+
+	const std::vector<float>& field = conf.dyn.method == Pressure ? m_pressure : m_velocity;
+	for (auto& mesh : m_meshes)
+	{
+		if (!mesh->voxelize)
+			continue;
+
+		mesh->torque = mesh->motion.calculateTorque(mesh->vertexData, mesh->indexData, mesh->world, worldToVoxel, m_resolution, conf.dyn.method, field, m_cellTypes.data(), m_threads);
+		if (accumulate)
+		{
+			XMStoreFloat3(&mesh->torqueSum, XMLoadFloat3(&mesh->torqueSum) + XMLoadFloat3(&mesh->torque));
+			mesh->torqueSamples++;
+		}
+
+		if (mesh->dynamics)
+		{
+			mesh->motion.integrate(mesh->torque, mesh->rotation, timeStep);
+			mesh->world = mesh->motion.getDynamicWorld(mesh->scale, mesh->rotation, mesh->position);
+		}
+	}
+
+	m_timings.dynamics += timer.nsecsElapsed() * 1e-6;
+}
+
+void HeadlessRunner::writeTorques(int step, double time)
+{
+	for (const auto& mesh : m_meshes)
+	{
+		if (!mesh->voxelize)
+			continue;
+
+		// Angular velocity in world space (see MeshActor::getAngularVelocity)
+		XMFLOAT3 angVel;
+		XMStoreFloat3(&angVel, XMVector3Rotate(XMLoadFloat3(&mesh->motion.getAngularVelocity()), XMLoadFloat4(&mesh->rotation)));
+
+		m_torqueFile << step << "," << time << "," << mesh->name << ","
+			<< mesh->torque.x << "," << mesh->torque.y << "," << mesh->torque.z << ","
+			<< angVel.x << "," << angVel.y << "," << angVel.z << "\n";
+
+		// Analysed by the thread of the statistics
+		float torque, axialAngVel, angAcc;
+		mesh->motion.getAxialMotion(mesh->torque, mesh->rotation, torque, axialAngVel, angAcc);
+		m_signals.add(mesh->name + "/torque", time, torque);
+		if (mesh->dynamics)
+		{
+			m_signals.add(mesh->name + "/angVel", time, axialAngVel);
+			m_signals.add(mesh->name + "/angAcc", time, angAcc);
+		}
+	}
+}
+
+void HeadlessRunner::writeFields(const QString& file)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	m_solver->fillDensity(m_density, m_densitySum);
+
+	BrickWriter writer;
+	bool success = writer.open(file, m_resolution, m_voxelSize)
+		&& writer.writeChannel("cellTypes", BrickFile::ElementType::UInt8, 1, m_cellTypes.data())
+		&& writer.writeChannel("velocity", BrickFile::ElementType::Float32, 4, m_velocity.data())
+		&& writer.writeChannel("pressure", BrickFile::ElementType::Float32, 1, m_pressure.data())
+		&& writer.writeChannel("density", BrickFile::ElementType::Float32, 1, m_density.data());
+
+	// Only needed for the output, so they are computed here instead of with every voxelization
+	if (success && m_computeFractions)
+	{
+		computeSolidFractions();
+		success = writer.writeChannel("solidFractions", BrickFile::ElementType::Float32, 4, m_solidFractions.data());
+	}
+
+	if (success && m_options.writeMetrics)
+	{
+		m_metrics.compute(m_velocity.data(), m_resolution);
+		for (int t = 0; t < FlowMetrics::NUM_TYPES && success; ++t)
+			success = writer.writeChannel(FlowMetrics::name(FlowMetrics::Type(t)), BrickFile::ElementType::Float32, 1, m_metrics.get(FlowMetrics::Type(t)).data());
+	}
+	success = success && writer.close();
+
+	if (!success)
+		throw std::runtime_error("Failed to write the fields: " + writer.errorString().toStdString());
+
+	m_timings.output += timer.nsecsElapsed() * 1e-6;
+}
+
+void HeadlessRunner::startRecording()
+{
+	FieldRecorder::Options options;
+	options.errorBound = conf.rec.errorBound;
+	options.interval = conf.rec.interval;
+	options.queueFrames = conf.rec.queueFrames;
+	options.threads = conf.rec.threads;
+	options.policy = conf.rec.dropFrames ? FieldRecorder::Policy::Drop : FieldRecorder::Policy::Block;
+
+	if (!m_recorder.open(m_options.recordFile, m_resolution, m_voxelSize, options))
+		throw std::runtime_error("Failed to start the recording: " + m_recorder.errorString().toStdString());
+}
+
+void HeadlessRunner::stopRecording()
+{
+	// Waits for the queued frames; only the time after the last step counts as output
+	QElapsedTimer timer;
+	timer.start();
+	bool success = m_recorder.close();
+	m_timings.output += timer.nsecsElapsed() * 1e-6;
+
+	if (!success)
+		throw std::runtime_error("Failed to write the recording: " + m_recorder.errorString().toStdString());
+
+	std::ostringstream msg;
+	msg << "INFO: Recorded " << m_recorder.getNumFrames() << " frames (" << m_recorder.getNumDropped() << " dropped) to '" << m_options.recordFile.toStdString() << "', compression ratio "
+		<< (m_recorder.getCompressedBytes() > 0 ? static_cast<double>(m_recorder.getRawBytes()) / m_recorder.getCompressedBytes() : 0.0) << ", "
+		<< (m_recorder.getNumFrames() > 0 ? m_recorder.getSubmitTime() / m_recorder.getNumFrames() : 0.0) << "msec per frame in the simulation loop";
+	log(msg.str());
+}
+
+void HeadlessRunner::startPublishing()
+{
+	if (!m_publisher.open(m_options.publishName.toStdString(), m_resolution, m_voxelSize, conf.pub.slots, conf.pub.interval))
+		throw std::runtime_error("Failed to publish the fields as '" + m_options.publishName.toStdString() + "': " + m_publisher.errorString());
+	log("INFO: Publishing the fields as '" + m_options.publishName.toStdString() + "'.");
+}
+
+void HeadlessRunner::stopPublishing()
+{
+	std::ostringstream msg;
+	msg << "INFO: Published " << m_publisher.getNumPublished() << " steps as '" << m_options.publishName.toStdString() << "', "
+		<< (m_publisher.getNumPublished() > 0 ? m_publisher.getPublishTime() / m_publisher.getNumPublished() : 0.0) << "msec per step in the simulation loop";
+	log(msg.str());
+	m_publisher.close();
+}
+
+void HeadlessRunner::loadProbes()
+{
+	QFile f(m_options.probesFile);
+	if (!f.open(QIODevice::ReadOnly))
+		throw std::runtime_error("Failed to open the probes file '" + m_options.probesFile.toStdString() + "'.");
+	QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
+	f.close();
+
+	if (!doc.isArray())
+		throw std::runtime_error("The probes file '" + m_options.probesFile.toStdString() + "' contains no Json-Array.");
+
+	auto vector = [](const QJsonValue& value)
+	{
+		QJsonObject v = value.toObject();
+		return XMFLOAT3(v["x"].toDouble(), v["y"].toDouble(), v["z"].toDouble());
+	};
+
+	QJsonArray probes = doc.array();
+	for (int i = 0; i < probes.size(); ++i)
+	{
+		QJsonObject obj = probes[i].toObject();
+		std::string type = obj["type"].toString().toStdString();
+		std::string name = obj["name"].toString().toStdString();
+		if (name.empty())
+			name = "probe" + std::to_string(i);
+
+		if (type == "point")
+			m_probes.addPoint(name, vector(obj["position"]));
+		else if (type == "line")
+			m_probes.addLine(name, vector(obj["from"]), vector(obj["to"]), obj["points"].toInt(2));
+		else if (type == "plane")
+			m_probes.addPlane(name, vector(obj["origin"]), vector(obj["u"]), vector(obj["v"]), obj["pointsU"].toInt(2), obj["pointsV"].toInt(2));
+		else
+			throw std::runtime_error("The probe '" + name + "' has the unknown type '" + type + "'.");
+	}
+
+	m_probes.setGridTransform(m_gridWorld, m_voxelSize);
+	m_probes.setStatistics(&m_signals);
+	if (!m_probes.openFile(outputPath("probes.csv").toStdString()))
+		throw std::runtime_error(m_probes.errorString());
+	log("INFO: Sampling " + std::to_string(m_probes.getNumPoints()) + " points of " + std::to_string(probes.size()) + " probes.");
+}
+
+void HeadlessRunner::stopProbes()
+{
+	// Waits for the queued steps; only the time after the last step counts as output
+	QElapsedTimer timer;
+	timer.start();
+	m_probes.closeFile();
+	m_timings.output += timer.nsecsElapsed() * 1e-6;
+
+	std::ostringstream msg;
+	msg << "INFO: Sampled " << m_probes.getNumPoints() << " probe points in " << m_probes.getNumSteps() << " steps (" << m_probes.getNumDropped() << " not written), "
+		<< (m_probes.getNumSteps() > 0 ? m_probes.getSampleTime() / m_probes.getNumSteps() : 0.0) << "msec per step in the simulation loop";
+	log(msg.str());
+}
+
+void HeadlessRunner::loadSlices()
+{
+	QFile f(m_options.slicesFile);
+	if (!f.open(QIODevice::ReadOnly))
+		throw std::runtime_error("Failed to open the slices file '" + m_options.slicesFile.toStdString() + "'.");
+	QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
+	f.close();
+
+	if (!doc.isArray())
+		throw std::runtime_error("The slices file '" + m_options.slicesFile.toStdString() + "' contains no Json-Array.");
+
+	QJsonArray slices = doc.array();
+	for (int i = 0; i < slices.size(); ++i)
+	{
+		QJsonObject obj = slices[i].toObject();
+		FieldSlices::Slice slice;
+		slice.name = obj["name"].toString().toStdString();
+		if (slice.name.empty())
+			slice.name = "slice" + std::to_string(i);
+
+		const QString orientation = obj["orientation"].toString("XY");
+		if (orientation == "XY")
+			slice.orientation = FieldSlices::Orientation::XY;
+		else if (orientation == "XZ")
+			slice.orientation = FieldSlices::Orientation::XZ;
+		else if (orientation == "YZ")
+			slice.orientation = FieldSlices::Orientation::YZ;
+		else
+			throw std::runtime_error("The slice '" + slice.name + "' has the unknown orientation '" + orientation.toStdString() + "'.");
+
+		const std::string field = obj["field"].toString("velocity").toStdString();
+		if (field == "velocity")
+			slice.field = FieldSlices::Field::Velocity;
+		else if (field == "pressure")
+			slice.field = FieldSlices::Field::Pressure;
+		else if (field == "density")
+			slice.field = FieldSlices::Field::Density;
+		else
+		{
+			int type = 0;
+			while (type < FlowMetrics::NUM_TYPES && field != FlowMetrics::name(FlowMetrics::Type(type)))
+				++type;
+			if (type == FlowMetrics::NUM_TYPES)
+				throw std::runtime_error("The slice '" + slice.name + "' has the unknown field '" + field + "'.");
+			slice.field = FieldSlices::Field::Metric;
+			slice.metric = FlowMetrics::Type(type);
+		}
+
+		const QString format = obj["format"].toString("png");
+		if (format == "png")
+			slice.format = FieldSlices::Format::Png;
+		else if (format == "raw")
+			slice.format = FieldSlices::Format::Raw;
+		else if (format == "csv")
+			slice.format = FieldSlices::Format::Csv;
+		else
+			throw std::runtime_error("The slice '" + slice.name + "' has the unknown format '" + format.toStdString() + "'.");
+
+		slice.position = static_cast<float>(obj["position"].toDouble(0.5));
+		slice.interval = obj["interval"].toInt(1);
+		if (obj.contains("min") && obj.contains("max"))
+			slice.range = XMFLOAT2(static_cast<float>(obj["min"].toDouble()), static_cast<float>(obj["max"].toDouble()));
+		m_slices.add(slice);
+	}
+
+	const QString directory = outputPath("slices");
+	if (!QDir().mkpath(directory))
+		throw std::runtime_error("Failed to create the slices directory '" + directory.toStdString() + "'.");
+	m_slices.open(directory.toStdString());
+	log("INFO: Writing " + std::to_string(slices.size()) + " slices.");
+}
+
+void HeadlessRunner::stopSlices()
+{
+	// Waits for the queued steps; only the time after the last step counts as output
+	QElapsedTimer timer;
+	timer.start();
+	m_slices.close();
+	m_timings.output += timer.nsecsElapsed() * 1e-6;
+
+	std::ostringstream msg;
+	msg << "INFO: Sliced " << m_slices.getNumSteps() << " steps (" << m_slices.getNumDropped() << " not written, " << m_slices.getNumFailed() << " files failed), "
+		<< (m_slices.getNumSteps() > 0 ? m_slices.getCopyTime() / m_slices.getNumSteps() : 0.0) << "msec per step in the simulation loop";
+	log(msg.str());
+}
+
+void HeadlessRunner::parseIsosurfaces()
+{
+	m_isosurfaces.clear();
+	for (const QString& isosurface : m_options.isosurfaces)
+	{
+		const QStringList parts = isosurface.split('=');
+		bool valid = parts.size() == 2;
+		const float value = valid ? parts[1].toFloat(&valid) : 0.0f;
+
+		int type = 0;
+		while (valid && type < FlowMetrics::NUM_TYPES && parts[0].toStdString() != FlowMetrics::name(FlowMetrics::Type(type)))
+			++type;
+		if (!valid || type == FlowMetrics::NUM_TYPES)
+			throw std::runtime_error("Invalid isosurface '" + isosurface.toStdString() + "', expected <metric>=<value> with a metric of the written fields, e.g. qCriterion=0.01.");
+
+		m_isosurfaces.push_back(std::make_pair(FlowMetrics::Type(type), value));
+	}
+}
+
+void HeadlessRunner::writeIsosurfaces()
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	unsigned int types = 0;
+	for (const auto& isosurface : m_isosurfaces)
+		types |= FlowMetrics::mask(isosurface.first);
+	m_metrics.compute(m_velocity.data(), m_resolution, types);
+
+	Isosurface extractor(m_threads);
+	std::vector<float> negated;
+	for (const auto& isosurface : m_isosurfaces)
+	{
+		const std::string name = FlowMetrics::name(isosurface.first);
+		const std::vector<float>& values = m_metrics.get(isosurface.first);
+		if (isosurface.first == FlowMetrics::LAMBDA2_CRITERION)
+		{
+			negated.resize(values.size());
+			std::transform(values.begin(), values.end(), negated.begin(), std::negate<float>());
+			extractor.extract(negated.data(), m_resolution, m_voxelSize, -isosurface.second);
+		}
+		else
+		{
+			extractor.extract(values.data(), m_resolution, m_voxelSize, isosurface.second);
+		}
+
+		const QString file = outputPath(QString::fromStdString("isosurface_" + name + ".ply"));
+		if (!extractor.writePly(file.toStdString()))
+			throw std::runtime_error("Failed to write the isosurface: " + extractor.errorString());
+
+		std::ostringstream msg;
+		msg << "INFO: Isosurface " << name << "=" << isosurface.second << ": " << extractor.getNumTriangles() << " triangles in " << extractor.getExtractTime() << "msec ("
+			<< static_cast<int>(extractor.getActiveBricks() * 100.0f + 0.5f) << "% of the bricks)";
+		log(msg.str());
+	}
+
+	m_timings.output += timer.nsecsElapsed() * 1e-6;
+}
+
+void HeadlessRunner::loadSnapshots()
+{
+	QFile f(m_options.snapshotsFile);
+	if (!f.open(QIODevice::ReadOnly))
+		throw std::runtime_error("Failed to open the snapshots file '" + m_options.snapshotsFile.toStdString() + "'.");
+	QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
+	f.close();
+
+	if (!doc.isArray())
+		throw std::runtime_error("The snapshots file '" + m_options.snapshotsFile.toStdString() + "' contains no Json-Array.");
+
+	auto vector = [](const QJsonValue& value, const XMFLOAT3& fallback)
+	{
+		if (!value.isObject())
+			return fallback;
+		QJsonObject v = value.toObject();
+		return XMFLOAT3(v["x"].toDouble(), v["y"].toDouble(), v["z"].toDouble());
+	};
+
+	// The center of the grid in world space
+	XMFLOAT3 center;
+	XMStoreFloat3(&center, XMVector3TransformCoord(XMVectorSet(0.5f * m_resolution.x * m_voxelSize.x, 0.5f * m_resolution.y * m_voxelSize.y, 0.5f * m_resolution.z * m_voxelSize.z, 1.0f), XMLoadFloat4x4(&m_gridWorld)));
+
+	const QString defaultMetric = Metric::toString(Metric::toMetric(m_volumeSettings["metric"].toString()));
+	QJsonArray snapshots = doc.array();
+	for (int i = 0; i < snapshots.size(); ++i)
+	{
+		QJsonObject obj = snapshots[i].toObject();
+		Snapshot snapshot;
+		snapshot.name = obj["name"].toString().toStdString();
+		if (snapshot.name.empty())
+			snapshot.name = "snapshot" + std::to_string(i);
+
+		const std::string metric = obj["metric"].toString().toStdString();
+		if (metric.empty())
+		{
+			snapshot.metric = FlowMetrics::Type(Metric::toMetric(defaultMetric));
+		}
+		else
+		{
+			int type = 0;
+			while (type < FlowMetrics::NUM_TYPES && metric != FlowMetrics::name(FlowMetrics::Type(type)))
+				++type;
+			if (type == FlowMetrics::NUM_TYPES)
+				throw std::runtime_error("The snapshot '" + snapshot.name + "' has the unknown metric '" + metric + "'.");
+			snapshot.metric = FlowMetrics::Type(type);
+		}
+
+		snapshot.width = obj["width"].toInt(snapshot.width);
+		snapshot.height = obj["height"].toInt(snapshot.height);
+		if (snapshot.width <= 0 || snapshot.height <= 0)
+			throw std::runtime_error("The snapshot '" + snapshot.name + "' has an empty size.");
+
+		QJsonObject camera = obj["camera"].toObject();
+		if (!camera.contains("position"))
+			throw std::runtime_error("The snapshot '" + snapshot.name + "' has no camera position.");
+		snapshot.position = vector(camera["position"], snapshot.position);
+		snapshot.target = vector(camera["target"], center);
+		snapshot.up = vector(camera["up"], snapshot.up);
+		snapshot.fov = degToRad(static_cast<float>(camera["fov"].toDouble(60.0)));
+		snapshot.nearZ = static_cast<float>(camera["near"].toDouble(snapshot.nearZ));
+		snapshot.farZ = static_cast<float>(camera["far"].toDouble(snapshot.farZ));
+
+		const XMVECTOR direction = XMVectorSubtract(XMLoadFloat3(&snapshot.target), XMLoadFloat3(&snapshot.position));
+		if (XMVectorGetX(XMVector3Length(direction)) <= 0.0f || XMVectorGetX(XMVector3Length(XMVector3Cross(direction, XMLoadFloat3(&snapshot.up)))) <= 0.0f)
+			throw std::runtime_error("The camera of the snapshot '" + snapshot.name + "' looks at its position or along its up vector.");
+		if (!(snapshot.fov > 0.0f && snapshot.fov < degToRad(180.0f)) || !(snapshot.nearZ > 0.0f && snapshot.farZ > snapshot.nearZ))
+			throw std::runtime_error("The camera of the snapshot '" + snapshot.name + "' has an invalid field of view or depth range.");
+
+		snapshot.stepSize = static_cast<float>(obj["stepSize"].toDouble(m_volumeSettings["stepSize"].toDouble(0.5)));
+		snapshot.autoRange = obj["autoRange"].toBool(m_volumeSettings["autoRange"].toBool());
+		if (obj.contains("min") && obj.contains("max"))
+			snapshot.range = XMFLOAT2(static_cast<float>(obj["min"].toDouble()), static_cast<float>(obj["max"].toDouble()));
+
+		QJsonArray background = obj["background"].toArray();
+		if (background.size() >= 3)
+		{
+			snapshot.background = XMFLOAT4(background[0].toInt() / 255.0f, background[1].toInt() / 255.0f, background[2].toInt() / 255.0f,
+				background.size() >= 4 ? background[3].toInt() / 255.0f : 1.0f);
+		}
+		m_snapshots.push_back(snapshot);
+	}
+	log("INFO: Rendering " + std::to_string(m_snapshots.size()) + " snapshots after the last step.");
+}
+
+void HeadlessRunner::writeSnapshots()
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	unsigned int types = 0;
+	for (const Snapshot& snapshot : m_snapshots)
+		types |= FlowMetrics::mask(snapshot.metric);
+	m_metrics.compute(m_velocity.data(), m_resolution, types);
+
+	const QString directory = outputPath("snapshots");
+	if (!QDir().mkpath(directory))
+		throw std::runtime_error("Failed to create the snapshots directory '" + directory.toStdString() + "'.");
+
+	const QJsonObject functions = m_volumeSettings["transferFunctions"].toObject();
+	VolumeRaycaster raycaster(m_threads);
+	int fieldMetric = -1;
+	for (const Snapshot& snapshot : m_snapshots)
+	{
+		// The macrocells are only rebuilt for another metric
+		const std::vector<float>& values = m_metrics.get(snapshot.metric);
+		if (fieldMetric != snapshot.metric)
+		{
+			raycaster.setField(values.data(), m_resolution, m_voxelSize);
+			fieldMetric = snapshot.metric;
+		}
+
+		// FlowMetrics::Type is in the order of Metric::Volume
+		const QString metric = Metric::toString(Metric::Volume(snapshot.metric));
+		TransferFunction txfn = functions.contains(metric) ? TransferFunction::fromJson(functions[metric].toObject()) : TransferFunction();
+		std::vector<char> texture;
+		txfn.getTexR8G8B8A8(texture, VolumeRaycaster::TXFN_RESOLUTION);
+
+		// As VolumeRenderer::updateRange, without the smoothing over the steps
+		float rangeMin = static_cast<float>(txfn.rangeMin), rangeMax = static_cast<float>(txfn.rangeMax);
+		if (snapshot.range.x < snapshot.range.y)
+		{
+			rangeMin = snapshot.range.x;
+			rangeMax = snapshot.range.y;
+		}
+		else if (snapshot.autoRange)
+		{
+			FieldStatistics::Result statistics = FieldStatistics::compute(values.data(), values.size(), m_threads);
+			if (statistics.count > 0)
+			{
+				rangeMin = statistics.percentile(0.01);
+				rangeMax = statistics.percentile(0.99);
+				if (rangeMax <= rangeMin)
+				{
+					const float pad = std::max(std::abs(rangeMax), 1.0e-6f);
+					rangeMin -= pad;
+					rangeMax += pad;
+				}
+			}
+		}
+		raycaster.setTransferFunction(texture, rangeMin, rangeMax);
+		raycaster.setStepSize(snapshot.stepSize);
+
+		XMFLOAT4X4 view, projection;
+		XMStoreFloat4x4(&view, XMMatrixLookAtLH(XMLoadFloat3(&snapshot.position), XMLoadFloat3(&snapshot.target), XMLoadFloat3(&snapshot.up)));
+		XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(snapshot.fov, static_cast<float>(snapshot.width) / snapshot.height, snapshot.nearZ, snapshot.farZ));
+		raycaster.render(m_gridWorld, view, projection, snapshot.width, snapshot.height);
+
+		const QString file = directory + "/" + QString::fromStdString(snapshot.name + ".png");
+		if (!raycaster.writePng(file.toStdString(), snapshot.background))
+			throw std::runtime_error("Failed to write the snapshot '" + snapshot.name + "': " + raycaster.errorString());
+
+		std::ostringstream msg;
+		msg << "INFO: Snapshot " << snapshot.name << " of " << FlowMetrics::name(snapshot.metric) << " [" << rangeMin << ", " << rangeMax << "]: " << snapshot.width << "x" << snapshot.height
+			<< " in " << raycaster.getRenderTime() << "msec (" << raycaster.getSamplesPerRay() << " samples per ray, " << static_cast<int>(raycaster.getEmptyMacrocells() * 100.0f + 0.5f)
+			<< "% of the macrocells skipped)";
+		log(msg.str());
+	}
+
+	m_timings.output += timer.nsecsElapsed() * 1e-6;
+}
+
+void HeadlessRunner::loadStreamlines()
+{
+	QFile f(m_options.streamlinesFile);
+	if (!f.open(QIODevice::ReadOnly))
+		throw std::runtime_error("Failed to open the streamlines file '" + m_options.streamlinesFile.toStdString() + "'.");
+	QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
+	f.close();
+
+	if (!doc.isArray())
+		throw std::runtime_error("The streamlines file '" + m_options.streamlinesFile.toStdString() + "' contains no Json-Array.");
+
+	auto vector = [](const QJsonValue& value)
+	{
+		QJsonObject v = value.toObject();
+		return XMFLOAT3(v["x"].toDouble(), v["y"].toDouble(), v["z"].toDouble());
+	};
+
+	// Points from <origin> to <origin> + <u> + <v>, including the ends
+	auto span = [](const XMFLOAT3& origin, const XMFLOAT3& u, const XMFLOAT3& v, int numU, int numV, std::vector<XMFLOAT3>& seeds)
+	{
+		for (int j = 0; j < numV; ++j)
+		{
+			float tv = numV > 1 ? static_cast<float>(j) / (numV - 1) : 0.0f;
+			for (int i = 0; i < numU; ++i)
+			{
+				float tu = numU > 1 ? static_cast<float>(i) / (numU - 1) : 0.0f;
+				seeds.push_back(XMFLOAT3(origin.x + tu * u.x + tv * v.x, origin.y + tu * u.y + tv * v.y, origin.z + tu * u.z + tv * v.z));
+			}
+		}
+	};
+
+	size_t numSeeds = 0;
+	QJsonArray sets = doc.array();
+	for (int i = 0; i < sets.size(); ++i)
+	{
+		QJsonObject obj = sets[i].toObject();
+		StreamlineSet set;
+		std::string type = obj["type"].toString().toStdString();
+		set.name = obj["name"].toString().toStdString();
+		if (set.name.empty())
+			set.name = "seeds" + std::to_string(i);
+
+		if (type == "point")
+		{
+			set.seeds.push_back(vector(obj["position"]));
+		}
+		else if (type == "line")
+		{
+			XMFLOAT3 from = vector(obj["from"]);
+			XMFLOAT3 to = vector(obj["to"]);
+			span(from, XMFLOAT3(to.x - from.x, to.y - from.y, to.z - from.z), XMFLOAT3(0.0f, 0.0f, 0.0f), std::max(obj["points"].toInt(2), 1), 1, set.seeds);
+		}
+		else if (type == "plane")
+		{
+			span(vector(obj["origin"]), vector(obj["u"]), vector(obj["v"]), std::max(obj["pointsU"].toInt(2), 1), std::max(obj["pointsV"].toInt(2), 1), set.seeds);
+		}
+		else
+		{
+			throw std::runtime_error("The seed set '" + set.name + "' has the unknown type '" + type + "'.");
+		}
+
+		const std::string integrator = obj["integrator"].toString("rk45").toLower().toStdString();
+		const std::string direction = obj["direction"].toString("both").toLower().toStdString();
+		if (integrator != "rk4" && integrator != "rk45")
+			throw std::runtime_error("The seed set '" + set.name + "' has the unknown integrator '" + integrator + "'.");
+		if (direction != "forward" && direction != "backward" && direction != "both")
+			throw std::runtime_error("The seed set '" + set.name + "' has the unknown direction '" + direction + "'.");
+		set.options.integrator = integrator == "rk4" ? StreamTracer::Integrator::RK4 : StreamTracer::Integrator::RK45;
+		set.options.direction = direction == "forward" ? StreamTracer::Direction::Forward : direction == "backward" ? StreamTracer::Direction::Backward : StreamTracer::Direction::Both;
+		set.options.stepSize = static_cast<float>(obj["stepSize"].toDouble(set.options.stepSize));
+		set.options.maxVertices = std::max(obj["maxVertices"].toInt(set.options.maxVertices), 2);
+		set.options.threads = m_threads;
+
+		numSeeds += set.seeds.size();
+		m_streamlines.push_back(set);
+	}
+	log("INFO: Tracing " + std::to_string(numSeeds) + " streamlines of " + std::to_string(m_streamlines.size()) + " seed sets after the last step.");
+}
+
+void HeadlessRunner::writeStreamlines()
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	static const char* ends[] = { "active", "length", "outside", "solid", "stalled" };
+
+	// World space -> grid object space -> voxel space, as the probes; the vertices go back to grid object space
+	XMMATRIX worldToVoxel = XMMatrixInverse(nullptr, XMLoadFloat4x4(&m_gridWorld)) * XMMatrixScalingFromVector(XMVectorReciprocal(XMLoadFloat3(&m_voxelSize)));
+	FieldSampler sampler(m_velocity.data(), nullptr, m_resolution);
+	Polylines lines;
+	for (const StreamlineSet& set : m_streamlines)
+	{
+		std::vector<XMFLOAT3> seeds(set.seeds.size());
+		for (size_t i = 0; i < seeds.size(); ++i)
+			XMStoreFloat3(&seeds[i], XMVector3TransformCoord(XMLoadFloat3(&set.seeds[i]), worldToVoxel));
+
+		StreamTracer tracer(set.options);
+		tracer.trace(sampler, m_cellTypes.data(), seeds, lines);
+
+		const std::string file = outputPath(QString::fromStdString("streamlines_" + set.name + ".csv")).toStdString();
+		std::ofstream out(file, std::ios::out | std::ios::trunc);
+		if (!out.is_open())
+			throw std::runtime_error("Failed to open '" + file + "' for writing.");
+		out << "line,vertex,x,y,z,speed,end" << std::endl;
+		for (size_t line = 0; line < lines.numLines(); ++line)
+		{
+			for (uint32_t v = 0; v < lines.numVertices(line); ++v)
+			{
+				const XMFLOAT4& vertex = lines.vertices[lines.first[line] + v];
+				out << line << "," << v << "," << vertex.x * m_voxelSize.x << "," << vertex.y * m_voxelSize.y << "," << vertex.z * m_voxelSize.z << ","
+					<< vertex.w << "," << ends[lines.end[line]] << "\n";
+			}
+		}
+		out.close();
+		if (out.fail())
+			throw std::runtime_error("Failed to write '" + file + "'.");
+
+		std::ostringstream msg;
+		msg << "INFO: Streamlines " << set.name << ": " << lines.numLines() << " lines with " << lines.vertices.size() << " vertices in " << tracer.getTraceTime() << "msec";
+		log(msg.str());
+	}
+
+	m_timings.output += timer.nsecsElapsed() * 1e-6;
+}
+
+void HeadlessRunner::collectResult(int steps, double simulatedTime, double totalTime)
+{
+	m_result = Result();
+	m_result.steps = steps;
+	m_result.threads = static_cast<int>(Parallel::numThreads(m_threads));
+	m_result.simulatedTime = simulatedTime;
+	m_result.totalTime = totalTime;
+
+	double cells = static_cast<double>(m_resolution.x) * m_resolution.y * m_resolution.z;
+	m_result.stepsPerSecond = m_timings.simulation > 0.0 ? steps / (m_timings.simulation * 1e-3) : 0.0;
+	m_result.mlups = m_timings.simulation > 0.0 ? cells * steps / (m_timings.simulation * 1e3) : 0.0; // Million lattice updates per second
+
+	for (const auto& mesh : m_meshes)
+	{
+		if (!mesh->voxelize)
+			continue;
+
+		MeshResult m;
+		m.name = mesh->name;
+		m.dynamics = mesh->dynamics;
+		m.torque = mesh->torque;
+		float n = static_cast<float>(std::max(mesh->torqueSamples, 1));
+		m.meanTorque = XMFLOAT3(mesh->torqueSum.x / n, mesh->torqueSum.y / n, mesh->torqueSum.z / n);
+		XMStoreFloat3(&m.angularVelocity, XMVector3Rotate(XMLoadFloat3(&mesh->motion.getAngularVelocity()), XMLoadFloat4(&mesh->rotation)));
+		m_result.meshes.push_back(m);
+	}
+
+	m_signals.flush();
+	m_result.signalStatistics = m_signals.getSignals();
+}
+
+void HeadlessRunner::writeSummary()
+{
+	QJsonObject summary;
+	summary["project"] = QFileInfo(m_options.projectFile).absoluteFilePath();
+	summary["solver"] = QString::fromStdString(m_solver->getName());
+	summary["threads"] = m_result.threads;
+
+	QJsonObject grid;
+	grid["x"] = static_cast<int>(m_resolution.x);
+	grid["y"] = static_cast<int>(m_resolution.y);
+	grid["z"] = static_cast<int>(m_resolution.z);
+	summary["resolution"] = grid;
+	summary["voxelSize"] = vectorToJson(m_voxelSize);
+
+	summary["steps"] = m_result.steps;
+	summary["simulatedTime"] = m_result.simulatedTime;
+
+	// Wall clock times in msec
+	QJsonObject timings;
+	timings["total"] = m_result.totalTime;
+	timings["load"] = m_timings.load;
+	timings["voxelization"] = m_timings.voxelization;
+	timings["classification"] = m_timings.classification;
+	timings["simulation"] = m_timings.simulation;
+	timings["dynamics"] = m_timings.dynamics;
+	timings["output"] = m_timings.output;
+	summary["timings"] = timings;
+
+	summary["stepsPerSecond"] = m_result.stepsPerSecond;
+	summary["mlups"] = m_result.mlups;
+
+	if (!m_options.recordFile.isEmpty())
+	{
+		QJsonObject recording;
+		recording["file"] = QFileInfo(m_options.recordFile).absoluteFilePath();
+		recording["frames"] = static_cast<double>(m_recorder.getNumFrames());
+		recording["dropped"] = static_cast<double>(m_recorder.getNumDropped());
+		recording["rawBytes"] = static_cast<double>(m_recorder.getRawBytes());
+		recording["compressedBytes"] = static_cast<double>(m_recorder.getCompressedBytes());
+		recording["submitTime"] = m_recorder.getSubmitTime(); // msec, included in the simulation time
+		summary["recording"] = recording;
+	}
+
+	QJsonArray stats;
+	std::istringstream lines(m_solver->getStats());
+	for (std::string line; std::getline(lines, line);)
+		stats.append(QString::fromStdString(line));
+	summary["solverStats"] = stats;
+
+	QJsonArray meshes;
+	for (const auto& mesh : m_result.meshes)
+	{
+		QJsonObject m;
+		m["name"] = QString::fromStdString(mesh.name);
+		m["dynamics"] = mesh.dynamics;
+		m["torque"] = vectorToJson(mesh.torque);
+		m["meanTorque"] = vectorToJson(mesh.meanTorque);
+		m["angularVelocity"] = vectorToJson(mesh.angularVelocity);
+		meshes.append(m);
+	}
+	summary["meshes"] = meshes;
+
+	// Mean and deviation of all steps, the range, mean and dominant frequency of the last window of steps
+	QJsonObject statistics;
+	for (const auto& signal : m_result.signalStatistics)
+	{
+		const RunningStatistics::Result& r = signal.result;
+		QJsonObject s;
+		s["samples"] = static_cast<double>(r.count);
+		s["mean"] = r.mean;
+		s["deviation"] = r.deviation;
+		s["window"] = r.windowCount;
+		s["windowMin"] = r.windowMin;
+		s["windowMax"] = r.windowMax;
+		s["windowMean"] = r.windowMean;
+		s["frequency"] = r.frequency; // 1/s, 0 until the window is full
+		s["amplitude"] = r.amplitude;
+		statistics[QString::fromStdString(signal.name)] = s;
+	}
+	summary["signals"] = statistics;
+
+	QFile f(outputPath("summary.json"));
+	if (!f.open(QIODevice::WriteOnly))
+		throw std::runtime_error("Failed to open '" + outputPath("summary.json").toStdString() + "' for writing.");
+	f.write(QJsonDocument(summary).toJson());
+	f.close();
+
+	std::ostringstream msg;
+	msg << "INFO: " << m_result.steps << " steps (" << m_result.simulatedTime << "s simulated) in " << m_result.totalTime << "msec: "
+		<< m_result.stepsPerSecond << " steps/s, " << m_result.mlups << " MLUPS";
+	log(msg.str());
+}
+
+QString HeadlessRunner::outputPath(const QString& name) const
+{
+	return QDir(m_options.outputDir).filePath(name);
+}
+
+void HeadlessRunner::log(const std::string& msg) const
+{
+	if (m_options.name.isEmpty())
+		writeLog(msg);
+	else
+		writeLog("[" + m_options.name.toStdString() + "] " + msg);
+}
+
+void HeadlessRunner::writeLog(const std::string& msg)
+{
+	std::lock_guard<std::mutex> guard(s_logMutex);
+	std::cout << msg << std::endl;
+}
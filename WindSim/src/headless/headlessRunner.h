@@ -0,0 +1,266 @@
+#ifndef HEADLESS_RUNNER_H
+#define HEADLESS_RUNNER_H
+
+#include "../3D/distanceField.h"
+#include "../3D/cellClassifier.h"
+#include "../3D/cpuDynamics.h"
+#include "../3D/solverBackend.h"
+#include "../3D/flowMetrics.h"
+#include "../3D/fieldProbes.h"
+#include "../3D/fieldSlices.h"
+#include "../3D/isosurface.h"
+#include "../3D/streamTracer.h"
+#include "common.h"
+#include "fieldRecording.h"
+#include "fieldPublishing.h"
+#include "signalStatistics.h"
+
+#include <DirectXMath.h>
+
+#include <QString>
+#include <QStringList>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <mutex>
+#include <cstdint>
+
+// Runs the simulation of a saved project without a window or graphics device
+// The project file is read as written by Project::saveAs; meshes are voxelized with their signed distance fields, the flow is
+// computed by one of the CPU solver backends and the mesh dynamics are integrated on the CPU (see CpuDynamics)
+//
+// Output (in Options::outputDir):
+// - fields.wsb: cell types, velocity, pressure and density after the last step (plus fields_<step>.wsb every fieldsInterval steps),
+//   with Options::writeMetrics also the derived flow metrics of the volume renderer (see FlowMetrics)
+// - torques.csv: torque and angular velocity of every voxelized mesh after each step
+// - summary.json: grid, solver and timing summary of the run, with the running statistics of the torque, angular velocity and angular acceleration
+//   of the meshes and of the mean speed and pressure at the probes (see SignalStatistics)
+// - Options::recordFile: the fields of every step (see FieldRecorder and the [Recording] section of the settings)
+// - Options::publishName: the fields of every step in shared memory for other processes (see FieldPublisher)
+// - probes.csv: with Options::probesFile the velocity and pressure at the probes of every step (see FieldProbes and loadProbes)
+// - slices/: with Options::slicesFile planes of the fields every step as images, raw floats or CSV (see FieldSlices and loadSlices)
+// - isosurface_<metric>.ply: the Options::isosurfaces of the flow metrics after the last step, in grid object space (see Isosurface)
+// - snapshots/: with Options::snapshotsFile volume renderings of the flow metrics after the last step as PNG (see VolumeRaycaster and loadSnapshots)
+// - streamlines_<name>.csv: with Options::streamlinesFile the streamlines of each seed set after the last step, in grid object space (see StreamTracer
+//   and loadStreamlines)
+//
+// The global settings are only read, so several runners may work concurrently (see SweepScheduler)
+class HeadlessRunner
+{
+public:
+	struct Options
+	{
+		Options();
+		QString projectFile; // Relative paths within the project are resolved against its directory
+		QString outputDir;
+		QString solver; // "CpuLbm" or "CpuProjection"; empty uses the solver of the ini file
+		QString name; // Prefix of the log messages, empty for none
+		int steps;
+		int fieldsInterval; // Write the fields every n steps; 0 only after the last step
+		bool writeFields; // Write fields.wsb after the last step
+		bool writeMetrics; // Add the flow metrics to the written fields
+		int threads; // Thread budget of the run, overrides Settings::Cpu::threads if not negative
+		QString recordFile; // Record the simulation, empty for none
+		QString publishName; // Publish the steps under this name, empty for none; slots and interval of the [Publishing] section
+		QString probesFile; // Json array of probes in world space, empty for none (see loadProbes)
+		QString slicesFile; // Json array of axis-aligned slices, empty for none (see loadSlices)
+		QStringList isosurfaces; // "<metric>=<iso value>" with the channel names of FlowMetrics, e.g. "qCriterion=0.01"
+		QString snapshotsFile; // Json array of volume snapshots, empty for none (see loadSnapshots)
+		QString streamlinesFile; // Json array of streamline seed sets in world space, empty for none (see loadStreamlines)
+	};
+
+	struct MeshResult
+	{
+		MeshResult();
+		std::string name;
+		bool dynamics;
+		DirectX::XMFLOAT3 torque; // Of the last step
+		DirectX::XMFLOAT3 meanTorque; // Over the second half of the steps
+		DirectX::XMFLOAT3 angularVelocity; // World space, after the last step
+	};
+
+	// Outcome of a finished run, as written to summary.json
+	struct Result
+	{
+		Result();
+		int steps;
+		int threads;
+		double simulatedTime;
+		double totalTime; // msec
+		double stepsPerSecond;
+		double mlups;
+		std::vector<MeshResult> meshes; // Voxelized meshes only
+		std::vector<SignalStatistics::Signal> signalStatistics; // "<mesh>/torque", "<mesh>/angVel", "<mesh>/angAcc", "<probe>/speed", "<probe>/pressure"
+	};
+
+	// <project> is the object array of a project file (see readProject)
+	HeadlessRunner(const Options& options, const QJsonArray& project);
+
+	// Throws std::runtime_error if the project can not be loaded or the output not be written
+	void run();
+
+	const Result& getResult() const { return m_result; };
+
+	// Throws std::runtime_error if the file can not be read or is no project
+	static QJsonArray readProject(const QString& file);
+
+	// Writes a line to std::cout; lines of concurrent runners are not interleaved
+	static void writeLog(const std::string& msg);
+
+private:
+	struct Mesh
+	{
+		Mesh();
+		std::string name;
+		std::vector<float> vertexData;
+		std::vector<uint32_t> indexData;
+		DistanceField distanceField;
+
+		DirectX::XMFLOAT3 position;
+		DirectX::XMFLOAT3 scale;
+		DirectX::XMFLOAT4 rotation;
+		DirectX::XMFLOAT4X4 world; // Including the dynamic rotation
+		DirectX::XMFLOAT4X4 voxelizedWorld; // Of the last voxelization, for the solid fractions of the written fields
+
+		bool voxelize;
+		bool dynamics;
+		CpuDynamics motion;
+
+		DirectX::XMFLOAT3 torque; // Of the last step
+		DirectX::XMFLOAT3 torqueSum; // Over the second half of the steps
+		int torqueSamples;
+	};
+
+	// Volume rendering of a flow metric with the transfer function of the project
+	struct Snapshot
+	{
+		Snapshot();
+		std::string name;
+		FlowMetrics::Type metric;
+		int width;
+		int height;
+		DirectX::XMFLOAT3 position; // Camera in world space
+		DirectX::XMFLOAT3 target;
+		DirectX::XMFLOAT3 up;
+		float fov; // Vertical, radians
+		float nearZ;
+		float farZ;
+		float stepSize;
+		bool autoRange;
+		DirectX::XMFLOAT2 range; // Overrides the range of the transfer function if not empty (x >= y)
+		DirectX::XMFLOAT4 background; // RGBA in [0, 1]
+	};
+
+	// Seeds of streamlines, which are traced with the same options
+	struct StreamlineSet
+	{
+		std::string name;
+		std::vector<DirectX::XMFLOAT3> seeds; // World space
+		StreamTracer::Options options;
+	};
+
+	// Accumulated wall clock times in msec
+	struct Timings
+	{
+		Timings();
+		double load;
+		double voxelization;
+		double classification;
+		double simulation;
+		double dynamics;
+		double output;
+	};
+
+	void loadProject();
+	void addMesh(const QJsonObject& data);
+	void setGrid(const QJsonObject& data);
+	void createSolver(const QString& settingsFile);
+
+	void voxelize();
+	void computeSolidFractions(); // Of the meshes at their last voxelization, as VoxelGrid hands them to the simulation
+	void calculateDynamics(float timeStep, bool accumulate);
+	void writeTorques(int step, double time);
+	void writeFields(const QString& file);
+	void startRecording();
+	void stopRecording();
+	void startPublishing();
+	void stopPublishing();
+	// Probes as objects { "type": "point", "name", "position" }, { "type": "line", "name", "from", "to", "points" } or
+	// { "type": "plane", "name", "origin", "u", "v", "pointsU", "pointsV" }; vectors as { "x", "y", "z" } like the positions of the project
+	void loadProbes();
+	void stopProbes();
+	// Slices as objects { "name", "orientation": "XY"|"XZ"|"YZ", "position": [0, 1], "field": "velocity"|"pressure"|"density"|<metric>,
+	// "format": "png"|"raw"|"csv", "interval", "min", "max" } with the channel names of FlowMetrics as metrics; min and max are optional
+	void loadSlices();
+	void stopSlices();
+	// Vortices are above the iso value, except for lambda2, whose surfaces are extracted from -lambda2 (at -value), so that the normals
+	// point out of the vortices for all criteria
+	void parseIsosurfaces();
+	void writeIsosurfaces();
+	// Snapshots as objects { "name", "metric", "width", "height", "camera": { "position", "target", "up", "fov", "near", "far" }, "stepSize", "autoRange",
+	// "min", "max", "background": [r, g, b, a] } with the channel names of FlowMetrics as metrics and vectors as { "x", "y", "z" }. The fov is in
+	// degrees; the metric, step size and auto range default to the volume settings of the voxel grid, the target to the center of the grid and
+	// fov, near and far to the camera of the GUI
+	void loadSnapshots();
+	void writeSnapshots();
+	// Seed sets as objects { "type": "point", "name", "position" }, { "type": "line", "name", "from", "to", "points" } or { "type": "plane", "name",
+	// "origin", "u", "v", "pointsU", "pointsV" } like the probes, with the optional tracing options "integrator": "rk4"|"rk45", "direction":
+	// "forward"|"backward"|"both", "stepSize", "maxVertices" (defaults of StreamTracer::Options)
+	void loadStreamlines();
+	// One row per vertex: line, vertex, position in grid object space, speed and why the line ended
+	void writeStreamlines();
+	void collectResult(int steps, double simulatedTime, double totalTime);
+	void writeSummary();
+
+	QString outputPath(const QString& name) const;
+	void log(const std::string& msg) const;
+
+	Options m_options;
+	QJsonArray m_project;
+	int m_threads;
+
+	std::vector<std::unique_ptr<Mesh>> m_meshes;
+
+	bool m_hasGrid;
+	DirectX::XMUINT3 m_resolution;
+	DirectX::XMFLOAT3 m_voxelSize;
+	DirectX::XMFLOAT4X4 m_gridWorld;
+	VoxelizationMode m_voxelizationMode;
+	QString m_importFile;
+	bool m_computeFractions; // Write the solid volume fractions of the boundary voxels with the fields
+	bool m_classifyCells;
+	bool m_removeCavities;
+	CellClassifier::Faces m_boundaryFaces;
+	QJsonObject m_volumeSettings; // Of the voxel grid, as for VolumeRenderer::changeSettings
+
+	std::unique_ptr<SolverBackend> m_solver;
+	std::vector<wtl::CellType> m_voxelized; // Before classification
+	std::vector<wtl::CellType> m_cellTypes;
+	std::vector<float> m_solidFractions; // See SolidFraction::compute
+	std::vector<float> m_velocity;
+	std::vector<float> m_pressure;
+	std::vector<float> m_density;
+	std::vector<float> m_densitySum;
+	FlowMetrics m_metrics;
+
+	std::ofstream m_torqueFile;
+	FieldRecorder m_recorder;
+	FieldPublisher m_publisher;
+	SignalStatistics m_signals; // Before the probes, which keep a pointer
+	FieldProbes m_probes;
+	FieldSlices m_slices;
+	std::vector<std::pair<FlowMetrics::Type, float>> m_isosurfaces;
+	std::vector<Snapshot> m_snapshots;
+	std::vector<StreamlineSet> m_streamlines;
+	Timings m_timings;
+	Result m_result;
+
+	static std::mutex s_logMutex;
+	static std::mutex s_massPropsMutex; // VolInt keeps its state in globals
+};
+
+#endif
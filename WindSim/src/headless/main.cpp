@@ -0,0 +1,143 @@
+#include "headlessRunner.h"
+#include "sweepScheduler.h"
+#include "settings.h"
+#include "fieldPublishingTools.h"
+#include "fieldLayoutBenchmark.h"
+#include "classifierBenchmark.h"
+#include "metricsBenchmark.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFileInfo>
+#include <QDir>
+
+#include <iostream>
+#include <stdexcept>
+
+// Command line front end of HeadlessRunner, e.g.
+// WindSimHeadless project.json --steps 2000 --output results --solver CpuProjection --threads 8
+// WindSimHeadless project.json --sweep pitch.json --output pitch --threads 16
+// WindSimHeadless project.json --steps 500 --record run.wsr
+// WindSimHeadless project.json --steps 5000 --publish windsim-fields, read by WindSimHeadless --subscribe windsim-fields --steps 100
+int main(int argc, char *argv[])
+{
+	QCoreApplication a(argc, argv);
+	QCoreApplication::setApplicationName("WindSimHeadless");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Runs the simulation of a WindSim project without a window.");
+	parser.addHelpOption();
+	parser.addPositionalArgument("project", "Project file (as saved by WindSim).");
+	QCommandLineOption stepsOption("steps", "Number of simulation steps.", "n", "1000");
+	QCommandLineOption outputOption(QStringList() << "o" << "output", "Output directory.", "dir", ".");
+	QCommandLineOption solverOption("solver", "CpuLbm or CpuProjection (default: the solver of the ini file).", "name");
+	QCommandLineOption threadsOption("threads", "Worker threads, 0 uses all hardware threads (default: the ini file).", "n");
+	QCommandLineOption fieldsOption("fields-interval", "Additionally write the fields every n steps.", "n", "0");
+	QCommandLineOption metricsOption("metrics", "Add vorticity, divergence, Q, delta and lambda2 to the written fields.");
+	QCommandLineOption iniOption("ini", "Settings file (default: settings.ini next to the executable).", "file");
+	QCommandLineOption sweepOption("sweep", "Run the project for every configuration of a parameter sweep (see SweepScheduler); --threads is the budget of all runs.", "file");
+	QCommandLineOption recordOption("record", "Record the fields of every step to a compressed file (see the [Recording] section of the ini file).", "file");
+	QCommandLineOption publishOption("publish", "Publish the fields of every step in shared memory (see the [Publishing] section of the ini file).", "name");
+	QCommandLineOption probesOption("probes", "Sample velocity and pressure at the probes of a Json file after every step (probes.csv).", "file");
+	QCommandLineOption slicesOption("slices", "Write axis-aligned planes of the fields of a Json file after every step (slices/).", "file");
+	QCommandLineOption isosurfaceOption("isosurface", "Write the isosurface of a flow metric after the last step as isosurface_<metric>.ply, e.g. qCriterion=0.01 (repeatable).", "metric=value");
+	QCommandLineOption snapshotsOption("snapshots", "Render volume snapshots of the flow metrics of a Json file after the last step (snapshots/).", "file");
+	QCommandLineOption streamlinesOption("streamlines", "Trace streamlines from the seeds of a Json file after the last step (streamlines_<name>.csv).", "file");
+	QCommandLineOption subscribeOption("subscribe", "Print a summary of the next --steps steps, which another process publishes; no project is run.", "name");
+	QCommandLineOption benchmarkPublishingOption("benchmark-publishing", "Measure the publishing of fields in shared memory; no project is run.");
+	QCommandLineOption benchmarkLayoutOption("benchmark-layout", "Compare the linear and the bricked field layout at 256^3 and 512^3 with --threads threads; no project is run.");
+	QCommandLineOption benchmarkClassifierOption("benchmark-classifier", "Verify the cell classification against its reference for all face configurations and time it at 256^3 and 512^3 with 1 and --threads threads; no project is run.");
+	QCommandLineOption benchmarkMetricsOption("benchmark-metrics", "Verify the flow metrics against their reference and time them at 128^3 and 256^3 with 1 and --threads threads; no project is run.");
+	parser.addOption(stepsOption);
+	parser.addOption(outputOption);
+	parser.addOption(solverOption);
+	parser.addOption(threadsOption);
+	parser.addOption(fieldsOption);
+	parser.addOption(metricsOption);
+	parser.addOption(iniOption);
+	parser.addOption(sweepOption);
+	parser.addOption(recordOption);
+	parser.addOption(publishOption);
+	parser.addOption(probesOption);
+	parser.addOption(slicesOption);
+	parser.addOption(isosurfaceOption);
+	parser.addOption(snapshotsOption);
+	parser.addOption(streamlinesOption);
+	parser.addOption(subscribeOption);
+	parser.addOption(benchmarkPublishingOption);
+	parser.addOption(benchmarkLayoutOption);
+	parser.addOption(benchmarkClassifierOption);
+	parser.addOption(benchmarkMetricsOption);
+	parser.process(a);
+
+	if (parser.isSet(benchmarkPublishingOption))
+		return runPublishingBenchmark(std::cout);
+	if (parser.isSet(benchmarkLayoutOption))
+		return runLayoutBenchmark(std::cout, parser.isSet(threadsOption) ? parser.value(threadsOption).toInt() : 0);
+	if (parser.isSet(benchmarkClassifierOption))
+		return runClassifierBenchmark(std::cout, parser.isSet(threadsOption) ? parser.value(threadsOption).toInt() : 0);
+	if (parser.isSet(benchmarkMetricsOption))
+		return runMetricsBenchmark(std::cout, parser.isSet(threadsOption) ? parser.value(threadsOption).toInt() : 0);
+
+	if (parser.positionalArguments().size() != 1 && !parser.isSet(subscribeOption))
+		parser.showHelp(1);
+
+	QString iniFile = parser.isSet(iniOption) ? parser.value(iniOption) : QDir(QCoreApplication::applicationDirPath()).filePath("settings.ini");
+	if (QFileInfo(iniFile).exists())
+		loadIni(iniFile.toStdString());
+	else
+		std::cout << "WARNING: Could not open ini-file '" << iniFile.toStdString() << "', using default settings." << std::endl;
+
+	if (parser.value(stepsOption).toInt() <= 0)
+	{
+		std::cerr << "ERROR: The number of steps has to be positive." << std::endl;
+		return 1;
+	}
+
+	if (parser.isSet(subscribeOption))
+		return runFieldSubscriber(parser.value(subscribeOption).toStdString(), parser.value(stepsOption).toInt(), std::cout);
+
+	try
+	{
+		if (parser.isSet(sweepOption))
+		{
+			SweepScheduler::Options options;
+			options.sweepFile = parser.value(sweepOption);
+			options.projectFile = parser.positionalArguments().first();
+			options.outputDir = parser.value(outputOption);
+			options.solver = parser.value(solverOption);
+			options.steps = parser.value(stepsOption).toInt();
+			options.threads = parser.isSet(threadsOption) ? parser.value(threadsOption).toInt() : conf.cpu.threads;
+
+			SweepScheduler sweep(options);
+			return sweep.run() > 0 ? 2 : 0;
+		}
+
+		HeadlessRunner::Options options;
+		options.projectFile = parser.positionalArguments().first();
+		options.outputDir = parser.value(outputOption);
+		options.solver = parser.value(solverOption);
+		options.steps = parser.value(stepsOption).toInt();
+		options.fieldsInterval = parser.value(fieldsOption).toInt();
+		options.writeMetrics = parser.isSet(metricsOption);
+		if (parser.isSet(threadsOption))
+			options.threads = parser.value(threadsOption).toInt();
+		options.recordFile = parser.value(recordOption);
+		options.publishName = parser.value(publishOption);
+		options.probesFile = parser.value(probesOption);
+		options.slicesFile = parser.value(slicesOption);
+		options.isosurfaces = parser.values(isosurfaceOption);
+		options.snapshotsFile = parser.value(snapshotsOption);
+		options.streamlinesFile = parser.value(streamlinesOption);
+
+		HeadlessRunner runner(options, HeadlessRunner::readProject(options.projectFile));
+		runner.run();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
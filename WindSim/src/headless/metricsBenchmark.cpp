@@ -0,0 +1,152 @@
+#include "metricsBenchmark.h"
+#include "../3D/flowMetrics.h"
+#include "parallel.h"
+
+#include <chrono>
+#include <vector>
+#include <random>
+#include <new>
+#include <cmath>
+#include <iomanip>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const unsigned int g_benchmarkSizes[] = { 128, 256 };
+	const int g_benchmarkRepeats = 3; // The fastest run counts
+	const XMUINT3 g_grids[] = { XMUINT3(1, 1, 1), XMUINT3(3, 5, 2), XMUINT3(6, 9, 7), XMUINT3(7, 7, 7), XMUINT3(9, 13, 11), XMUINT3(17, 8, 33),
+		XMUINT3(64, 7, 9), XMUINT3(65, 31, 20), XMUINT3(130, 18, 10) }; // Up to 6 cells along an axis there are no edge cells
+	const float g_tolerance = 1.0e-3f; // Relative to the largest magnitude of the reference, as the lambda2 of both differ in rounding
+
+	// Vortices along all axes with a source, so every metric varies; <noise> adds random velocities of up to that magnitude
+	void velocityField(std::vector<float>& velocity, const XMUINT3& res, float noise, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+		velocity.resize(4 * static_cast<size_t>(res.x) * res.y * res.z);
+		const float k = 6.2831853f / 24.0f;
+		size_t i = 0;
+		for (unsigned int z = 0; z < res.z; ++z)
+		{
+			for (unsigned int y = 0; y < res.y; ++y)
+			{
+				for (unsigned int x = 0; x < res.x; ++x, i += 4)
+				{
+					velocity[i + 0] = 10.0f + std::sin(k * y) * std::cos(k * z) + 0.05f * x + noise * uniform(random);
+					velocity[i + 1] = std::sin(k * z) * std::cos(k * x) + noise * uniform(random);
+					velocity[i + 2] = std::sin(k * x) * std::cos(k * y) - 0.03f * z + noise * uniform(random);
+					velocity[i + 3] = 0.0f;
+				}
+			}
+		}
+	}
+
+	// Index of the first cell, which differs from the reference by more than the tolerance, or -1
+	long long mismatch(const std::vector<float>& values, const std::vector<float>& reference)
+	{
+		float scale = 0.0f;
+		for (float value : reference)
+			scale = std::max(scale, std::abs(value));
+		for (size_t i = 0; i < reference.size(); ++i)
+		{
+			if (!(std::abs(values[i] - reference[i]) <= g_tolerance * scale + 1.0e-6f))
+				return static_cast<long long>(i);
+		}
+		return -1;
+	}
+
+	template <typename Function>
+	double fastest(Function func)
+	{
+		double best = 0.0;
+		for (int i = 0; i < g_benchmarkRepeats; ++i)
+		{
+			auto start = std::chrono::steady_clock::now();
+			func();
+			double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			best = i == 0 ? time : std::min(best, time);
+		}
+		return best;
+	}
+
+	void report(std::ostream& out, const char* kernel, double time, size_t numCells, unsigned int threads)
+	{
+		out << "  " << std::left << std::setw(22) << kernel << std::right << std::setw(10) << time << " ms " << std::setw(3) << threads << (threads == 1 ? " thread " : " threads")
+			<< std::setw(10) << numCells / (time * 1.0e3) << " Mcells/s" << std::endl;
+	}
+}
+
+int runMetricsBenchmark(std::ostream& out, int threads)
+{
+	out << std::fixed << std::setprecision(2);
+
+	std::mt19937 random(1);
+	std::vector<float> velocity, reference;
+	FlowMetrics metrics(threads);
+
+	const float noises[] = { 0.0f, 1.0f };
+	int numFields = 0;
+	for (const XMUINT3& res : g_grids)
+	{
+		const size_t numCells = static_cast<size_t>(res.x) * res.y * res.z;
+		reference.resize(numCells);
+		for (float noise : noises)
+		{
+			velocityField(velocity, res, noise, random);
+			metrics.compute(velocity.data(), res);
+			++numFields;
+			for (int t = 0; t < FlowMetrics::NUM_TYPES; ++t)
+			{
+				const FlowMetrics::Type type = FlowMetrics::Type(t);
+				FlowMetrics::computeReference(velocity.data(), res, type, reference.data());
+				const long long cell = mismatch(metrics.get(type), reference);
+				if (cell >= 0)
+				{
+					out << "ERROR: compute() differs from the reference for " << FlowMetrics::name(type) << " at " << res.x << "x" << res.y << "x" << res.z
+						<< (noise > 0.0f ? " (random)" : " (smooth)") << " in cell " << cell << ": " << metrics.get(type)[cell] << " instead of " << reference[cell] << std::endl;
+					return 1;
+				}
+			}
+		}
+	}
+	out << "compute() matches the reference for all metrics on " << numFields << " smooth and random fields of "
+		<< sizeof(g_grids) / sizeof(g_grids[0]) << " grids" << std::endl;
+
+	const unsigned int numThreads = Parallel::numThreads(threads);
+	FlowMetrics single(1);
+	out << "All metrics in one pass with 1 and " << numThreads << " threads, best of " << g_benchmarkRepeats << " runs" << std::endl;
+
+	for (unsigned int size : g_benchmarkSizes)
+	{
+		const XMUINT3 res(size, size, size);
+		const size_t numCells = static_cast<size_t>(size) * size * size;
+		try
+		{
+			velocityField(velocity, res, 0.1f, random);
+			reference.resize(numCells);
+		}
+		catch (const std::bad_alloc&)
+		{
+			out << size << "^3: not enough memory" << std::endl;
+			continue;
+		}
+
+		out << size << "^3:" << std::endl;
+		report(out, "compute", fastest([&]() { single.compute(velocity.data(), res); }), numCells, 1);
+		report(out, "compute", fastest([&]() { metrics.compute(velocity.data(), res); }), numCells, numThreads);
+
+		auto start = std::chrono::steady_clock::now();
+		for (int t = 0; t < FlowMetrics::NUM_TYPES; ++t)
+		{
+			FlowMetrics::computeReference(velocity.data(), res, FlowMetrics::Type(t), reference.data());
+			if (mismatch(metrics.get(FlowMetrics::Type(t)), reference) >= 0)
+			{
+				out << "ERROR: compute() differs from the reference for " << FlowMetrics::name(FlowMetrics::Type(t)) << " at " << size << "^3" << std::endl;
+				return 1;
+			}
+		}
+		report(out, "reference", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), numCells, 1);
+	}
+	return 0;
+}
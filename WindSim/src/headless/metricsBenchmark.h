@@ -0,0 +1,12 @@
+#ifndef METRICS_BENCHMARK_H
+#define METRICS_BENCHMARK_H
+
+#include <ostream>
+
+// Verifies and times FlowMetrics (WindSimHeadless --benchmark-metrics): compute() is compared with computeReference() for every metric
+// on smooth and on random velocity fields of grids from one cell up to sizes, which are no multiples of the SSE width and the blocks of
+// work, with and without edge cells. Then compute() is timed for all metrics at 128^3 and 256^3 with one and with <threads> threads (0 for
+// all) next to the reference; returns 1 if the results differ
+int runMetricsBenchmark(std::ostream& out, int threads);
+
+#endif
@@ -0,0 +1,395 @@
+#include "sweepScheduler.h"
+#include "parallel.h"
+
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QElapsedTimer>
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	QJsonObject vectorToJson(const XMFLOAT3& v)
+	{
+		QJsonObject json;
+		json["x"] = v.x;
+		json["y"] = v.y;
+		json["z"] = v.z;
+		return json;
+	}
+
+	// Objects are values in Qt, so every level of the path is copied, modified and written back
+	QJsonObject setValue(QJsonObject object, const QStringList& path, int depth, const QJsonValue& value)
+	{
+		if (depth == path.size() - 1)
+			object[path[depth]] = value;
+		else
+			object[path[depth]] = setValue(object[path[depth]].toObject(), path, depth + 1, value);
+		return object;
+	}
+
+	std::string valueToString(const QJsonValue& value)
+	{
+		if (value.isDouble())
+			return QString::number(value.toDouble()).toStdString();
+		if (value.isBool())
+			return value.toBool() ? "true" : "false";
+		if (value.isString())
+			return value.toString().toStdString();
+		if (value.isObject())
+			return QJsonDocument(value.toObject()).toJson(QJsonDocument::Compact).toStdString();
+		if (value.isArray())
+			return QJsonDocument(value.toArray()).toJson(QJsonDocument::Compact).toStdString();
+		return "";
+	}
+
+	std::string csvField(const std::string& field)
+	{
+		if (field.find_first_of(",\"\n") == std::string::npos)
+			return field;
+
+		std::string quoted = "\"";
+		for (char c : field)
+		{
+			if (c == '"')
+				quoted += '"';
+			quoted += c;
+		}
+		return quoted + "\"";
+	}
+}
+
+SweepScheduler::Options::Options()
+	: sweepFile(),
+	projectFile(),
+	outputDir("."),
+	solver(),
+	steps(1000),
+	threads(0)
+{
+}
+
+SweepScheduler::Run::Run()
+	: valueIndices(),
+	name(),
+	success(false),
+	error(),
+	result()
+{
+}
+
+SweepScheduler::SweepScheduler(const Options& options)
+	: m_options(options),
+	m_project(),
+	m_parameters(),
+	m_runs(),
+	m_steps(options.steps),
+	m_solver(options.solver),
+	m_writeFields(false),
+	m_workers(0),
+	m_threadsPerRun(0)
+{
+}
+
+int SweepScheduler::run()
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	m_project = HeadlessRunner::readProject(m_options.projectFile);
+	readSweep();
+	createRuns();
+	distributeThreads();
+
+	if (!QDir().mkpath(m_options.outputDir))
+		throw std::runtime_error("Failed to create the output directory '" + m_options.outputDir.toStdString() + "'.");
+
+	HeadlessRunner::writeLog("INFO: Sweeping " + std::to_string(m_runs.size()) + " configurations with " + std::to_string(m_workers) + " workers and "
+		+ std::to_string(m_threadsPerRun) + " threads per run.");
+
+	// Every run is a chunk of its own, so the workers pick up the next configuration as soon as they are done
+	Parallel::forRange(0, static_cast<int>(m_runs.size()), [&](int first, int last)
+	{
+		for (int i = first; i < last; ++i)
+			execute(m_runs[i]);
+	}, m_workers, 1);
+
+	writeCsv();
+	writeJson(timer.nsecsElapsed() * 1e-6);
+
+	int failed = static_cast<int>(std::count_if(m_runs.begin(), m_runs.end(), [](const Run& r) { return !r.success; }));
+	HeadlessRunner::writeLog("INFO: Sweep finished in " + std::to_string(timer.nsecsElapsed() * 1e-6) + "msec, " + std::to_string(failed) + " of "
+		+ std::to_string(m_runs.size()) + " runs failed.");
+	return failed;
+}
+
+void SweepScheduler::readSweep()
+{
+	QFile f(m_options.sweepFile);
+	if (!f.open(QIODevice::ReadOnly))
+		throw std::runtime_error("Failed to open the sweep file '" + m_options.sweepFile.toStdString() + "'.");
+
+	QJsonParseError error;
+	QJsonDocument doc = QJsonDocument::fromJson(f.readAll(), &error);
+	f.close();
+
+	if (!doc.isObject())
+		throw std::runtime_error("Failed to parse the sweep file '" + m_options.sweepFile.toStdString() + "': " + error.errorString().toStdString());
+
+	QJsonObject sweep = doc.object();
+	m_steps = sweep["steps"].toInt(m_steps);
+	m_solver = sweep["solver"].toString(m_solver);
+	m_writeFields = sweep["writeFields"].toBool(false);
+	m_workers = sweep["workers"].toInt(0);
+	m_threadsPerRun = sweep["threadsPerRun"].toInt(0);
+
+	if (m_steps <= 0)
+		throw std::invalid_argument("The number of steps has to be positive.");
+
+	for (auto p : sweep["parameters"].toArray())
+	{
+		QJsonObject jParam = p.toObject();
+		Parameter param;
+		param.object = jParam["object"].toString();
+		param.path = jParam["key"].toString().split('.', QString::SkipEmptyParts);
+		for (auto v : jParam["values"].toArray())
+			param.values.push_back(v);
+
+		if (param.path.isEmpty() || param.values.empty())
+			throw std::invalid_argument("Every sweep parameter needs a key and at least one value.");
+
+		bool found = false;
+		for (auto o : m_project)
+			found |= o.toObject()["name"].toString() == param.object;
+		if (!found)
+			throw std::invalid_argument("The project contains no object '" + param.object.toStdString() + "' to sweep '" + jParam["key"].toString().toStdString() + "'.");
+
+		m_parameters.push_back(param);
+	}
+
+	if (m_parameters.empty())
+		throw std::invalid_argument("The sweep file '" + m_options.sweepFile.toStdString() + "' defines no parameters.");
+}
+
+void SweepScheduler::createRuns()
+{
+	// Cartesian product of all parameter values, the last parameter varies fastest
+	size_t numRuns = 1;
+	for (const auto& param : m_parameters)
+		numRuns *= param.values.size();
+
+	m_runs.resize(numRuns);
+	for (size_t i = 0; i < numRuns; ++i)
+	{
+		Run& run = m_runs[i];
+		run.name = QString("run_%1").arg(static_cast<int>(i), 3, 10, QChar('0'));
+		run.valueIndices.resize(m_parameters.size());
+
+		size_t index = i;
+		for (size_t p = m_parameters.size(); p-- > 0;)
+		{
+			run.valueIndices[p] = static_cast<int>(index % m_parameters[p].values.size());
+			index /= m_parameters[p].values.size();
+		}
+	}
+}
+
+void SweepScheduler::distributeThreads()
+{
+	// Each worker runs one configuration at a time with its own thread budget, so workers * threadsPerRun threads are busy
+	int total = static_cast<int>(Parallel::numThreads(m_options.threads));
+	int numRuns = static_cast<int>(m_runs.size());
+
+	if (m_workers <= 0 && m_threadsPerRun <= 0)
+	{
+		m_workers = std::min(numRuns, total);
+		m_threadsPerRun = std::max(total / m_workers, 1);
+	}
+	else if (m_workers <= 0)
+	{
+		m_workers = std::max(total / m_threadsPerRun, 1);
+	}
+	else if (m_threadsPerRun <= 0)
+	{
+		m_threadsPerRun = std::max(total / m_workers, 1);
+	}
+	m_workers = std::min(m_workers, numRuns);
+
+	if (m_workers * m_threadsPerRun > total)
+		HeadlessRunner::writeLog("WARNING: " + std::to_string(m_workers) + " workers with " + std::to_string(m_threadsPerRun) + " threads each oversubscribe the "
+			+ std::to_string(total) + " available threads.");
+}
+
+QJsonArray SweepScheduler::createProject(const Run& run) const
+{
+	QJsonArray project = m_project;
+	for (size_t p = 0; p < m_parameters.size(); ++p)
+	{
+		const Parameter& param = m_parameters[p];
+		for (int i = 0; i < project.size(); ++i)
+		{
+			QJsonObject obj = project[i].toObject();
+			if (obj["name"].toString() == param.object)
+				project[i] = setValue(obj, param.path, 0, param.values[run.valueIndices[p]]);
+		}
+	}
+	return project;
+}
+
+void SweepScheduler::execute(Run& run) const
+{
+	HeadlessRunner::Options options;
+	options.projectFile = m_options.projectFile;
+	options.outputDir = outputPath(run.name);
+	options.solver = m_solver;
+	options.name = run.name;
+	options.steps = m_steps;
+	options.writeFields = m_writeFields;
+	options.threads = m_threadsPerRun;
+
+	// A failed configuration must not stop the others
+	try
+	{
+		HeadlessRunner runner(options, createProject(run));
+		runner.run();
+		run.result = runner.getResult();
+		run.success = true;
+	}
+	catch (const std::exception& e)
+	{
+		run.error = e.what();
+		HeadlessRunner::writeLog("WARNING: [" + run.name.toStdString() + "] " + run.error);
+	}
+}
+
+void SweepScheduler::writeCsv() const
+{
+	std::ofstream f(outputPath("sweep.csv").toStdString(), std::ios::out | std::ios::trunc);
+	if (!f.is_open())
+		throw std::runtime_error("Failed to open '" + outputPath("sweep.csv").toStdString() + "' for writing.");
+
+	std::vector<std::string> meshes = meshNames();
+
+	f << "run";
+	for (const auto& param : m_parameters)
+		f << "," << csvField(param.name().toStdString());
+	f << ",status,steps,simulatedTime,totalTime,stepsPerSecond,mlups";
+	for (const auto& mesh : meshes)
+	{
+		for (const char* column : { "meanTorqueX", "meanTorqueY", "meanTorqueZ", "angVelX", "angVelY", "angVelZ" })
+			f << "," << csvField(mesh + "." + column);
+	}
+	f << "\n";
+
+	for (const auto& run : m_runs)
+	{
+		f << run.name.toStdString();
+		for (size_t p = 0; p < m_parameters.size(); ++p)
+			f << "," << csvField(valueToString(m_parameters[p].values[run.valueIndices[p]]));
+
+		if (!run.success)
+		{
+			f << "," << csvField("failed: " + run.error) << "\n";
+			continue;
+		}
+
+		const HeadlessRunner::Result& r = run.result;
+		f << ",ok," << r.steps << "," << r.simulatedTime << "," << r.totalTime << "," << r.stepsPerSecond << "," << r.mlups;
+		for (const auto& name : meshes)
+		{
+			auto mesh = std::find_if(r.meshes.begin(), r.meshes.end(), [&](const HeadlessRunner::MeshResult& m) { return m.name == name; });
+			if (mesh == r.meshes.end())
+			{
+				f << ",,,,,,";
+				continue;
+			}
+			f << "," << mesh->meanTorque.x << "," << mesh->meanTorque.y << "," << mesh->meanTorque.z
+				<< "," << mesh->angularVelocity.x << "," << mesh->angularVelocity.y << "," << mesh->angularVelocity.z;
+		}
+		f << "\n";
+	}
+}
+
+void SweepScheduler::writeJson(double totalTime) const
+{
+	QJsonObject sweep;
+	sweep["project"] = QFileInfo(m_options.projectFile).absoluteFilePath();
+	sweep["sweep"] = QFileInfo(m_options.sweepFile).absoluteFilePath();
+	sweep["workers"] = m_workers;
+	sweep["threadsPerRun"] = m_threadsPerRun;
+	sweep["totalTime"] = totalTime; // msec
+
+	QJsonArray runs;
+	for (const auto& run : m_runs)
+	{
+		QJsonObject r;
+		r["name"] = run.name;
+
+		QJsonObject parameters;
+		for (size_t p = 0; p < m_parameters.size(); ++p)
+			parameters[m_parameters[p].name()] = m_parameters[p].values[run.valueIndices[p]];
+		r["parameters"] = parameters;
+
+		r["success"] = run.success;
+		if (!run.success)
+		{
+			r["error"] = QString::fromStdString(run.error);
+			runs.append(r);
+			continue;
+		}
+
+		r["steps"] = run.result.steps;
+		r["threads"] = run.result.threads;
+		r["simulatedTime"] = run.result.simulatedTime;
+		r["totalTime"] = run.result.totalTime;
+		r["stepsPerSecond"] = run.result.stepsPerSecond;
+		r["mlups"] = run.result.mlups;
+
+		QJsonArray meshes;
+		for (const auto& mesh : run.result.meshes)
+		{
+			QJsonObject m;
+			m["name"] = QString::fromStdString(mesh.name);
+			m["meanTorque"] = vectorToJson(mesh.meanTorque);
+			m["angularVelocity"] = vectorToJson(mesh.angularVelocity);
+			meshes.append(m);
+		}
+		r["meshes"] = meshes;
+		runs.append(r);
+	}
+	sweep["runs"] = runs;
+
+	QFile f(outputPath("sweep.json"));
+	if (!f.open(QIODevice::WriteOnly))
+		throw std::runtime_error("Failed to open '" + outputPath("sweep.json").toStdString() + "' for writing.");
+	f.write(QJsonDocument(sweep).toJson());
+	f.close();
+}
+
+std::vector<std::string> SweepScheduler::meshNames() const
+{
+	// Parameters may enable voxelization of a mesh, so the columns are the union over all runs
+	std::vector<std::string> names;
+	for (const auto& run : m_runs)
+	{
+		for (const auto& mesh : run.result.meshes)
+		{
+			if (std::find(names.begin(), names.end(), mesh.name) == names.end())
+				names.push_back(mesh.name);
+		}
+	}
+	return names;
+}
+
+QString SweepScheduler::outputPath(const QString& name) const
+{
+	return QDir(m_options.outputDir).filePath(name);
+}
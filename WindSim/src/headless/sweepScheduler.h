@@ -0,0 +1,91 @@
+#ifndef SWEEP_SCHEDULER_H
+#define SWEEP_SCHEDULER_H
+
+#include "headlessRunner.h"
+
+#include <QString>
+#include <QStringList>
+#include <QJsonValue>
+#include <QJsonArray>
+
+#include <vector>
+#include <string>
+
+// Runs a base project for every combination of a parameter grid, several configurations at once
+// The sweep file is a Json object, e.g.
+// {
+//     "steps": 2000, "workers": 4, "threadsPerRun": 2, "solver": "CpuLbm", "writeFields": false,
+//     "parameters": [
+//         { "object": "Rotor", "key": "rotation.angle", "values": [0, 15, 30] },
+//         { "object": "Grid", "key": "windTunnelSettings", "values": ["slow.json", "fast.json"] }
+//     ]
+// }
+// <key> is a '.'-separated path into the object data as saved in the project (and sent to ObjectManager::modify); file paths
+// are relative to the project file. All entries except "parameters" are optional and default to the Options.
+//
+// Each run writes the output of HeadlessRunner to <outputDir>/run_<n>; sweep.csv and sweep.json hold one row per run with the
+// parameter values, the steady-state (mean over the second half) torque, the final angular velocity and the steps/s
+class SweepScheduler
+{
+public:
+	struct Options
+	{
+		Options();
+		QString sweepFile;
+		QString projectFile;
+		QString outputDir;
+		QString solver; // Default of the sweep file entry
+		int steps; // Default of the sweep file entry
+		int threads; // Total thread budget of all workers, 0 uses all hardware threads
+	};
+
+	explicit SweepScheduler(const Options& options);
+
+	// Failed runs are reported in the table; throws std::runtime_error if the sweep or project file is invalid
+	// Returns the number of failed runs
+	int run();
+
+private:
+	struct Parameter
+	{
+		QString name() const { return object + "." + path.join('.'); }; // Column of the result table
+		QString object; // Name of the object
+		QStringList path;
+		std::vector<QJsonValue> values;
+	};
+
+	struct Run
+	{
+		Run();
+		std::vector<int> valueIndices; // One per parameter
+		QString name;
+		bool success;
+		std::string error;
+		HeadlessRunner::Result result;
+	};
+
+	void readSweep();
+	void createRuns();
+	void distributeThreads();
+	QJsonArray createProject(const Run& run) const;
+	void execute(Run& run) const;
+
+	void writeCsv() const;
+	void writeJson(double totalTime) const;
+	std::vector<std::string> meshNames() const;
+
+	QString outputPath(const QString& name) const;
+
+	Options m_options;
+	QJsonArray m_project;
+	std::vector<Parameter> m_parameters;
+	std::vector<Run> m_runs;
+
+	int m_steps;
+	QString m_solver;
+	bool m_writeFields;
+	int m_workers;
+	int m_threadsPerRun;
+};
+
+#endif
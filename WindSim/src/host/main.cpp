@@ -0,0 +1,30 @@
+#include "simHost.h"
+#include "transportBenchmark.h"
+
+#include <iostream>
+#include <string>
+
+// Simulation host, started by the GUI (RemoteBackend) when the solver runs out of process ([Simulation] OutOfProcess=1)
+// The only argument is the transport endpoint of the GUI; "--benchmark-transport" measures the transport instead
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		std::cerr << "Usage: WindSimHost <endpoint> | --benchmark-transport" << std::endl;
+		return 1;
+	}
+
+	std::string argument = argv[1];
+	if (argument == "--benchmark-transport")
+		return runTransportBenchmark(std::cout);
+
+	std::unique_ptr<Transport> transport = Transport::create();
+	if (!transport->connect(argument, 10000))
+	{
+		std::cerr << "ERROR: " << transport->errorString() << std::endl;
+		return 1;
+	}
+
+	SimHost host(*transport);
+	return host.run();
+}
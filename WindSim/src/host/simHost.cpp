@@ -0,0 +1,219 @@
+#include "simHost.h"
+#include "common.h"
+#include "../3D/lbmBackend.h"
+#include "../3D/projectionBackend.h"
+#ifndef WINDSIM_NO_WINDTUNNEL
+#include "../3D/windTunnelBackend.h"
+#endif
+
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+
+using namespace DirectX;
+using namespace wtl;
+
+namespace
+{
+	template <typename T>
+	T payloadStruct(const Transport::Message& request)
+	{
+		if (request.size < sizeof(T))
+			throw std::runtime_error("Message too short.");
+		T value;
+		std::memcpy(&value, request.data(), sizeof(T));
+		return value;
+	}
+
+	std::string payloadString(const Transport::Message& request, size_t offset = 0)
+	{
+		return offset < request.size ? std::string(request.data() + offset, request.size - offset) : std::string();
+	}
+}
+
+SimHost::SimHost(Transport& transport)
+	: m_transport(transport),
+	m_solver(),
+	m_resolution(0, 0, 0),
+	m_cellTypes(),
+	m_lines(),
+	m_shm(),
+	m_layout()
+{
+}
+
+int SimHost::run()
+{
+	// Reused, so the requests do not allocate; the answers are batched until the next receive
+	Transport::Message request;
+	for (;;)
+	{
+		if (!m_transport.receive(request, -1))
+			return 0; // The GUI process closed the connection
+		if (static_cast<MsgToSimProc>(request.type) == MsgToSimProc::Exit)
+			return 0;
+
+		try
+		{
+			handle(request);
+		}
+		catch (const std::exception& ex)
+		{
+			std::cerr << "ERROR: " << ex.what() << std::endl;
+			if (!send(MsgFromSimProc::Error, std::string(ex.what())))
+				return 1;
+		}
+	}
+}
+
+void SimHost::handle(const Transport::Message& request)
+{
+	MsgToSimProc type = static_cast<MsgToSimProc>(request.type);
+	if (type != MsgToSimProc::InitSim && !m_solver)
+		throw std::runtime_error("The simulation is not initialized.");
+
+	switch (type)
+	{
+	case MsgToSimProc::InitSim:
+		initSim(request);
+		break;
+	case MsgToSimProc::UpdateDimensions:
+		updateDimensions(request);
+		break;
+	case MsgToSimProc::OpenShm:
+		openShm(request);
+		break;
+	case MsgToSimProc::UpdateGrid:
+		if (!m_shm.isOpen())
+			throw std::runtime_error("The shared memory is not open.");
+		m_cellTypes.assign(reinterpret_cast<const CellType*>(m_shm.data() + m_layout.cellTypesOffset), reinterpret_cast<const CellType*>(m_shm.data() + m_layout.cellTypesOffset) + m_layout.numCells);
+		m_solver->updateGrid(m_cellTypes);
+		send(MsgFromSimProc::FinishedVoxelGridAccess);
+		break;
+	case MsgToSimProc::FillVelocity:
+		fill(request);
+		break;
+	case MsgToSimProc::CloseShm:
+		m_shm.close();
+		send(MsgFromSimProc::ClosedShm);
+		break;
+	case MsgToSimProc::Reset:
+		m_solver->reset();
+		break;
+	case MsgToSimProc::SmokeSettings:
+		m_solver->setSmokeSettings(payloadStruct<SolverBackend::SmokeSettings>(request));
+		break;
+	case MsgToSimProc::LineSettings:
+		m_solver->setLineSettings(payloadStruct<SolverBackend::LineSettings>(request));
+		break;
+	default:
+		throw std::runtime_error("Unknown request " + std::to_string(static_cast<int>(type)) + ".");
+	}
+}
+
+void SimHost::initSim(const Transport::Message& request)
+{
+	SimProcInit init = payloadStruct<SimProcInit>(request);
+	std::string settingsFile = payloadString(request, sizeof(init));
+
+	m_solver.reset();
+	SolverType solver = static_cast<SolverType>(init.solver);
+	if (solver == SolverType::CpuLbm)
+	{
+		m_solver.reset(new LbmBackend(LbmBackend::readParameters(settingsFile), init.threads));
+	}
+	else if (solver == SolverType::CpuProjection)
+	{
+		m_solver.reset(new ProjectionBackend(ProjectionBackend::readParameters(settingsFile), init.threads));
+	}
+	else
+	{
+#ifndef WINDSIM_NO_WINDTUNNEL
+		// Every host runs a single simulation, so the OpenCL context is only created once
+		static bool openCLInitialized = false;
+		if (!openCLInitialized)
+			WindTunnel::initOpenCL(init.clDevice, init.clPlatform);
+		openCLInitialized = true;
+		m_solver.reset(new WindTunnelBackend(settingsFile));
+#else
+		throw std::runtime_error("The OpenCL solver is not available in this build of the simulation host.");
+#endif
+	}
+
+	std::cerr << "INFO: Simulation host runs '" << m_solver->getName() << "' with settings file '" << settingsFile << "'." << std::endl;
+	send(MsgFromSimProc::Initialized, m_solver->getName());
+}
+
+void SimHost::updateDimensions(const Transport::Message& request)
+{
+	SimProcDimensions dimensions = payloadStruct<SimProcDimensions>(request);
+
+	// The layout of an open shared memory does not fit anymore
+	m_shm.close();
+
+	m_resolution = XMUINT3(dimensions.resolution[0], dimensions.resolution[1], dimensions.resolution[2]);
+	m_solver->setGridDimension(m_resolution, XMFLOAT3(dimensions.voxelSize[0], dimensions.voxelSize[1], dimensions.voxelSize[2]));
+
+	dimensions.lineBufferSize = m_solver->getLineBufferSize();
+	m_lines.resize(dimensions.lineBufferSize);
+	send(MsgFromSimProc::Initialized, &dimensions, sizeof(dimensions));
+}
+
+void SimHost::openShm(const Transport::Message& request)
+{
+	std::string name = payloadString(request);
+	if (!m_shm.open(name))
+		throw std::runtime_error(m_shm.errorString());
+
+	SimShmHeader header;
+	std::memcpy(&header, m_shm.data(), std::min(sizeof(header), m_shm.size()));
+	uint64_t numCells = static_cast<uint64_t>(m_resolution.x) * m_resolution.y * m_resolution.z;
+	if (m_shm.size() < sizeof(header) || std::memcmp(header.magic, SIM_SHM_MAGIC, sizeof(header.magic)) != 0 || header.version != SIM_SHM_VERSION
+		|| header.numCells != numCells || header.lineBufferSize != m_lines.size() || m_shm.size() < simShmSize(header))
+	{
+		m_shm.close();
+		throw std::runtime_error("The shared memory '" + name + "' does not match the grid.");
+	}
+
+	m_layout = header;
+	send(MsgFromSimProc::OpenedShm);
+}
+
+void SimHost::fill(const Transport::Message& request)
+{
+	SimProcFill fillRequest = payloadStruct<SimProcFill>(request);
+	if (!m_shm.isOpen() || fillRequest.slot >= m_layout.numSlots)
+		throw std::runtime_error("Invalid slot " + std::to_string(fillRequest.slot) + ".");
+
+	SimProcFilled filled = { fillRequest.slot, m_solver->step() };
+
+	char* slot = m_shm.data() + m_layout.slotOffset + fillRequest.slot * m_layout.slotSize;
+	SimShmSlot* header = reinterpret_cast<SimShmSlot*>(slot);
+	m_solver->fillVelocity(reinterpret_cast<float*>(slot + m_layout.velocityOffset), m_layout.numCells);
+	m_solver->fillPressure(reinterpret_cast<float*>(slot + m_layout.pressureOffset), m_layout.numCells);
+	if (fillRequest.density)
+		m_solver->fillDensity(reinterpret_cast<float*>(slot + m_layout.densityOffset), reinterpret_cast<float*>(slot + m_layout.densitySumOffset), m_layout.numCells);
+	header->density = fillRequest.density;
+
+	header->lines = fillRequest.lines && !m_lines.empty();
+	if (header->lines)
+	{
+		// The line buffer is small, the solvers only fill vectors
+		int reseedCounter = 0;
+		int numLines = 0;
+		m_solver->fillLines(m_lines, reseedCounter, numLines);
+		std::memcpy(slot + m_layout.linesOffset, m_lines.data(), m_lines.size());
+		header->reseedCounter = reseedCounter;
+		header->numLines = numLines;
+	}
+
+	std::string stats = m_solver->getStats();
+	TransportSegment answer[] = { { &filled, sizeof(filled) }, { stats.data(), stats.size() } };
+	m_transport.send(static_cast<uint32_t>(MsgFromSimProc::FinishedVelocityAccess), answer, 2);
+}
+
+bool SimHost::send(MsgFromSimProc type, const void* payload, size_t size)
+{
+	return m_transport.send(static_cast<uint32_t>(type), payload, size);
+}
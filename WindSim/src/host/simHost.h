@@ -0,0 +1,43 @@
+#ifndef SIM_HOST_H
+#define SIM_HOST_H
+
+#include "../3D/solverBackend.h"
+#include "msgDef.h"
+#include "sharedMemory.h"
+#include "transport.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Simulation host process: runs one solver on behalf of a RemoteBackend in the GUI process
+// Requests are received and answered through the connected <transport> (see msgDef.h); the fields are written directly to the slots of the shared memory
+class SimHost
+{
+public:
+	explicit SimHost(Transport& transport);
+
+	int run(); // Handles requests until Exit or the end of the connection, returns the exit code
+
+private:
+	void handle(const Transport::Message& request); // Throws std::runtime_error, which is answered with Error
+	void initSim(const Transport::Message& request);
+	void updateDimensions(const Transport::Message& request);
+	void openShm(const Transport::Message& request);
+	void fill(const Transport::Message& request);
+
+	bool send(MsgFromSimProc type, const void* payload = nullptr, size_t size = 0);
+	bool send(MsgFromSimProc type, const std::string& payload) { return send(type, payload.data(), payload.size()); };
+
+	Transport& m_transport;
+
+	std::unique_ptr<SolverBackend> m_solver;
+	DirectX::XMUINT3 m_resolution;
+	std::vector<wtl::CellType> m_cellTypes;
+	std::vector<char> m_lines;
+
+	SharedMemory m_shm;
+	SimShmHeader m_layout;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "transportBenchmark.h"
+#include "transport.h"
+#include "sharedMemory.h"
+
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	enum MsgType : uint32_t { Stop, Ping, Data, Sync };
+
+	const int g_numPings = 10000;
+	const int g_numSmall = 1000000;
+	const int g_numUnbatched = 100000;
+	const size_t g_smallSize = 64;
+	const int g_numLarge = 32;
+	const size_t g_largeSize = 16 << 20;
+
+	// Answers Ping and Sync, ignores Data
+	void echo(const std::string& name)
+	{
+		std::unique_ptr<Transport> transport = Transport::create();
+		if (!transport->connect(name, 5000))
+			return;
+
+		Transport::Message message;
+		while (transport->receive(message, -1) && message.type != Stop)
+		{
+			if (message.type == Ping || message.type == Sync)
+				transport->send(message.type, message.data(), message.size);
+		}
+	}
+
+	double seconds(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// Sends <count> Data messages of <size> bytes, waits until the peer has received them and returns the time
+	bool stream(Transport& transport, int count, const std::vector<char>& payload, bool flushEach, double& time)
+	{
+		Transport::Message answer;
+		auto start = Clock::now();
+		for (int i = 0; i < count; ++i)
+		{
+			if (!transport.send(Data, payload.data(), payload.size()) || (flushEach && !transport.flush()))
+				return false;
+		}
+		if (!transport.send(Sync) || !transport.receive(answer, -1))
+			return false;
+		time = seconds(start);
+		return true;
+	}
+}
+
+int runTransportBenchmark(std::ostream& out)
+{
+	std::string name = SharedMemory::uniqueName("windsim-benchmark");
+	std::unique_ptr<Transport> transport = Transport::create();
+	if (!transport->listen(name))
+	{
+		out << "ERROR: " << transport->errorString() << std::endl;
+		return 1;
+	}
+	std::thread peer(echo, name);
+	if (!transport->accept(5000))
+	{
+		out << "ERROR: " << transport->errorString() << std::endl;
+		peer.join();
+		return 1;
+	}
+
+	bool success = true;
+	out << std::fixed << std::setprecision(2);
+
+	// Latency: one small message there and back
+	std::vector<char> small(g_smallSize, 1);
+	std::vector<double> roundTrips;
+	roundTrips.reserve(g_numPings);
+	Transport::Message answer;
+	for (int i = 0; i < g_numPings && success; ++i)
+	{
+		auto start = Clock::now();
+		success = transport->send(Ping, small.data(), small.size()) && transport->receive(answer, -1);
+		roundTrips.push_back(seconds(start) * 1e6);
+	}
+	if (success)
+	{
+		std::sort(roundTrips.begin(), roundTrips.end());
+		double sum = 0.0;
+		for (double t : roundTrips)
+			sum += t;
+		out << "Round trip (" << g_smallSize << " bytes, " << g_numPings << "x): mean " << sum / roundTrips.size() << " us, median " << roundTrips[roundTrips.size() / 2]
+			<< " us, 99% " << roundTrips[roundTrips.size() * 99 / 100] << " us" << std::endl;
+	}
+
+	// Rate of small messages, batched and with one system call each
+	double time = 0.0;
+	if (success && (success = stream(*transport, g_numSmall, small, false, time)))
+		out << "Small messages, batched (" << g_smallSize << " bytes, " << g_numSmall << "x): " << g_numSmall / time / 1e6 << " M messages/s" << std::endl;
+	if (success && (success = stream(*transport, g_numUnbatched, small, true, time)))
+		out << "Small messages, flushed each (" << g_smallSize << " bytes, " << g_numUnbatched << "x): " << g_numUnbatched / time / 1e6 << " M messages/s" << std::endl;
+
+	// Throughput of large messages, which are written from the memory of the sender
+	std::vector<char> large(g_largeSize, 1);
+	if (success && (success = stream(*transport, g_numLarge, large, false, time)))
+		out << "Large messages (" << (g_largeSize >> 20) << " MB, " << g_numLarge << "x): " << g_numLarge * static_cast<double>(g_largeSize) / time / (1 << 30) << " GB/s" << std::endl;
+
+	if (!success)
+		out << "ERROR: " << transport->errorString() << std::endl;
+
+	transport->send(Stop);
+	transport->flush();
+	peer.join();
+	return success ? 0 : 1;
+}
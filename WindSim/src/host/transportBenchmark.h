@@ -0,0 +1,10 @@
+#ifndef TRANSPORT_BENCHMARK_H
+#define TRANSPORT_BENCHMARK_H
+
+#include <ostream>
+
+// Measures the Transport of the platform between two threads of this process (WindSimHost --benchmark-transport):
+// round trip latency of small messages, the rate of small messages with and without batching and the throughput of large ones
+int runTransportBenchmark(std::ostream& out);
+
+#endif
@@ -0,0 +1,486 @@
+#include "brickFile.h"
+#include "parallel.h"
+
+#include <cstring>
+#include <algorithm>
+
+using namespace DirectX;
+using namespace BrickFile;
+
+namespace
+{
+	const char g_magic[8] = { 'W', 'S', 'B', 'R', 'I', 'C', 'K', '\0' };
+	const uint32_t g_version = 1;
+	const size_t g_nameSize = 32;
+
+#pragma pack(push, 1)
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t resolution[3];
+		float voxelSize[3];
+	};
+
+	struct DirectoryEntry
+	{
+		char name[g_nameSize];
+		uint32_t type;
+		uint32_t components;
+		uint64_t offset;
+	};
+
+	struct Footer
+	{
+		uint64_t directoryOffset;
+		uint32_t numChannels;
+		char magic[4];
+	};
+#pragma pack(pop)
+
+	XMUINT3 brickCount(const XMUINT3& resolution)
+	{
+		return XMUINT3((resolution.x + BRICK_SIZE - 1) / BRICK_SIZE, (resolution.y + BRICK_SIZE - 1) / BRICK_SIZE, (resolution.z + BRICK_SIZE - 1) / BRICK_SIZE);
+	}
+
+	size_t maskWords(const XMUINT3& bricks)
+	{
+		return (static_cast<size_t>(bricks.x) * bricks.y + 63) / 64;
+	}
+}
+
+// =============================================================================
+// WRITER
+// =============================================================================
+
+BrickWriter::BrickWriter()
+	: m_file(),
+	m_resolution(0, 0, 0),
+	m_bricks(0, 0, 0),
+	m_channels(),
+	m_inChannel(false),
+	m_slab(),
+	m_slabSlices(0),
+	m_slices(0),
+	m_brick(),
+	m_numBricks(0),
+	m_numActiveBricks(0),
+	m_error()
+{
+}
+
+BrickWriter::~BrickWriter()
+{
+	if (m_file.isOpen())
+		close();
+}
+
+bool BrickWriter::open(const QString& path, const XMUINT3& resolution, const XMFLOAT3& voxelSize)
+{
+	m_file.setFileName(path);
+	if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return fail("Failed to open '" + path + "' for writing: " + m_file.errorString());
+
+	m_resolution = resolution;
+	m_bricks = brickCount(resolution);
+	m_channels.clear();
+	m_inChannel = false;
+	m_numBricks = 0;
+	m_numActiveBricks = 0;
+
+	Header header;
+	std::memcpy(header.magic, g_magic, sizeof(header.magic));
+	header.version = g_version;
+	header.resolution[0] = resolution.x;
+	header.resolution[1] = resolution.y;
+	header.resolution[2] = resolution.z;
+	header.voxelSize[0] = voxelSize.x;
+	header.voxelSize[1] = voxelSize.y;
+	header.voxelSize[2] = voxelSize.z;
+	return write(&header, sizeof(header));
+}
+
+bool BrickWriter::close()
+{
+	if (!m_file.isOpen())
+		return false;
+
+	if (m_inChannel && !endChannel())
+	{
+		m_file.close();
+		return false;
+	}
+
+	Footer footer;
+	footer.directoryOffset = m_file.pos();
+	footer.numChannels = static_cast<uint32_t>(m_channels.size());
+	std::memcpy(footer.magic, g_magic, sizeof(footer.magic));
+
+	for (const auto& channel : m_channels)
+	{
+		DirectoryEntry entry;
+		std::memset(entry.name, 0, g_nameSize);
+		std::memcpy(entry.name, channel.name.data(), std::min(channel.name.size(), g_nameSize - 1));
+		entry.type = static_cast<uint32_t>(channel.type);
+		entry.components = channel.components;
+		entry.offset = channel.offset;
+		if (!write(&entry, sizeof(entry)))
+			break;
+	}
+
+	bool success = write(&footer, sizeof(footer));
+	m_file.close();
+	return success;
+}
+
+bool BrickWriter::beginChannel(const std::string& name, ElementType type, int components)
+{
+	if (!m_file.isOpen())
+		return fail("No file opened.");
+	if (m_inChannel && !endChannel())
+		return false;
+	if (components < 1)
+		return fail("Invalid number of components for channel '" + QString::fromStdString(name) + "'.");
+
+	Channel channel;
+	channel.name = name;
+	channel.type = type;
+	channel.components = components;
+	channel.offset = m_file.pos();
+	m_channels.push_back(channel);
+
+	size_t sliceSize = static_cast<size_t>(m_resolution.x) * m_resolution.y * channel.elementSize();
+	m_slab.resize(sliceSize * BRICK_SIZE);
+	m_brick.resize(BRICK_CELLS * channel.elementSize());
+	m_slabSlices = 0;
+	m_slices = 0;
+	m_inChannel = true;
+	return true;
+}
+
+bool BrickWriter::writeSlices(const void* data, int numSlices)
+{
+	if (!m_inChannel)
+		return fail("No channel started.");
+	if (m_slices + numSlices > m_resolution.z)
+		return fail("More slices than the grid resolution passed to channel '" + QString::fromStdString(m_channels.back().name) + "'.");
+
+	const size_t sliceSize = static_cast<size_t>(m_resolution.x) * m_resolution.y * m_channels.back().elementSize();
+	const char* src = static_cast<const char*>(data);
+
+	for (int i = 0; i < numSlices; ++i)
+	{
+		std::memcpy(&m_slab[m_slabSlices * sliceSize], src + i * sliceSize, sliceSize);
+		++m_slabSlices;
+		++m_slices;
+
+		if (m_slabSlices == BRICK_SIZE || m_slices == m_resolution.z)
+		{
+			if (!flushSlab())
+				return false;
+		}
+	}
+	return true;
+}
+
+bool BrickWriter::endChannel()
+{
+	if (!m_inChannel)
+		return fail("No channel started.");
+
+	m_inChannel = false;
+	if (m_slices != m_resolution.z)
+		return fail("Channel '" + QString::fromStdString(m_channels.back().name) + "' is incomplete (" + QString::number(m_slices) + " of " + QString::number(m_resolution.z) + " slices).");
+	return true;
+}
+
+bool BrickWriter::writeChannel(const std::string& name, ElementType type, int components, const void* data)
+{
+	return beginChannel(name, type, components) && writeSlices(data, m_resolution.z) && endChannel();
+}
+
+bool BrickWriter::flushSlab()
+{
+	const size_t elemSize = m_channels.back().elementSize();
+	const size_t rowSize = m_resolution.x * elemSize;
+	const size_t sliceSize = rowSize * m_resolution.y;
+
+	// Find the constant bricks first, as the mask precedes the brick data
+	std::vector<uint64_t> mask(maskWords(m_bricks), 0);
+	for (uint32_t by = 0; by < m_bricks.y; ++by)
+	{
+		for (uint32_t bx = 0; bx < m_bricks.x; ++bx)
+		{
+			const char* first = &m_slab[by * BRICK_SIZE * rowSize + bx * BRICK_SIZE * elemSize];
+			uint32_t xEnd = std::min<uint32_t>(BRICK_SIZE, m_resolution.x - bx * BRICK_SIZE);
+			uint32_t yEnd = std::min<uint32_t>(BRICK_SIZE, m_resolution.y - by * BRICK_SIZE);
+
+			bool constant = true;
+			for (int z = 0; z < m_slabSlices && constant; ++z)
+			{
+				for (uint32_t y = 0; y < yEnd && constant; ++y)
+				{
+					const char* row = first + z * sliceSize + y * rowSize;
+					for (uint32_t x = 0; x < xEnd; ++x)
+					{
+						if (std::memcmp(row + x * elemSize, first, elemSize) != 0)
+						{
+							constant = false;
+							break;
+						}
+					}
+				}
+			}
+
+			if (!constant)
+			{
+				size_t index = by * m_bricks.x + bx;
+				mask[index / 64] |= 1ull << (index % 64);
+			}
+		}
+	}
+
+	if (!write(mask.data(), mask.size() * sizeof(uint64_t)))
+		return false;
+
+	for (uint32_t by = 0; by < m_bricks.y; ++by)
+	{
+		for (uint32_t bx = 0; bx < m_bricks.x; ++bx)
+		{
+			size_t index = by * m_bricks.x + bx;
+			const char* first = &m_slab[by * BRICK_SIZE * rowSize + bx * BRICK_SIZE * elemSize];
+			++m_numBricks;
+
+			if (!(mask[index / 64] & (1ull << (index % 64))))
+			{
+				if (!write(first, elemSize))
+					return false;
+				continue;
+			}
+
+			// Gather the brick, cells outside of the grid are zero
+			std::fill(m_brick.begin(), m_brick.end(), 0);
+			uint32_t xEnd = std::min<uint32_t>(BRICK_SIZE, m_resolution.x - bx * BRICK_SIZE);
+			uint32_t yEnd = std::min<uint32_t>(BRICK_SIZE, m_resolution.y - by * BRICK_SIZE);
+			for (int z = 0; z < m_slabSlices; ++z)
+			{
+				for (uint32_t y = 0; y < yEnd; ++y)
+					std::memcpy(&m_brick[((z * BRICK_SIZE) + y) * BRICK_SIZE * elemSize], first + z * sliceSize + y * rowSize, xEnd * elemSize);
+			}
+
+			++m_numActiveBricks;
+			if (!write(m_brick.data(), m_brick.size()))
+				return false;
+		}
+	}
+
+	m_slabSlices = 0;
+	return true;
+}
+
+bool BrickWriter::write(const void* data, size_t size)
+{
+	if (m_file.write(static_cast<const char*>(data), size) != static_cast<qint64>(size))
+		return fail("Failed to write '" + m_file.fileName() + "': " + m_file.errorString());
+	return true;
+}
+
+bool BrickWriter::fail(const QString& msg)
+{
+	m_error = msg;
+	return false;
+}
+
+// =============================================================================
+// READER
+// =============================================================================
+
+BrickReader::BrickReader()
+	: m_file(),
+	m_data(nullptr),
+	m_size(0),
+	m_resolution(0, 0, 0),
+	m_voxelSize(0.0f, 0.0f, 0.0f),
+	m_bricks(0, 0, 0),
+	m_channels(),
+	m_brickOffsets(),
+	m_error()
+{
+}
+
+BrickReader::~BrickReader()
+{
+	close();
+}
+
+bool BrickReader::open(const QString& path)
+{
+	close();
+
+	m_file.setFileName(path);
+	if (!m_file.open(QIODevice::ReadOnly))
+		return fail("Failed to open '" + path + "': " + m_file.errorString());
+
+	m_size = m_file.size();
+	if (m_size < sizeof(Header) + sizeof(Footer))
+		return fail("'" + path + "' is not a brick file (too small).");
+
+	m_data = m_file.map(0, m_size);
+	if (!m_data)
+		return fail("Failed to map '" + path + "': " + m_file.errorString());
+
+	Header header;
+	std::memcpy(&header, m_data, sizeof(header));
+	Footer footer;
+	std::memcpy(&footer, m_data + m_size - sizeof(footer), sizeof(footer));
+	if (std::memcmp(header.magic, g_magic, sizeof(header.magic)) != 0 || std::memcmp(footer.magic, g_magic, sizeof(footer.magic)) != 0)
+		return fail("'" + path + "' is not a brick file or was not written completely.");
+	if (header.version != g_version)
+		return fail("Unsupported version " + QString::number(header.version) + " of brick file '" + path + "'.");
+	if (footer.directoryOffset + footer.numChannels * sizeof(DirectoryEntry) + sizeof(Footer) != m_size)
+		return fail("Corrupt directory in brick file '" + path + "'.");
+
+	m_resolution = XMUINT3(header.resolution[0], header.resolution[1], header.resolution[2]);
+	m_voxelSize = XMFLOAT3(header.voxelSize[0], header.voxelSize[1], header.voxelSize[2]);
+	m_bricks = brickCount(m_resolution);
+
+	const uint64_t slabBricks = static_cast<uint64_t>(m_bricks.x) * m_bricks.y;
+	const size_t words = maskWords(m_bricks);
+
+	for (uint32_t i = 0; i < footer.numChannels; ++i)
+	{
+		DirectoryEntry entry;
+		std::memcpy(&entry, m_data + footer.directoryOffset + i * sizeof(entry), sizeof(entry));
+		entry.name[g_nameSize - 1] = '\0';
+
+		Channel channel;
+		channel.name = entry.name;
+		channel.type = ElementType(entry.type);
+		channel.components = entry.components;
+		channel.offset = entry.offset;
+		if ((channel.type != ElementType::UInt8 && channel.type != ElementType::Float32) || channel.components == 0)
+			return fail("Unknown element type of channel '" + QString::fromStdString(channel.name) + "' in '" + path + "'.");
+
+		// Locate the bricks
+		const size_t elemSize = channel.elementSize();
+		std::vector<uint64_t> offsets(slabBricks * m_bricks.z);
+		uint64_t pos = channel.offset;
+		for (uint32_t bz = 0; bz < m_bricks.z; ++bz)
+		{
+			if (pos + words * sizeof(uint64_t) > footer.directoryOffset)
+				return fail("Channel '" + QString::fromStdString(channel.name) + "' in '" + path + "' is truncated.");
+
+			std::vector<uint64_t> mask(words);
+			std::memcpy(mask.data(), m_data + pos, words * sizeof(uint64_t));
+			pos += words * sizeof(uint64_t);
+
+			for (uint64_t b = 0; b < slabBricks; ++b)
+			{
+				bool active = (mask[b / 64] & (1ull << (b % 64))) != 0;
+				offsets[bz * slabBricks + b] = (pos << 1) | (active ? 1 : 0);
+				pos += active ? BRICK_CELLS * elemSize : elemSize;
+			}
+		}
+		if (pos > footer.directoryOffset)
+			return fail("Channel '" + QString::fromStdString(channel.name) + "' in '" + path + "' is truncated.");
+
+		m_channels.push_back(channel);
+		m_brickOffsets.push_back(std::move(offsets));
+	}
+
+	return true;
+}
+
+void BrickReader::close()
+{
+	if (m_data)
+		m_file.unmap(const_cast<uchar*>(m_data));
+	m_data = nullptr;
+	m_size = 0;
+	m_file.close();
+	m_channels.clear();
+	m_brickOffsets.clear();
+}
+
+int BrickReader::findChannel(const std::string& name) const
+{
+	for (size_t i = 0; i < m_channels.size(); ++i)
+	{
+		if (m_channels[i].name == name)
+			return static_cast<int>(i);
+	}
+	return -1;
+}
+
+bool BrickReader::readChannel(int channel, void* out, int threads) const
+{
+	if (channel < 0 || channel >= static_cast<int>(m_channels.size()))
+		return false;
+
+	const size_t elemSize = m_channels[channel].elementSize();
+	const size_t rowSize = m_resolution.x * elemSize;
+	const size_t sliceSize = rowSize * m_resolution.y;
+	const std::vector<uint64_t>& offsets = m_brickOffsets[channel];
+	char* dst = static_cast<char*>(out);
+
+	// Brick slabs write disjoint z ranges of the output
+	Parallel::forRange(0, m_bricks.z, [&](int bzBegin, int bzEnd)
+	{
+		for (int bz = bzBegin; bz < bzEnd; ++bz)
+		{
+			uint32_t zEnd = std::min<uint32_t>(BRICK_SIZE, m_resolution.z - bz * BRICK_SIZE);
+			for (uint32_t by = 0; by < m_bricks.y; ++by)
+			{
+				uint32_t yEnd = std::min<uint32_t>(BRICK_SIZE, m_resolution.y - by * BRICK_SIZE);
+				for (uint32_t bx = 0; bx < m_bricks.x; ++bx)
+				{
+					uint32_t xEnd = std::min<uint32_t>(BRICK_SIZE, m_resolution.x - bx * BRICK_SIZE);
+					uint64_t offset = offsets[(static_cast<size_t>(bz) * m_bricks.y + by) * m_bricks.x + bx];
+					const uchar* src = m_data + (offset >> 1);
+					char* first = dst + bz * BRICK_SIZE * sliceSize + by * BRICK_SIZE * rowSize + bx * BRICK_SIZE * elemSize;
+
+					for (uint32_t z = 0; z < zEnd; ++z)
+					{
+						for (uint32_t y = 0; y < yEnd; ++y)
+						{
+							char* row = first + z * sliceSize + y * rowSize;
+							if (offset & 1)
+							{
+								std::memcpy(row, src + ((z * BRICK_SIZE) + y) * BRICK_SIZE * elemSize, xEnd * elemSize);
+							}
+							else
+							{
+								for (uint32_t x = 0; x < xEnd; ++x)
+									std::memcpy(row + x * elemSize, src, elemSize);
+							}
+						}
+					}
+				}
+			}
+		}
+	}, threads);
+
+	return true;
+}
+
+const void* BrickReader::element(int channel, uint32_t x, uint32_t y, uint32_t z) const
+{
+	if (channel < 0 || channel >= static_cast<int>(m_channels.size()) || x >= m_resolution.x || y >= m_resolution.y || z >= m_resolution.z)
+		return nullptr;
+
+	size_t brick = (static_cast<size_t>(z / BRICK_SIZE) * m_bricks.y + y / BRICK_SIZE) * m_bricks.x + x / BRICK_SIZE;
+	uint64_t offset = m_brickOffsets[channel][brick];
+	const uchar* src = m_data + (offset >> 1);
+	if (!(offset & 1))
+		return src;
+
+	size_t cell = ((z % BRICK_SIZE) * BRICK_SIZE + y % BRICK_SIZE) * BRICK_SIZE + x % BRICK_SIZE;
+	return src + cell * m_channels[channel].elementSize();
+}
+
+bool BrickReader::fail(const QString& msg)
+{
+	m_error = msg;
+	close();
+	return false;
+}
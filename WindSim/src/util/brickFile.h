@@ -0,0 +1,124 @@
+#ifndef BRICK_FILE_H
+#define BRICK_FILE_H
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include <QFile>
+#include <QString>
+
+// Sparse, tiled storage of grid fields (cell types, velocity, pressure, ...)
+// The grid is split into bricks of 8^3 cells; bricks with a constant value are stored as a single element, all others densely
+//
+// File layout (little endian):
+// - Header: magic "WSBRICK", version, resolution (3 x uint32), voxel size (3 x float)
+// - Channels: Consecutive brick slabs (8 z slices each); every slab starts with the active mask (one bit per brick, x fastest,
+//   padded to uint64 words), followed by each brick as either one element (constant) or 512 elements (active, x fastest)
+// - Directory: one entry per channel (name, element type, components, file offset)
+// - Footer: directory offset and number of channels
+namespace BrickFile
+{
+	static const int BRICK_SIZE = 8;
+	static const int BRICK_CELLS = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+
+	enum class ElementType : uint32_t { UInt8 = 1, Float32 = 4 }; // Value is the byte size of one component
+
+	struct Channel
+	{
+		std::string name;
+		ElementType type;
+		uint32_t components;
+		uint64_t offset; // File offset of the first brick slab
+
+		size_t elementSize() const { return static_cast<size_t>(type) * components; };
+	};
+}
+
+// Writes the channels one after the other; the cells of a channel may be passed in chunks of z slices, only one brick slab is buffered
+class BrickWriter
+{
+public:
+	BrickWriter();
+	~BrickWriter();
+
+	bool open(const QString& path, const DirectX::XMUINT3& resolution, const DirectX::XMFLOAT3& voxelSize);
+	bool close(); // Writes the directory; the file is incomplete without
+
+	bool beginChannel(const std::string& name, BrickFile::ElementType type, int components);
+	bool writeSlices(const void* data, int numSlices); // Appends z slices (x fastest) to the current channel
+	bool endChannel();
+
+	// Shortcut for a complete channel
+	bool writeChannel(const std::string& name, BrickFile::ElementType type, int components, const void* data);
+
+	const QString& errorString() const { return m_error; };
+
+	// Statistics of the written channels
+	uint64_t getNumBricks() const { return m_numBricks; };
+	uint64_t getNumActiveBricks() const { return m_numActiveBricks; };
+
+private:
+	bool flushSlab();
+	bool write(const void* data, size_t size);
+	bool fail(const QString& msg);
+
+	QFile m_file;
+	DirectX::XMUINT3 m_resolution;
+	DirectX::XMUINT3 m_bricks; // Number of bricks along each axis
+	std::vector<BrickFile::Channel> m_channels;
+	bool m_inChannel;
+
+	std::vector<char> m_slab; // Up to BRICK_SIZE z slices of the current channel
+	int m_slabSlices;
+	uint32_t m_slices; // Slices written to the current channel
+	std::vector<char> m_brick;
+
+	uint64_t m_numBricks;
+	uint64_t m_numActiveBricks;
+	QString m_error;
+};
+
+// Reads files written by BrickWriter; the file is memory mapped, so only the accessed bricks are loaded from disk
+class BrickReader
+{
+public:
+	BrickReader();
+	~BrickReader();
+
+	bool open(const QString& path);
+	void close();
+	bool isOpen() const { return m_data != nullptr; };
+
+	DirectX::XMUINT3 getResolution() const { return m_resolution; };
+	DirectX::XMFLOAT3 getVoxelSize() const { return m_voxelSize; };
+	const std::vector<BrickFile::Channel>& getChannels() const { return m_channels; };
+	int findChannel(const std::string& name) const; // -1 if not contained
+
+	// Decode a whole channel into a dense array (x fastest) of resolution.x * resolution.y * resolution.z elements
+	bool readChannel(int channel, void* out, int threads = 0) const;
+
+	// Random access to a single cell
+	const void* element(int channel, uint32_t x, uint32_t y, uint32_t z) const;
+
+	const QString& errorString() const { return m_error; };
+
+private:
+	bool fail(const QString& msg);
+
+	QFile m_file;
+	const uchar* m_data;
+	uint64_t m_size;
+
+	DirectX::XMUINT3 m_resolution;
+	DirectX::XMFLOAT3 m_voxelSize;
+	DirectX::XMUINT3 m_bricks;
+	std::vector<BrickFile::Channel> m_channels;
+	std::vector<std::vector<uint64_t>> m_brickOffsets; // Per channel and brick: file offset of its data, the lowest bit marks active bricks
+
+	QString m_error;
+};
+
+#endif
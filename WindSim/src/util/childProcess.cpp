@@ -0,0 +1,147 @@
+#include "childProcess.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace
+{
+	std::string lastError()
+	{
+#ifdef _WIN32
+		return std::to_string(GetLastError());
+#else
+		return std::strerror(errno);
+#endif
+	}
+
+#ifdef _WIN32
+	// Command line argument quoted for CommandLineToArgvW
+	std::string quote(const std::string& arg)
+	{
+		std::string quoted = "\"";
+		size_t backslashes = 0;
+		for (char c : arg)
+		{
+			if (c == '\\')
+			{
+				backslashes++;
+				continue;
+			}
+			quoted.append(c == '"' ? 2 * backslashes + 1 : backslashes, '\\');
+			backslashes = 0;
+			quoted += c;
+		}
+		quoted.append(2 * backslashes, '\\');
+		return quoted + "\"";
+	}
+#endif
+}
+
+ChildProcess::ChildProcess()
+	: m_error(),
+#ifdef _WIN32
+	m_process(NULL)
+#else
+	m_pid(-1)
+#endif
+{
+}
+
+ChildProcess::~ChildProcess()
+{
+	kill();
+}
+
+#ifdef _WIN32
+
+bool ChildProcess::start(const std::string& program, const std::vector<std::string>& arguments)
+{
+	kill();
+
+	std::string commandLine = quote(program);
+	for (const auto& arg : arguments)
+		commandLine += " " + quote(arg);
+
+	STARTUPINFOA startupInfo;
+	ZeroMemory(&startupInfo, sizeof(startupInfo));
+	startupInfo.cb = sizeof(startupInfo);
+	startupInfo.dwFlags = STARTF_USESTDHANDLES;
+	startupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+	startupInfo.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+	startupInfo.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+	PROCESS_INFORMATION processInfo;
+	if (!CreateProcessA(program.c_str(), &commandLine[0], NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, NULL, &startupInfo, &processInfo))
+		return fail("Could not start '" + program + "': " + lastError());
+
+	CloseHandle(processInfo.hThread);
+	m_process = processInfo.hProcess;
+	return true;
+}
+
+void ChildProcess::kill()
+{
+	if (m_process != NULL)
+	{
+		TerminateProcess(m_process, 1);
+		WaitForSingleObject(m_process, INFINITE);
+		CloseHandle(m_process);
+	}
+	m_process = NULL;
+}
+
+bool ChildProcess::isRunning()
+{
+	return m_process != NULL && WaitForSingleObject(m_process, 0) == WAIT_TIMEOUT;
+}
+
+#else
+
+bool ChildProcess::start(const std::string& program, const std::vector<std::string>& arguments)
+{
+	kill();
+
+	std::vector<char*> argv;
+	argv.push_back(const_cast<char*>(program.c_str()));
+	for (const auto& arg : arguments)
+		argv.push_back(const_cast<char*>(arg.c_str()));
+	argv.push_back(nullptr);
+
+	m_pid = fork();
+	if (m_pid == 0)
+	{
+		execv(program.c_str(), argv.data());
+		_exit(127);
+	}
+	if (m_pid < 0)
+		return fail("Could not start '" + program + "': " + lastError());
+	return true;
+}
+
+void ChildProcess::kill()
+{
+	if (m_pid > 0)
+	{
+		::kill(m_pid, SIGKILL);
+		waitpid(m_pid, nullptr, 0);
+	}
+	m_pid = -1;
+}
+
+bool ChildProcess::isRunning()
+{
+	return m_pid > 0 && waitpid(m_pid, nullptr, WNOHANG) == 0;
+}
+
+#endif
+
+bool ChildProcess::fail(const std::string& msg)
+{
+	m_error = msg;
+	return false;
+}
@@ -0,0 +1,39 @@
+#ifndef CHILD_PROCESS_H
+#define CHILD_PROCESS_H
+
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/types.h>
+#endif
+
+// Process, which is started with the standard input, output and error of this one and talks to it through a Transport
+// Unlike QProcess, it needs no event loop and may be used from any (single) thread
+class ChildProcess
+{
+public:
+	ChildProcess();
+	~ChildProcess(); // Kills a running process
+
+	bool start(const std::string& program, const std::vector<std::string>& arguments);
+	void kill(); // Terminates the process and waits for it
+	bool isRunning();
+
+	const std::string& errorString() const { return m_error; };
+
+private:
+	bool fail(const std::string& msg);
+
+	std::string m_error;
+
+#ifdef _WIN32
+	HANDLE m_process;
+#else
+	pid_t m_pid;
+#endif
+};
+
+#endif
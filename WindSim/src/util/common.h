@@ -4,6 +4,7 @@
 #include <DirectXMath.h>
 
 #include <cstdint>
+#include <climits>
 #include <string>
 #include <fstream>
 #include <cmath>
@@ -49,10 +50,14 @@ enum CameraType { FirstPerson, ModelView };
 
 enum DynamicsMethod { Pressure, Velocity };
 
+enum class SolverType { OpenCL, CpuLbm, CpuProjection }; // WindTunnel library on an OpenCL device, the native CPU lattice Boltzmann or multigrid projection solver
+
 enum class Shading{ Smooth, Flat }; // Mesh Shading type
 
 enum VoxelType { Solid, Wireframe };
 
+enum class VoxelizationMode { Rasterization, DistanceField, File }; // GPU rasterization of all triangles, CPU lookup in the cached signed distance field of each mesh or cell types imported from a brick file
+
 enum Orientation {XY_PLANE, XZ_PLANE, YZ_PLANE};
 
 enum class VolumeMetric{ Magnitude, Vorticity };
@@ -79,6 +84,7 @@ enum Modification
 	LineSettings       = 0x10000,
 	VolumeSettings     = 0x20000,
 	VoxelSettings      = 0x40000,
+	VoxelizationSettings = 0x80000,
 
 	All = UINT_MAX
 };
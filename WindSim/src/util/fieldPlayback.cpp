@@ -0,0 +1,168 @@
+#include "fieldPlayback.h"
+
+#include <algorithm>
+
+using namespace FieldRecording;
+
+FieldPlayback::FieldPlayback()
+	: m_reader(),
+	m_prefetchFrames(0),
+	m_threads(0),
+	m_loop(true),
+	m_cache(),
+	m_failed(),
+	m_target(0),
+	m_direction(1),
+	m_stopping(false),
+	m_mutex(),
+	m_cond(),
+	m_worker()
+{
+}
+
+FieldPlayback::~FieldPlayback()
+{
+	close();
+}
+
+bool FieldPlayback::open(const QString& path, int prefetchFrames, int threads, bool loop)
+{
+	close();
+
+	if (!m_reader.open(path))
+		return false;
+
+	m_prefetchFrames = std::max(prefetchFrames, 0);
+	m_threads = threads;
+	m_loop = loop;
+	m_target = 0;
+	m_direction = 1;
+	m_stopping = false;
+	m_failed.clear();
+
+	// The window plus the frames, which the render thread may still hold
+	m_cache.clear();
+	for (int i = 0; i < m_prefetchFrames + 3; ++i)
+	{
+		Entry entry;
+		entry.frame = -1;
+		m_cache.push_back(entry);
+	}
+
+	m_worker = std::thread(&FieldPlayback::work, this);
+	return true;
+}
+
+void FieldPlayback::close()
+{
+	if (m_worker.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_cond.notify_all();
+		m_worker.join();
+	}
+
+	m_cache.clear();
+	m_reader.close();
+}
+
+std::shared_ptr<const Fields> FieldPlayback::request(int frame, int direction)
+{
+	std::shared_ptr<const Fields> result;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		int target = std::max(0, std::min(frame, m_reader.getNumFrames() - 1));
+		if (target != m_target)
+			m_failed.clear();
+		m_target = target;
+		m_direction = direction < 0 ? -1 : 1;
+
+		for (const auto& entry : m_cache)
+		{
+			if (entry.frame == m_target)
+				result = entry.fields;
+		}
+	}
+	m_cond.notify_one();
+	return result;
+}
+
+void FieldPlayback::work()
+{
+	for (;;)
+	{
+		int frame = -1;
+		Entry* entry = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cond.wait(lock, [&]()
+			{
+				if (m_stopping)
+					return true;
+				frame = nextMissing();
+				entry = frame >= 0 ? freeEntry() : nullptr;
+				return entry != nullptr;
+			});
+			if (m_stopping)
+				return;
+
+			// Invalidate the entry while decoding; the fields are not shared, so they can be written without lock
+			entry->frame = -1;
+			if (!entry->fields)
+				entry->fields = std::make_shared<Fields>();
+		}
+
+		bool success = m_reader.readFrame(frame, *entry->fields, m_threads);
+
+		// A corrupt frame is skipped, so the rest of the window is still decoded
+		std::lock_guard<std::mutex> lock(m_mutex);
+		entry->frame = success ? frame : -1;
+		if (!success)
+			m_failed.insert(frame);
+	}
+}
+
+std::vector<int> FieldPlayback::window() const
+{
+	const int numFrames = m_reader.getNumFrames();
+	std::vector<int> frames;
+	frames.push_back(m_target);
+	for (int i = 1; i <= m_prefetchFrames && i < numFrames; ++i)
+	{
+		int frame = m_target + i * m_direction;
+		if (m_loop)
+			frame = (frame % numFrames + numFrames) % numFrames;
+		else if (frame < 0 || frame >= numFrames)
+			break;
+		frames.push_back(frame);
+	}
+	return frames;
+}
+
+int FieldPlayback::nextMissing() const
+{
+	for (int frame : window())
+	{
+		bool cached = false;
+		for (const auto& entry : m_cache)
+			cached |= entry.frame == frame;
+		if (!cached && m_failed.count(frame) == 0)
+			return frame;
+	}
+	return -1;
+}
+
+FieldPlayback::Entry* FieldPlayback::freeEntry()
+{
+	std::vector<int> frames = window();
+	for (auto& entry : m_cache)
+	{
+		bool held = entry.fields && entry.fields.use_count() > 1;
+		if (!held && std::find(frames.begin(), frames.end(), entry.frame) == frames.end())
+			return &entry;
+	}
+	return nullptr;
+}
@@ -0,0 +1,62 @@
+#ifndef FIELD_PLAYBACK_H
+#define FIELD_PLAYBACK_H
+
+#include "fieldRecording.h"
+
+#include <QString>
+
+#include <vector>
+#include <set>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Source of recorded fields for reviewing a simulation without running the solver
+// The frame, which was requested last, and the following <prefetchFrames> frames in playback direction are decoded by a
+// background thread, so the render thread never waits for the decoding; while scrubbing, only the latest request is decoded
+class FieldPlayback
+{
+public:
+	FieldPlayback();
+	~FieldPlayback();
+
+	bool open(const QString& path, int prefetchFrames, int threads, bool loop); // <threads>: decoding threads per frame, 0 uses all
+	void close();
+	bool isOpen() const { return m_reader.isOpen(); };
+
+	const FieldRecordingReader& getReader() const { return m_reader; };
+	const QString& errorString() const { return m_reader.errorString(); };
+
+	// Returns the frame if it is decoded already, otherwise null; <direction> (1 or -1) selects the frames to prefetch
+	std::shared_ptr<const FieldRecording::Fields> request(int frame, int direction);
+
+private:
+	struct Entry
+	{
+		int frame; // -1 if unused
+		std::shared_ptr<FieldRecording::Fields> fields;
+	};
+
+	void work();
+	std::vector<int> window() const; // Frames to keep decoded, the requested frame first
+	int nextMissing() const; // -1 if the window is decoded or the missing frames failed
+	Entry* freeEntry(); // Entry outside the window, which is not held by a caller; null if none
+
+	FieldRecordingReader m_reader;
+	int m_prefetchFrames;
+	int m_threads;
+	bool m_loop;
+
+	std::vector<Entry> m_cache;
+	std::set<int> m_failed; // Frames, which could not be decoded; retried after the requested frame changes
+	int m_target;
+	int m_direction;
+	bool m_stopping;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::thread m_worker;
+};
+
+#endif
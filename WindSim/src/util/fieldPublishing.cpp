@@ -0,0 +1,333 @@
+#include "fieldPublishing.h"
+
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <algorithm>
+#include <new>
+
+using namespace DirectX;
+using namespace FieldPublishing;
+
+namespace
+{
+	uint64_t align(uint64_t offset)
+	{
+		return (offset + 63) & ~static_cast<uint64_t>(63);
+	}
+}
+
+int64_t FieldPublishing::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+FieldPublisher::FieldPublisher()
+	: m_name(),
+	m_directory(),
+	m_ring(),
+	m_header(nullptr),
+	m_interval(1),
+	m_sequence(0),
+	m_numPublished(0),
+	m_publishTime(0.0),
+	m_error()
+{
+}
+
+FieldPublisher::~FieldPublisher()
+{
+	close();
+}
+
+bool FieldPublisher::open(const std::string& name, const XMUINT3& resolution, const XMFLOAT3& voxelSize, int numSlots, int interval)
+{
+	// The subscribers keep the directory, only the ring is replaced
+	closeRing();
+	if (name != m_name || !m_directory.isOpen())
+	{
+		close();
+		if (!m_directory.create(name, sizeof(Directory)))
+		{
+			// Left behind by a publisher, which crashed
+			SharedMemory::remove(name);
+			if (!m_directory.create(name, sizeof(Directory)))
+				return fail(m_directory.errorString());
+		}
+		Directory* directory = new (m_directory.data()) Directory();
+		std::memcpy(directory->magic, DIRECTORY_MAGIC, sizeof(directory->magic));
+		directory->version = VERSION;
+		m_name = name;
+	}
+
+	m_interval = std::max(interval, 1);
+	m_sequence = 0;
+	m_numPublished = 0;
+	m_publishTime = 0.0;
+
+	uint64_t numCells = static_cast<uint64_t>(resolution.x) * resolution.y * resolution.z;
+	uint64_t velocityOffset = align(sizeof(SlotHeader));
+	uint64_t pressureOffset = align(velocityOffset + numCells * 4 * sizeof(float));
+	uint64_t densityOffset = align(pressureOffset + numCells * sizeof(float));
+	uint64_t slotSize = align(densityOffset + numCells * sizeof(float));
+	uint64_t slotOffset = align(sizeof(RingHeader));
+	uint32_t slots = static_cast<uint32_t>(std::max(numSlots, 2));
+
+	std::string ringName = SharedMemory::uniqueName(name);
+	if (ringName.size() >= MAX_NAME)
+		return fail("The name '" + name + "' is too long.");
+	if (!m_ring.create(ringName, static_cast<size_t>(slotOffset + slots * slotSize)))
+		return fail(m_ring.errorString());
+
+	RingHeader* header = new (m_ring.data()) RingHeader();
+	std::memcpy(header->magic, RING_MAGIC, sizeof(header->magic));
+	header->version = VERSION;
+	header->numSlots = slots;
+	header->resolution[0] = resolution.x;
+	header->resolution[1] = resolution.y;
+	header->resolution[2] = resolution.z;
+	header->voxelSize[0] = voxelSize.x;
+	header->voxelSize[1] = voxelSize.y;
+	header->voxelSize[2] = voxelSize.z;
+	header->numCells = numCells;
+	header->slotOffset = slotOffset;
+	header->slotSize = slotSize;
+	header->velocityOffset = velocityOffset;
+	header->pressureOffset = pressureOffset;
+	header->densityOffset = densityOffset;
+	for (uint32_t i = 0; i < slots; ++i)
+		new (m_ring.data() + slotOffset + i * slotSize) SlotHeader();
+	m_header = header;
+
+	// Point the subscribers to the new ring; the odd generation marks the name as incomplete
+	Directory* directory = reinterpret_cast<Directory*>(m_directory.data());
+	uint32_t generation = directory->generation.load(std::memory_order_relaxed);
+	directory->generation.store(generation + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memset(directory->ring, 0, MAX_NAME);
+	std::memcpy(directory->ring, ringName.data(), ringName.size());
+	directory->generation.store(generation + 2, std::memory_order_release);
+	return true;
+}
+
+void FieldPublisher::close()
+{
+	closeRing();
+	if (m_directory.isOpen())
+		reinterpret_cast<Directory*>(m_directory.data())->closed.store(1, std::memory_order_release);
+	m_directory.close();
+	m_name.clear();
+}
+
+void FieldPublisher::closeRing()
+{
+	if (m_header)
+		m_header->closed.store(1, std::memory_order_release);
+	m_header = nullptr;
+	m_ring.close();
+}
+
+void FieldPublisher::stepPublished(const FieldFrame& frame)
+{
+	if (!m_header || frame.step % m_interval != 0)
+		return;
+	if (frame.resolution.x != m_header->resolution[0] || frame.resolution.y != m_header->resolution[1] || frame.resolution.z != m_header->resolution[2])
+		return;
+
+	auto start = std::chrono::steady_clock::now();
+
+	uint64_t sequence = ++m_sequence;
+	char* slot = m_ring.data() + m_header->slotOffset + (sequence % m_header->numSlots) * m_header->slotSize;
+	SlotHeader* header = reinterpret_cast<SlotHeader*>(slot);
+
+	// Readers of this slot discard their copy from now on
+	header->sequence.store(2 * sequence - 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	size_t numCells = static_cast<size_t>(m_header->numCells);
+	header->step = frame.step;
+	header->time = frame.time;
+	header->hasDensity = frame.density != nullptr;
+	std::memcpy(slot + m_header->velocityOffset, frame.velocity, numCells * 4 * sizeof(float));
+	std::memcpy(slot + m_header->pressureOffset, frame.pressure, numCells * sizeof(float));
+	if (frame.density)
+		std::memcpy(slot + m_header->densityOffset, frame.density, numCells * sizeof(float));
+	header->publishTime = FieldPublishing::now();
+
+	header->sequence.store(2 * sequence, std::memory_order_release);
+	m_header->latest.store(sequence, std::memory_order_release);
+
+	m_numPublished++;
+	m_publishTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool FieldPublisher::fail(const std::string& msg)
+{
+	m_error = msg;
+	return false;
+}
+
+FieldSubscriber::Frame::Frame()
+	: sequence(0),
+	step(0),
+	time(0.0),
+	publishTime(0),
+	resolution(0, 0, 0),
+	voxelSize(0.0f, 0.0f, 0.0f),
+	velocity(),
+	pressure(),
+	density()
+{
+}
+
+FieldSubscriber::FieldSubscriber()
+	: m_directory(),
+	m_ring(),
+	m_generation(0),
+	m_header(nullptr),
+	m_last(0),
+	m_numMissed(0),
+	m_error()
+{
+}
+
+bool FieldSubscriber::attach(const std::string& name)
+{
+	detach();
+	if (!m_directory.open(name, true))
+	{
+		m_error = m_directory.errorString();
+		return false;
+	}
+
+	const Directory* directory = reinterpret_cast<const Directory*>(m_directory.data());
+	if (m_directory.size() < sizeof(Directory) || std::memcmp(directory->magic, DIRECTORY_MAGIC, sizeof(directory->magic)) != 0 || directory->version != VERSION)
+	{
+		m_directory.close();
+		m_error = "'" + name + "' is no field publisher.";
+		return false;
+	}
+	return true;
+}
+
+void FieldSubscriber::detach()
+{
+	m_ring.close();
+	m_directory.close();
+	m_header = nullptr;
+	m_generation = 0;
+	m_last = 0;
+	m_numMissed = 0;
+}
+
+bool FieldSubscriber::isClosed() const
+{
+	return !m_directory.isOpen() || reinterpret_cast<const Directory*>(m_directory.data())->closed.load(std::memory_order_acquire) != 0;
+}
+
+bool FieldSubscriber::openRing()
+{
+	const Directory* directory = reinterpret_cast<const Directory*>(m_directory.data());
+	uint32_t generation = directory->generation.load(std::memory_order_acquire);
+	if (generation == m_generation)
+		return m_header != nullptr;
+	if (generation == 0 || generation % 2 == 1)
+		return false; // No ring yet or the publisher is switching
+
+	char name[MAX_NAME];
+	std::memcpy(name, directory->ring, MAX_NAME);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (directory->generation.load(std::memory_order_relaxed) != generation)
+		return false;
+	name[MAX_NAME - 1] = '\0';
+
+	m_header = nullptr;
+	m_last = 0;
+	if (!m_ring.open(name, true))
+	{
+		// The publisher may have replaced the ring meanwhile, the next read tries again
+		m_error = m_ring.errorString();
+		return false;
+	}
+
+	const RingHeader* header = reinterpret_cast<const RingHeader*>(m_ring.data());
+	if (m_ring.size() < sizeof(RingHeader) || std::memcmp(header->magic, RING_MAGIC, sizeof(header->magic)) != 0 || header->version != VERSION
+		|| m_ring.size() < header->slotOffset + header->numSlots * header->slotSize)
+	{
+		m_ring.close();
+		m_error = "The ring '" + std::string(name) + "' is invalid.";
+		return false;
+	}
+
+	m_header = header;
+	m_generation = generation;
+	return true;
+}
+
+bool FieldSubscriber::readLatest(Frame& frame)
+{
+	if (!m_directory.isOpen() || !openRing())
+		return false;
+
+	// A few tries, as the publisher may overtake a reader of the latest step while it copies
+	for (int attempt = 0; attempt < 3; ++attempt)
+	{
+		uint64_t sequence = m_header->latest.load(std::memory_order_acquire);
+		if (sequence == 0 || sequence == m_last)
+			return false;
+
+		const char* slot = m_ring.data() + m_header->slotOffset + (sequence % m_header->numSlots) * m_header->slotSize;
+		const SlotHeader* header = reinterpret_cast<const SlotHeader*>(slot);
+		uint64_t before = header->sequence.load(std::memory_order_acquire);
+		if (before != 2 * sequence)
+			continue;
+
+		size_t numCells = static_cast<size_t>(m_header->numCells);
+		frame.step = header->step;
+		frame.time = header->time;
+		frame.publishTime = header->publishTime;
+		bool hasDensity = header->hasDensity != 0;
+		frame.velocity.resize(numCells * 4);
+		frame.pressure.resize(numCells);
+		frame.density.resize(hasDensity ? numCells : 0);
+		std::memcpy(frame.velocity.data(), slot + m_header->velocityOffset, numCells * 4 * sizeof(float));
+		std::memcpy(frame.pressure.data(), slot + m_header->pressureOffset, numCells * sizeof(float));
+		if (hasDensity)
+			std::memcpy(frame.density.data(), slot + m_header->densityOffset, numCells * sizeof(float));
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (header->sequence.load(std::memory_order_relaxed) != before)
+			continue;
+
+		if (m_last > 0 && sequence > m_last + 1)
+			m_numMissed += sequence - m_last - 1;
+		m_last = sequence;
+		frame.sequence = sequence;
+		frame.resolution = XMUINT3(m_header->resolution[0], m_header->resolution[1], m_header->resolution[2]);
+		frame.voxelSize = XMFLOAT3(m_header->voxelSize[0], m_header->voxelSize[1], m_header->voxelSize[2]);
+		return true;
+	}
+	return false;
+}
+
+bool FieldSubscriber::waitNext(Frame& frame, int timeout)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (int polls = 0;; ++polls)
+	{
+		if (readLatest(frame))
+			return true;
+		if (isClosed())
+			return false;
+
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		if (timeout >= 0 && elapsed >= timeout)
+			return false;
+
+		// Spin briefly for a low latency, then give the core to the simulation
+		if (polls < 1000)
+			std::this_thread::yield();
+		else
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
@@ -0,0 +1,152 @@
+#ifndef FIELD_PUBLISHING_H
+#define FIELD_PUBLISHING_H
+
+#include "stepListener.h"
+#include "sharedMemory.h"
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+// Live fields of a running simulation in shared memory, written by FieldPublisher and read by any number of FieldSubscribers in other processes
+//
+// Shared memory "<name>" (directory): FieldPublishing::Directory with the name of the current ring, which changes with the grid dimensions
+// Shared memory of a ring: FieldPublishing::RingHeader, followed by <numSlots> slots of <slotSize> bytes; a slot starts with a
+// FieldPublishing::SlotHeader, followed by the velocity (4 floats per cell, x fastest), pressure and density (one float per cell)
+//
+// The steps are numbered from 1 and step n goes to slot n % numSlots. The sequence of a slot is 2n - 1 while the publisher writes it and 2n
+// once it is complete, so readers check it before and after copying (seqlock) and never block the publisher; a reader, which is slower
+// than numSlots - 1 steps, finds its slot overwritten and retries with the latest step. The atomics are lock free on all supported platforms.
+namespace FieldPublishing
+{
+	static const char DIRECTORY_MAGIC[8] = "WSFDIR";
+	static const char RING_MAGIC[8] = "WSFRING";
+	static const uint32_t VERSION = 1;
+	static const size_t MAX_NAME = 64;
+
+	struct Directory
+	{
+		char magic[8];
+		uint32_t version;
+		std::atomic<uint32_t> generation; // Odd while the ring name is written, 0 before the first ring
+		std::atomic<uint32_t> closed; // The publisher stopped, a new one creates a new directory
+		char ring[MAX_NAME];
+	};
+
+	struct RingHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t numSlots;
+		uint32_t resolution[3];
+		float voxelSize[3];
+		uint64_t numCells;
+		uint64_t slotOffset;
+		uint64_t slotSize;
+		uint64_t velocityOffset; // Relative to the slot
+		uint64_t pressureOffset;
+		uint64_t densityOffset;
+		std::atomic<uint64_t> latest; // Number of the last complete step, 0 if none
+		std::atomic<uint32_t> closed; // The publisher left the ring, the directory names the next one
+	};
+
+	struct SlotHeader
+	{
+		std::atomic<uint64_t> sequence;
+		int32_t step; // Step count of the simulator
+		uint32_t hasDensity;
+		double time; // Simulated time in seconds
+		int64_t publishTime; // When the slot was complete: ns since the epoch of the system clock, comparable between processes
+	};
+
+	int64_t now(); // The clock of SlotHeader::publishTime
+}
+
+// Publishes the simulation steps into the shared memory ring of a name (see FieldPublishing), e.g. for analysis dashboards
+// Every <interval>-th step is copied directly into the next slot in the simulation thread, the publisher never waits for readers.
+// Opening it again with other grid dimensions keeps the name and switches the subscribers to a new ring.
+class FieldPublisher : public StepListener
+{
+public:
+	FieldPublisher();
+	~FieldPublisher();
+
+	bool open(const std::string& name, const DirectX::XMUINT3& resolution, const DirectX::XMFLOAT3& voxelSize, int numSlots, int interval);
+	void close();
+	bool isOpen() const { return m_header != nullptr; };
+
+	void stepPublished(const FieldFrame& frame) override;
+
+	const std::string& getName() const { return m_name; };
+	const std::string& errorString() const { return m_error; };
+
+	// Statistics
+	uint64_t getNumPublished() const { return m_numPublished; };
+	double getPublishTime() const { return m_publishTime; }; // msec in the simulation thread, summed over all steps
+
+private:
+	void closeRing();
+	bool fail(const std::string& msg);
+
+	std::string m_name;
+	SharedMemory m_directory;
+	SharedMemory m_ring;
+	FieldPublishing::RingHeader* m_header;
+	int m_interval;
+	uint64_t m_sequence;
+
+	std::atomic<uint64_t> m_numPublished;
+	double m_publishTime;
+	std::string m_error;
+};
+
+// Reads the steps of a FieldPublisher, usually in another process, and follows it to new rings; after the publisher stopped (isClosed) or
+// crashed, the name has to be attached again. Reading copies the fields and never blocks the publisher; every reader thread needs its own subscriber
+class FieldSubscriber
+{
+public:
+	struct Frame
+	{
+		Frame();
+		uint64_t sequence; // Number of the step in the ring
+		int step;
+		double time;
+		int64_t publishTime; // See FieldPublishing::SlotHeader
+		DirectX::XMUINT3 resolution;
+		DirectX::XMFLOAT3 voxelSize;
+		std::vector<float> velocity; // 4 floats per cell
+		std::vector<float> pressure;
+		std::vector<float> density; // Empty if the step has no density
+	};
+
+	FieldSubscriber();
+
+	bool attach(const std::string& name); // Fails if no publisher created the name
+	void detach();
+	bool isAttached() const { return m_directory.isOpen(); };
+	bool isClosed() const;
+
+	// Copies the latest step, if it is newer than the last one read; false if there is none, <frame> keeps its buffers
+	bool readLatest(Frame& frame);
+	// Polls for up to <timeout> ms (negative: forever) for a newer step; returns early, once the publisher stopped
+	bool waitNext(Frame& frame, int timeout);
+
+	uint64_t getNumMissed() const { return m_numMissed; }; // Steps published between two reads
+	const std::string& errorString() const { return m_error; };
+
+private:
+	bool openRing(); // Maps the current ring of the directory if it changed
+
+	SharedMemory m_directory;
+	SharedMemory m_ring;
+	uint32_t m_generation;
+	const FieldPublishing::RingHeader* m_header;
+	uint64_t m_last;
+	uint64_t m_numMissed;
+	std::string m_error;
+};
+
+#endif
@@ -0,0 +1,675 @@
+#include "fieldRecording.h"
+#include "parallel.h"
+
+#include <QElapsedTimer>
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+using namespace FieldRecording;
+
+namespace
+{
+	const char g_magic[8] = { 'W', 'S', 'F', 'R', 'A', 'M', 'E', 'S' };
+	const char g_frameMagic[4] = { 'W', 'S', 'F', 'R' };
+	const uint32_t g_version = 2;
+
+#pragma pack(push, 1)
+	struct FileHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t resolution[3];
+		float voxelSize[3];
+		uint32_t codec;
+		float errorBound;
+	};
+
+	struct FrameHeader
+	{
+		char magic[4];
+		int32_t step;
+		double time;
+		uint32_t channelSizes[NUM_CHANNELS];
+	};
+
+	struct IndexEntry
+	{
+		int32_t step;
+		double time;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	struct Footer
+	{
+		uint64_t indexOffset;
+		uint64_t numFrames;
+		char magic[8];
+	};
+#pragma pack(pop)
+
+	// First byte of a channel of the quantized codec
+	const uchar g_quantized = 0;
+	const uchar g_losslessFallback = 1; // A value was not finite or too large to quantize
+
+	inline uint64_t zigzag(int64_t v)
+	{
+		return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+	}
+
+	inline int64_t unzigzag(uint64_t v)
+	{
+		return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+	}
+
+	// Appends the byte planes of the differences of the bit patterns
+	void encodeLossless(const float* values, size_t count, std::vector<uchar>& buffer)
+	{
+		// Neighbouring cells have similar bit patterns, so the differences mostly have zero upper bytes
+		const size_t offset = buffer.size();
+		buffer.resize(offset + count * 4);
+		uchar* out = buffer.data() + offset;
+		uint32_t previous = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint32_t bits;
+			std::memcpy(&bits, values + i, 4);
+			uint32_t delta = bits - previous;
+			previous = bits;
+			for (int b = 0; b < 4; ++b)
+				out[b * count + i] = static_cast<uchar>(delta >> (8 * b));
+		}
+	}
+
+	// Appends the varints of the quantized differences; false if a value can not be quantized
+	bool encodeQuantized(const float* values, size_t count, float errorBound, std::vector<uchar>& buffer)
+	{
+		const double scale = 1.0 / (2.0 * errorBound);
+		const double limit = 4611686018427387904.0; // 2^62, keeps the differences within int64
+		int64_t previous = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			double q = std::floor(values[i] * scale + 0.5);
+			if (!(std::abs(q) < limit)) // Also NaN
+				return false;
+			int64_t quantized = static_cast<int64_t>(q);
+			uint64_t v = zigzag(quantized - previous);
+			previous = quantized;
+			while (v >= 0x80)
+			{
+				buffer.push_back(static_cast<uchar>(v | 0x80));
+				v >>= 7;
+			}
+			buffer.push_back(static_cast<uchar>(v));
+		}
+		return true;
+	}
+
+	bool decodeLossless(const uchar* in, size_t length, size_t count, float* values, size_t stride)
+	{
+		if (length != count * 4)
+			return false;
+
+		uint32_t previous = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint32_t delta = in[i] | (in[count + i] << 8) | (in[2 * count + i] << 16) | (static_cast<uint32_t>(in[3 * count + i]) << 24);
+			previous += delta;
+			std::memcpy(values + i * stride, &previous, 4);
+		}
+		return true;
+	}
+}
+
+// =============================================================================
+// CODEC
+// =============================================================================
+
+QByteArray FieldRecording::encode(const float* values, size_t count, Codec codec, float errorBound, int level)
+{
+	std::vector<uchar> buffer;
+
+	if (codec == Codec::Lossless)
+	{
+		encodeLossless(values, count, buffer);
+	}
+	else
+	{
+		buffer.reserve(count * 2 + 1);
+		buffer.push_back(g_quantized);
+		if (!encodeQuantized(values, count, errorBound, buffer))
+		{
+			buffer.assign(1, g_losslessFallback);
+			encodeLossless(values, count, buffer);
+		}
+	}
+
+	return qCompress(buffer.data(), static_cast<int>(buffer.size()), level);
+}
+
+bool FieldRecording::decode(const char* data, size_t size, size_t count, Codec codec, float errorBound, float* values, size_t stride)
+{
+	QByteArray buffer = qUncompress(reinterpret_cast<const uchar*>(data), static_cast<int>(size));
+	const uchar* in = reinterpret_cast<const uchar*>(buffer.constData());
+	const size_t length = buffer.size();
+
+	if (codec == Codec::Lossless)
+		return decodeLossless(in, length, count, values, stride);
+
+	if (length == 0)
+		return false;
+	if (in[0] == g_losslessFallback)
+		return decodeLossless(in + 1, length - 1, count, values, stride);
+	if (in[0] != g_quantized)
+		return false;
+
+	const double step = 2.0 * errorBound;
+	int64_t previous = 0;
+	size_t pos = 1;
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint64_t v = 0;
+		for (int shift = 0; ; shift += 7)
+		{
+			if (pos >= length || shift > 63)
+				return false;
+			uchar byte = in[pos++];
+			v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+				break;
+		}
+		previous += unzigzag(v);
+		values[i * stride] = static_cast<float>(previous * step);
+	}
+	return pos == length;
+}
+
+// =============================================================================
+// RECORDER
+// =============================================================================
+
+FieldRecorder::Options::Options()
+	: errorBound(0.0f),
+	interval(1),
+	queueFrames(3),
+	threads(2),
+	policy(Policy::Drop),
+	level(1)
+{
+}
+
+FieldRecorder::FieldRecorder()
+	: m_file(),
+	m_resolution(0, 0, 0),
+	m_options(),
+	m_frames(),
+	m_free(),
+	m_pending(),
+	m_completed(),
+	m_nextSequence(0),
+	m_nextWrite(0),
+	m_stopping(false),
+	m_mutex(),
+	m_freeCond(),
+	m_pendingCond(),
+	m_writeMutex(),
+	m_workers(),
+	m_index(),
+	m_numFrames(0),
+	m_numDropped(0),
+	m_rawBytes(0),
+	m_compressedBytes(0),
+	m_submitTime(0.0),
+	m_error()
+{
+}
+
+FieldRecorder::~FieldRecorder()
+{
+	if (m_file.isOpen())
+		close();
+}
+
+bool FieldRecorder::open(const QString& path, const XMUINT3& resolution, const XMFLOAT3& voxelSize, const Options& options)
+{
+	if (m_file.isOpen())
+		close();
+
+	m_error.clear();
+	m_file.setFileName(path);
+	if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		fail("Failed to open '" + path + "' for writing: " + m_file.errorString());
+		return false;
+	}
+
+	m_resolution = resolution;
+	m_options = options;
+	m_options.interval = std::max(m_options.interval, 1);
+	m_options.queueFrames = std::max(m_options.queueFrames, 1);
+	m_options.threads = std::max(m_options.threads, 1);
+
+	FileHeader header;
+	std::memcpy(header.magic, g_magic, sizeof(header.magic));
+	header.version = g_version;
+	header.resolution[0] = resolution.x;
+	header.resolution[1] = resolution.y;
+	header.resolution[2] = resolution.z;
+	header.voxelSize[0] = voxelSize.x;
+	header.voxelSize[1] = voxelSize.y;
+	header.voxelSize[2] = voxelSize.z;
+	header.codec = static_cast<uint32_t>(m_options.errorBound > 0.0f ? Codec::Quantized : Codec::Lossless);
+	header.errorBound = std::max(m_options.errorBound, 0.0f);
+	if (!write(&header, sizeof(header)))
+	{
+		m_file.close();
+		return false;
+	}
+
+	// All buffers are allocated up front, so recording does not allocate in the simulation thread
+	size_t cells = static_cast<size_t>(resolution.x) * resolution.y * resolution.z;
+	m_frames.clear();
+	m_free.clear();
+	for (int i = 0; i < m_options.queueFrames; ++i)
+	{
+		std::unique_ptr<Frame> frame(new Frame());
+		for (auto& channel : frame->channels)
+			channel.resize(cells);
+		m_free.push_back(frame.get());
+		m_frames.push_back(std::move(frame));
+	}
+
+	m_pending.clear();
+	m_completed.clear();
+	m_index.clear();
+	m_nextSequence = 0;
+	m_nextWrite = 0;
+	m_stopping = false;
+	m_numFrames = 0;
+	m_numDropped = 0;
+	m_rawBytes = 0;
+	m_compressedBytes = 0;
+	m_submitTime = 0.0;
+
+	for (int i = 0; i < m_options.threads; ++i)
+		m_workers.emplace_back(&FieldRecorder::work, this);
+
+	return true;
+}
+
+bool FieldRecorder::close()
+{
+	if (!m_file.isOpen())
+		return false;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_pendingCond.notify_all();
+	m_freeCond.notify_all();
+	for (auto& worker : m_workers)
+		worker.join();
+	m_workers.clear();
+
+	bool success = m_error.isEmpty();
+	Footer footer;
+	footer.indexOffset = m_file.pos();
+	footer.numFrames = m_index.size();
+	std::memcpy(footer.magic, g_magic, sizeof(footer.magic));
+	for (const auto& info : m_index)
+	{
+		IndexEntry entry;
+		entry.step = info.step;
+		entry.time = info.time;
+		entry.offset = info.offset;
+		entry.size = info.size;
+		success = success && write(&entry, sizeof(entry));
+	}
+	success = success && write(&footer, sizeof(footer));
+	m_file.close();
+
+	m_frames.clear();
+	m_free.clear();
+	return success;
+}
+
+bool FieldRecorder::submit(const FieldFrame& frame)
+{
+	if (!m_file.isOpen() || frame.step % m_options.interval != 0)
+		return false;
+
+	if (frame.resolution.x != m_resolution.x || frame.resolution.y != m_resolution.y || frame.resolution.z != m_resolution.z)
+	{
+		m_numDropped++;
+		return false;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+
+	Frame* buffer = nullptr;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_options.policy == Policy::Block)
+			m_freeCond.wait(lock, [this]() { return !m_free.empty() || m_stopping; });
+
+		if (m_free.empty() || m_stopping)
+		{
+			m_numDropped++;
+			return false;
+		}
+		buffer = m_free.back();
+		m_free.pop_back();
+	}
+
+	// The velocity is split into its components, which compress better than the interleaved vectors
+	buffer->step = frame.step;
+	buffer->time = frame.time;
+	const size_t sliceSize = static_cast<size_t>(m_resolution.x) * m_resolution.y;
+	Parallel::forRange(0, m_resolution.z, [&](int zBegin, int zEnd)
+	{
+		for (size_t i = zBegin * sliceSize; i < zEnd * sliceSize; ++i)
+		{
+			buffer->channels[0][i] = frame.velocity[4 * i];
+			buffer->channels[1][i] = frame.velocity[4 * i + 1];
+			buffer->channels[2][i] = frame.velocity[4 * i + 2];
+		}
+		std::copy(frame.pressure + zBegin * sliceSize, frame.pressure + zEnd * sliceSize, buffer->channels[3].begin() + zBegin * sliceSize);
+		if (frame.density)
+			std::copy(frame.density + zBegin * sliceSize, frame.density + zEnd * sliceSize, buffer->channels[4].begin() + zBegin * sliceSize);
+		else
+			std::fill(buffer->channels[4].begin() + zBegin * sliceSize, buffer->channels[4].begin() + zEnd * sliceSize, 0.0f);
+	});
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		buffer->sequence = m_nextSequence++;
+		m_pending.push_back(buffer);
+	}
+	m_pendingCond.notify_one();
+
+	m_submitTime += timer.nsecsElapsed() * 1e-6;
+	return true;
+}
+
+void FieldRecorder::work()
+{
+	const Codec codec = m_options.errorBound > 0.0f ? Codec::Quantized : Codec::Lossless;
+
+	for (;;)
+	{
+		Frame* frame = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_pendingCond.wait(lock, [this]() { return !m_pending.empty() || m_stopping; });
+			if (m_pending.empty())
+				return; // Stopping and all frames handed out
+			frame = m_pending.front();
+			m_pending.pop_front();
+		}
+
+		for (int c = 0; c < NUM_CHANNELS; ++c)
+			frame->compressed[c] = encode(frame->channels[c].data(), frame->channels[c].size(), codec, m_options.errorBound, m_options.level);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_completed[frame->sequence] = frame;
+		}
+		writeCompleted();
+	}
+}
+
+void FieldRecorder::writeCompleted()
+{
+	// Frames are compressed concurrently but written in order; whoever holds the write lock writes all frames, which are due
+	std::lock_guard<std::mutex> writeLock(m_writeMutex);
+	for (;;)
+	{
+		Frame* frame = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto it = m_completed.find(m_nextWrite);
+			if (it == m_completed.end())
+				return;
+			frame = it->second;
+			m_completed.erase(it);
+			m_nextWrite++;
+		}
+
+		FrameHeader header;
+		std::memcpy(header.magic, g_frameMagic, sizeof(header.magic));
+		header.step = frame->step;
+		header.time = frame->time;
+		uint64_t size = sizeof(header);
+		for (int c = 0; c < NUM_CHANNELS; ++c)
+		{
+			header.channelSizes[c] = static_cast<uint32_t>(frame->compressed[c].size());
+			size += frame->compressed[c].size();
+		}
+
+		FrameInfo info;
+		info.step = frame->step;
+		info.time = frame->time;
+		info.offset = m_file.pos();
+		info.size = size;
+
+		bool success = m_error.isEmpty() && write(&header, sizeof(header));
+		for (int c = 0; c < NUM_CHANNELS && success; ++c)
+			success = write(frame->compressed[c].constData(), frame->compressed[c].size());
+		if (success)
+		{
+			m_index.push_back(info);
+			m_numFrames++;
+			m_rawBytes += NUM_CHANNELS * frame->channels[0].size() * sizeof(float);
+			m_compressedBytes += size;
+		}
+
+		for (auto& compressed : frame->compressed)
+			compressed.clear();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_free.push_back(frame);
+		}
+		m_freeCond.notify_one();
+	}
+}
+
+bool FieldRecorder::write(const void* data, size_t size)
+{
+	if (m_file.write(static_cast<const char*>(data), size) != static_cast<qint64>(size))
+	{
+		fail("Failed to write to '" + m_file.fileName() + "': " + m_file.errorString());
+		return false;
+	}
+	return true;
+}
+
+void FieldRecorder::fail(const QString& msg)
+{
+	if (m_error.isEmpty())
+		m_error = msg;
+}
+
+// =============================================================================
+// READER
+// =============================================================================
+
+FieldRecordingReader::FieldRecordingReader()
+	: m_file(),
+	m_data(nullptr),
+	m_size(0),
+	m_resolution(0, 0, 0),
+	m_voxelSize(0.0f, 0.0f, 0.0f),
+	m_codec(Codec::Lossless),
+	m_errorBound(0.0f),
+	m_index(),
+	m_error()
+{
+}
+
+FieldRecordingReader::~FieldRecordingReader()
+{
+	close();
+}
+
+bool FieldRecordingReader::open(const QString& path)
+{
+	close();
+
+	m_file.setFileName(path);
+	if (!m_file.open(QIODevice::ReadOnly))
+		return fail("Failed to open '" + path + "': " + m_file.errorString());
+
+	m_size = m_file.size();
+	if (m_size < sizeof(FileHeader))
+		return fail("'" + path + "' is not a recording (too small).");
+
+	m_data = m_file.map(0, m_size);
+	if (!m_data)
+		return fail("Failed to map '" + path + "': " + m_file.errorString());
+
+	FileHeader header;
+	std::memcpy(&header, m_data, sizeof(header));
+	if (std::memcmp(header.magic, g_magic, sizeof(header.magic)) != 0)
+		return fail("'" + path + "' is not a recording.");
+	if (header.version != g_version)
+		return fail("Unsupported version " + QString::number(header.version) + " of recording '" + path + "'.");
+	if (header.codec != static_cast<uint32_t>(Codec::Lossless) && header.codec != static_cast<uint32_t>(Codec::Quantized))
+		return fail("Unknown codec of recording '" + path + "'.");
+
+	m_resolution = XMUINT3(header.resolution[0], header.resolution[1], header.resolution[2]);
+	m_voxelSize = XMFLOAT3(header.voxelSize[0], header.voxelSize[1], header.voxelSize[2]);
+	m_codec = Codec(header.codec);
+	m_errorBound = header.errorBound;
+
+	Footer footer;
+	bool indexed = false;
+	if (m_size >= sizeof(FileHeader) + sizeof(Footer))
+	{
+		std::memcpy(&footer, m_data + m_size - sizeof(footer), sizeof(footer));
+		indexed = std::memcmp(footer.magic, g_magic, sizeof(footer.magic)) == 0
+			&& footer.indexOffset + footer.numFrames * sizeof(IndexEntry) + sizeof(Footer) == m_size;
+	}
+
+	if (indexed)
+	{
+		m_index.resize(footer.numFrames);
+		for (uint64_t i = 0; i < footer.numFrames; ++i)
+		{
+			IndexEntry entry;
+			std::memcpy(&entry, m_data + footer.indexOffset + i * sizeof(entry), sizeof(entry));
+			if (entry.offset + entry.size > footer.indexOffset || entry.size < sizeof(FrameHeader))
+				return fail("Corrupt index in recording '" + path + "'.");
+			m_index[i].step = entry.step;
+			m_index[i].time = entry.time;
+			m_index[i].offset = entry.offset;
+			m_index[i].size = entry.size;
+		}
+	}
+	else
+	{
+		// Follow the frame headers up to the first incomplete frame
+		uint64_t offset = sizeof(FileHeader);
+		while (offset + sizeof(FrameHeader) <= m_size)
+		{
+			FrameHeader frame;
+			std::memcpy(&frame, m_data + offset, sizeof(frame));
+			if (std::memcmp(frame.magic, g_frameMagic, sizeof(frame.magic)) != 0)
+				break;
+
+			uint64_t size = sizeof(frame);
+			for (uint32_t channelSize : frame.channelSizes)
+				size += channelSize;
+			if (offset + size > m_size)
+				break;
+
+			FrameInfo info;
+			info.step = frame.step;
+			info.time = frame.time;
+			info.offset = offset;
+			info.size = size;
+			m_index.push_back(info);
+			offset += size;
+		}
+	}
+
+	if (m_index.empty())
+		return fail("The recording '" + path + "' contains no frames.");
+
+	return true;
+}
+
+void FieldRecordingReader::close()
+{
+	if (m_data)
+		m_file.unmap(const_cast<uchar*>(m_data));
+	m_data = nullptr;
+	m_size = 0;
+	m_file.close();
+	m_index.clear();
+}
+
+int FieldRecordingReader::findFrame(double time) const
+{
+	auto it = std::upper_bound(m_index.begin(), m_index.end(), time, [](double t, const FrameInfo& info) { return t < info.time; });
+	return it == m_index.begin() ? 0 : static_cast<int>(it - m_index.begin()) - 1;
+}
+
+bool FieldRecordingReader::readFrame(int frame, Fields& fields, int threads) const
+{
+	if (!m_data || frame < 0 || frame >= getNumFrames())
+		return false;
+
+	const FrameInfo& info = m_index[frame];
+	FrameHeader header;
+	std::memcpy(&header, m_data + info.offset, sizeof(header));
+	if (std::memcmp(header.magic, g_frameMagic, sizeof(header.magic)) != 0)
+		return false;
+
+	const size_t cells = static_cast<size_t>(m_resolution.x) * m_resolution.y * m_resolution.z;
+	fields.step = info.step;
+	fields.time = info.time;
+	fields.velocity.resize(cells * 4);
+	fields.pressure.resize(cells);
+	fields.density.resize(cells);
+
+	const char* data[NUM_CHANNELS];
+	const char* next = reinterpret_cast<const char*>(m_data + info.offset + sizeof(header));
+	for (int c = 0; c < NUM_CHANNELS; ++c)
+	{
+		data[c] = next;
+		next += header.channelSizes[c];
+	}
+	if (next > reinterpret_cast<const char*>(m_data + info.offset + info.size))
+		return false;
+
+	// The channels are independent, so they are decoded concurrently; the velocity components go directly into their slots
+	std::atomic<bool> success(true);
+	Parallel::forRange(0, NUM_CHANNELS, [&](int first, int last)
+	{
+		for (int c = first; c < last; ++c)
+		{
+			float* values = c < 3 ? fields.velocity.data() + c : (c == 3 ? fields.pressure.data() : fields.density.data());
+			if (!decode(data[c], header.channelSizes[c], cells, m_codec, m_errorBound, values, c < 3 ? 4 : 1))
+				success = false;
+		}
+	}, threads);
+
+	// Padding of the velocity
+	for (size_t i = 0; i < cells; ++i)
+		fields.velocity[4 * i + 3] = 0.0f;
+
+	return success;
+}
+
+bool FieldRecordingReader::fail(const QString& msg)
+{
+	m_error = msg;
+	close();
+	return false;
+}
@@ -0,0 +1,187 @@
+#ifndef FIELD_RECORDING_H
+#define FIELD_RECORDING_H
+
+#include "stepListener.h"
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+
+// Time series of velocity, pressure and density, compressed frame by frame
+//
+// File layout (little endian):
+// - Header: magic "WSFRAMES", version, resolution (3 x uint32), voxel size (3 x float), codec, error bound
+// - Frames: frame header (magic "WSFR", step, time, compressed size of each channel) followed by the compressed channels
+//   velocity x, y, z, pressure and density; each channel is the qCompress'ed (zlib) output of the codec stage
+// - Index: one entry per frame (step, time, file offset, size), followed by the footer (index offset, number of frames, magic)
+// A file without index (e.g. after a crash) can still be read sequentially along the frame headers
+//
+// Codecs (applied to each channel, x fastest):
+// - Lossless: difference of the float bit patterns to the previous cell, split into 4 byte planes
+// - Quantized: round(v / (2 * errorBound)) as 64 bit integer, so the reconstruction differs by at most errorBound (up to float rounding); the
+//   difference to the previous cell is zigzag encoded as variable length integer, which leaves mostly single bytes for the entropy coder. A leading
+//   byte says if the channel is quantized (0) or, if a value is not finite or at least 2^62 steps large, encoded as by the lossless codec (1)
+namespace FieldRecording
+{
+	static const int NUM_CHANNELS = 5;
+	static const char* const CHANNEL_NAMES[NUM_CHANNELS] = { "velocityX", "velocityY", "velocityZ", "pressure", "density" };
+
+	enum class Codec : uint32_t { Lossless = 0, Quantized = 1 };
+
+	// Index entry of a recorded frame
+	struct FrameInfo
+	{
+		int step;
+		double time; // Simulated time in seconds
+		uint64_t offset; // File offset of the frame header
+		uint64_t size; // Including the frame header
+	};
+
+	// Decoded fields of a frame in the layout of the simulator output
+	struct Fields
+	{
+		int step;
+		double time;
+		std::vector<float> velocity; // 4 floats per cell (xyz, padding)
+		std::vector<float> pressure;
+		std::vector<float> density;
+	};
+
+	// Encode/decode one channel of <count> values; decode writes every <stride>-th float, so channels can be interleaved
+	QByteArray encode(const float* values, size_t count, Codec codec, float errorBound, int level);
+	bool decode(const char* data, size_t size, size_t count, Codec codec, float errorBound, float* values, size_t stride = 1);
+}
+
+// Subscribes to the simulation steps and records them in the background
+// Published fields are copied into one of <queueFrames> preallocated buffers and compressed by <threads> worker threads;
+// the compressed frames are written in step order. When all buffers are in flight, the policy decides whether the
+// solver waits (Block) or the step is not recorded (Drop)
+class FieldRecorder : public StepListener
+{
+public:
+	enum class Policy { Block, Drop };
+
+	struct Options
+	{
+		Options();
+		float errorBound; // Maximum absolute error of the quantization; 0 records lossless
+		int interval; // Record every n-th step
+		int queueFrames; // Number of frame buffers (each holds 5 floats per cell)
+		int threads; // Compression threads
+		Policy policy;
+		int level; // zlib compression level
+	};
+
+	FieldRecorder();
+	~FieldRecorder();
+
+	bool open(const QString& path, const DirectX::XMUINT3& resolution, const DirectX::XMFLOAT3& voxelSize, const Options& options);
+	bool close(); // Waits for the queued frames and writes the index; the file is incomplete without
+	bool isOpen() const { return m_file.isOpen(); };
+
+	void stepPublished(const FieldFrame& frame) override { submit(frame); };
+	bool submit(const FieldFrame& frame); // False if the frame was dropped or not due
+
+	const QString& errorString() const { return m_error; };
+
+	// Statistics
+	uint64_t getNumFrames() const { return m_numFrames; };
+	uint64_t getNumDropped() const { return m_numDropped; };
+	uint64_t getRawBytes() const { return m_rawBytes; };
+	uint64_t getCompressedBytes() const { return m_compressedBytes; };
+	double getSubmitTime() const { return m_submitTime; }; // msec in the simulation thread, summed over all frames
+
+private:
+	struct Frame
+	{
+		int step;
+		double time;
+		uint64_t sequence;
+		std::vector<float> channels[FieldRecording::NUM_CHANNELS];
+		QByteArray compressed[FieldRecording::NUM_CHANNELS];
+	};
+
+	void work();
+	void writeCompleted();
+	bool write(const void* data, size_t size);
+	void fail(const QString& msg);
+
+	QFile m_file;
+	DirectX::XMUINT3 m_resolution;
+	Options m_options;
+
+	std::vector<std::unique_ptr<Frame>> m_frames;
+	std::vector<Frame*> m_free;
+	std::deque<Frame*> m_pending;
+	std::map<uint64_t, Frame*> m_completed;
+	uint64_t m_nextSequence;
+	uint64_t m_nextWrite;
+	bool m_stopping;
+
+	std::mutex m_mutex; // Guards the queues
+	std::condition_variable m_freeCond;
+	std::condition_variable m_pendingCond;
+	std::mutex m_writeMutex; // Guards the file and the index
+	std::vector<std::thread> m_workers;
+
+	std::vector<FieldRecording::FrameInfo> m_index;
+	std::atomic<uint64_t> m_numFrames;
+	std::atomic<uint64_t> m_numDropped;
+	std::atomic<uint64_t> m_rawBytes;
+	std::atomic<uint64_t> m_compressedBytes;
+	double m_submitTime;
+	QString m_error;
+};
+
+// Reads files written by FieldRecorder; the file is memory mapped, so only the decoded frames are loaded from disk
+// Recordings without index (the recorder was not closed) are indexed along the frame headers
+class FieldRecordingReader
+{
+public:
+	FieldRecordingReader();
+	~FieldRecordingReader();
+
+	bool open(const QString& path);
+	void close();
+	bool isOpen() const { return m_data != nullptr; };
+
+	DirectX::XMUINT3 getResolution() const { return m_resolution; };
+	DirectX::XMFLOAT3 getVoxelSize() const { return m_voxelSize; };
+	int getNumFrames() const { return static_cast<int>(m_index.size()); };
+	const FieldRecording::FrameInfo& getFrameInfo(int frame) const { return m_index[frame]; };
+	int findFrame(double time) const; // Last frame at or before <time>, the first frame if <time> is before
+
+	// Decode the channels of a frame with up to <threads> threads; thread safe
+	bool readFrame(int frame, FieldRecording::Fields& fields, int threads = 0) const;
+
+	const QString& errorString() const { return m_error; };
+
+private:
+	bool fail(const QString& msg);
+
+	QFile m_file;
+	const uchar* m_data;
+	uint64_t m_size;
+
+	DirectX::XMUINT3 m_resolution;
+	DirectX::XMFLOAT3 m_voxelSize;
+	FieldRecording::Codec m_codec;
+	float m_errorBound;
+	std::vector<FieldRecording::FrameInfo> m_index;
+
+	QString m_error;
+};
+
+#endif
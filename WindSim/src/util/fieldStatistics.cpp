@@ -0,0 +1,189 @@
+#include "fieldStatistics.h"
+#include "parallel.h"
+
+#include <emmintrin.h>
+
+#include <mutex>
+#include <limits>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+	const int GRAIN = 1 << 17; // Values per chunk of work
+	const size_t BLOCK = 1024; // Values summed in float before the sum is added in double
+	const int BIN_SHIFT = 20; // 23 mantissa bits - 3 bits kept per power of two
+
+	inline uint32_t bits(float value)
+	{
+		uint32_t b;
+		std::memcpy(&b, &value, sizeof(b));
+		return b;
+	}
+
+	inline __m128 select(__m128 mask, __m128 a, __m128 b) // mask ? a : b
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	inline float fromBits(uint32_t b)
+	{
+		float value;
+		std::memcpy(&value, &b, sizeof(value));
+		return value;
+	}
+}
+
+FieldStatistics::Result::Result()
+	: min(0.0f),
+	max(0.0f),
+	mean(0.0),
+	count(0),
+	histogram()
+{
+}
+
+float FieldStatistics::Result::percentile(double fraction) const
+{
+	if (count == 0)
+		return 0.0f;
+
+	double target = std::max(0.0, std::min(1.0, fraction)) * count;
+	double below = 0.0;
+
+	// Ascending values: negative bins from the largest magnitude down, then positive bins up
+	for (int i = 0; i < NUM_BINS; ++i)
+	{
+		bool negative = i < BINS_PER_SIGN;
+		int bin = negative ? BINS_PER_SIGN - 1 - i : i - BINS_PER_SIGN;
+		uint32_t n = histogram[negative ? BINS_PER_SIGN + bin : bin];
+		if (n == 0 || below + n < target)
+		{
+			below += n;
+			continue;
+		}
+
+		float lower = negative ? -binUpper(bin) : binLower(bin);
+		float upper = negative ? -binLower(bin) : binUpper(bin);
+		float t = static_cast<float>((target - below) / n);
+		return std::max(min, std::min(max, lower + t * (upper - lower)));
+	}
+	return max;
+}
+
+FieldStatistics::Result FieldStatistics::compute(const float* values, size_t count, int threads)
+{
+	Result result;
+	result.min = std::numeric_limits<float>::max();
+	result.max = -std::numeric_limits<float>::max();
+	result.histogram.assign(NUM_BINS, 0);
+
+	std::mutex mutex;
+	double sum = 0.0;
+	const int numChunks = static_cast<int>((count + GRAIN - 1) / GRAIN);
+
+	Parallel::forRange(0, numChunks, [&](int begin, int end)
+	{
+		// 4 histograms, one per SSE lane, so consecutive values in the same bin do not wait for each other
+		std::vector<uint32_t> histograms(4 * NUM_BINS, 0);
+		const __m128i exponentMask = _mm_set1_epi32(0x7f800000);
+		const __m128i absMask = _mm_set1_epi32(0x7fffffff);
+		const __m128i lane = _mm_setr_epi32(0, NUM_BINS, 2 * NUM_BINS, 3 * NUM_BINS);
+		__m128 min = _mm_set1_ps(std::numeric_limits<float>::max());
+		__m128 max = _mm_set1_ps(-std::numeric_limits<float>::max());
+		__m128i finite = _mm_setzero_si128();
+		double chunkSum = 0.0;
+
+		const size_t first = static_cast<size_t>(begin) * GRAIN;
+		const size_t last = std::min(count, static_cast<size_t>(end) * GRAIN);
+		size_t i = first;
+		while (i + 4 <= last)
+		{
+			// Partial sums in float over a short block only
+			__m128 blockSum = _mm_setzero_ps();
+			const size_t blockEnd = std::min(i + BLOCK, last - (last - i) % 4);
+			for (; i < blockEnd; i += 4)
+			{
+				__m128 v = _mm_loadu_ps(values + i);
+				__m128i b = _mm_castps_si128(v);
+				__m128i valid = _mm_xor_si128(_mm_cmpeq_epi32(_mm_and_si128(b, exponentMask), exponentMask), _mm_set1_epi32(-1)); // Not infinity or NaN
+				__m128 validMask = _mm_castsi128_ps(valid);
+
+				min = _mm_min_ps(min, select(validMask, v, _mm_set1_ps(std::numeric_limits<float>::max())));
+				max = _mm_max_ps(max, select(validMask, v, _mm_set1_ps(-std::numeric_limits<float>::max())));
+				blockSum = _mm_add_ps(blockSum, _mm_and_ps(validMask, v));
+				finite = _mm_sub_epi32(finite, valid);
+
+				// Bin of the magnitude, plus BINS_PER_SIGN for negative values; skipped values go to the unused bins of infinity
+				__m128i bin = _mm_add_epi32(_mm_srli_epi32(_mm_and_si128(b, absMask), BIN_SHIFT), _mm_and_si128(_mm_srai_epi32(b, 31), _mm_set1_epi32(BINS_PER_SIGN)));
+				bin = _mm_add_epi32(bin, lane);
+				int index[4];
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(index), bin);
+				histograms[index[0]]++;
+				histograms[index[1]]++;
+				histograms[index[2]]++;
+				histograms[index[3]]++;
+			}
+			float partial[4];
+			_mm_storeu_ps(partial, blockSum);
+			chunkSum += (static_cast<double>(partial[0]) + partial[1]) + (static_cast<double>(partial[2]) + partial[3]);
+		}
+
+		float mins[4];
+		float maxs[4];
+		int counts[4];
+		_mm_storeu_ps(mins, min);
+		_mm_storeu_ps(maxs, max);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(counts), finite);
+		float chunkMin = std::min(std::min(mins[0], mins[1]), std::min(mins[2], mins[3]));
+		float chunkMax = std::max(std::max(maxs[0], maxs[1]), std::max(maxs[2], maxs[3]));
+		uint64_t chunkCount = static_cast<uint64_t>(counts[0]) + counts[1] + counts[2] + counts[3];
+
+		// Remaining values of the chunk
+		for (; i < last; ++i)
+		{
+			float value = values[i];
+			uint32_t b = bits(value);
+			if ((b & 0x7f800000u) == 0x7f800000u)
+				continue;
+
+			histograms[((b >> 31) * BINS_PER_SIGN) + ((b & 0x7fffffffu) >> BIN_SHIFT)]++;
+			chunkMin = std::min(chunkMin, value);
+			chunkMax = std::max(chunkMax, value);
+			chunkSum += value;
+			chunkCount++;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		for (int bin = 0; bin < NUM_BINS; ++bin)
+			result.histogram[bin] += histograms[bin] + histograms[NUM_BINS + bin] + histograms[2 * NUM_BINS + bin] + histograms[3 * NUM_BINS + bin];
+		result.min = std::min(result.min, chunkMin);
+		result.max = std::max(result.max, chunkMax);
+		sum += chunkSum;
+		result.count += chunkCount;
+	}, threads);
+
+	if (result.count == 0)
+		return Result();
+
+	// The skipped values were counted in the bins of infinity
+	for (int sign = 0; sign < 2; ++sign)
+	{
+		for (int bin = BINS_PER_SIGN - 8; bin < BINS_PER_SIGN; ++bin)
+			result.histogram[sign * BINS_PER_SIGN + bin] = 0;
+	}
+
+	result.mean = sum / result.count;
+	return result;
+}
+
+float FieldStatistics::binLower(int bin)
+{
+	return fromBits(static_cast<uint32_t>(bin) << BIN_SHIFT);
+}
+
+float FieldStatistics::binUpper(int bin)
+{
+	// The last bins hold the largest finite floats
+	return bin + 1 < BINS_PER_SIGN - 8 ? fromBits(static_cast<uint32_t>(bin + 1) << BIN_SHIFT) : std::numeric_limits<float>::max();
+}
@@ -0,0 +1,38 @@
+#ifndef FIELD_STATISTICS_H
+#define FIELD_STATISTICS_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Statistics of a scalar field in one multi-threaded pass: range, mean and a logarithmic histogram
+// The histogram bins are taken directly from the bits of the floats (exponent and the upper 3 bits of the mantissa), so no range has to be
+// known in advance: every power of two is split into 8 bins, separately for positive and negative values. Values, which are not finite, are skipped
+class FieldStatistics
+{
+public:
+	static const int BINS_PER_SIGN = 2048;
+	static const int NUM_BINS = 2 * BINS_PER_SIGN; // Positive values first
+
+	struct Result
+	{
+		Result();
+		float min;
+		float max;
+		double mean;
+		uint64_t count; // Finite values
+		std::vector<uint32_t> histogram; // Empty if count is 0
+
+		// Value, below which <fraction> of the values lie; interpolated linearly within a bin (relative error below 9%)
+		float percentile(double fraction) const;
+	};
+
+	// Runs over chunks of 128K values; the values of a chunk are processed per SSE vector
+	static Result compute(const float* values, size_t count, int threads = 0);
+
+	// Range of the magnitudes in a bin of one sign
+	static float binLower(int bin);
+	static float binUpper(int bin);
+};
+
+#endif
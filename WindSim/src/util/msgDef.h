@@ -2,11 +2,110 @@
 #define MSG_DEF_H
 
 #include <string>
+#include <cstdint>
 
 // Messages received from the simulation process
-enum class MsgFromSimProc { Initialized, FinishedVoxelGridAccess, FinishedVelocityAccess, ClosedShm };
+enum class MsgFromSimProc { Initialized, FinishedVoxelGridAccess, FinishedVelocityAccess, ClosedShm, OpenedShm, Error };
 
-enum class MsgToSimProc { InitSim, UpdateDimensions, UpdateGrid, FillVelocity, CloseShm, Exit };
+enum class MsgToSimProc { InitSim, UpdateDimensions, UpdateGrid, FillVelocity, CloseShm, Exit, OpenShm, Reset, SmokeSettings, LineSettings };
+
+// Protocol of the simulation host process (see RemoteBackend and SimHost) over a Transport, whose endpoint name is the only argument of the host
+// The message types are MsgToSimProc and MsgFromSimProc; the host answers the requests in order:
+//   InitSim (SimProcInit, settings file)   -> Initialized (solver name)
+//   UpdateDimensions (SimProcDimensions)   -> Initialized (SimProcDimensions with the line buffer size of the solver)
+//   OpenShm (name)                         -> OpenedShm, maps the shared memory (SimShmHeader) created by the GUI process
+//   UpdateGrid                             -> FinishedVoxelGridAccess, after the cell types were read from the shared memory
+//   FillVelocity (SimProcFill)             -> FinishedVelocityAccess (SimProcFilled, solver stats), after one step was written to the slot
+//   CloseShm                               -> ClosedShm, after the shared memory was unmapped
+//   Reset, SmokeSettings and LineSettings (the SolverBackend structs) and Exit are not answered
+// Every request may be answered with Error (message) instead, the host stays usable
+struct SimProcInit
+{
+	uint32_t solver; // SolverType
+	int32_t threads;
+	int32_t clPlatform;
+	int32_t clDevice;
+};
+
+struct SimProcDimensions
+{
+	uint32_t resolution[3];
+	float voxelSize[3];
+	int32_t lineBufferSize;
+};
+
+struct SimProcFill
+{
+	uint32_t slot;
+	uint32_t density; // Write the density fields as well
+	uint32_t lines;
+};
+
+struct SimProcFilled
+{
+	uint32_t slot;
+	float timeStep;
+};
+
+// Shared memory of a simulation host: header, cell types and <numSlots> result slots, every section starts at a cache line
+// A slot belongs to the host from the FillVelocity request until its answer, afterwards to the GUI process until it requests the slot again
+static const char SIM_SHM_MAGIC[8] = "WSSHM";
+static const uint32_t SIM_SHM_VERSION = 1;
+
+struct SimShmHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t numSlots;
+	uint64_t numCells;
+	uint64_t lineBufferSize;
+	uint64_t cellTypesOffset; // One byte per cell
+	uint64_t slotOffset;
+	uint64_t slotSize;
+
+	// Sections of a slot, relative to its start
+	uint64_t velocityOffset; // 4 floats per cell
+	uint64_t pressureOffset;
+	uint64_t densityOffset;
+	uint64_t densitySumOffset;
+	uint64_t linesOffset;
+};
+
+struct SimShmSlot
+{
+	uint32_t density; // The density fields were written
+	uint32_t lines;
+	int32_t reseedCounter;
+	int32_t numLines;
+};
+
+inline SimShmHeader simShmLayout(uint64_t numCells, uint64_t lineBufferSize, uint32_t numSlots)
+{
+	auto align = [](uint64_t offset) { return (offset + 63) & ~static_cast<uint64_t>(63); };
+
+	SimShmHeader header = {};
+	for (int i = 0; i < 8; ++i)
+		header.magic[i] = SIM_SHM_MAGIC[i];
+	header.version = SIM_SHM_VERSION;
+	header.numSlots = numSlots;
+	header.numCells = numCells;
+	header.lineBufferSize = lineBufferSize;
+	header.cellTypesOffset = align(sizeof(SimShmHeader));
+	header.slotOffset = align(header.cellTypesOffset + numCells);
+
+	header.velocityOffset = align(sizeof(SimShmSlot));
+	header.pressureOffset = align(header.velocityOffset + numCells * 4 * sizeof(float));
+	header.densityOffset = align(header.pressureOffset + numCells * sizeof(float));
+	header.densitySumOffset = align(header.densityOffset + numCells * sizeof(float));
+	header.linesOffset = align(header.densitySumOffset + numCells * sizeof(float));
+	header.slotSize = align(header.linesOffset + lineBufferSize);
+	return header;
+}
+
+inline uint64_t simShmSize(const SimShmHeader& header)
+{
+	return header.slotOffset + header.numSlots * header.slotSize;
+}
 
 
 // Messages, posted to the simulator thread and process
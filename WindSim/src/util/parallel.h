@@ -0,0 +1,80 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+
+namespace Parallel
+{
+	// Returns the number of worker threads to use for a requested thread count
+	// 0 (or less) means: use all hardware threads
+	static inline unsigned int numThreads(int requested = 0)
+	{
+		if (requested > 0)
+			return static_cast<unsigned int>(requested);
+
+		unsigned int hw = std::thread::hardware_concurrency();
+		return hw > 0 ? hw : 1;
+	}
+
+	// Splits [begin, end) into chunks of <grain> elements, which are processed by <threads> worker threads
+	// func(first, last) is called for each chunk [first, last); chunks are handed out dynamically, so uneven work is balanced
+	// The calling thread works on chunks as well; exceptions thrown by func are rethrown in the calling thread
+	template <typename Function>
+	void forRange(int begin, int end, Function func, int threads = 0, int grain = 1)
+	{
+		if (end <= begin)
+			return;
+
+		grain = std::max(grain, 1);
+		int numChunks = (end - begin + grain - 1) / grain;
+		int numWorkers = static_cast<int>(std::min(numThreads(threads), static_cast<unsigned int>(numChunks)));
+
+		if (numWorkers <= 1)
+		{
+			func(begin, end);
+			return;
+		}
+
+		std::atomic<int> nextChunk(0);
+		std::vector<std::exception_ptr> errors(numWorkers);
+
+		auto worker = [&](int id)
+		{
+			try
+			{
+				for (int chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++)
+				{
+					int first = begin + chunk * grain;
+					func(first, std::min(first + grain, end));
+				}
+			}
+			catch (...)
+			{
+				errors[id] = std::current_exception();
+				nextChunk = numChunks; // Stop handing out further chunks
+			}
+		};
+
+		std::vector<std::thread> pool;
+		pool.reserve(numWorkers - 1);
+		for (int i = 1; i < numWorkers; ++i)
+			pool.emplace_back(worker, i);
+
+		worker(0);
+
+		for (auto& t : pool)
+			t.join();
+
+		for (const auto& e : errors)
+		{
+			if (e)
+				std::rethrow_exception(e);
+		}
+	}
+}
+
+#endif
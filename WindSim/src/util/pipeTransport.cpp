@@ -0,0 +1,204 @@
+#ifdef _WIN32
+
+#include "pipeTransport.h"
+
+#include <thread>
+#include <algorithm>
+
+namespace
+{
+	const DWORD g_pipeBufferSize = 1 << 16;
+	const size_t g_maxWrite = 1 << 30; // WriteFile and ReadFile take DWORD sizes
+
+	std::string lastError()
+	{
+		return std::to_string(GetLastError());
+	}
+
+	std::string pipeName(const std::string& name)
+	{
+		return "\\\\.\\pipe\\" + name;
+	}
+}
+
+NamedPipeTransport::NamedPipeTransport()
+	: Transport(),
+	m_pipe(NULL),
+	m_connected(false),
+	m_listening(false),
+	m_read(),
+	m_write()
+{
+	ZeroMemory(&m_read, sizeof(OVERLAPPED));
+	ZeroMemory(&m_write, sizeof(OVERLAPPED));
+}
+
+NamedPipeTransport::~NamedPipeTransport()
+{
+	close();
+}
+
+bool NamedPipeTransport::open(HANDLE pipe)
+{
+	m_pipe = pipe;
+	m_read.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	m_write.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (m_read.hEvent == NULL || m_write.hEvent == NULL)
+	{
+		std::string error = lastError();
+		close();
+		return fail("Could not create the events of the pipe: " + error);
+	}
+	return true;
+}
+
+bool NamedPipeTransport::listen(const std::string& name)
+{
+	close();
+
+	HANDLE pipe = CreateNamedPipeA(pipeName(name).c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+		PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, 1, g_pipeBufferSize, g_pipeBufferSize, 0, NULL);
+	if (pipe == INVALID_HANDLE_VALUE)
+		return fail("Could not create the pipe '" + pipeName(name) + "': " + lastError());
+
+	m_listening = true;
+	return open(pipe);
+}
+
+bool NamedPipeTransport::accept(int timeout)
+{
+	if (!m_listening)
+		return fail("Not listening.");
+
+	// The read event is free until the connection exists
+	ResetEvent(m_read.hEvent);
+	if (!ConnectNamedPipe(m_pipe, &m_read))
+	{
+		DWORD error = GetLastError();
+		if (error == ERROR_IO_PENDING)
+		{
+			if (WaitForSingleObject(m_read.hEvent, timeout < 0 ? INFINITE : static_cast<DWORD>(timeout)) != WAIT_OBJECT_0)
+			{
+				// Keep listening, a later accept() starts a new wait
+				CancelIoEx(m_pipe, &m_read);
+				DWORD transferred;
+				if (!GetOverlappedResult(m_pipe, &m_read, &transferred, TRUE))
+					return fail("No connection within " + std::to_string(timeout) + " ms.");
+			}
+		}
+		else if (error != ERROR_PIPE_CONNECTED)
+		{
+			return fail("Could not wait for a connection: " + std::to_string(error));
+		}
+	}
+
+	resetBuffers();
+	m_listening = false;
+	m_connected = true;
+	return true;
+}
+
+bool NamedPipeTransport::connect(const std::string& name, int timeout)
+{
+	close();
+
+	// The server may not have created the pipe yet
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout, 0));
+	for (;;)
+	{
+		HANDLE pipe = CreateFileA(pipeName(name).c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+		if (pipe != INVALID_HANDLE_VALUE)
+		{
+			if (!open(pipe))
+				return false;
+			resetBuffers();
+			m_connected = true;
+			return true;
+		}
+
+		DWORD error = GetLastError();
+		if ((error != ERROR_FILE_NOT_FOUND && error != ERROR_PIPE_BUSY) || (timeout >= 0 && std::chrono::steady_clock::now() >= deadline))
+			return fail("Could not connect to '" + pipeName(name) + "': " + std::to_string(error));
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+}
+
+void NamedPipeTransport::close()
+{
+	if (m_pipe != NULL)
+	{
+		CancelIoEx(m_pipe, NULL);
+		CloseHandle(m_pipe);
+	}
+	if (m_read.hEvent != NULL)
+		CloseHandle(m_read.hEvent);
+	if (m_write.hEvent != NULL)
+		CloseHandle(m_write.hEvent);
+
+	m_pipe = NULL;
+	m_connected = m_listening = false;
+	ZeroMemory(&m_read, sizeof(OVERLAPPED));
+	ZeroMemory(&m_write, sizeof(OVERLAPPED));
+	resetBuffers();
+}
+
+bool NamedPipeTransport::writeSegments(const TransportSegment* segments, size_t count)
+{
+	// WriteFileGather only supports files, so every segment is one write; small messages arrive here as one batch anyway
+	for (size_t i = 0; i < count; ++i)
+	{
+		const char* data = static_cast<const char*>(segments[i].data);
+		size_t size = segments[i].size;
+		while (size > 0)
+		{
+			DWORD written = 0;
+			ResetEvent(m_write.hEvent);
+			if (!WriteFile(m_pipe, data, static_cast<DWORD>(std::min(size, g_maxWrite)), &written, &m_write))
+			{
+				if (GetLastError() != ERROR_IO_PENDING || !GetOverlappedResult(m_pipe, &m_write, &written, TRUE))
+					return fail("Could not write to the pipe: " + lastError());
+			}
+			data += written;
+			size -= written;
+		}
+	}
+	return true;
+}
+
+int64_t NamedPipeTransport::readSome(void* data, size_t size, int timeout)
+{
+	DWORD numRead = 0;
+	ResetEvent(m_read.hEvent);
+	if (!ReadFile(m_pipe, data, static_cast<DWORD>(std::min(size, g_maxWrite)), &numRead, &m_read))
+	{
+		DWORD error = GetLastError();
+		if (error != ERROR_IO_PENDING)
+		{
+			fail(error == ERROR_BROKEN_PIPE ? "The connection was closed." : "Could not read from the pipe: " + std::to_string(error));
+			return -1;
+		}
+
+		if (WaitForSingleObject(m_read.hEvent, timeout < 0 ? INFINITE : static_cast<DWORD>(timeout)) != WAIT_OBJECT_0)
+		{
+			// Data may have arrived while the read was cancelled
+			CancelIoEx(m_pipe, &m_read);
+			if (GetOverlappedResult(m_pipe, &m_read, &numRead, TRUE) && numRead > 0)
+				return numRead;
+			return 0;
+		}
+		if (!GetOverlappedResult(m_pipe, &m_read, &numRead, FALSE))
+		{
+			error = GetLastError();
+			fail(error == ERROR_BROKEN_PIPE ? "The connection was closed." : "Could not read from the pipe: " + std::to_string(error));
+			return -1;
+		}
+	}
+	if (numRead == 0)
+	{
+		fail("The connection was closed.");
+		return -1;
+	}
+	return numRead;
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef PIPE_TRANSPORT_H
+#define PIPE_TRANSPORT_H
+
+#ifdef _WIN32
+
+#include "transport.h"
+
+#include <Windows.h>
+#include <atomic>
+
+// Transport over a Win32 byte mode named pipe "\\.\pipe\<name>" with overlapped I/O, so reads and accept() can time out and
+// one thread may write while another one reads
+class NamedPipeTransport : public Transport
+{
+public:
+	NamedPipeTransport();
+	~NamedPipeTransport();
+
+	bool listen(const std::string& name) override;
+	bool accept(int timeout) override;
+	bool connect(const std::string& name, int timeout) override;
+	void close() override;
+	bool isConnected() const override { return m_connected; };
+
+protected:
+	bool writeSegments(const TransportSegment* segments, size_t count) override;
+	int64_t readSome(void* data, size_t size, int timeout) override;
+
+private:
+	bool open(HANDLE pipe);
+
+	HANDLE m_pipe;
+	std::atomic<bool> m_connected;
+	bool m_listening; // m_pipe waits for a client
+
+	// Separate events, the directions are used from different threads
+	OVERLAPPED m_read;
+	OVERLAPPED m_write;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,117 @@
+#include "pngFile.h"
+
+#include <QByteArray>
+
+#include <fstream>
+#include <vector>
+
+namespace
+{
+	// CRC-32 of the chunks (ISO 3309, as zlib)
+	struct CrcTable
+	{
+		CrcTable()
+		{
+			for (uint32_t n = 0; n < 256; ++n)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; ++k)
+					c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				values[n] = c;
+			}
+		}
+
+		uint32_t values[256];
+	};
+
+	const CrcTable CRC_TABLE;
+
+	uint32_t crc(const char* data, size_t size, uint32_t c = 0xffffffffu)
+	{
+		for (size_t i = 0; i < size; ++i)
+			c = CRC_TABLE.values[(c ^ static_cast<uint8_t>(data[i])) & 0xff] ^ (c >> 8);
+		return c;
+	}
+
+	void appendUInt32(std::vector<char>& out, uint32_t value)
+	{
+		out.push_back(static_cast<char>(value >> 24));
+		out.push_back(static_cast<char>(value >> 16));
+		out.push_back(static_cast<char>(value >> 8));
+		out.push_back(static_cast<char>(value));
+	}
+
+	void appendChunk(std::vector<char>& out, const char* type, const char* data, size_t size)
+	{
+		appendUInt32(out, static_cast<uint32_t>(size));
+		const size_t start = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data, data + size);
+		appendUInt32(out, crc(&out[start], size + 4) ^ 0xffffffffu);
+	}
+}
+
+bool PngFile::write(const std::string& path, int width, int height, int channels, int bitDepth, const void* samples, int level, std::string* error)
+{
+	static const uint8_t COLOR_TYPES[5] = { 0, 0, 4, 2, 6 }; // Gray, gray + alpha, RGB, RGBA by channels
+	if (width <= 0 || height <= 0 || channels < 1 || channels > 4 || (bitDepth != 8 && bitDepth != 16))
+	{
+		if (error)
+			*error = "Unsupported image format.";
+		return false;
+	}
+
+	// Big endian samples with the Sub filter: each byte minus the same byte of the previous pixel
+	const size_t bytesPerPixel = static_cast<size_t>(channels) * bitDepth / 8;
+	const size_t rowBytes = bytesPerPixel * width;
+	std::vector<char> filtered((rowBytes + 1) * height);
+	std::vector<uint8_t> row(rowBytes);
+	for (int y = 0; y < height; ++y)
+	{
+		if (bitDepth == 16)
+		{
+			const uint16_t* in = static_cast<const uint16_t*>(samples) + static_cast<size_t>(y) * width * channels;
+			for (size_t i = 0; i < rowBytes / 2; ++i)
+			{
+				row[2 * i] = static_cast<uint8_t>(in[i] >> 8);
+				row[2 * i + 1] = static_cast<uint8_t>(in[i]);
+			}
+		}
+		else
+		{
+			const uint8_t* in = static_cast<const uint8_t*>(samples) + static_cast<size_t>(y) * rowBytes;
+			row.assign(in, in + rowBytes);
+		}
+
+		char* out = &filtered[(rowBytes + 1) * y];
+		out[0] = 1;
+		for (size_t i = 0; i < rowBytes; ++i)
+			out[i + 1] = static_cast<char>(i < bytesPerPixel ? row[i] : row[i] - row[i - bytesPerPixel]);
+	}
+
+	// qCompress prefixes the zlib stream with its uncompressed size
+	QByteArray compressed = qCompress(reinterpret_cast<const uchar*>(filtered.data()), static_cast<int>(filtered.size()), level);
+
+	std::vector<char> png = { '\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n' };
+	std::vector<char> header;
+	appendUInt32(header, static_cast<uint32_t>(width));
+	appendUInt32(header, static_cast<uint32_t>(height));
+	header.push_back(static_cast<char>(bitDepth));
+	header.push_back(static_cast<char>(COLOR_TYPES[channels]));
+	header.push_back(0); // Deflate
+	header.push_back(0); // Adaptive filtering
+	header.push_back(0); // No interlacing
+	appendChunk(png, "IHDR", header.data(), header.size());
+	appendChunk(png, "IDAT", compressed.constData() + 4, compressed.size() - 4);
+	appendChunk(png, "IEND", nullptr, 0);
+
+	std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	file.write(png.data(), png.size());
+	if (!file)
+	{
+		if (error)
+			*error = "Failed to write '" + path + "'.";
+		return false;
+	}
+	return true;
+}
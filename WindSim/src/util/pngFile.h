@@ -0,0 +1,16 @@
+#ifndef PNG_FILE_H
+#define PNG_FILE_H
+
+#include <string>
+#include <cstdint>
+
+// Minimal PNG encoder for images of the simulation (slices, snapshots): gray, gray + alpha, RGB or RGBA with 8 or 16 bits per sample,
+// rows top to bottom. Each row is stored with the Sub filter, which suits smooth fields, and deflated by qCompress (zlib)
+namespace PngFile
+{
+	// <samples> has width * channels samples per row (uint8_t for 8 bits, uint16_t in native byte order for 16 bits)
+	// <level> is the zlib level; low levels keep up with image sequences, 9 gives the smallest files
+	bool write(const std::string& path, int width, int height, int channels, int bitDepth, const void* samples, int level = 1, std::string* error = nullptr);
+}
+
+#endif
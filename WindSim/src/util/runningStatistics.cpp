@@ -0,0 +1,199 @@
+#include "runningStatistics.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+	const double PI = 3.14159265358979323846;
+}
+
+RunningStatistics::Result::Result()
+	: count(0),
+	mean(0.0),
+	variance(0.0),
+	deviation(0.0),
+	last(0.0),
+	windowCount(0),
+	windowMin(0.0),
+	windowMax(0.0),
+	windowMean(0.0),
+	frequency(0.0),
+	amplitude(0.0)
+{
+}
+
+RunningStatistics::RunningStatistics(int window)
+	: m_window(window < 4 ? 4 : window + (window & 1)),
+	m_count(0),
+	m_mean(0.0),
+	m_m2(0.0),
+	m_last(0.0),
+	m_values(m_window, 0.0),
+	m_times(m_window, 0.0),
+	m_next(0),
+	m_filled(0),
+	m_windowSum(0.0),
+	m_index(0),
+	m_minQueue(),
+	m_maxQueue(),
+	m_bins(m_window / 2 + 1),
+	m_twiddles(m_window),
+	m_sinceRecompute(0)
+{
+	for (int j = 0; j < m_window; ++j)
+		m_twiddles[j] = std::polar(1.0, -2.0 * PI * j / m_window);
+}
+
+void RunningStatistics::add(double time, double value)
+{
+	if (!std::isfinite(value))
+		return;
+
+	m_count++;
+	const double delta = value - m_mean;
+	m_mean += delta / m_count;
+	m_m2 += delta * (value - m_mean);
+	m_last = value;
+
+	const double leaving = m_values[m_next]; // 0 until the window is full
+	m_values[m_next] = value;
+	m_times[m_next] = time;
+	m_next = (m_next + 1) % m_window;
+	if (m_filled < m_window)
+		m_filled++;
+	m_windowSum += value - leaving;
+
+	while (!m_minQueue.empty() && m_minQueue.back().second >= value)
+		m_minQueue.pop_back();
+	m_minQueue.push_back(std::make_pair(m_index, value));
+	while (!m_maxQueue.empty() && m_maxQueue.back().second <= value)
+		m_maxQueue.pop_back();
+	m_maxQueue.push_back(std::make_pair(m_index, value));
+	m_index++;
+	while (m_minQueue.front().first + m_window < m_index)
+		m_minQueue.pop_front();
+	while (m_maxQueue.front().first + m_window < m_index)
+		m_maxQueue.pop_front();
+
+	// X_k(n) = e^(2 pi i k / N) * (X_k(n - 1) + x(n) - x(n - N)), the rotation is the conjugate of twiddle k
+	if (++m_sinceRecompute >= m_window)
+	{
+		recompute();
+	}
+	else
+	{
+		const double change = value - leaving;
+		for (size_t k = 0; k < m_bins.size(); ++k)
+			m_bins[k] = (m_bins[k] + change) * std::conj(m_twiddles[k]);
+	}
+}
+
+void RunningStatistics::reset()
+{
+	m_count = 0;
+	m_mean = 0.0;
+	m_m2 = 0.0;
+	m_last = 0.0;
+	std::fill(m_values.begin(), m_values.end(), 0.0);
+	std::fill(m_times.begin(), m_times.end(), 0.0);
+	m_next = 0;
+	m_filled = 0;
+	m_windowSum = 0.0;
+	m_index = 0;
+	m_minQueue.clear();
+	m_maxQueue.clear();
+	std::fill(m_bins.begin(), m_bins.end(), std::complex<double>());
+	m_sinceRecompute = 0;
+}
+
+void RunningStatistics::recompute()
+{
+	// Oldest sample first, as the recursion keeps them
+	for (size_t k = 0; k < m_bins.size(); ++k)
+	{
+		std::complex<double> sum;
+		for (int m = 0; m < m_window; ++m)
+			sum += m_values[(m_next + m) % m_window] * m_twiddles[(k * m) % m_window];
+		m_bins[k] = sum;
+	}
+	m_sinceRecompute = 0;
+}
+
+double RunningStatistics::amplitude(int bin) const
+{
+	if (bin == 0)
+		return std::abs(m_bins[0]) / m_window; // The mean
+
+	// Hann window applied in the frequency domain (0.5 X_k - 0.25 (X_k-1 + X_k+1)) to the window without its mean, which keeps the leakage
+	// of the trend of the signal out of the bins further away; the bin beyond Nyquist is the conjugate of the one below (real samples)
+	const int last = m_window / 2;
+	const std::complex<double> below = bin > 1 ? m_bins[bin - 1] : std::complex<double>();
+	const std::complex<double> above = bin < last ? m_bins[bin + 1] : std::conj(m_bins[last - 1]);
+	const std::complex<double> windowed = 0.5 * m_bins[bin] - 0.25 * (below + above);
+
+	// Both halves of the spectrum except for the Nyquist bin, divided by the mean of the window function (0.5)
+	const double scale = bin == last ? 2.0 : 4.0;
+	return scale * std::abs(windowed) / m_window;
+}
+
+RunningStatistics::Result RunningStatistics::getResult() const
+{
+	Result result;
+	result.count = m_count;
+	result.mean = m_mean;
+	result.variance = m_count > 1 ? m_m2 / m_count : 0.0;
+	result.deviation = std::sqrt(result.variance);
+	result.last = m_last;
+	result.windowCount = m_filled;
+	if (m_filled > 0)
+	{
+		result.windowMin = m_minQueue.front().second;
+		result.windowMax = m_maxQueue.front().second;
+		result.windowMean = m_windowSum / m_filled;
+	}
+
+	std::vector<double> amplitudes;
+	double binWidth = 0.0;
+	getSpectrum(amplitudes, binWidth);
+	if (!amplitudes.empty())
+	{
+		int peak = 1;
+		for (int k = 2; k < static_cast<int>(amplitudes.size()); ++k)
+		{
+			if (amplitudes[k] > amplitudes[peak])
+				peak = k;
+		}
+
+		// The maximum of a parabola through the logarithms of the peak and its neighbours lies between the bins
+		double offset = 0.0;
+		if (peak > 1 && peak + 1 < static_cast<int>(amplitudes.size()) && amplitudes[peak - 1] > 0.0 && amplitudes[peak + 1] > 0.0) // Bin 0 is the mean
+		{
+			const double a = std::log(amplitudes[peak - 1]), b = std::log(amplitudes[peak]), c = std::log(amplitudes[peak + 1]);
+			const double denominator = a - 2.0 * b + c;
+			if (denominator < 0.0)
+				offset = 0.5 * (a - c) / denominator;
+		}
+		result.frequency = (peak + offset) * binWidth;
+		result.amplitude = amplitudes[peak];
+	}
+	return result;
+}
+
+void RunningStatistics::getSpectrum(std::vector<double>& amplitudes, double& binWidth) const
+{
+	amplitudes.clear();
+	binWidth = 0.0;
+	if (m_filled < m_window)
+		return;
+
+	// m_next is the oldest sample of a full window
+	const double span = m_times[(m_next + m_window - 1) % m_window] - m_times[m_next];
+	if (!(span > 0.0))
+		return;
+	binWidth = (m_window - 1) / (span * m_window); // 1 / (window * mean interval)
+
+	amplitudes.resize(m_bins.size());
+	for (size_t k = 0; k < m_bins.size(); ++k)
+		amplitudes[k] = amplitude(static_cast<int>(k));
+}
@@ -0,0 +1,78 @@
+#ifndef RUNNING_STATISTICS_H
+#define RUNNING_STATISTICS_H
+
+#include <vector>
+#include <deque>
+#include <complex>
+#include <utility>
+#include <cstdint>
+
+// Statistics of a signal, updated sample by sample instead of over a recorded series:
+// - mean and variance of all samples with Welford's method, which needs no sum of squares and stays accurate for long runs
+// - minimum and maximum of the last <window> samples with a monotonic queue each (amortized constant time per sample)
+// - spectrum of the last <window> samples with a sliding DFT: each bin is corrected by the entering and the leaving sample and rotated
+//   by one sample, which takes window / 2 complex products per sample instead of an FFT of the whole window. The bins are recomputed from
+//   the window every <window> samples, so the rounding errors of the recursion do not accumulate. The amplitudes are those of the window
+//   without its mean and with a Hann window (applied to the bins), the frequency of the peak is interpolated between the bins. A drift of the
+//   signal, e.g. while the flow starts up, shows up in the lowest bins
+// The frequencies assume equidistant samples with the mean interval of the window. Values, which are not finite, are skipped
+class RunningStatistics
+{
+public:
+	struct Result
+	{
+		Result();
+		uint64_t count;
+		double mean;
+		double variance; // Of all samples (population variance), 0 below 2 samples
+		double deviation; // Standard deviation, the RMS of the fluctuation around the mean
+		double last;
+		int windowCount; // Samples in the window, up to its length
+		double windowMin;
+		double windowMax;
+		double windowMean;
+		double frequency; // Of the strongest component of the window (without its mean) in 1/s, 0 until the window is full
+		double amplitude; // Of that component
+	};
+
+	RunningStatistics(int window = 256); // At least 4 samples, rounded up to an even number
+
+	// <time> in seconds, increasing
+	void add(double time, double value);
+	void reset();
+
+	Result getResult() const;
+	int getWindow() const { return m_window; };
+
+	// Amplitudes of the bins 0 (the mean) to window / 2 of the window (bin k has k periods per window) and the width of a bin in 1/s;
+	// empty until the window is full
+	void getSpectrum(std::vector<double>& amplitudes, double& binWidth) const;
+
+private:
+	void recompute();
+	double amplitude(int bin) const;
+
+	int m_window;
+
+	// Welford
+	uint64_t m_count;
+	double m_mean;
+	double m_m2; // Sum of the squared differences to the mean
+	double m_last;
+
+	// Ring of the last <window> samples
+	std::vector<double> m_values;
+	std::vector<double> m_times;
+	int m_next;
+	int m_filled;
+	double m_windowSum;
+	uint64_t m_index; // Of the next sample, for the queues
+	std::deque<std::pair<uint64_t, double>> m_minQueue; // Increasing values, the front is the minimum of the window
+	std::deque<std::pair<uint64_t, double>> m_maxQueue; // Decreasing values
+
+	std::vector<std::complex<double>> m_bins; // 0 to window / 2
+	std::vector<std::complex<double>> m_twiddles; // e^(-2 pi i j / window)
+	int m_sinceRecompute;
+};
+
+#endif
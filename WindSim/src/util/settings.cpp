@@ -16,6 +16,12 @@ Settings conf = {
 		false, // showInfo
 		false // printInfo
 	},
+	// Simulation
+	{
+		SolverType::OpenCL, // solver
+		false, // outOfProcess
+		30000 // hostTimeout
+	},
 	// Mesh
 	{
 		{ 204, 204, 204 }, // DefaultColor rgb
@@ -36,9 +42,48 @@ Settings conf = {
 		false,
 		Pressure,
 		0.85
+	},
+
+	// Cpu
+	{
+		0 // threads
+	},
+
+	// Voxelization
+	{
+		128, // sdfResolution
+		3 // sdfBand
+	},
+
+	// Recording
+	{
+		0.0f, // errorBound
+		1, // interval
+		3, // queueFrames
+		2, // threads
+		true // dropFrames
+	},
+
+	// Playback
+	{
+		true, // loop
+		4, // prefetchFrames
+		0 // threads
+	},
+
+	// Publishing
+	{
+		false, // enabled
+		"windsim-fields", // name
+		3, // slots
+		1 // interval
 	}
 };
 
+static std::string solverName(SolverType solver)
+{
+	return solver == SolverType::CpuLbm ? "CpuLbm" : (solver == SolverType::CpuProjection ? "CpuProjection" : "OpenCL");
+}
 
 void loadIni(const std::string& path)
 {
@@ -63,6 +108,12 @@ void loadIni(const std::string& path)
 	conf.opencl.showInfo = std::stoi(getIniVal(iniMap, "OpenCL", "ShowInfo", std::to_string(conf.opencl.showInfo)));
 	conf.opencl.printInfo = std::stoi(getIniVal(iniMap, "OpenCL", "PrintInfo", std::to_string(conf.opencl.printInfo)));
 
+	std::string solver = solverName(conf.sim.solver);
+	solver = getIniVal(iniMap, "Simulation", "Solver", solver);
+	conf.sim.solver = solver == "CpuLbm" ? SolverType::CpuLbm : (solver == "CpuProjection" ? SolverType::CpuProjection : SolverType::OpenCL);
+	conf.sim.outOfProcess = std::stoi(getIniVal(iniMap, "Simulation", "OutOfProcess", std::to_string(conf.sim.outOfProcess)));
+	conf.sim.hostTimeout = std::stoi(getIniVal(iniMap, "Simulation", "HostTimeout", std::to_string(conf.sim.hostTimeout)));
+
 	conf.mesh.dc.r = std::stoi(getIniVal(iniMap, "Mesh", "DefaultColor.red", std::to_string(conf.mesh.dc.r)));
 	conf.mesh.dc.g = std::stoi(getIniVal(iniMap, "Mesh", "DefaultColor.green", std::to_string(conf.mesh.dc.g)));
 	conf.mesh.dc.b = std::stoi(getIniVal(iniMap, "Mesh", "DefaultColor.blue", std::to_string(conf.mesh.dc.b)));
@@ -88,6 +139,26 @@ void loadIni(const std::string& path)
 	std::string method = conf.dyn.method == Pressure ? "Pressure" : "Velocity";
 	method = getIniVal(iniMap, "Dynamics", "Method", method);
 	conf.dyn.method= method == "Pressure" ? Pressure : Velocity;
+
+	conf.cpu.threads = std::stoi(getIniVal(iniMap, "CPU", "Threads", std::to_string(conf.cpu.threads)));
+
+	conf.vox.sdfResolution = std::stoi(getIniVal(iniMap, "Voxelization", "DistanceField.resolution", std::to_string(conf.vox.sdfResolution)));
+	conf.vox.sdfBand = std::stoi(getIniVal(iniMap, "Voxelization", "DistanceField.band", std::to_string(conf.vox.sdfBand)));
+
+	conf.rec.errorBound = std::stof(getIniVal(iniMap, "Recording", "ErrorBound", std::to_string(conf.rec.errorBound)));
+	conf.rec.interval = std::stoi(getIniVal(iniMap, "Recording", "Interval", std::to_string(conf.rec.interval)));
+	conf.rec.queueFrames = std::stoi(getIniVal(iniMap, "Recording", "QueueFrames", std::to_string(conf.rec.queueFrames)));
+	conf.rec.threads = std::stoi(getIniVal(iniMap, "Recording", "Threads", std::to_string(conf.rec.threads)));
+	conf.rec.dropFrames = std::stoi(getIniVal(iniMap, "Recording", "DropFrames", std::to_string(conf.rec.dropFrames)));
+
+	conf.play.loop = std::stoi(getIniVal(iniMap, "Playback", "Loop", std::to_string(conf.play.loop)));
+	conf.play.prefetchFrames = std::stoi(getIniVal(iniMap, "Playback", "PrefetchFrames", std::to_string(conf.play.prefetchFrames)));
+	conf.play.threads = std::stoi(getIniVal(iniMap, "Playback", "Threads", std::to_string(conf.play.threads)));
+
+	conf.pub.enabled = std::stoi(getIniVal(iniMap, "Publishing", "Enabled", std::to_string(conf.pub.enabled)));
+	conf.pub.name = getIniVal(iniMap, "Publishing", "Name", conf.pub.name);
+	conf.pub.slots = std::stoi(getIniVal(iniMap, "Publishing", "Slots", std::to_string(conf.pub.slots)));
+	conf.pub.interval = std::stoi(getIniVal(iniMap, "Publishing", "Interval", std::to_string(conf.pub.interval)));
 }
 
 void storeIni(const std::string& path)
@@ -100,11 +171,41 @@ void storeIni(const std::string& path)
 	out << "ShowInfo=" << conf.opencl.showInfo << std::endl;
 	out << "PrintInfo=" << conf.opencl.printInfo << std::endl;
 	out << std::endl;
+	out << "[Simulation]\n";
+	out << "Solver=" << solverName(conf.sim.solver) << std::endl;
+	out << "OutOfProcess=" << conf.sim.outOfProcess << std::endl;
+	out << "HostTimeout=" << conf.sim.hostTimeout << std::endl;
+	out << std::endl;
 	out << "[Dynamics]\n";
 	out << "ShowDynDuringMod=" << conf.dyn.showDynDuringMod << std::endl;
 	out << "FrictionCoefficient=" << conf.dyn.frictionCoefficient << std::endl;
 	out << "Method=" << (conf.dyn.method == Pressure ? "Pressure" : "Velocity") << std::endl;
 	out << std::endl;
+	out << "[CPU]\n";
+	out << "Threads=" << conf.cpu.threads << std::endl;
+	out << std::endl;
+	out << "[Voxelization]\n";
+	out << "DistanceField.resolution=" << conf.vox.sdfResolution << std::endl;
+	out << "DistanceField.band=" << conf.vox.sdfBand << std::endl;
+	out << std::endl;
+	out << "[Recording]\n";
+	out << "ErrorBound=" << conf.rec.errorBound << std::endl;
+	out << "Interval=" << conf.rec.interval << std::endl;
+	out << "QueueFrames=" << conf.rec.queueFrames << std::endl;
+	out << "Threads=" << conf.rec.threads << std::endl;
+	out << "DropFrames=" << conf.rec.dropFrames << std::endl;
+	out << std::endl;
+	out << "[Playback]\n";
+	out << "Loop=" << conf.play.loop << std::endl;
+	out << "PrefetchFrames=" << conf.play.prefetchFrames << std::endl;
+	out << "Threads=" << conf.play.threads << std::endl;
+	out << std::endl;
+	out << "[Publishing]\n";
+	out << "Enabled=" << conf.pub.enabled << std::endl;
+	out << "Name=" << conf.pub.name << std::endl;
+	out << "Slots=" << conf.pub.slots << std::endl;
+	out << "Interval=" << conf.pub.interval << std::endl;
+	out << std::endl;
 	out << "[Camera]\n";
 	out << "FirstPerson.rotationSpeed=" << conf.cam.fp.rotationSpeed << std::endl;
 	out << "FirstPerson.translationSpeed=" << conf.cam.fp.translationSpeed << std::endl;
@@ -37,6 +37,13 @@ struct Settings
 		bool printInfo;
 	} opencl;
 
+	struct Simulation
+	{
+		SolverType solver; // Backend of newly created simulations
+		bool outOfProcess; // Run the solver in the simulation host process (WindSimHost), which may crash without the GUI
+		int hostTimeout; // Maximum time for a step of the simulation host in ms, 0 waits forever
+	} sim;
+
 	struct Mesh
 	{
 		struct DefaultColor
@@ -80,6 +87,41 @@ struct Settings
 		DynamicsMethod method; // The method, used for calculating dynamics
 		float frictionCoefficient; // The amount of velocity, which remains after one second without further force effect
 	} dyn;
+
+	struct Cpu
+	{
+		int threads; // Number of worker threads for CPU side grid processing, 0 uses all hardware threads
+	} cpu;
+
+	struct Voxelization
+	{
+		int sdfResolution; // Number of distance field cells along the longest side of a mesh
+		int sdfBand; // Width of the narrow band of the distance field in cells
+	} vox;
+
+	struct Recording
+	{
+		float errorBound; // Maximum absolute error of the recorded fields, 0 records lossless
+		int interval; // Record every n-th simulation step
+		int queueFrames; // Number of frames, which may wait for compression
+		int threads; // Compression threads
+		bool dropFrames; // Skip steps instead of waiting when the queue is full
+	} rec;
+
+	struct Playback
+	{
+		bool loop; // Restart at the first frame after the last one
+		int prefetchFrames; // Number of frames, which are decoded ahead of the shown one
+		int threads; // Decoding threads, 0 uses all hardware threads
+	} play;
+
+	struct Publishing
+	{
+		bool enabled; // Publish the fields of the running simulation for other processes (see FieldPublisher)
+		std::string name; // Shared memory name, which the subscribers attach to
+		int slots; // Number of steps in the ring
+		int interval; // Publish every n-th simulation step
+	} pub;
 };
 
 
@@ -0,0 +1,184 @@
+#include "sharedMemory.h"
+
+#include <atomic>
+#include <cstdint>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace
+{
+	std::atomic<int> g_nameCounter(0);
+
+	// Platform object name of a shared memory name
+	std::string systemName(const std::string& name)
+	{
+#ifdef _WIN32
+		return "Local\\" + name;
+#else
+		return "/" + name;
+#endif
+	}
+
+	std::string lastError()
+	{
+#ifdef _WIN32
+		return std::to_string(GetLastError());
+#else
+		return std::strerror(errno);
+#endif
+	}
+}
+
+SharedMemory::SharedMemory()
+	: m_name(),
+	m_owner(false),
+	m_data(nullptr),
+	m_size(0),
+	m_error(),
+#ifdef _WIN32
+	m_mapping(NULL)
+#else
+	m_fd(-1)
+#endif
+{
+}
+
+SharedMemory::~SharedMemory()
+{
+	close();
+}
+
+std::string SharedMemory::uniqueName(const std::string& prefix)
+{
+#ifdef _WIN32
+	unsigned long pid = GetCurrentProcessId();
+#else
+	unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+	return prefix + "-" + std::to_string(pid) + "-" + std::to_string(g_nameCounter++);
+}
+
+void SharedMemory::remove(const std::string& name)
+{
+#ifndef _WIN32
+	shm_unlink(systemName(name).c_str());
+#endif
+}
+
+bool SharedMemory::create(const std::string& name, size_t size)
+{
+	close();
+	m_name = name;
+	m_owner = true;
+	m_size = size;
+
+#ifdef _WIN32
+	uint64_t size64 = size;
+	m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64 & 0xffffffff), systemName(name).c_str());
+	if (m_mapping == NULL)
+		return fail("Could not create the shared memory '" + name + "': " + lastError());
+	if (GetLastError() == ERROR_ALREADY_EXISTS)
+		return fail("The shared memory '" + name + "' exists already.");
+
+	m_data = static_cast<char*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size));
+	if (!m_data)
+		return fail("Could not map the shared memory '" + name + "': " + lastError());
+#else
+	m_fd = shm_open(systemName(name).c_str(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	if (m_fd < 0)
+	{
+		m_owner = false; // Do not unlink the object of somebody else
+		return fail("Could not create the shared memory '" + name + "': " + lastError());
+	}
+
+	// The object is extended with zeros
+	if (ftruncate(m_fd, static_cast<off_t>(size)) != 0)
+		return fail("Could not resize the shared memory '" + name + "': " + lastError());
+
+	void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (data == MAP_FAILED)
+		return fail("Could not map the shared memory '" + name + "': " + lastError());
+	m_data = static_cast<char*>(data);
+#endif
+
+	return true;
+}
+
+bool SharedMemory::open(const std::string& name, bool readOnly)
+{
+	close();
+	m_name = name;
+	m_owner = false;
+
+#ifdef _WIN32
+	DWORD access = readOnly ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS;
+	m_mapping = OpenFileMappingA(access, FALSE, systemName(name).c_str());
+	if (m_mapping == NULL)
+		return fail("Could not open the shared memory '" + name + "': " + lastError());
+
+	m_data = static_cast<char*>(MapViewOfFile(m_mapping, access, 0, 0, 0));
+	if (!m_data)
+		return fail("Could not map the shared memory '" + name + "': " + lastError());
+
+	// The size of a mapping is not queryable, the view covers it rounded up to pages
+	MEMORY_BASIC_INFORMATION info;
+	if (VirtualQuery(m_data, &info, sizeof(info)) == 0)
+		return fail("Could not query the shared memory '" + name + "': " + lastError());
+	m_size = info.RegionSize;
+#else
+	m_fd = shm_open(systemName(name).c_str(), readOnly ? O_RDONLY : O_RDWR, 0);
+	if (m_fd < 0)
+		return fail("Could not open the shared memory '" + name + "': " + lastError());
+
+	struct stat info;
+	if (fstat(m_fd, &info) != 0)
+		return fail("Could not query the shared memory '" + name + "': " + lastError());
+	m_size = static_cast<size_t>(info.st_size);
+
+	void* data = mmap(nullptr, m_size, readOnly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (data == MAP_FAILED)
+		return fail("Could not map the shared memory '" + name + "': " + lastError());
+	m_data = static_cast<char*>(data);
+#endif
+
+	return true;
+}
+
+void SharedMemory::close()
+{
+#ifdef _WIN32
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != NULL)
+		CloseHandle(m_mapping);
+	m_mapping = NULL;
+#else
+	if (m_data)
+		munmap(m_data, m_size);
+	if (m_fd >= 0)
+	{
+		::close(m_fd);
+		if (m_owner)
+			shm_unlink(systemName(m_name).c_str());
+	}
+	m_fd = -1;
+#endif
+
+	m_data = nullptr;
+	m_size = 0;
+	m_owner = false;
+}
+
+bool SharedMemory::fail(const std::string& msg)
+{
+	close();
+	m_error = msg;
+	return false;
+}
@@ -0,0 +1,48 @@
+#ifndef SHARED_MEMORY_H
+#define SHARED_MEMORY_H
+
+#include <string>
+#include <cstddef>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+// Named memory, which is mapped by several processes: a POSIX shared memory object (shm_open) or a Win32 file mapping backed by the paging file
+// The creator owns the name; on POSIX it is unlinked when the creator closes the memory, mappings of other processes stay valid until they close
+class SharedMemory
+{
+public:
+	SharedMemory();
+	~SharedMemory();
+
+	bool create(const std::string& name, size_t size); // Fails if the name exists already; the memory is zero initialized
+	bool open(const std::string& name, bool readOnly = false); // Maps the whole memory of another process
+	void close();
+
+	bool isOpen() const { return m_data != nullptr; };
+	char* data() const { return m_data; };
+	size_t size() const { return m_size; };
+	const std::string& getName() const { return m_name; };
+	const std::string& errorString() const { return m_error; };
+
+	static std::string uniqueName(const std::string& prefix); // <prefix>-<process id>-<counter>, valid on all platforms
+	static void remove(const std::string& name); // Removes the name left behind by a crashed creator (POSIX only, Win32 names end with the last handle)
+
+private:
+	bool fail(const std::string& msg);
+
+	std::string m_name;
+	bool m_owner;
+	char* m_data;
+	size_t m_size;
+	std::string m_error;
+
+#ifdef _WIN32
+	HANDLE m_mapping;
+#else
+	int m_fd;
+#endif
+};
+
+#endif
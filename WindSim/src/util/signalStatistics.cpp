@@ -0,0 +1,160 @@
+#include "signalStatistics.h"
+
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+SignalStatistics::SignalStatistics(int window, int queueSamples)
+	: m_window(window),
+	m_queueSamples(std::max(queueSamples, 1)),
+	m_worker(),
+	m_queueMutex(),
+	m_queueCond(),
+	m_idleCond(),
+	m_queue(),
+	m_busy(false),
+	m_clear(false),
+	m_stopping(false),
+	m_signals(),
+	m_resultMutex(),
+	m_results(),
+	m_summary(),
+	m_numDropped(0)
+{
+}
+
+SignalStatistics::~SignalStatistics()
+{
+	if (!m_worker.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_stopping = true;
+	}
+	m_queueCond.notify_one();
+	m_worker.join();
+}
+
+void SignalStatistics::add(const std::string& name, double time, double value)
+{
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+	if (static_cast<int>(m_queue.size()) >= m_queueSamples)
+	{
+		m_numDropped++;
+		return;
+	}
+
+	Sample sample = { name, time, value };
+	m_queue.push_back(sample);
+	if (!m_worker.joinable())
+		m_worker = std::thread(&SignalStatistics::analyse, this);
+	lock.unlock();
+	m_queueCond.notify_one();
+}
+
+void SignalStatistics::clear()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_queue.clear();
+		m_clear = true;
+	}
+	std::lock_guard<std::mutex> lock(m_resultMutex);
+	m_results.clear();
+	m_summary.clear();
+}
+
+void SignalStatistics::flush()
+{
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+	m_idleCond.wait(lock, [this] { return m_queue.empty() && !m_busy; });
+}
+
+std::vector<SignalStatistics::Signal> SignalStatistics::getSignals() const
+{
+	std::lock_guard<std::mutex> lock(m_resultMutex);
+	return m_results;
+}
+
+bool SignalStatistics::getSignal(const std::string& name, RunningStatistics::Result& result) const
+{
+	std::lock_guard<std::mutex> lock(m_resultMutex);
+	for (const Signal& signal : m_results)
+	{
+		if (signal.name == name)
+		{
+			result = signal.result;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string SignalStatistics::getSummary() const
+{
+	std::lock_guard<std::mutex> lock(m_resultMutex);
+	return m_summary;
+}
+
+void SignalStatistics::analyse()
+{
+	std::vector<Sample> batch;
+	for (;;)
+	{
+		bool clear;
+		{
+			std::unique_lock<std::mutex> lock(m_queueMutex);
+			m_busy = false;
+			m_idleCond.notify_all();
+			m_queueCond.wait(lock, [this] { return m_stopping || m_clear || !m_queue.empty(); });
+			if (m_stopping)
+				return;
+
+			// The samples of a batch are swapped out, so the producers are not blocked while they are analysed
+			batch.clear();
+			std::swap(batch, m_queue);
+			clear = m_clear;
+			m_clear = false;
+			m_busy = true;
+		}
+
+		if (clear)
+			m_signals.clear();
+
+		// Samples of the same signal arrive in order, so they are added in the order of the batch
+		for (const Sample& sample : batch)
+		{
+			auto it = m_signals.find(sample.name);
+			if (it == m_signals.end())
+				it = m_signals.insert(std::make_pair(sample.name, RunningStatistics(m_window))).first;
+			it->second.add(sample.time, sample.value);
+		}
+
+		std::vector<Signal> results;
+		results.reserve(m_signals.size());
+		std::ostringstream summary;
+		summary << std::setprecision(3);
+		for (const auto& signal : m_signals)
+		{
+			Signal s = { signal.first, signal.second.getResult() };
+			summary << s.name << ": " << s.result.mean << " +- " << s.result.deviation << " [" << s.result.windowMin << ", " << s.result.windowMax << "]";
+			if (s.result.frequency > 0.0)
+				summary << " " << s.result.frequency << " Hz";
+			summary << "\n";
+			results.push_back(s);
+		}
+		std::string text = summary.str();
+		if (!text.empty())
+			text.pop_back();
+
+		// A clear during the analysis drops the results of the batch as well
+		std::lock_guard<std::mutex> queueLock(m_queueMutex);
+		if (!m_clear)
+		{
+			std::lock_guard<std::mutex> lock(m_resultMutex);
+			m_results.swap(results);
+			m_summary = text;
+		}
+	}
+}
@@ -0,0 +1,79 @@
+#ifndef SIGNAL_STATISTICS_H
+#define SIGNAL_STATISTICS_H
+
+#include "runningStatistics.h"
+
+#include <vector>
+#include <map>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+// Running statistics (see RunningStatistics) of named signals, e.g. the torque of the meshes and the values at the probes
+// Producers only queue their samples; a background thread updates the statistics and formats the summary for the info overlay, so the
+// thread, which produces the samples (the simulation or the render thread), does not pay for the analysis. The queue is bounded; when the
+// analysis falls behind, further samples are dropped and counted. Signals are created with their first sample
+class SignalStatistics
+{
+public:
+	struct Signal
+	{
+		std::string name;
+		RunningStatistics::Result result;
+	};
+
+	SignalStatistics(int window = 256, int queueSamples = 1 << 16);
+	~SignalStatistics();
+
+	// Thread safe; <time> in seconds, increasing per signal
+	void add(const std::string& name, double time, double value);
+
+	// Removes all signals and queued samples
+	void clear();
+
+	// Waits until the queued samples are analysed
+	void flush();
+
+	// Statistics as of the last analysed samples, thread safe
+	std::vector<Signal> getSignals() const; // Sorted by name
+	bool getSignal(const std::string& name, RunningStatistics::Result& result) const;
+	std::string getSummary() const; // One line per signal (mean +- deviation [window range] frequency), empty without signals
+
+	int getWindow() const { return m_window; };
+	uint64_t getNumDropped() const { return m_numDropped; };
+
+private:
+	struct Sample
+	{
+		std::string name;
+		double time;
+		double value;
+	};
+
+	void analyse();
+
+	int m_window;
+	int m_queueSamples;
+
+	std::thread m_worker; // Started with the first sample
+	std::mutex m_queueMutex; // Guards the queue and the flags
+	std::condition_variable m_queueCond;
+	std::condition_variable m_idleCond;
+	std::vector<Sample> m_queue;
+	bool m_busy; // The worker analyses a batch
+	bool m_clear; // The worker drops its signals before the next batch
+	bool m_stopping;
+
+	std::map<std::string, RunningStatistics> m_signals; // Of the worker
+
+	mutable std::mutex m_resultMutex; // Guards the results and the summary
+	std::vector<Signal> m_results;
+	std::string m_summary;
+
+	std::atomic<uint64_t> m_numDropped;
+};
+
+#endif
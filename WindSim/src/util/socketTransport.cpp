@@ -0,0 +1,246 @@
+#ifndef _WIN32
+
+#include "socketTransport.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
+#include <algorithm>
+
+#ifndef IOV_MAX
+#define IOV_MAX 16
+#endif
+
+namespace
+{
+	std::string lastError()
+	{
+		return std::strerror(errno);
+	}
+
+	// Not inherited by child processes, so the end of a peer is noticed although this process starts others
+	int createSocket()
+	{
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd >= 0)
+			fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+		int on = 1;
+		if (fd >= 0)
+			setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+		return fd;
+	}
+
+	bool address(const std::string& path, sockaddr_un& addr)
+	{
+		std::memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(addr.sun_path))
+			return false;
+		std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+		return true;
+	}
+}
+
+UnixSocketTransport::UnixSocketTransport()
+	: Transport(),
+	m_socket(-1),
+	m_listener(-1),
+	m_path(),
+	m_vectors()
+{
+}
+
+UnixSocketTransport::~UnixSocketTransport()
+{
+	close();
+}
+
+std::string UnixSocketTransport::socketPath(const std::string& name)
+{
+	const char* dir = std::getenv("TMPDIR");
+	std::string path = dir && *dir ? dir : "/tmp";
+	if (path.back() != '/')
+		path += '/';
+	return path + name + ".sock";
+}
+
+bool UnixSocketTransport::listen(const std::string& name)
+{
+	close();
+
+	sockaddr_un addr;
+	std::string path = socketPath(name);
+	if (!address(path, addr))
+		return fail("Socket path '" + path + "' is too long.");
+
+	m_listener = createSocket();
+	if (m_listener < 0)
+		return fail("Could not create a socket: " + lastError());
+
+	if (bind(m_listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(m_listener, 1) != 0)
+	{
+		std::string error = "Could not listen on '" + path + "': " + lastError();
+		closeListener();
+		return fail(error);
+	}
+	m_path = path;
+	return true;
+}
+
+bool UnixSocketTransport::accept(int timeout)
+{
+	if (m_listener < 0)
+		return fail("Not listening.");
+
+	pollfd fd = { m_listener, POLLIN, 0 };
+	int ready = poll(&fd, 1, timeout);
+	if (ready == 0)
+		return fail("No connection within " + std::to_string(timeout) + " ms.");
+	if (ready < 0)
+		return fail("Could not wait for a connection: " + lastError());
+
+	int socket = ::accept(m_listener, nullptr, nullptr);
+	if (socket < 0)
+		return fail("Could not accept a connection: " + lastError());
+	fcntl(socket, F_SETFD, FD_CLOEXEC);
+
+	// A single peer per endpoint
+	closeListener();
+	resetBuffers();
+	m_socket = socket;
+	return true;
+}
+
+bool UnixSocketTransport::connect(const std::string& name, int timeout)
+{
+	close();
+
+	sockaddr_un addr;
+	std::string path = socketPath(name);
+	if (!address(path, addr))
+		return fail("Socket path '" + path + "' is too long.");
+
+	// The listener may not exist yet
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout, 0));
+	for (;;)
+	{
+		int socket = createSocket();
+		if (socket < 0)
+			return fail("Could not create a socket: " + lastError());
+		if (::connect(socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0)
+		{
+			resetBuffers();
+			m_socket = socket;
+			return true;
+		}
+
+		int error = errno;
+		std::string msg = lastError();
+		::close(socket);
+		if ((error != ENOENT && error != ECONNREFUSED) || (timeout >= 0 && std::chrono::steady_clock::now() >= deadline))
+			return fail("Could not connect to '" + path + "': " + msg);
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+}
+
+void UnixSocketTransport::close()
+{
+	closeListener();
+	int socket = m_socket.exchange(-1);
+	if (socket >= 0)
+		::close(socket);
+	resetBuffers();
+}
+
+void UnixSocketTransport::closeListener()
+{
+	if (m_listener >= 0)
+		::close(m_listener);
+	if (!m_path.empty())
+		unlink(m_path.c_str());
+	m_listener = -1;
+	m_path.clear();
+}
+
+bool UnixSocketTransport::writeSegments(const TransportSegment* segments, size_t count)
+{
+	m_vectors.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		m_vectors[i].iov_base = const_cast<void*>(segments[i].data);
+		m_vectors[i].iov_len = segments[i].size;
+	}
+
+	iovec* vectors = m_vectors.data();
+	while (count > 0)
+	{
+		msghdr msg;
+		std::memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = vectors;
+		msg.msg_iovlen = std::min<size_t>(count, IOV_MAX);
+
+#ifdef MSG_NOSIGNAL
+		ssize_t written = sendmsg(m_socket, &msg, MSG_NOSIGNAL);
+#else
+		ssize_t written = sendmsg(m_socket, &msg, 0);
+#endif
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written < 0)
+			return fail("Could not send: " + lastError());
+
+		// Skip the written segments, a partial one continues from its rest
+		size_t rest = static_cast<size_t>(written);
+		while (count > 0 && rest >= vectors->iov_len)
+		{
+			rest -= vectors->iov_len;
+			++vectors;
+			--count;
+		}
+		if (count > 0)
+		{
+			vectors->iov_base = static_cast<char*>(vectors->iov_base) + rest;
+			vectors->iov_len -= rest;
+		}
+	}
+	return true;
+}
+
+int64_t UnixSocketTransport::readSome(void* data, size_t size, int timeout)
+{
+	for (;;)
+	{
+		pollfd fd = { m_socket, POLLIN, 0 };
+		int ready = poll(&fd, 1, timeout);
+		if (ready < 0 && errno == EINTR)
+			continue;
+		if (ready < 0)
+		{
+			fail("Could not wait for data: " + lastError());
+			return -1;
+		}
+		if (ready == 0)
+			return 0;
+
+		ssize_t numRead = recv(m_socket, data, std::min<size_t>(size, SSIZE_MAX), 0);
+		if (numRead < 0 && errno == EINTR)
+			continue;
+		if (numRead <= 0)
+		{
+			fail(numRead == 0 ? "The connection was closed." : "Could not receive: " + lastError());
+			return -1;
+		}
+		return numRead;
+	}
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef SOCKET_TRANSPORT_H
+#define SOCKET_TRANSPORT_H
+
+#ifndef _WIN32
+
+#include "transport.h"
+
+#include <sys/uio.h>
+#include <atomic>
+
+// Transport over a Unix domain stream socket; the endpoint <name> is a socket file in the temporary directory ($TMPDIR or /tmp),
+// which is removed as soon as the peer connected; WindSimHost uses it on Linux (WindSim/CMakeLists.txt)
+class UnixSocketTransport : public Transport
+{
+public:
+	UnixSocketTransport();
+	~UnixSocketTransport();
+
+	bool listen(const std::string& name) override;
+	bool accept(int timeout) override;
+	bool connect(const std::string& name, int timeout) override;
+	void close() override;
+	bool isConnected() const override { return m_socket >= 0; };
+
+protected:
+	bool writeSegments(const TransportSegment* segments, size_t count) override;
+	int64_t readSome(void* data, size_t size, int timeout) override;
+
+private:
+	static std::string socketPath(const std::string& name);
+	void closeListener();
+
+	std::atomic<int> m_socket;
+	int m_listener;
+	std::string m_path; // Socket file of the listener
+	std::vector<iovec> m_vectors;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef STEP_LISTENER_H
+#define STEP_LISTENER_H
+
+#include <DirectXMath.h>
+
+#include <vector>
+#include <memory>
+
+// Fields of one step in memory of the simulation; the simulation reuses them once no listener holds them
+struct FieldBuffers
+{
+	std::vector<float> velocity; // 4 floats per cell (xyz, padding)
+	std::vector<float> pressure;
+	std::vector<float> density;
+};
+
+// Fields of one simulation step; the pointers are only valid during StepListener::stepPublished, unless the listener holds <buffers>
+struct FieldFrame
+{
+	int step;
+	double time; // Simulated time in seconds
+	DirectX::XMUINT3 resolution;
+	const float* velocity; // 4 floats per cell (xyz, padding)
+	const float* pressure;
+	const float* density; // Null if the step has no smoke density
+	const char* cellTypes; // wtl::CellType per cell as the solver used them in this step, null if unknown
+	std::shared_ptr<const FieldBuffers> buffers; // Owner of velocity, pressure and density, null if they are in memory of the solver
+};
+
+// Receives the fields of every simulation step (see Simulator::addStepListener)
+// Called in the simulation thread while the solver waits, so implementations have to hand the data off quickly, e.g. by holding the buffers
+class StepListener
+{
+public:
+	virtual ~StepListener() {};
+
+	virtual void stepPublished(const FieldFrame& frame) = 0;
+};
+
+#endif
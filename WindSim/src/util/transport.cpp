@@ -0,0 +1,257 @@
+#include "transport.h"
+
+#ifdef _WIN32
+#include "pipeTransport.h"
+#else
+#include "socketTransport.h"
+#endif
+
+#include <cstring>
+#include <algorithm>
+#include <limits>
+
+const size_t Transport::BATCH_LIMIT;
+const size_t Transport::BATCH_CAPACITY;
+const size_t Transport::READ_BUFFER_SIZE;
+
+BufferPool::BufferPool(size_t maxBuffers)
+	: m_mutex(),
+	m_free(),
+	m_maxBuffers(maxBuffers)
+{
+	m_free.reserve(maxBuffers);
+}
+
+BufferPool::~BufferPool()
+{
+	for (auto buffer : m_free)
+		delete buffer;
+}
+
+BufferPool::Buffer BufferPool::acquire(size_t size)
+{
+	std::vector<char>* buffer = nullptr;
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		if (!m_free.empty())
+		{
+			buffer = m_free.back();
+			m_free.pop_back();
+		}
+	}
+	if (!buffer)
+		buffer = new std::vector<char>();
+
+	buffer->resize(size);
+	Release release = { this };
+	return Buffer(buffer, release);
+}
+
+void BufferPool::release(std::vector<char>* buffer)
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+	if (m_free.size() < m_maxBuffers)
+		m_free.push_back(buffer);
+	else
+		delete buffer;
+}
+
+std::unique_ptr<Transport> Transport::create()
+{
+#ifdef _WIN32
+	return std::unique_ptr<Transport>(new NamedPipeTransport());
+#else
+	return std::unique_ptr<Transport>(new UnixSocketTransport());
+#endif
+}
+
+Transport::Transport()
+	: m_errorMutex(),
+	m_error(),
+	m_sendMutex(),
+	m_batch(),
+	m_gather(),
+	m_receiveMutex(),
+	m_readBuffer(READ_BUFFER_SIZE),
+	m_readBegin(0),
+	m_readEnd(0),
+	m_pool()
+{
+	m_batch.reserve(BATCH_CAPACITY);
+}
+
+bool Transport::send(uint32_t type, const void* payload, size_t size)
+{
+	TransportSegment segment = { payload, size };
+	return send(type, &segment, size > 0 ? 1 : 0);
+}
+
+bool Transport::send(uint32_t type, const TransportSegment* segments, size_t count)
+{
+	TransportFrame frame = { type, 0, 0 };
+	for (size_t i = 0; i < count; ++i)
+		frame.size += segments[i].size;
+
+	std::lock_guard<std::mutex> guard(m_sendMutex);
+
+	if (!isConnected())
+		return fail("Not connected.");
+
+	size_t frameSize = sizeof(frame) + static_cast<size_t>(frame.size);
+	if (frame.size <= BATCH_LIMIT)
+	{
+		if (m_batch.size() + frameSize > BATCH_CAPACITY && !flushBatch())
+			return false;
+
+		const char* header = reinterpret_cast<const char*>(&frame);
+		m_batch.insert(m_batch.end(), header, header + sizeof(frame));
+		for (size_t i = 0; i < count; ++i)
+		{
+			const char* data = static_cast<const char*>(segments[i].data);
+			m_batch.insert(m_batch.end(), data, data + segments[i].size);
+		}
+		return true;
+	}
+
+	// Keep the order of the batched messages, the payload is written from the memory of the caller
+	if (!flushBatch())
+		return false;
+
+	m_gather.clear();
+	TransportSegment header = { &frame, sizeof(frame) };
+	m_gather.push_back(header);
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (segments[i].size > 0)
+			m_gather.push_back(segments[i]);
+	}
+	return writeSegments(m_gather.data(), m_gather.size());
+}
+
+bool Transport::flush()
+{
+	std::lock_guard<std::mutex> guard(m_sendMutex);
+	return flushBatch();
+}
+
+bool Transport::flushBatch()
+{
+	if (m_batch.empty())
+		return true;
+
+	TransportSegment batch = { m_batch.data(), m_batch.size() };
+	bool success = writeSegments(&batch, 1);
+	m_batch.clear();
+	return success;
+}
+
+bool Transport::receive(Message& message, int timeout)
+{
+	// The peer may wait for a batched request before it answers
+	if (!flush())
+		return false;
+
+	auto deadline = Clock::now() + std::chrono::milliseconds(std::max(timeout, 0));
+	if (timeout < 0)
+		deadline = Clock::time_point::max();
+
+	bool timedOut = false;
+	bool success = false;
+	{
+		std::lock_guard<std::mutex> guard(m_receiveMutex);
+		message.payload.reset();
+		message.size = 0;
+
+		TransportFrame frame;
+		if (readExactly(reinterpret_cast<char*>(&frame), sizeof(frame), deadline, timedOut))
+		{
+			if (frame.size > std::numeric_limits<size_t>::max())
+			{
+				fail("Message of " + std::to_string(frame.size) + " bytes is too large.");
+			}
+			else
+			{
+				message.type = frame.type;
+				message.size = static_cast<size_t>(frame.size);
+				message.payload = m_pool.acquire(message.size);
+				success = readExactly(message.payload->data(), message.size, deadline, timedOut);
+
+				// The header is consumed, so the stream is out of sync after any failure
+				timedOut = false;
+			}
+		}
+	}
+
+	// A timeout before the frame header leaves the stream intact, everything else does not
+	if (!success && !timedOut)
+		close();
+	return success;
+}
+
+bool Transport::readExactly(char* data, size_t size, Clock::time_point deadline, bool& timedOut)
+{
+	bool started = false;
+	while (size > 0)
+	{
+		size_t available = m_readEnd - m_readBegin;
+		if (available > 0)
+		{
+			size_t count = std::min(available, size);
+			std::memcpy(data, m_readBuffer.data() + m_readBegin, count);
+			m_readBegin += count;
+			data += count;
+			size -= count;
+			started = true;
+			continue;
+		}
+
+		int wait = -1;
+		if (deadline != Clock::time_point::max())
+			wait = static_cast<int>(std::max<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count(), 0));
+
+		// Large payloads are read directly into the message, everything else through the read buffer
+		bool direct = size >= m_readBuffer.size();
+		int64_t numRead = direct ? readSome(data, size, wait) : readSome(m_readBuffer.data(), m_readBuffer.size(), wait);
+		if (numRead < 0)
+			return false;
+		if (numRead == 0)
+		{
+			timedOut = !started;
+			return fail("Timed out while waiting for a message.");
+		}
+
+		started = true;
+		if (direct)
+		{
+			data += numRead;
+			size -= static_cast<size_t>(numRead);
+		}
+		else
+		{
+			m_readBegin = 0;
+			m_readEnd = static_cast<size_t>(numRead);
+		}
+	}
+	return true;
+}
+
+bool Transport::fail(const std::string& msg)
+{
+	std::lock_guard<std::mutex> guard(m_errorMutex);
+	m_error = msg;
+	return false;
+}
+
+std::string Transport::errorString() const
+{
+	std::lock_guard<std::mutex> guard(m_errorMutex);
+	return m_error;
+}
+
+void Transport::resetBuffers()
+{
+	std::lock_guard<std::mutex> sendGuard(m_sendMutex);
+	std::lock_guard<std::mutex> receiveGuard(m_receiveMutex);
+	m_batch.clear();
+	m_readBegin = m_readEnd = 0;
+}
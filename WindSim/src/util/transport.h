@@ -0,0 +1,124 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// Recycles message buffers, so steady traffic does not allocate; a buffer keeps its capacity while it is in the pool
+// The pool has to outlive the buffers it handed out, they may be returned from any thread
+class BufferPool
+{
+public:
+	struct Release
+	{
+		BufferPool* pool;
+		void operator()(std::vector<char>* buffer) const { pool->release(buffer); };
+	};
+	typedef std::unique_ptr<std::vector<char>, Release> Buffer;
+
+	explicit BufferPool(size_t maxBuffers = 16);
+	~BufferPool();
+
+	Buffer acquire(size_t size); // Buffer of <size> bytes
+
+private:
+	void release(std::vector<char>* buffer);
+
+	std::mutex m_mutex;
+	std::vector<std::vector<char>*> m_free;
+	size_t m_maxBuffers;
+};
+
+// Header of every message on the wire, followed by <size> bytes of payload
+struct TransportFrame
+{
+	uint32_t type;
+	uint32_t reserved;
+	uint64_t size;
+};
+
+// Part of a message, which is sent without copying it first (scatter/gather)
+struct TransportSegment
+{
+	const void* data;
+	size_t size;
+};
+
+// Connection to one other local process, which exchanges framed messages of any size
+// Small messages are collected and written with one system call by flush(), before receive() and when the batch is full; larger ones are
+// written directly from the segments of the caller. Reads fill a buffer, so a burst of small messages costs one system call as well.
+// One thread may send while another one receives; the backends are UnixSocketTransport and NamedPipeTransport (see create())
+class Transport
+{
+public:
+	struct Message
+	{
+		uint32_t type;
+		size_t size;
+		BufferPool::Buffer payload; // At least <size> bytes, goes back to the pool of the transport when the message is reused or destroyed
+
+		Message() : type(0), size(0), payload() {};
+		const char* data() const { return payload ? payload->data() : nullptr; };
+	};
+
+	static std::unique_ptr<Transport> create(); // Backend of the platform
+
+	Transport();
+	virtual ~Transport() {};
+
+	// The listening side creates the endpoint <name> and accepts a single peer, which connects with the same name; <timeout> in ms, negative waits forever
+	virtual bool listen(const std::string& name) = 0;
+	virtual bool accept(int timeout) = 0;
+	virtual bool connect(const std::string& name, int timeout) = 0;
+	virtual void close() = 0; // Discards batched messages
+	virtual bool isConnected() const = 0;
+
+	bool send(uint32_t type, const void* payload = nullptr, size_t size = 0);
+	bool send(uint32_t type, const TransportSegment* segments, size_t count);
+	bool flush();
+
+	// Waits at most <timeout> ms (negative: forever) for the next message, the previous payload of <message> is returned to the pool first
+	// A timeout within a message or the end of the connection closes the transport
+	bool receive(Message& message, int timeout);
+
+	std::string errorString() const;
+
+	static const size_t BATCH_LIMIT = 4096; // Larger messages are not copied into the batch
+	static const size_t BATCH_CAPACITY = 1 << 16;
+	static const size_t READ_BUFFER_SIZE = 1 << 16;
+
+protected:
+	// Writes all segments or fails
+	virtual bool writeSegments(const TransportSegment* segments, size_t count) = 0;
+	// Bytes read, 0 after <timeout> ms without data, negative if the connection ended or failed
+	virtual int64_t readSome(void* data, size_t size, int timeout) = 0;
+
+	bool fail(const std::string& msg);
+	void resetBuffers(); // For close() and new connections
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	bool flushBatch(); // Needs the send mutex
+	bool readExactly(char* data, size_t size, Clock::time_point deadline, bool& timedOut);
+
+	mutable std::mutex m_errorMutex;
+	std::string m_error;
+
+	std::mutex m_sendMutex;
+	std::vector<char> m_batch;
+	std::vector<TransportSegment> m_gather;
+
+	std::mutex m_receiveMutex;
+	std::vector<char> m_readBuffer;
+	size_t m_readBegin;
+	size_t m_readEnd;
+	BufferPool m_pool;
+};
+
+#endif